@@ -72,6 +72,7 @@
 // #define ASMJIT_DISABLE_TEXT       // Disable everything that contains text
 //                                   // representation (instructions, errors, ...).
 // #define ASMJIT_DISABLE_VALIDATION // Disable Validation (completely).
+// #define ASMJIT_DISABLE_ZONE_CACHE // Disable thread-local cache of Zone blocks.
 
 // Prevent compile-time errors caused by misconfiguration.
 #if defined(ASMJIT_DISABLE_TEXT) && !defined(ASMJIT_DISABLE_LOGGING)
@@ -20,6 +20,7 @@
 #include "./base/func.h"
 #include "./base/globals.h"
 #include "./base/inst.h"
+#include "./base/jitqueue.h"
 #include "./base/logging.h"
 #include "./base/operand.h"
 #include "./base/osutils.h"
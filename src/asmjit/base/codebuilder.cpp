@@ -26,11 +26,13 @@ namespace asmjit {
 CodeBuilder::CodeBuilder() noexcept
   : CodeEmitter(kTypeBuilder),
     _cbBaseZone(32768 - Zone::kZoneOverhead),
+    _cbNodeZone(32768 - Zone::kZoneOverhead),
     _cbDataZone(16384 - Zone::kZoneOverhead),
     _cbPassZone(32768 - Zone::kZoneOverhead),
     _cbHeap(&_cbBaseZone),
     _cbPasses(),
     _cbLabels(),
+    _cbLabelsLive(0),
     _firstNode(nullptr),
     _lastNode(nullptr),
     _cursor(nullptr),
@@ -49,9 +51,11 @@ Error CodeBuilder::onAttach(CodeHolder* code) noexcept {
 Error CodeBuilder::onDetach(CodeHolder* code) noexcept {
   _cbPasses.reset();
   _cbLabels.reset();
+  _cbLabelsLive = 0;
   _cbHeap.reset(&_cbBaseZone);
 
   _cbBaseZone.reset(false);
+  _cbNodeZone.reset(false);
   _cbDataZone.reset(false);
   _cbPassZone.reset(false);
 
@@ -85,13 +89,32 @@ Error CodeBuilder::getCBLabel(CBLabel** pOut, uint32_t id) noexcept {
     node = newNodeT<CBLabel>(id);
     if (ASMJIT_UNLIKELY(!node))
       return DebugUtils::errored(kErrorNoHeapMemory);
+
     _cbLabels[index] = node;
+    if (index < _cbLabelsLive)
+      _cbLabelsLive = index;
   }
 
   *pOut = node;
   return kErrorOk;
 }
 
+void CodeBuilder::_releaseNodes() noexcept {
+  // Only entries that were added or recreated since the last release can map
+  // to a node, so each entry is cleared only once.
+  size_t len = _cbLabels.getLength();
+  for (size_t i = _cbLabelsLive; i < len; i++)
+    _cbLabels[i] = nullptr;
+  _cbLabelsLive = len;
+
+  _cbNodeZone.reset(false);
+  _cbDataZone.reset(false);
+
+  _firstNode = nullptr;
+  _lastNode = nullptr;
+  _cursor = nullptr;
+}
+
 Error CodeBuilder::registerLabelNode(CBLabel* node) noexcept {
   if (_lastError) return _lastError;
   ASMJIT_ASSERT(_code != nullptr);
@@ -461,6 +484,10 @@ ASMJIT_FAVOR_SIZE CBPass* CodeBuilder::getPassByName(const char* name) const noe
 }
 
 ASMJIT_FAVOR_SIZE Error CodeBuilder::addPass(CBPass* pass) noexcept {
+  return insertPass(_cbPasses.getLength(), pass);
+}
+
+ASMJIT_FAVOR_SIZE Error CodeBuilder::insertPass(size_t index, CBPass* pass) noexcept {
   if (ASMJIT_UNLIKELY(pass == nullptr)) {
     // Since this is directly called by `addPassT()` we treat `null` argument
     // as out-of-memory condition. Otherwise it would be API misuse.
@@ -473,7 +500,10 @@ ASMJIT_FAVOR_SIZE Error CodeBuilder::addPass(CBPass* pass) noexcept {
     return DebugUtils::errored(kErrorInvalidState);
   }
 
-  ASMJIT_PROPAGATE(_cbPasses.append(&_cbHeap, pass));
+  if (ASMJIT_UNLIKELY(index > _cbPasses.getLength()))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  ASMJIT_PROPAGATE(_cbPasses.insert(&_cbHeap, index, pass));
   pass->_cb = this;
   return kErrorOk;
 }
@@ -505,75 +535,447 @@ Error CodeBuilder::serialize(CodeEmitter* dst) {
   Error err = kErrorOk;
   CBNode* node_ = getFirstNode();
 
-  do {
-    dst->setInlineComment(node_->getInlineComment());
+  while (node_) {
+    err = serializeNode(dst, node_);
+    if (err) break;
+    node_ = node_->getNext();
+  }
 
-    switch (node_->getType()) {
-      case CBNode::kNodeAlign: {
-        CBAlign* node = static_cast<CBAlign*>(node_);
-        err = dst->align(node->getMode(), node->getAlignment());
-        break;
-      }
+  return err;
+}
 
-      case CBNode::kNodeData: {
-        CBData* node = static_cast<CBData*>(node_);
-        err = dst->embed(node->getData(), node->getSize());
-        break;
+Error CodeBuilder::serializeNode(CodeEmitter* dst, CBNode* node_) {
+  Error err = kErrorOk;
+  dst->setInlineComment(node_->getInlineComment());
+
+  switch (node_->getType()) {
+    case CBNode::kNodeAlign: {
+      CBAlign* node = static_cast<CBAlign*>(node_);
+      err = dst->align(node->getMode(), node->getAlignment());
+      break;
+    }
+
+    case CBNode::kNodeData: {
+      CBData* node = static_cast<CBData*>(node_);
+      err = dst->embed(node->getData(), node->getSize());
+      break;
+    }
+
+    case CBNode::kNodeFunc:
+    case CBNode::kNodeLabel: {
+      CBLabel* node = static_cast<CBLabel*>(node_);
+      err = dst->bind(node->getLabel());
+      break;
+    }
+
+    case CBNode::kNodeLabelData: {
+      CBLabelData* node = static_cast<CBLabelData*>(node_);
+      err = dst->embedLabel(node->getLabel());
+      break;
+    }
+
+    case CBNode::kNodeConstPool: {
+      CBConstPool* node = static_cast<CBConstPool*>(node_);
+      err = dst->embedConstPool(node->getLabel(), node->getConstPool());
+      break;
+    }
+
+    case CBNode::kNodeInst:
+    case CBNode::kNodeFuncCall: {
+      CBInst* node = node_->as<CBInst>();
+      dst->setOptions(node->getOptions());
+      dst->setExtraReg(node->getExtraReg());
+      err = dst->emitOpArray(node->getInstId(), node->getOpArray(), node->getOpCount());
+      break;
+    }
+
+    case CBNode::kNodeComment: {
+      CBComment* node = static_cast<CBComment*>(node_);
+      err = dst->comment(node->getInlineComment());
+      break;
+    }
+
+    default:
+      break;
+  }
+
+  return err;
+}
+
+// ============================================================================
+// [asmjit::CBPass]
+// ============================================================================
+
+CBPass::CBPass(const char* name) noexcept
+  : _cb(nullptr),
+    _name(name) {}
+CBPass::~CBPass() noexcept {}
+
+// ============================================================================
+// [asmjit::CBFragment - Helpers]
+// ============================================================================
+
+//! \internal
+//!
+//! Find a register param matching `regType` and `regId`, or label param if
+//! `regType` is `Label::kLabelTag`. Returns `kInvalidValue` if not found.
+static uint32_t CBFragment_findRegOrLabel(
+  const Operand* params, uint32_t paramCount,
+  const uint32_t* labelIds, uint32_t labelCount,
+  uint32_t regType, uint32_t regId) noexcept {
+
+  uint32_t i;
+  if (regType == Label::kLabelTag) {
+    for (i = 0; i < paramCount; i++)
+      if (params[i].isLabel() && params[i].getId() == regId)
+        return i;
+
+    for (i = 0; i < labelCount; i++)
+      if (labelIds[i] == regId)
+        return paramCount + i;
+  }
+  else {
+    for (i = 0; i < paramCount; i++)
+      if (params[i].isReg() && params[i].as<Reg>().getType() == regType && params[i].getId() == regId)
+        return i;
+  }
+
+  return kInvalidValue;
+}
+
+//! \internal
+//!
+//! Add patches of operand `opIndex` to `patches` and return their count.
+static uint32_t CBFragment_patchOperand(
+  CBFragment::Patch* patches,
+  const Operand* params, uint32_t paramCount,
+  const uint32_t* labelIds, uint32_t labelCount,
+  const Operand& op, uint32_t opIndex) noexcept {
+
+  uint32_t slot = kInvalidValue;
+  uint32_t count = 0;
+  uint32_t i;
+
+  for (i = 0; i < paramCount; i++) {
+    if (op.isEqual(params[i])) {
+      slot = i;
+      break;
+    }
+  }
+
+  if (slot == kInvalidValue && op.isLabel())
+    slot = CBFragment_findRegOrLabel(params, paramCount, labelIds, labelCount, Label::kLabelTag, op.getId());
+
+  if (slot != kInvalidValue) {
+    patches[0].type = CBFragment::Patch::kTypeOperand;
+    patches[0].opIndex = static_cast<uint8_t>(opIndex);
+    patches[0].slot = static_cast<uint16_t>(slot);
+    return 1;
+  }
+
+  if (op.isMem()) {
+    const Mem& mem = op.as<Mem>();
+
+    if (mem.hasBase()) {
+      slot = CBFragment_findRegOrLabel(params, paramCount, labelIds, labelCount, mem.getBaseType(), mem.getBaseId());
+      if (slot != kInvalidValue) {
+        patches[count].type = CBFragment::Patch::kTypeBase;
+        patches[count].opIndex = static_cast<uint8_t>(opIndex);
+        patches[count].slot = static_cast<uint16_t>(slot);
+        count++;
       }
+    }
 
-      case CBNode::kNodeFunc:
-      case CBNode::kNodeLabel: {
-        CBLabel* node = static_cast<CBLabel*>(node_);
-        err = dst->bind(node->getLabel());
-        break;
+    if (mem.hasIndexReg()) {
+      slot = CBFragment_findRegOrLabel(params, paramCount, labelIds, labelCount, mem.getIndexType(), mem.getIndexId());
+      if (slot != kInvalidValue) {
+        patches[count].type = CBFragment::Patch::kTypeIndex;
+        patches[count].opIndex = static_cast<uint8_t>(opIndex);
+        patches[count].slot = static_cast<uint16_t>(slot);
+        count++;
       }
+    }
+  }
+
+  return count;
+}
+
+// ============================================================================
+// [asmjit::CBFragment - Construction / Destruction]
+// ============================================================================
+
+CBFragment::CBFragment() noexcept
+  : _zone(4096 - Zone::kZoneOverhead, 8),
+    _itemArray(nullptr),
+    _opArray(nullptr),
+    _patchArray(nullptr),
+    _paramArray(nullptr),
+    _itemCount(0),
+    _paramCount(0),
+    _labelCount(0),
+    _isValidated(false) {}
+CBFragment::~CBFragment() noexcept {}
+
+// ============================================================================
+// [asmjit::CBFragment - Init / Reset]
+// ============================================================================
+
+Error CBFragment::init(CBNode* first, CBNode* last, const Operand_* params, uint32_t paramCount) noexcept {
+  reset();
+
+  if (ASMJIT_UNLIKELY(!first || !last || paramCount > kMaxSlots))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  uint32_t labelIds[kMaxSlots];
+  uint32_t labelCount = 0;
+  uint32_t itemCount = 0;
+  uint32_t opCount = 0;
+  uint32_t i;
+
+  // First pass - count items and operands and collect labels bound by the
+  // fragment, as they can be referenced before they are bound.
+  CBNode* node_ = first;
+  for (;;) {
+    if (ASMJIT_UNLIKELY(!node_))
+      return DebugUtils::errored(kErrorInvalidArgument);
 
-      case CBNode::kNodeLabelData: {
-        CBLabelData* node = static_cast<CBLabelData*>(node_);
-        err = dst->embedLabel(node->getLabel());
+    switch (node_->getType()) {
+      case CBNode::kNodeInst:
+        opCount += static_cast<CBInst*>(node_)->getOpCount();
+        itemCount++;
         break;
-      }
 
-      case CBNode::kNodeConstPool: {
-        CBConstPool* node = static_cast<CBConstPool*>(node_);
-        err = dst->embedConstPool(node->getLabel(), node->getConstPool());
+      case CBNode::kNodeLabel: {
+        uint32_t labelId = static_cast<CBLabel*>(node_)->getId();
+        for (i = 0; i < paramCount; i++)
+          if (params[i].isLabel() && params[i].getId() == labelId)
+            break;
+
+        if (i == paramCount) {
+          if (ASMJIT_UNLIKELY(paramCount + labelCount >= kMaxSlots))
+            return DebugUtils::errored(kErrorInvalidArgument);
+          labelIds[labelCount++] = labelId;
+        }
+
+        opCount++;
+        itemCount++;
         break;
       }
 
-      case CBNode::kNodeInst:
-      case CBNode::kNodeFuncCall: {
-        CBInst* node = node_->as<CBInst>();
-        dst->setOptions(node->getOptions());
-        dst->setExtraReg(node->getExtraReg());
-        err = dst->emitOpArray(node->getInstId(), node->getOpArray(), node->getOpCount());
+      case CBNode::kNodeAlign:
+        itemCount++;
         break;
-      }
 
-      case CBNode::kNodeComment: {
-        CBComment* node = static_cast<CBComment*>(node_);
-        err = dst->comment(node->getInlineComment());
+      case CBNode::kNodeComment:
+      case CBNode::kNodeSentinel:
         break;
-      }
 
       default:
-        break;
+        return DebugUtils::errored(kErrorInvalidArgument);
     }
 
-    if (err) break;
+    if (node_ == last)
+      break;
     node_ = node_->getNext();
-  } while (node_);
+  }
 
-  return err;
+  // Each operand is patched at most twice (base and index of a memory operand).
+  _opArray = _zone.allocT<Operand>((opCount + paramCount) * sizeof(Operand) + 1);
+  _itemArray = _zone.allocT<Item>(itemCount * sizeof(Item) + 1);
+  _patchArray = _zone.allocT<Patch>(opCount * 2 * sizeof(Patch) + 1);
+
+  if (ASMJIT_UNLIKELY(!_opArray || !_itemArray || !_patchArray)) {
+    reset();
+    return DebugUtils::errored(kErrorNoHeapMemory);
+  }
+
+  _paramArray = _opArray + opCount;
+  for (i = 0; i < paramCount; i++)
+    _paramArray[i].copyFrom(params[i]);
+
+  // Second pass - record items.
+  uint32_t opIndex = 0;
+  uint32_t patchIndex = 0;
+
+  Item* item = _itemArray;
+  node_ = first;
+
+  for (;;) {
+    uint32_t type = node_->getType();
+
+    if (type == CBNode::kNodeInst || type == CBNode::kNodeLabel || type == CBNode::kNodeAlign) {
+      item->opCount = 0;
+      item->instId = 0;
+      item->options = 0;
+      item->opIndex = opIndex;
+      item->patchIndex = patchIndex;
+      item->extraReg.reset();
+
+      if (type == CBNode::kNodeInst) {
+        CBInst* node = static_cast<CBInst*>(node_);
+        const Operand* nodeOps = node->getOpArray();
+
+        item->type = Item::kTypeInst;
+        item->opCount = static_cast<uint8_t>(node->getOpCount());
+        item->instId = node->getInstId();
+        item->options = node->getOptions();
+        item->extraReg = node->getExtraReg();
+
+        for (i = 0; i < item->opCount; i++)
+          _opArray[opIndex + i].copyFrom(nodeOps[i]);
+      }
+      else if (type == CBNode::kNodeLabel) {
+        item->type = Item::kTypeLabel;
+        item->opCount = 1;
+        _opArray[opIndex].copyFrom(static_cast<CBLabel*>(node_)->getLabel());
+      }
+      else {
+        CBAlign* node = static_cast<CBAlign*>(node_);
+        item->type = Item::kTypeAlign;
+        item->instId = node->getAlignment();
+        item->options = node->getMode();
+      }
+
+      for (i = 0; i < item->opCount; i++)
+        patchIndex += CBFragment_patchOperand(_patchArray + patchIndex,
+          _paramArray, paramCount, labelIds, labelCount, _opArray[opIndex + i], i);
+
+      item->patchCount = static_cast<uint16_t>(patchIndex - item->patchIndex);
+      opIndex += item->opCount;
+      item++;
+    }
+
+    if (node_ == last)
+      break;
+    node_ = node_->getNext();
+  }
+
+  _itemCount = itemCount;
+  _paramCount = paramCount;
+  _labelCount = labelCount;
+  return kErrorOk;
+}
+
+void CBFragment::reset() noexcept {
+  _zone.reset(false);
+
+  _itemArray = nullptr;
+  _opArray = nullptr;
+  _patchArray = nullptr;
+  _paramArray = nullptr;
+  _itemCount = 0;
+  _paramCount = 0;
+  _labelCount = 0;
+  _isValidated = false;
 }
 
 // ============================================================================
-// [asmjit::CBPass]
+// [asmjit::CBFragment - Validate / Emit]
 // ============================================================================
 
-CBPass::CBPass(const char* name) noexcept
-  : _cb(nullptr),
-    _name(name) {}
-CBPass::~CBPass() noexcept {}
+Error CBFragment::validate(uint32_t archType) noexcept {
+  if (ASMJIT_UNLIKELY(!isInitialized()))
+    return DebugUtils::errored(kErrorNotInitialized);
+
+#if !defined(ASMJIT_DISABLE_VALIDATION)
+  for (uint32_t i = 0; i < _itemCount; i++) {
+    const Item& item = _itemArray[i];
+    if (item.type != Item::kTypeInst)
+      continue;
+
+    Inst::Detail detail(item.instId, item.options, item.extraReg);
+    ASMJIT_PROPAGATE(Inst::validate(archType, detail, _opArray + item.opIndex, item.opCount));
+  }
+
+  _isValidated = true;
+#else
+  ASMJIT_UNUSED(archType);
+#endif // !ASMJIT_DISABLE_VALIDATION
+
+  return kErrorOk;
+}
+
+Error CBFragment::emit(CodeEmitter* dst, const Operand_* args, uint32_t argCount) {
+  if (ASMJIT_UNLIKELY(!isInitialized()))
+    return DebugUtils::errored(kErrorNotInitialized);
+
+  if (ASMJIT_UNLIKELY(argCount != _paramCount))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  uint32_t i;
+  uint32_t paramCount = _paramCount;
+  Operand slots[kMaxSlots];
+
+  // A validated fragment stays valid only if the args are of the same kind.
+  uint32_t mask = _isValidated ? 0xFFFFFFFFU : static_cast<uint32_t>(Operand::kSignatureOpMask);
+  for (i = 0; i < paramCount; i++) {
+    if (ASMJIT_UNLIKELY(((args[i].getSignature() ^ _paramArray[i].getSignature()) & mask) != 0))
+      return DebugUtils::errored(kErrorInvalidArgument);
+    slots[i].copyFrom(args[i]);
+  }
+
+  for (i = 0; i < _labelCount; i++) {
+    Label label = dst->newLabel();
+    if (ASMJIT_UNLIKELY(!label.isValid()))
+      return DebugUtils::errored(kErrorNoHeapMemory);
+    slots[paramCount + i].copyFrom(label);
+  }
+
+  // Strict validation is not needed, the instructions have been validated.
+  // Immediates are the exception as their range depends on the value, so
+  // an instruction that has an immediate patched in is validated again.
+  uint32_t strict = _isValidated ? dst->_globalOptions & CodeEmitter::kOptionStrictValidation : 0;
+  dst->_globalOptions &= ~strict;
+
+  Error err = kErrorOk;
+  for (i = 0; i < _itemCount; i++) {
+    const Item& item = _itemArray[i];
+
+    Operand opArray[6];
+    uint32_t opCount = item.opCount;
+    uint32_t immStrict = 0;
+    uint32_t j;
+
+    for (j = 0; j < opCount; j++)
+      opArray[j].copyFrom(_opArray[item.opIndex + j]);
+
+    for (j = 0; j < item.patchCount; j++) {
+      const Patch& patch = _patchArray[item.patchIndex + j];
+      Operand& op = opArray[patch.opIndex];
+      const Operand& src = slots[patch.slot];
+
+      switch (patch.type) {
+        case Patch::kTypeOperand: op.copyFrom(src); immStrict |= src.isImm() ? strict : 0; break;
+        case Patch::kTypeBase   : op.as<Mem>()._setBase(op.as<Mem>().getBaseType(), src.getId()); break;
+        case Patch::kTypeIndex  : op.as<Mem>()._setIndex(op.as<Mem>().getIndexType(), src.getId()); break;
+      }
+    }
+
+    switch (item.type) {
+      case Item::kTypeInst:
+        dst->setOptions(item.options);
+        dst->setExtraReg(item.extraReg);
+        dst->_globalOptions |= immStrict;
+        err = dst->_emitOpArray(item.instId, opArray, opCount);
+        dst->_globalOptions &= ~immStrict;
+        break;
+
+      case Item::kTypeLabel:
+        err = dst->bind(opArray[0].as<Label>());
+        break;
+
+      case Item::kTypeAlign:
+        err = dst->align(item.options, item.instId);
+        break;
+    }
+
+    if (ASMJIT_UNLIKELY(err))
+      break;
+  }
+
+  dst->_globalOptions |= strict;
+  return err;
+}
 
 } // asmjit namespace
 
@@ -92,21 +92,43 @@ public:
   // [Node-Management]
   // --------------------------------------------------------------------------
 
+  //! \internal
+  //!
+  //! Allocate `size` bytes for a node and its trailing data (operands).
+  //!
+  //! Nodes are never released, so they are allocated sequentially from the
+  //! node zone instead of `_cbHeap`, which would round each node up to its
+  //! slot size. Nodes created one after another also end up next to each other
+  //! in memory, which makes iterating over them by passes cache friendly.
+  ASMJIT_INLINE void* _newNodeMem(size_t size) noexcept {
+    return _cbNodeZone.alloc(Utils::alignTo<size_t>(size, sizeof(intptr_t)));
+  }
+
   //! \internal
   template<typename T>
-  ASMJIT_INLINE T* newNodeT() noexcept { return new(_cbHeap.alloc(sizeof(T))) T(this); }
+  ASMJIT_INLINE T* newNodeT() noexcept { return new(_newNodeMem(sizeof(T))) T(this); }
 
   //! \internal
   template<typename T, typename P0>
-  ASMJIT_INLINE T* newNodeT(P0 p0) noexcept { return new(_cbHeap.alloc(sizeof(T))) T(this, p0); }
+  ASMJIT_INLINE T* newNodeT(P0 p0) noexcept { return new(_newNodeMem(sizeof(T))) T(this, p0); }
 
   //! \internal
   template<typename T, typename P0, typename P1>
-  ASMJIT_INLINE T* newNodeT(P0 p0, P1 p1) noexcept { return new(_cbHeap.alloc(sizeof(T))) T(this, p0, p1); }
+  ASMJIT_INLINE T* newNodeT(P0 p0, P1 p1) noexcept { return new(_newNodeMem(sizeof(T))) T(this, p0, p1); }
 
   //! \internal
   template<typename T, typename P0, typename P1, typename P2>
-  ASMJIT_INLINE T* newNodeT(P0 p0, P1 p1, P2 p2) noexcept { return new(_cbHeap.alloc(sizeof(T))) T(this, p0, p1, p2); }
+  ASMJIT_INLINE T* newNodeT(P0 p0, P1 p1, P2 p2) noexcept { return new(_newNodeMem(sizeof(T))) T(this, p0, p1, p2); }
+
+  //! \internal
+  //!
+  //! Release all nodes, their data, and the memory they use, and make the
+  //! node list empty. `CBLabel` nodes of labels that were already created are
+  //! created again by `getCBLabel()` when needed.
+  //!
+  //! The nodes must not be used after this call, they should be serialized
+  //! first.
+  ASMJIT_API void _releaseNodes() noexcept;
 
   ASMJIT_API Error registerLabelNode(CBLabel* node) noexcept;
   //! Get `CBLabel` by `id`.
@@ -177,14 +199,19 @@ public:
   template<typename T>
   ASMJIT_INLINE Error addPassT() noexcept { return addPass(newPassT<T>()); }
   template<typename T, typename P0>
-  ASMJIT_INLINE Error addPassT(P0 p0) noexcept { return addPass(newPassT<P0>(p0)); }
+  ASMJIT_INLINE Error addPassT(P0 p0) noexcept { return addPass(newPassT<T, P0>(p0)); }
   template<typename T, typename P0, typename P1>
-  ASMJIT_INLINE Error addPassT(P0 p0, P1 p1) noexcept { return addPass(newPassT<P0, P1>(p0, p1)); }
+  ASMJIT_INLINE Error addPassT(P0 p0, P1 p1) noexcept { return addPass(newPassT<T, P0, P1>(p0, p1)); }
 
   //! Get a `CBPass` by name.
   ASMJIT_API CBPass* getPassByName(const char* name) const noexcept;
   //! Add `pass` to the list of passes.
   ASMJIT_API Error addPass(CBPass* pass) noexcept;
+  //! Insert a `CBPass` at `index`, passes are processed in order.
+  //!
+  //! Can be used to run a pass before the passes added implicitly, for example
+  //! before the register allocator added by \ref CodeCompiler.
+  ASMJIT_API Error insertPass(size_t index, CBPass* pass) noexcept;
   //! Remove `pass` from the list of passes and delete it.
   ASMJIT_API Error deletePass(CBPass* pass) noexcept;
 
@@ -192,19 +219,24 @@ public:
   // [Serialization]
   // --------------------------------------------------------------------------
 
+  //! Serialize all nodes to `dst`.
   ASMJIT_API virtual Error serialize(CodeEmitter* dst);
+  //! Serialize a single `node` to `dst`.
+  ASMJIT_API Error serializeNode(CodeEmitter* dst, CBNode* node);
 
   // --------------------------------------------------------------------------
   // [Members]
   // --------------------------------------------------------------------------
 
-  Zone _cbBaseZone;                      //!< Base zone used to allocate nodes and `CBPass`.
+  Zone _cbBaseZone;                      //!< Base zone used to allocate `CBPass` and containers.
+  Zone _cbNodeZone;                      //!< Node zone used to allocate nodes and their operands.
   Zone _cbDataZone;                      //!< Data zone used to allocate data and names.
   Zone _cbPassZone;                      //!< Zone passed to `CBPass::process()`.
   ZoneHeap _cbHeap;                      //!< ZoneHeap that uses `_cbBaseZone`.
 
   ZoneVector<CBPass*> _cbPasses;         //!< Array of `CBPass` objects.
   ZoneVector<CBLabel*> _cbLabels;        //!< Maps label indexes to `CBLabel` nodes.
+  size_t _cbLabelsLive;                  //!< First index in `_cbLabels` that can map to a node.
 
   CBNode* _firstNode;                    //!< First node of the current section.
   CBNode* _lastNode;                     //!< Last node of the current section.
@@ -455,7 +487,9 @@ public:
 
 //! Instruction (CodeBuilder).
 //!
-//! Wraps an instruction with its options and operands.
+//! Wraps an instruction with its options and operands. Operands are stored
+//! right after the node (or after the structure that inherits it) and only
+//! their offset is kept in the node.
 class CBInst : public CBNode {
 public:
   ASMJIT_NONCOPYABLE(CBInst)
@@ -472,8 +506,14 @@ public:
     _instDetail.instId = static_cast<uint16_t>(instId);
     _instDetail.options = options;
 
+    // Operands are allocated together with the node, only their offset is
+    // stored (see `CodeBuilder::_newNodeMem()`).
+    ASMJIT_ASSERT(reinterpret_cast<uint8_t*>(opArray) >= reinterpret_cast<uint8_t*>(this));
+    ASMJIT_ASSERT(reinterpret_cast<uint8_t*>(opArray) - reinterpret_cast<uint8_t*>(this) <= 0xFFFF);
+
     _opCount = static_cast<uint8_t>(opCount);
-    _opArray = opArray;
+    _reserved = 0;
+    _opOffset = static_cast<uint16_t>(reinterpret_cast<uint8_t*>(opArray) - reinterpret_cast<uint8_t*>(this));
 
     _updateMemOp();
   }
@@ -522,10 +562,16 @@ public:
 
   //! Get operands count.
   ASMJIT_INLINE uint32_t getOpCount() const noexcept { return _opCount; }
+  //! Set operands count (the operand array must be large enough).
+  ASMJIT_INLINE void setOpCount(uint32_t opCount) noexcept { _opCount = static_cast<uint8_t>(opCount); }
   //! Get operands list.
-  ASMJIT_INLINE Operand* getOpArray() noexcept { return _opArray; }
+  ASMJIT_INLINE Operand* getOpArray() noexcept {
+    return reinterpret_cast<Operand*>(reinterpret_cast<uint8_t*>(this) + _opOffset);
+  }
   //! \overload
-  ASMJIT_INLINE const Operand* getOpArray() const noexcept { return _opArray; }
+  ASMJIT_INLINE const Operand* getOpArray() const noexcept {
+    return reinterpret_cast<const Operand*>(reinterpret_cast<const uint8_t*>(this) + _opOffset);
+  }
 
   //! Get whether the instruction contains a memory operand.
   ASMJIT_INLINE bool hasMemOp() const noexcept { return _memOpIndex != 0xFF; }
@@ -535,13 +581,13 @@ public:
   //! see `hasMemOp()`.
   ASMJIT_INLINE Mem* getMemOp() const noexcept {
     ASMJIT_ASSERT(hasMemOp());
-    return static_cast<Mem*>(&_opArray[_memOpIndex]);
+    return static_cast<Mem*>(&const_cast<CBInst*>(this)->getOpArray()[_memOpIndex]);
   }
   //! \overload
   template<typename T>
   ASMJIT_INLINE T* getMemOp() const noexcept {
     ASMJIT_ASSERT(hasMemOp());
-    return static_cast<T*>(&_opArray[_memOpIndex]);
+    return static_cast<T*>(&const_cast<CBInst*>(this)->getOpArray()[_memOpIndex]);
   }
 
   //! Set memory operand index, `0xFF` means no memory operand.
@@ -573,8 +619,8 @@ Update:
 
   Inst::Detail _instDetail;              //!< Instruction id, options, and extra register.
   uint8_t _memOpIndex;                   //!< \internal
-  uint8_t _reserved[7];                  //!< \internal
-  Operand* _opArray;                     //!< Instruction operands.
+  uint8_t _reserved;                     //!< \internal
+  uint16_t _opOffset;                    //!< Offset of instruction operands from the node.
 };
 
 // ============================================================================
@@ -903,6 +949,154 @@ public:
   ASMJIT_INLINE ~CBSentinel() noexcept {}
 };
 
+// ============================================================================
+// [asmjit::CBFragment]
+// ============================================================================
+
+//! Fragment of code recorded from a range of \ref CodeBuilder nodes, which
+//! can be emitted many times with different operands.
+//!
+//! A fragment is recorded by `init()` from instructions, labels, and
+//! alignments between two nodes (other nodes are not supported). Operands of
+//! the recorded instructions that match one of the params passed to `init()`
+//! become placeholders, which are replaced by args passed to `emit()`:
+//!
+//!   - Register and label params replace registers and labels equal to them,
+//!     and also base and index registers and base labels of memory operands.
+//!   - Immediate params replace immediates of the same value, so use values
+//!     that are not used by the fragment otherwise.
+//!   - Memory params replace memory operands equal to them.
+//!
+//! Labels bound by the fragment that are not params are replaced by new
+//! labels each time the fragment is emitted. Other operands are emitted as
+//! recorded.
+//!
+//! The fragment can be emitted to any \ref CodeEmitter (\ref Assembler or
+//! \ref CodeBuilder) and doesn't depend on the `CodeBuilder` it was recorded
+//! from. If the fragment was validated by `validate()` it's emitted without
+//! strict validation (see \ref CodeEmitter::kOptionStrictValidation), in such
+//! case each arg must have the same signature as its param (same operand
+//! type, register type, and size), which is checked by `emit()`.
+//!
+//! ~~~
+//! X86Gp dst = cc.newIntPtr(), src = cc.newIntPtr();
+//! CBNode* prev = cc.getCursor();
+//! cc.mov(x86::eax, x86::dword_ptr(src));
+//! cc.add(x86::dword_ptr(dst), x86::eax);
+//!
+//! Operand params[] = { dst, src };
+//! CBFragment fragment;
+//! fragment.init(prev->getNext(), cc.getCursor(), params, 2);
+//! cc.removeNodes(prev->getNext(), cc.getCursor());
+//! fragment.validate(cc.getArchType());
+//!
+//! Operand args[] = { x86::rdi, x86::rsi };
+//! fragment.emit(&a, args, 2);
+//! ~~~
+class CBFragment {
+public:
+  ASMJIT_NONCOPYABLE(CBFragment)
+
+  ASMJIT_ENUM(Limits) {
+    //! Maximum number of params and labels bound by the fragment (together).
+    kMaxSlots = 64
+  };
+
+  //! \internal
+  //!
+  //! Recorded item.
+  struct Item {
+    ASMJIT_ENUM(Type) {
+      kTypeInst  = 0,                    //!< Instruction.
+      kTypeLabel = 1,                    //!< Bind a label (the only operand).
+      kTypeAlign = 2                     //!< Align (`instId` is alignment, `options` is mode).
+    };
+
+    uint8_t type;                        //!< Item type.
+    uint8_t opCount;                     //!< Count of operands.
+    uint16_t patchCount;                 //!< Count of patches.
+    uint32_t instId;                     //!< Instruction id.
+    uint32_t options;                    //!< Instruction options.
+    uint32_t opIndex;                    //!< Index of the first operand in `_opArray`.
+    uint32_t patchIndex;                 //!< Index of the first patch in `_patchArray`.
+    RegOnly extraReg;                    //!< Extra register.
+  };
+
+  //! \internal
+  //!
+  //! Replacement of an operand (or its part) by an arg or a new label.
+  struct Patch {
+    ASMJIT_ENUM(Type) {
+      kTypeOperand = 0,                  //!< Replace the whole operand.
+      kTypeBase    = 1,                  //!< Replace the base id of a memory operand.
+      kTypeIndex   = 2                   //!< Replace the index id of a memory operand.
+    };
+
+    uint8_t type;                        //!< Patch type.
+    uint8_t opIndex;                     //!< Operand index (relative to the item).
+    uint16_t slot;                       //!< Index of the param or `paramCount + label index`.
+  };
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  //! Create an empty `CBFragment` instance.
+  ASMJIT_API CBFragment() noexcept;
+  //! Destroy the `CBFragment` instance.
+  ASMJIT_API ~CBFragment() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Init / Reset]
+  // --------------------------------------------------------------------------
+
+  //! Record nodes from `first` to `last` (inclusive), replacing operands that
+  //! match `params` by placeholders.
+  ASMJIT_API Error init(CBNode* first, CBNode* last, const Operand_* params, uint32_t paramCount) noexcept;
+  //! Reset the fragment and release its memory.
+  ASMJIT_API void reset() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  //! Get whether the fragment was recorded.
+  ASMJIT_INLINE bool isInitialized() const noexcept { return _itemArray != nullptr; }
+  //! Get whether the fragment was validated by `validate()`.
+  ASMJIT_INLINE bool isValidated() const noexcept { return _isValidated; }
+
+  //! Get count of recorded items (instructions, labels, and alignments).
+  ASMJIT_INLINE uint32_t getItemCount() const noexcept { return _itemCount; }
+  //! Get count of params.
+  ASMJIT_INLINE uint32_t getParamCount() const noexcept { return _paramCount; }
+  //! Get count of labels bound by the fragment that are not params.
+  ASMJIT_INLINE uint32_t getLabelCount() const noexcept { return _labelCount; }
+
+  // --------------------------------------------------------------------------
+  // [Validate / Emit]
+  // --------------------------------------------------------------------------
+
+  //! Validate all recorded instructions for `archType`.
+  ASMJIT_API Error validate(uint32_t archType) noexcept;
+
+  //! Emit the fragment to `dst` with params replaced by `args`.
+  ASMJIT_API Error emit(CodeEmitter* dst, const Operand_* args, uint32_t argCount);
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  Zone _zone;                            //!< Zone used to allocate recorded data.
+  Item* _itemArray;                      //!< Recorded items.
+  Operand* _opArray;                     //!< Recorded operands.
+  Patch* _patchArray;                    //!< Operand patches.
+  Operand* _paramArray;                  //!< Params.
+  uint32_t _itemCount;                   //!< Count of items.
+  uint32_t _paramCount;                  //!< Count of params.
+  uint32_t _labelCount;                  //!< Count of labels bound by the fragment (not params).
+  bool _isValidated;                     //!< Validated by `validate()`.
+};
+
 //! \}
 
 } // asmjit namespace
@@ -61,7 +61,8 @@ CodeCompiler::CodeCompiler() noexcept
     _vRegZone(4096 - Zone::kZoneOverhead),
     _vRegArray(),
     _localConstPool(nullptr),
-    _globalConstPool(nullptr) {
+    _globalConstPool(nullptr),
+    _streaming(false) {
 
   _type = kTypeCompiler;
 }
@@ -136,7 +137,7 @@ CCFunc* CodeCompiler::newFunc(const FuncSignature& sign) noexcept {
   // Allocate space for function arguments.
   func->_args = nullptr;
   if (func->getArgCount() != 0) {
-    func->_args = _cbHeap.allocT<VirtReg*>(func->getArgCount() * sizeof(VirtReg*));
+    func->_args = static_cast<VirtReg**>(_newNodeMem(func->getArgCount() * sizeof(VirtReg*)));
     if (!func->_args) goto _NoMemory;
 
     ::memset(func->_args, 0, func->getArgCount() * sizeof(VirtReg*));
@@ -193,6 +194,15 @@ CBSentinel* CodeCompiler::endFunc() {
 
   CBSentinel* end = func->getEnd();
   setCursor(end);
+
+  if (_streaming) {
+    // The flush error is reported by `getLastError()`.
+    Error err = flush();
+    if (ASMJIT_UNLIKELY(err) && !_lastError)
+      setLastError(err);
+    return nullptr;
+  }
+
   return end;
 }
 
@@ -223,7 +233,7 @@ CCFuncCall* CodeCompiler::newCall(uint32_t instId, const Operand_& o0, const Fun
   Error err;
   uint32_t nArgs;
 
-  CCFuncCall* node = _cbHeap.allocT<CCFuncCall>(sizeof(CCFuncCall) + sizeof(Operand));
+  CCFuncCall* node = static_cast<CCFuncCall*>(_newNodeMem(sizeof(CCFuncCall) + sizeof(Operand)));
   Operand* opArray = reinterpret_cast<Operand*>(reinterpret_cast<uint8_t*>(node) + sizeof(CCFuncCall));
 
   if (ASMJIT_UNLIKELY(!node))
@@ -241,7 +251,7 @@ CCFuncCall* CodeCompiler::newCall(uint32_t instId, const Operand_& o0, const Fun
   if ((nArgs = sign.getArgCount()) == 0)
     return node;
 
-  node->_args = static_cast<Operand*>(_cbHeap.alloc(nArgs * sizeof(Operand)));
+  node->_args = static_cast<Operand*>(_newNodeMem(nArgs * sizeof(Operand)));
   if (!node->_args) goto _NoMemory;
 
   ::memset(node->_args, 0, nArgs * sizeof(Operand));
@@ -464,10 +474,27 @@ Error CodeCompiler::_newConst(Mem& out, uint32_t scope, const void* data, size_t
   else
     return setLastError(DebugUtils::errored(kErrorInvalidArgument));
 
-  if (!*pPool && !(*pPool = newConstPool()))
-    return setLastError(DebugUtils::errored(kErrorNoHeapMemory));
-
   CBConstPool* pool = *pPool;
+  if (!pool) {
+    if (scope == kConstScopeLocal) {
+      // Constants of a local pool are released together with the function.
+      pool = newConstPool();
+      if (pool) pool->getConstPool().reset(&_cbNodeZone);
+    }
+    else {
+      // The global pool is not a part of the node list until `finalize()`,
+      // allocate it outside of nodes released by `flush()`.
+      void* p = _cbBaseZone.alloc(sizeof(CBConstPool));
+      pool = p ? new(p) CBConstPool(this) : nullptr;
+      if (pool && registerLabelNode(pool) != kErrorOk)
+        pool = nullptr;
+    }
+
+    if (!pool)
+      return setLastError(DebugUtils::errored(kErrorNoHeapMemory));
+    *pPool = pool;
+  }
+
   size_t off;
 
   Error err = pool->add(data, size, off);
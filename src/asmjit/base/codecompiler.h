@@ -121,8 +121,15 @@ struct VirtReg {
   //! Add a home register index to the home registers mask.
   ASMJIT_INLINE void addHomeId(uint32_t physId) { _homeMask |= Utils::mask(physId); }
 
+  //! Get mask of registers clobbered by function calls the variable is live across.
+  ASMJIT_INLINE uint32_t getCallClobberedMask() const { return _callClobberedMask; }
+
   ASMJIT_INLINE bool isFixed() const noexcept { return static_cast<bool>(_isFixed); }
 
+  //! Get whether the register holds a constant that can be rematerialized by
+  //! a single instruction instead of being saved and loaded by `RAPass`.
+  ASMJIT_INLINE bool isMaterialized() const noexcept { return static_cast<bool>(_isMaterialized); }
+
   //! Get whether the VirtReg is only memory allocated on the stack.
   ASMJIT_INLINE bool isStack() const noexcept { return static_cast<bool>(_isStack); }
 
@@ -168,6 +175,9 @@ struct VirtReg {
   uint32_t _raId;                        //!< Register allocator work-id (used by RAPass).
   int32_t _memOffset;                    //!< Home memory offset.
   uint32_t _homeMask;                    //!< Mask of all registers variable has been allocated to.
+  uint32_t _callClobberedMask;           //!< Mask of registers clobbered by calls the variable is live across.
+  uint32_t _rematInstId;                 //!< Instruction that rematerializes the register (if `_isMaterialized`).
+  Operand_ _rematOps[2];                 //!< Operands of `_rematInstId`, the first one is the register itself.
 
   uint8_t _state;                        //!< Variable state (connected with actual `RAState)`.
   uint8_t _physId;                       //!< Actual register index (only used by `RAPass)`, during translate.
@@ -442,9 +452,9 @@ public:
   ASMJIT_INLINE const FuncDetail& getDetail() const noexcept { return _funcDetail; }
 
   //! Get target operand.
-  ASMJIT_INLINE Operand& getTarget() noexcept { return static_cast<Operand&>(_opArray[0]); }
+  ASMJIT_INLINE Operand& getTarget() noexcept { return static_cast<Operand&>(getOpArray()[0]); }
   //! \overload
-  ASMJIT_INLINE const Operand& getTarget() const noexcept { return static_cast<const Operand&>(_opArray[0]); }
+  ASMJIT_INLINE const Operand& getTarget() const noexcept { return static_cast<const Operand&>(getOpArray()[0]); }
 
   //! Get return at `i`.
   ASMJIT_INLINE Operand& getRet(uint32_t i = 0) noexcept {
@@ -600,8 +610,37 @@ public:
   //! Add a new function.
   ASMJIT_API CCFunc* addFunc(const FuncSignature& sign);
   //! Emit a sentinel that marks the end of the current function.
+  //!
+  //! In streaming mode the function is flushed by `flush()` and null is
+  //! returned, as its nodes were released. If the flush failed its error is
+  //! returned by `getLastError()`.
   ASMJIT_API CBSentinel* endFunc();
 
+  // --------------------------------------------------------------------------
+  // [Streaming]
+  // --------------------------------------------------------------------------
+
+  //! Get whether the compiler is in streaming mode, see `setStreaming()`.
+  ASMJIT_INLINE bool isStreaming() const noexcept { return _streaming; }
+  //! Set whether the compiler is in streaming mode.
+  //!
+  //! In streaming mode each function is processed by all passes, serialized,
+  //! and released when `endFunc()` is called, so the memory used by the
+  //! compiler is bounded by the largest function instead of all functions.
+  //! All nodes and virtual registers created before `endFunc()` can't be used
+  //! after it (including functions created by `newFunc()` that were not added
+  //! yet, use a label bound before `addFunc()` to call a function defined
+  //! later), and passes only see one function at a time.
+  ASMJIT_INLINE void setStreaming(bool streaming) noexcept { _streaming = streaming; }
+
+  //! Process all nodes added so far by all passes, serialize them, and release
+  //! them together with all virtual registers. The nodes are released even if
+  //! processing or serialization failed, the error is set as the last error.
+  //!
+  //! Can't be called inside of a function. The global constant pool is kept
+  //! until `finalize()`.
+  virtual Error flush() = 0;
+
   // --------------------------------------------------------------------------
   // [Ret]
   // --------------------------------------------------------------------------
@@ -724,6 +763,7 @@ public:
 
   CBConstPool* _localConstPool;          //!< Local constant pool, flushed at the end of each function.
   CBConstPool* _globalConstPool;         //!< Global constant pool, flushed at the end of the compilation.
+  bool _streaming;                       //!< Streaming mode, see `setStreaming()`.
 };
 
 //! \}
@@ -108,6 +108,28 @@ Error CodeEmitter::_emitOpArray(uint32_t instId, const Operand_* opArray, size_t
   }
 }
 
+Error CodeEmitter::_emitBatch(const Inst::Record* records, size_t count, size_t* failedIndex) {
+  size_t i = 0;
+  Error err = _lastError;
+
+  if (ASMJIT_LIKELY(!err)) {
+    resetInlineComment();
+
+    for (; i < count; i++) {
+      const Inst::Record& record = records[i];
+
+      setOptions(record.options);
+      setExtraReg(record.extraReg);
+
+      err = _emitOpArray(record.instId, record.operands, record.opCount);
+      if (ASMJIT_UNLIKELY(err)) break;
+    }
+  }
+
+  if (failedIndex) *failedIndex = i;
+  return err;
+}
+
 // ============================================================================
 // [asmjit::CodeEmitter - Finalize]
 // ============================================================================
@@ -163,7 +185,7 @@ Error CodeEmitter::setLastError(Error error, const char* message) {
 
 bool CodeEmitter::isLabelValid(uint32_t id) const noexcept {
   size_t index = Operand::unpackId(id);
-  return _code && index < _code->_labels.getLength();
+  return _code && index < _code->getLabelsCount();
 }
 
 Error CodeEmitter::commentf(const char* fmt, ...) {
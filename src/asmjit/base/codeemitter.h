@@ -11,6 +11,7 @@
 // [Dependencies]
 #include "../base/arch.h"
 #include "../base/codeholder.h"
+#include "../base/inst.h"
 #include "../base/operand.h"
 
 // [Api-Begin]
@@ -77,7 +78,35 @@ public:
     //! This feature is disabled by default, because the only processor that
     //! used to take into consideration prediction hints was P4. Newer processors
     //! implement heuristics for branch prediction that ignores any static hints.
-    kHintPredictedJumps = 0x00000002U
+    kHintPredictedJumps = 0x00000002U,
+
+    //! Align loop headers when serializing \ref CodeBuilder to \ref Assembler.
+    //!
+    //! Default `false`.
+    //!
+    //! X86/X64 Specific
+    //! ----------------
+    //!
+    //! A label is considered a loop header if it's a target of a backward
+    //! jump. Such label is aligned to `CodeHolder::getLoopAlignment()` bytes
+    //! so the hot loop body starts at a fetch-friendly offset.
+    kHintAlignLoops = 0x00000004U,
+
+    //! Keep branches off 32-byte boundaries when serializing \ref CodeBuilder
+    //! to \ref Assembler.
+    //!
+    //! Default `false`.
+    //!
+    //! X86/X64 Specific
+    //! ----------------
+    //!
+    //! Some Intel processors (Skylake and derivatives patched for JCC erratum)
+    //! don't cache decoded uops of a jump that crosses or ends on a 32-byte
+    //! boundary. If this hint is enabled jmp, jcc, call, ret, and macro-fused
+    //! cmp|test|add|sub|and|inc|dec + jcc pairs are moved to the next 32-byte
+    //! boundary by inserting multi-byte NOPs in front of them. Loop headers
+    //! are padded by multi-byte NOPs as well, regardless of `kHintOptimizedAlign`.
+    kHintAlignBranches = 0x00000008U
   };
 
   //! CodeEmitter options that are merged with instruction options.
@@ -174,6 +203,8 @@ public:
   virtual Error _emit(uint32_t instId, const Operand_& o0, const Operand_& o1, const Operand_& o2, const Operand_& o3, const Operand_& o4, const Operand_& o5) = 0;
   //! Emit instruction having operands stored in array.
   virtual Error _emitOpArray(uint32_t instId, const Operand_* opArray, size_t opCount);
+  //! Emit `count` instructions stored in `records`.
+  virtual Error _emitBatch(const Inst::Record* records, size_t count, size_t* failedIndex);
 
   //! Create a new label.
   virtual Label newLabel() = 0;
@@ -461,6 +492,21 @@ public:
     return _emitOpArray(instId, opArray, opCount);
   }
 
+  //! Emit `count` instructions stored in `records`.
+  //!
+  //! Each record provides its own options and extraReg, options and inline
+  //! comment set before the call are discarded. Emission stops at the first
+  //! record that fails, the error is returned and the index of the record is
+  //! stored to `failedIndex` (if not null), which is `count` on success.
+  //! Records before the failing one are emitted.
+  //!
+  //! The emitter checks its error state once per batch and \ref Assembler
+  //! reserves the buffer for multiple records at once, so emitting a batch is
+  //! faster than emitting each instruction by `emit()`.
+  ASMJIT_INLINE Error emitBatch(const Inst::Record* records, size_t count, size_t* failedIndex = nullptr) {
+    return _emitBatch(records, count, failedIndex);
+  }
+
   // --------------------------------------------------------------------------
   // [Members]
   // --------------------------------------------------------------------------
@@ -40,6 +40,18 @@ static void CodeHolder_setGlobalOption(CodeHolder* self, uint32_t clear, uint32_
   }
 }
 
+static void CodeHolder_setGlobalHint(CodeHolder* self, uint32_t clear, uint32_t add) noexcept {
+  // Modify global hints of `CodeHolder` itself.
+  self->_globalHints = (self->_globalHints & ~clear) | add;
+
+  // Modify all global hints of all `CodeEmitter`s attached.
+  CodeEmitter* emitter = self->_emitters;
+  while (emitter) {
+    emitter->_globalHints = (emitter->_globalHints & ~clear) | add;
+    emitter = emitter->_nextEmitter;
+  }
+}
+
 static void CodeHolder_resetInternal(CodeHolder* self, bool releaseMemory) noexcept {
   // Detach all `CodeEmitter`s.
   while (self->_emitters)
@@ -54,6 +66,8 @@ static void CodeHolder_resetInternal(CodeHolder* self, bool releaseMemory) noexc
 
   self->_unresolvedLabelsCount = 0;
   self->_trampolinesSize = 0;
+  self->_loopAlignment = 16;
+  self->_layoutPaddingSize = 0;
 
   // Reset all sections.
   size_t numSections = self->_sections.getLength();
@@ -69,8 +83,10 @@ static void CodeHolder_resetInternal(CodeHolder* self, bool releaseMemory) noexc
   ZoneHeap* heap = &self->_baseHeap;
 
   self->_namedLabels.reset(heap);
+  self->_unwindEntries.reset();
   self->_relocations.reset();
-  self->_labels.reset();
+  self->_labelChunks.reset();
+  self->_labelsCount = 0;
   self->_sections.reset();
 
   heap->reset(&self->_baseZone);
@@ -91,9 +107,12 @@ CodeHolder::CodeHolder() noexcept
     _errorHandler(nullptr),
     _unresolvedLabelsCount(0),
     _trampolinesSize(0),
+    _loopAlignment(16),
+    _layoutPaddingSize(0),
     _baseZone(16384 - Zone::kZoneOverhead),
     _dataZone(16384 - Zone::kZoneOverhead),
     _baseHeap(&_baseZone),
+    _labelsCount(0),
     _namedLabels(&_baseHeap) {}
 
 CodeHolder::~CodeHolder() noexcept {
@@ -224,6 +243,18 @@ Error CodeHolder::detach(CodeEmitter* emitter) noexcept {
   return err;
 }
 
+// ============================================================================
+// [asmjit::CodeHolder - Global Information]
+// ============================================================================
+
+void CodeHolder::addGlobalHints(uint32_t hints) noexcept {
+  CodeHolder_setGlobalHint(this, 0, hints);
+}
+
+void CodeHolder::clearGlobalHints(uint32_t hints) noexcept {
+  CodeHolder_setGlobalHint(this, hints, 0);
+}
+
 // ============================================================================
 // [asmjit::CodeHolder - Sync]
 // ============================================================================
@@ -356,6 +387,25 @@ Error CodeHolder::reserveBuffer(CodeBuffer* cb, size_t n) noexcept {
   return CodeHolder_reserveInternal(this, cb, n);
 }
 
+void CodeHolder::_setExecutableBuffer(CodeBuffer* cb, uint8_t* data, size_t capacity) noexcept {
+  // The current content is lost, it's either empty or already relocated.
+  ASMJIT_ASSERT(!cb->hasData() || cb->isExecutable());
+
+  cb->_data = data;
+  cb->_length = 0;
+  cb->_capacity = capacity;
+  cb->_isExternal = data != nullptr;
+  cb->_isFixedSize = data != nullptr;
+  cb->_isExecutable = data != nullptr;
+
+  Assembler* a = _cgAsm;
+  if (a && &a->_section->_buffer == cb) {
+    a->_bufferData = data;
+    a->_bufferEnd  = data + capacity;
+    a->_bufferPtr  = data;
+  }
+}
+
 // ============================================================================
 // [asmjit::CodeHolder - Labels & Symbols]
 // ============================================================================
@@ -369,9 +419,10 @@ class LabelByName {
 public:
   ASMJIT_INLINE LabelByName(const char* name, size_t nameLength, uint32_t hVal) noexcept
     : name(name),
-      nameLength(static_cast<uint32_t>(nameLength)) {}
+      nameLength(static_cast<uint32_t>(nameLength)),
+      hVal(hVal) {}
 
-  ASMJIT_INLINE bool matches(const LabelEntry* entry) const noexcept {
+  ASMJIT_INLINE bool matches(const LabelNameEntry* entry) const noexcept {
     return static_cast<uint32_t>(entry->getNameLength()) == nameLength &&
            ::memcmp(entry->getName(), name, nameLength) == 0;
   }
@@ -422,27 +473,46 @@ LabelLink* CodeHolder::newLabelLink(LabelEntry* le, uint32_t sectionId, size_t o
   return link;
 }
 
+//! \internal
+//!
+//! Create a new label entry, the caller must check the label index.
+static LabelEntry* CodeHolder_newLabelEntry(CodeHolder* self) noexcept {
+  size_t index = self->_labelsCount;
+  size_t chunkIndex = index & (CodeHolder::kLabelChunkSize - 1);
+
+  if (chunkIndex == 0) {
+    if (ASMJIT_UNLIKELY(self->_labelChunks.willGrow(&self->_baseHeap) != kErrorOk))
+      return nullptr;
+
+    LabelEntry* chunk = self->_baseZone.allocT<LabelEntry>(CodeHolder::kLabelChunkSize * sizeof(LabelEntry));
+    if (ASMJIT_UNLIKELY(!chunk))
+      return nullptr;
+
+    self->_labelChunks.appendUnsafe(chunk);
+  }
+
+  LabelEntry* le = self->_labelChunks.getData()[index >> CodeHolder::kLabelChunkShift] + chunkIndex;
+  le->_offset = 0;
+  le->_links = nullptr;
+  le->_nameEntry = nullptr;
+  le->_sectionId = SectionEntry::kInvalidId;
+  le->_id = Operand::packId(static_cast<uint32_t>(index));
+  return le;
+}
+
 Error CodeHolder::newLabelId(uint32_t& idOut) noexcept {
   idOut = 0;
 
-  size_t index = _labels.getLength();
-  if (ASMJIT_LIKELY(index >= Operand::kPackedIdCount))
+  size_t index = _labelsCount;
+  if (ASMJIT_UNLIKELY(index >= Operand::kPackedIdCount))
     return DebugUtils::errored(kErrorLabelIndexOverflow);
 
-  ASMJIT_PROPAGATE(_labels.willGrow(&_baseHeap));
-  LabelEntry* le = _baseHeap.allocZeroedT<LabelEntry>();
-
+  LabelEntry* le = CodeHolder_newLabelEntry(this);
   if (ASMJIT_UNLIKELY(!le))
-    return DebugUtils::errored(kErrorNoHeapMemory);;
-
-  uint32_t id = Operand::packId(static_cast<uint32_t>(index));
-  le->_setId(id);
-  le->_parentId = 0;
-  le->_sectionId = SectionEntry::kInvalidId;
-  le->_offset = 0;
+    return DebugUtils::errored(kErrorNoHeapMemory);
 
-  _labels.appendUnsafe(le);
-  idOut = id;
+  _labelsCount++;
+  idOut = le->getId();
   return kErrorOk;
 }
 
@@ -458,7 +528,7 @@ Error CodeHolder::newNamedLabelId(uint32_t& idOut, const char* name, size_t name
 
   switch (type) {
     case Label::kTypeLocal:
-      if (ASMJIT_UNLIKELY(Operand::unpackId(parentId) >= _labels.getLength()))
+      if (ASMJIT_UNLIKELY(Operand::unpackId(parentId) >= _labelsCount))
         return DebugUtils::errored(kErrorInvalidParentLabel);
 
       hVal ^= parentId;
@@ -477,53 +547,57 @@ Error CodeHolder::newNamedLabelId(uint32_t& idOut, const char* name, size_t name
   // Don't allow to insert duplicates. Local labels allow duplicates that have
   // different id, this is already accomplished by having a different hashes
   // between the same label names having different parent labels.
-  LabelEntry* le = _namedLabels.get(LabelByName(name, nameLength, hVal));
-  if (ASMJIT_UNLIKELY(le))
+  LabelNameEntry* ne = _namedLabels.get(LabelByName(name, nameLength, hVal));
+  if (ASMJIT_UNLIKELY(ne))
     return DebugUtils::errored(kErrorLabelAlreadyDefined);
 
-  Error err = kErrorOk;
-  size_t index = _labels.getLength();
-
+  size_t index = _labelsCount;
   if (ASMJIT_UNLIKELY(index >= Operand::kPackedIdCount))
     return DebugUtils::errored(kErrorLabelIndexOverflow);
 
-  ASMJIT_PROPAGATE(_labels.willGrow(&_baseHeap));
-  le = _baseHeap.allocZeroedT<LabelEntry>();
-
-  if (ASMJIT_UNLIKELY(!le))
-    return  DebugUtils::errored(kErrorNoHeapMemory);
+  ne = _baseHeap.allocZeroedT<LabelNameEntry>();
+  if (ASMJIT_UNLIKELY(!ne))
+    return DebugUtils::errored(kErrorNoHeapMemory);
 
-  uint32_t id = Operand::packId(static_cast<uint32_t>(index));
-  le->_hVal = hVal;
-  le->_setId(id);
-  le->_type = static_cast<uint8_t>(type);
-  le->_parentId = 0;
-  le->_sectionId = SectionEntry::kInvalidId;
-  le->_offset = 0;
+  ne->_type = static_cast<uint8_t>(type);
+  ne->_parentId = parentId;
 
-  if (le->_name.mustEmbed(nameLength)) {
-    le->_name.setEmbedded(name, nameLength);
+  if (ne->_name.mustEmbed(nameLength)) {
+    ne->_name.setEmbedded(name, nameLength);
   }
   else {
     char* nameExternal = static_cast<char*>(_dataZone.dup(name, nameLength, true));
     if (ASMJIT_UNLIKELY(!nameExternal))
       return DebugUtils::errored(kErrorNoHeapMemory);
-    le->_name.setExternal(nameExternal, nameLength);
+    ne->_name.setExternal(nameExternal, nameLength);
   }
 
-  _labels.appendUnsafe(le);
-  _namedLabels.put(le);
+  LabelEntry* le = CodeHolder_newLabelEntry(this);
+  if (ASMJIT_UNLIKELY(!le))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  ne->_hVal = hVal;
+  ne->_setId(le->getId());
 
-  idOut = id;
-  return err;
+  if (ASMJIT_UNLIKELY(!_namedLabels.put(ne)))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  le->_nameEntry = ne;
+  _labelsCount++;
+
+  idOut = le->getId();
+  return kErrorOk;
 }
 
 uint32_t CodeHolder::getLabelIdByName(const char* name, size_t nameLength, uint32_t parentId) noexcept {
   uint32_t hVal = CodeHolder_hashNameAndFixLen(name, nameLength);
   if (ASMJIT_UNLIKELY(!nameLength)) return 0;
 
-  LabelEntry* le = _namedLabels.get(LabelByName(name, nameLength, hVal));
-  return le ? le->getId() : static_cast<uint32_t>(0);
+  // Local labels are hashed together with their parent, see `newNamedLabelId()`.
+  hVal ^= parentId;
+
+  LabelNameEntry* ne = _namedLabels.get(LabelByName(name, nameLength, hVal));
+  return ne ? ne->getId() : static_cast<uint32_t>(0);
 }
 
 // ============================================================================
@@ -577,7 +651,9 @@ size_t CodeHolder::relocate(void* _dst, uint64_t baseAddress) const noexcept {
 
   // We will copy the exact size of the generated code. Extra code for trampolines
   // is generated on-the-fly by the relocator (this code doesn't exist at the moment).
-  ::memcpy(dst, section->_buffer._data, minCodeSize);
+  // Code emitted in place (see `JitRuntime::reserve()`) is already there.
+  if (dst != section->_buffer._data)
+    ::memcpy(dst, section->_buffer._data, minCodeSize);
 
   // Trampoline offset from the beginning of dst/baseAddress.
   size_t trampOffset = minCodeSize;
@@ -690,6 +766,82 @@ size_t CodeHolder::relocate(void* _dst, uint64_t baseAddress) const noexcept {
   return trampOffset;
 }
 
+// ============================================================================
+// [asmjit::CodeHolder - Unwind]
+// ============================================================================
+
+Error CodeHolder::addUnwindEntry(const Label& start, const Label& end, const FuncFrameLayout& layout, const Label& epilogEnd) noexcept {
+  if (ASMJIT_UNLIKELY(!isLabelValid(start) || !isLabelValid(end)))
+    return DebugUtils::errored(kErrorInvalidLabel);
+
+  if (ASMJIT_UNLIKELY(epilogEnd.isValid() && !isLabelValid(epilogEnd)))
+    return DebugUtils::errored(kErrorInvalidLabel);
+
+  ASMJIT_PROPAGATE(_unwindEntries.willGrow(&_baseHeap));
+
+  UnwindEntry* ue = _baseHeap.allocT<UnwindEntry>();
+  if (ASMJIT_UNLIKELY(!ue))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  ue->_startLabelId = start.getId();
+  ue->_endLabelId = end.getId();
+  ue->_epilogLabelId = epilogEnd.getId();
+  ue->_layout = layout;
+
+  _unwindEntries.appendUnsafe(ue);
+  return kErrorOk;
+}
+
+// ============================================================================
+// [asmjit::CodeHolder - Test]
+// ============================================================================
+
+#if defined(ASMJIT_TEST)
+UNIT(base_codeholder_labels) {
+  CodeHolder code;
+  EXPECT(code.init(CodeInfo(ArchInfo::kTypeHost)) == kErrorOk);
+
+  uint32_t i;
+  uint32_t kCount = CodeHolder::kLabelChunkSize * 3 + 1;
+  uint32_t first = 0;
+
+  INFO("Creating %u anonymous labels", kCount);
+  for (i = 0; i < kCount; i++) {
+    uint32_t id = 0;
+    EXPECT(code.newLabelId(id) == kErrorOk);
+    if (i == 0) first = id;
+
+    LabelEntry* le = code.getLabelEntry(id);
+    EXPECT(le != nullptr);
+    EXPECT(le->getId() == id);
+    EXPECT(!le->isBound());
+    EXPECT(!le->hasName());
+    EXPECT(le->getType() == Label::kTypeAnonymous);
+  }
+  EXPECT(code.getLabelsCount() == kCount);
+  EXPECT(code.getLabelEntry(first) + 1 == code.getLabelEntry(first + 1));
+
+  INFO("Creating named labels");
+  uint32_t globalId, localId, otherId;
+  EXPECT(code.newNamedLabelId(globalId, "func", Globals::kInvalidIndex, Label::kTypeGlobal, 0) == kErrorOk);
+  EXPECT(code.newNamedLabelId(localId, ".L1", Globals::kInvalidIndex, Label::kTypeLocal, globalId) == kErrorOk);
+  EXPECT(code.newNamedLabelId(otherId, ".L1", Globals::kInvalidIndex, Label::kTypeLocal, first) == kErrorOk);
+  EXPECT(code.newNamedLabelId(otherId, "func", Globals::kInvalidIndex, Label::kTypeGlobal, 0) == kErrorLabelAlreadyDefined);
+
+  LabelEntry* le = code.getLabelEntry(localId);
+  EXPECT(le->hasName());
+  EXPECT(le->getType() == Label::kTypeLocal);
+  EXPECT(le->getParentId() == globalId);
+  EXPECT(::strcmp(le->getName(), ".L1") == 0);
+
+  INFO("Looking up named labels");
+  EXPECT(code.getLabelIdByName("func") == globalId);
+  EXPECT(code.getLabelIdByName(".L1", Globals::kInvalidIndex, globalId) == localId);
+  EXPECT(code.getLabelIdByName(".L1", Globals::kInvalidIndex, first) != localId);
+  EXPECT(code.getLabelIdByName("none") == 0);
+}
+#endif // ASMJIT_TEST
+
 } // asmjit namespace
 
 // [Api-End]
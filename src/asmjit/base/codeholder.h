@@ -239,6 +239,7 @@ struct CodeBuffer {
 
   ASMJIT_INLINE bool isExternal() const noexcept { return _isExternal; }
   ASMJIT_INLINE bool isFixedSize() const noexcept { return _isFixedSize; }
+  ASMJIT_INLINE bool isExecutable() const noexcept { return _isExecutable; }
 
   // --------------------------------------------------------------------------
   // [Members]
@@ -249,6 +250,7 @@ struct CodeBuffer {
   size_t _capacity;                      //!< Buffer capacity (in bytes).
   bool _isExternal;                      //!< True if this is external buffer.
   bool _isFixedSize;                     //!< True if this buffer cannot grow.
+  bool _isExecutable;                    //!< True if this buffer is executable memory (see `JitRuntime::reserve()`).
 };
 
 // ============================================================================
@@ -330,25 +332,14 @@ struct LabelLink {
 };
 
 // ============================================================================
-// [asmjit::LabelEntry]
+// [asmjit::LabelNameEntry]
 // ============================================================================
 
-//! Label entry.
+//! Name of a named label (side table of \ref LabelEntry).
 //!
-//! Contains the following properties:
-//!   * Label id - This is the only thing that is set to the `Label` operand.
-//!   * Label name - Optional, used mostly to create executables and libraries.
-//!   * Label type - Type of the label, default `Label::kTypeAnonymous`.
-//!   * Label parent id - Derived from many assemblers that allow to define a
-//!       local label that falls under a global label. This allows to define
-//!       many labels of the same name that have different parent (global) label.
-//!   * Offset - offset of the label bound by `Assembler`.
-//!   * Links - single-linked list that contains locations of code that has
-//!       to be patched when the label gets bound. Every use of unbound label
-//!       adds one link to `_links` list.
-//!   * HVal - Hash value of label's name and optionally parentId.
-//!   * HashNext - Hash-table implementation detail.
-class LabelEntry : public ZoneHashNode {
+//! Only created for labels created by `CodeHolder::newNamedLabelId()`, which
+//! are also stored in a hash table that maps names to label ids.
+class LabelNameEntry : public ZoneHashNode {
 public:
   // NOTE: Label id is stored in `_customData`, which is provided by ZoneHashNode
   // to fill a padding that a C++ compiler targeting 64-bit CPU will add to align
@@ -361,31 +352,88 @@ public:
 
   //! Get label type, see \ref Label::Type.
   ASMJIT_INLINE uint32_t getType() const noexcept { return _type; }
+  //! Get label's parent id.
+  ASMJIT_INLINE uint32_t getParentId() const noexcept { return _parentId; }
+
+  //! Get the label's name.
+  ASMJIT_INLINE const char* getName() const noexcept { return _name.getData(); }
+  //! Get length of label's name.
+  ASMJIT_INLINE size_t getNameLength() const noexcept { return _name.getLength(); }
+
+  // ------------------------------------------------------------------------
+  // [Members]
+  // ------------------------------------------------------------------------
+
+  // Let's round the size of `LabelNameEntry` to 64 bytes (as ZoneHeap has 32
+  // bytes granularity anyway). This gives `_name` the remaining space, which
+  // is roughly 40 bytes on 64-bit and 48 bytes on 32-bit architectures.
+  enum { kNameBytes = 64 - (sizeof(ZoneHashNode) + 8) };
+
+  uint8_t _type;                         //!< Label type, see Label::Type.
+  uint8_t _reserved8;                    //!< Reserved.
+  uint16_t _reserved16;                  //!< Reserved.
+  uint32_t _parentId;                    //!< Label parent id or zero.
+  SmallString<kNameBytes> _name;         //!< Label name.
+};
+
+// ============================================================================
+// [asmjit::LabelEntry]
+// ============================================================================
+
+//! Label entry.
+//!
+//! Contains the following properties:
+//!   * Label id - This is the only thing that is set to the `Label` operand.
+//!   * Offset - offset of the label bound by `Assembler`.
+//!   * Links - single-linked list that contains locations of code that has
+//!       to be patched when the label gets bound. Every use of unbound label
+//!       adds one link to `_links` list.
+//!   * Name entry - Only provided by named labels, see \ref LabelNameEntry:
+//!     * Label name - Used mostly to create executables and libraries.
+//!     * Label type - Type of the label, `Label::kTypeAnonymous` if the label
+//!         doesn't have a name entry.
+//!     * Label parent id - Derived from many assemblers that allow to define a
+//!         local label that falls under a global label. This allows to define
+//!         many labels of the same name that have different parent (global) label.
+//!     * HVal - Hash value of label's name and optionally parentId.
+//!
+//! Label entries are small and stored in dense chunks owned by \ref CodeHolder
+//! (most labels are anonymous and only need the offset and links), pointers
+//! to them stay valid until the `CodeHolder` is reset.
+class LabelEntry {
+public:
+  //! Get label id.
+  ASMJIT_INLINE uint32_t getId() const noexcept { return _id; }
+
+  //! Get label type, see \ref Label::Type.
+  ASMJIT_INLINE uint32_t getType() const noexcept { return _nameEntry ? _nameEntry->getType() : uint32_t(Label::kTypeAnonymous); }
   //! Get label flags, returns 0 at the moment.
-  ASMJIT_INLINE uint32_t getFlags() const noexcept { return _flags; }
+  ASMJIT_INLINE uint32_t getFlags() const noexcept { return 0; }
 
-  ASMJIT_INLINE bool hasParent() const noexcept { return _parentId != 0; }
+  ASMJIT_INLINE bool hasParent() const noexcept { return getParentId() != 0; }
   //! Get label's parent id.
-  ASMJIT_INLINE uint32_t getParentId() const noexcept { return _parentId; }
+  ASMJIT_INLINE uint32_t getParentId() const noexcept { return _nameEntry ? _nameEntry->getParentId() : uint32_t(0); }
 
   //! Get label's section id where it's bound to (or `SectionEntry::kInvalidId` if it's not bound yet).
   ASMJIT_INLINE uint32_t getSectionId() const noexcept { return _sectionId; }
 
   //! Get if the label has name.
-  ASMJIT_INLINE bool hasName() const noexcept { return !_name.isEmpty(); }
+  ASMJIT_INLINE bool hasName() const noexcept { return _nameEntry != nullptr; }
+  //! Get the label's name entry, null if the label is anonymous.
+  ASMJIT_INLINE LabelNameEntry* getNameEntry() const noexcept { return _nameEntry; }
 
-  //! Get the label's name.
+  //! Get the label's name (empty string if the label is anonymous).
   //!
   //! NOTE: Local labels will return their local name without their parent
   //! part, for example ".L1".
-  ASMJIT_INLINE const char* getName() const noexcept { return _name.getData(); }
+  ASMJIT_INLINE const char* getName() const noexcept { return _nameEntry ? _nameEntry->getName() : ""; }
 
   //! Get length of label's name.
   //!
   //! NOTE: Label name is always null terminated, so you can use `strlen()` to
-  //! get it, however, it's also cached in `LabelEntry`, so if you want to know
-  //! the length the easiest way is to use `LabelEntry::getNameLength()`.
-  ASMJIT_INLINE size_t getNameLength() const noexcept { return _name.getLength(); }
+  //! get it, however, it's also cached in `LabelNameEntry`, so if you want to
+  //! know the length the easiest way is to use `LabelEntry::getNameLength()`.
+  ASMJIT_INLINE size_t getNameLength() const noexcept { return _nameEntry ? _nameEntry->getNameLength() : size_t(0); }
 
   //! Get if the label is bound.
   ASMJIT_INLINE bool isBound() const noexcept { return _sectionId != SectionEntry::kInvalidId; }
@@ -396,26 +444,17 @@ public:
   //!
   //! Label hash is calculated as `HASH(Name) ^ ParentId`. The hash function
   //! is implemented in `Utils::hashString()` and `Utils::hashRound()`.
-  ASMJIT_INLINE uint32_t getHVal() const noexcept { return _hVal; }
+  ASMJIT_INLINE uint32_t getHVal() const noexcept { return _nameEntry ? _nameEntry->_hVal : uint32_t(0); }
 
   // ------------------------------------------------------------------------
   // [Members]
   // ------------------------------------------------------------------------
 
-  // Let's round the size of `LabelEntry` to 64 bytes (as ZoneHeap has 32
-  // bytes granularity anyway). This gives `_name` the remaining space, which
-  // is roughly 16 bytes on 64-bit and 28 bytes on 32-bit architectures.
-  enum { kNameBytes = 64 - (sizeof(ZoneHashNode) + 16 + sizeof(intptr_t) + sizeof(LabelLink*)) };
-
-  uint8_t _type;                         //!< Label type, see Label::Type.
-  uint8_t _flags;                        //!< Must be zero.
-  uint16_t _reserved16;                  //!< Reserved.
-  uint32_t _parentId;                    //!< Label parent id or zero.
-  uint32_t _sectionId;                   //!< Section id or `SectionEntry::kInvalidId`.
-  uint32_t _reserved32;                  //!< Reserved.
   intptr_t _offset;                      //!< Label offset.
   LabelLink* _links;                     //!< Label links.
-  SmallString<kNameBytes> _name;         //!< Label name.
+  LabelNameEntry* _nameEntry;            //!< Label name entry (named labels only).
+  uint32_t _sectionId;                   //!< Section id or `SectionEntry::kInvalidId`.
+  uint32_t _id;                          //!< Label id.
 };
 
 // ============================================================================
@@ -466,6 +505,40 @@ struct RelocEntry {
   uint64_t _data;                        //!< Relocation data (target offset, target address, etc).
 };
 
+// ============================================================================
+// [asmjit::UnwindEntry]
+// ============================================================================
+
+//! Unwind entry.
+//!
+//! Associates a function delimited by two labels with the \ref FuncFrameLayout
+//! used to emit its prolog and epilog. The function must start with the prolog
+//! and contain the epilog, which ends at the end of the function unless there
+//! is a label bound after it, see \ref FuncFrameLayout::buildEhFrame().
+struct UnwindEntry {
+  // ------------------------------------------------------------------------
+  // [Accessors]
+  // ------------------------------------------------------------------------
+
+  //! Get id of the label bound at the start of the function.
+  ASMJIT_INLINE uint32_t getStartLabelId() const noexcept { return _startLabelId; }
+  //! Get id of the label bound after the end of the function.
+  ASMJIT_INLINE uint32_t getEndLabelId() const noexcept { return _endLabelId; }
+  //! Get id of the label bound after the epilog (zero if the epilog ends the function).
+  ASMJIT_INLINE uint32_t getEpilogLabelId() const noexcept { return _epilogLabelId; }
+  //! Get the function's frame layout.
+  ASMJIT_INLINE const FuncFrameLayout& getLayout() const noexcept { return _layout; }
+
+  // ------------------------------------------------------------------------
+  // [Members]
+  // ------------------------------------------------------------------------
+
+  uint32_t _startLabelId;                //!< Label bound at the start of the function.
+  uint32_t _endLabelId;                  //!< Label bound after the end of the function.
+  uint32_t _epilogLabelId;               //!< Label bound after the epilog (optional).
+  FuncFrameLayout _layout;               //!< Function frame layout.
+};
+
 // ============================================================================
 // [asmjit::CodeHolder]
 // ============================================================================
@@ -482,6 +555,12 @@ class CodeHolder {
 public:
   ASMJIT_NONCOPYABLE(CodeHolder)
 
+  //! Label entries are allocated in chunks of `kLabelChunkSize` entries.
+  ASMJIT_ENUM(LabelChunk) {
+    kLabelChunkShift = 7,
+    kLabelChunkSize = 1 << kLabelChunkShift
+  };
+
   // --------------------------------------------------------------------------
   // [Construction / Destruction]
   // --------------------------------------------------------------------------
@@ -550,6 +629,16 @@ public:
   //! Get global options, internally propagated to all `CodeEmitter`s attached.
   ASMJIT_INLINE uint32_t getGlobalOptions() const noexcept { return _globalOptions; }
 
+  //! Add global `hints`, see \ref CodeEmitter::Hints.
+  ASMJIT_API void addGlobalHints(uint32_t hints) noexcept;
+  //! Clear global `hints`, see \ref CodeEmitter::Hints.
+  ASMJIT_API void clearGlobalHints(uint32_t hints) noexcept;
+
+  //! Get alignment of loop headers used by \ref CodeEmitter::kHintAlignLoops.
+  ASMJIT_INLINE uint32_t getLoopAlignment() const noexcept { return _loopAlignment; }
+  //! Set alignment of loop headers used by \ref CodeEmitter::kHintAlignLoops.
+  ASMJIT_INLINE void setLoopAlignment(uint32_t alignment) noexcept { _loopAlignment = alignment; }
+
   // --------------------------------------------------------------------------
   // [Result Information]
   // --------------------------------------------------------------------------
@@ -565,6 +654,12 @@ public:
   //! address directly).
   ASMJIT_INLINE size_t getTrampolinesSize() const noexcept { return _trampolinesSize; }
 
+  //! Get size of all padding inserted to align loops and branches.
+  //!
+  //! This value is only non-zero if \ref CodeEmitter::kHintAlignLoops or
+  //! \ref CodeEmitter::kHintAlignBranches were used.
+  ASMJIT_INLINE size_t getLayoutPaddingSize() const noexcept { return _layoutPaddingSize; }
+
   // --------------------------------------------------------------------------
   // [Logging & Error Handling]
   // --------------------------------------------------------------------------
@@ -602,6 +697,16 @@ public:
   ASMJIT_API Error growBuffer(CodeBuffer* cb, size_t n) noexcept;
   ASMJIT_API Error reserveBuffer(CodeBuffer* cb, size_t n) noexcept;
 
+  //! \internal
+  //!
+  //! Use executable memory `data` of `capacity` bytes as a fixed-size buffer
+  //! `cb` (the code is emitted in place), or make `cb` an empty buffer again
+  //! if `data` is null. The attached `Assembler` is updated.
+  //!
+  //! Used by `JitRuntime::reserve()` and `JitRuntime::add()`, which own the
+  //! memory.
+  ASMJIT_API void _setExecutableBuffer(CodeBuffer* cb, uint8_t* data, size_t capacity) noexcept;
+
   // --------------------------------------------------------------------------
   // [Labels & Symbols]
   // --------------------------------------------------------------------------
@@ -624,11 +729,8 @@ public:
   //! Returns `null` if the allocation failed.
   ASMJIT_API LabelLink* newLabelLink(LabelEntry* le, uint32_t sectionId, size_t offset, intptr_t rel) noexcept;
 
-  //! Get array of `LabelEntry*` records.
-  ASMJIT_INLINE const ZoneVector<LabelEntry*>& getLabelEntries() const noexcept { return _labels; }
-
   //! Get number of labels created.
-  ASMJIT_INLINE size_t getLabelsCount() const noexcept { return _labels.getLength(); }
+  ASMJIT_INLINE size_t getLabelsCount() const noexcept { return _labelsCount; }
 
   //! Get number of label references, which are unresolved at the moment.
   ASMJIT_INLINE size_t getUnresolvedLabelsCount() const noexcept { return _unresolvedLabelsCount; }
@@ -640,7 +742,7 @@ public:
   //! Get if the label having `id` is valid (i.e. created by `newLabelId()`).
   ASMJIT_INLINE bool isLabelValid(uint32_t labelId) const noexcept {
     size_t index = Operand::unpackId(labelId);
-    return index < _labels.getLength();
+    return index < _labelsCount;
   }
 
   //! Get if the `label` is already bound.
@@ -652,7 +754,7 @@ public:
   //! \overload
   ASMJIT_INLINE bool isLabelBound(uint32_t id) const noexcept {
     size_t index = Operand::unpackId(id);
-    return index < _labels.getLength() && _labels[index]->isBound();
+    return index < _labelsCount && _getLabelEntryByIndex(index)->isBound();
   }
 
   //! Get a `label` offset or -1 if the label is not yet bound.
@@ -662,7 +764,7 @@ public:
   //! \overload
   ASMJIT_INLINE intptr_t getLabelOffset(uint32_t id) const noexcept {
     ASMJIT_ASSERT(isLabelValid(id));
-    return _labels[Operand::unpackId(id)]->getOffset();
+    return _getLabelEntryByIndex(Operand::unpackId(id))->getOffset();
   }
 
   //! Get information about the given `label`.
@@ -672,7 +774,15 @@ public:
   //! Get information about a label having the given `id`.
   ASMJIT_INLINE LabelEntry* getLabelEntry(uint32_t id) const noexcept {
     size_t index = static_cast<size_t>(Operand::unpackId(id));
-    return index < _labels.getLength() ? _labels[index] : static_cast<LabelEntry*>(nullptr);
+    return index < _labelsCount ? _getLabelEntryByIndex(index) : static_cast<LabelEntry*>(nullptr);
+  }
+
+  //! \internal
+  //!
+  //! Get a label entry at `index`, which must be valid.
+  ASMJIT_INLINE LabelEntry* _getLabelEntryByIndex(size_t index) const noexcept {
+    ASMJIT_ASSERT(index < _labelsCount);
+    return _labelChunks.getData()[index >> kLabelChunkShift] + (index & (kLabelChunkSize - 1));
   }
 
   // --------------------------------------------------------------------------
@@ -709,6 +819,24 @@ public:
   //! use `getCodeSize()`.
   ASMJIT_API size_t relocate(void* dst, uint64_t baseAddress = Globals::kNoBaseAddress) const noexcept;
 
+  // --------------------------------------------------------------------------
+  // [Unwind]
+  // --------------------------------------------------------------------------
+
+  //! Record unwind information of a function that starts at `start` and ends
+  //! at `end` (exclusive) and has a frame described by `layout`. If the code
+  //! follows the epilog `epilogEnd` must be bound right after its 'ret'.
+  //!
+  //! \ref CodeCompiler records all functions it finalizes. Users that emit
+  //! prolog and epilog manually by using \ref FuncUtils can call this function
+  //! to make \ref JitRuntime register the unwind information as well.
+  ASMJIT_API Error addUnwindEntry(const Label& start, const Label& end, const FuncFrameLayout& layout, const Label& epilogEnd = Label()) noexcept;
+
+  //! Get if the code contains unwind entries.
+  ASMJIT_INLINE bool hasUnwindEntries() const noexcept { return !_unwindEntries.isEmpty(); }
+  //! Get array of `UnwindEntry*` records.
+  ASMJIT_INLINE const ZoneVector<UnwindEntry*>& getUnwindEntries() const noexcept { return _unwindEntries; }
+
   // --------------------------------------------------------------------------
   // [Members]
   // --------------------------------------------------------------------------
@@ -726,15 +854,19 @@ public:
 
   uint32_t _unresolvedLabelsCount;       //!< Count of label references which were not resolved.
   uint32_t _trampolinesSize;             //!< Size of all possible trampolines.
+  uint32_t _loopAlignment;               //!< Alignment of loop headers.
+  uint32_t _layoutPaddingSize;           //!< Size of all padding inserted by the code layout.
 
   Zone _baseZone;                        //!< Base zone (used to allocate core structures).
   Zone _dataZone;                        //!< Data zone (used to allocate extra data like label names).
   ZoneHeap _baseHeap;                    //!< Zone allocator, used to manage internal containers.
 
   ZoneVector<SectionEntry*> _sections;   //!< Section entries.
-  ZoneVector<LabelEntry*> _labels;       //!< Label entries (each label is stored here).
+  ZoneVector<LabelEntry*> _labelChunks;  //!< Label entries, stored in chunks of `kLabelChunkSize`.
+  size_t _labelsCount;                   //!< Count of label entries.
   ZoneVector<RelocEntry*> _relocations;  //!< Relocation entries.
-  ZoneHash<LabelEntry> _namedLabels;     //!< Label name -> LabelEntry (only named labels).
+  ZoneVector<UnwindEntry*> _unwindEntries; //!< Unwind entries.
+  ZoneOpenHash<LabelNameEntry> _namedLabels; //!< Label name -> LabelNameEntry (only named labels).
 };
 
 //! \}
@@ -420,11 +420,13 @@ ASMJIT_FAVOR_SIZE static void x86DetectCpuInfo(CpuInfo* cpuInfo) noexcept {
     cpuInfo->_model    = (regs.eax >> 4) & 0x0F;
     cpuInfo->_stepping = (regs.eax     ) & 0x0F;
 
-    // Use extended family and model fields.
-    if (cpuInfo->_family == 0x0F) {
-      cpuInfo->_family += ((regs.eax >> 20) & 0xFF);
+    // Use extended family and model fields. Intel also uses extended model
+    // for family 6 (all processors since Core 2 report family 6).
+    if (cpuInfo->_family == 0x06 || cpuInfo->_family == 0x0F)
       cpuInfo->_model  += ((regs.eax >> 16) & 0x0F) << 4;
-    }
+
+    if (cpuInfo->_family == 0x0F)
+      cpuInfo->_family += ((regs.eax >> 20) & 0xFF);
 
     cpuInfo->_x86Data._processorType        = ((regs.eax >> 12) & 0x03);
     cpuInfo->_x86Data._brandIndex           = ((regs.ebx      ) & 0xFF);
@@ -111,6 +111,26 @@ ASMJIT_FAVOR_SIZE Error FuncFrameLayout::init(const FuncDetail& func, const Func
   return DebugUtils::errored(kErrorInvalidArgument);
 }
 
+// ============================================================================
+// [asmjit::FuncFrameLayout - Unwind]
+// ============================================================================
+
+ASMJIT_FAVOR_SIZE size_t FuncFrameLayout::buildEhFrame(uint8_t* dst, uint64_t funcAddress, size_t funcSize, size_t epilogEnd) const noexcept {
+  if (epilogEnd == Globals::kInvalidIndex)
+    epilogEnd = funcSize;
+
+#if defined(ASMJIT_BUILD_X86)
+  if (ArchInfo::isX86Family(getArchType()))
+    return X86Internal::buildEhFrame(*this, dst, funcAddress, funcSize, epilogEnd);
+#endif // ASMJIT_BUILD_X86
+
+  ASMJIT_UNUSED(dst);
+  ASMJIT_UNUSED(funcAddress);
+  ASMJIT_UNUSED(funcSize);
+  ASMJIT_UNUSED(epilogEnd);
+  return 0;
+}
+
 // ============================================================================
 // [asmjit::FuncArgsMapper]
 // ============================================================================
@@ -1048,7 +1048,8 @@ struct FuncFrameInfo {
 //! FuncFrameInfo specifies how much stack is used, and which registers are dirty.
 struct FuncFrameLayout {
   ASMJIT_ENUM(Limits) {
-    kMaxVRegKinds = Globals::kMaxVRegKinds
+    kMaxVRegKinds = Globals::kMaxVRegKinds,
+    kMaxEhFrameSize = 512                //!< Maximum size of data produced by `buildEhFrame()`.
   };
 
   // --------------------------------------------------------------------------
@@ -1058,10 +1059,31 @@ struct FuncFrameLayout {
   ASMJIT_API Error init(const FuncDetail& func, const FuncFrameInfo& ffi) noexcept;
   ASMJIT_INLINE void reset() noexcept { ::memset(this, 0, sizeof(*this)); }
 
+  // --------------------------------------------------------------------------
+  // [Unwind]
+  // --------------------------------------------------------------------------
+
+  //! Build DWARF `.eh_frame` data that describes a function that uses this
+  //! layout and starts at `funcAddress` and has `funcSize` bytes.
+  //!
+  //! The function must start with a prolog emitted by `FuncUtils::emitProlog()`
+  //! and must contain an epilog emitted by `FuncUtils::emitEpilog()` that ends
+  //! at `epilogEnd` (the end of the function if `Globals::kInvalidIndex`). Code
+  //! placed after the epilog uses the same rules as the function's body. The
+  //! data written to `dst` consists of a single CIE, a single FDE, and a zero
+  //! length terminator, so it can be passed to `__register_frame()` as is. The
+  //! `dst` buffer must have at least `kMaxEhFrameSize` bytes.
+  //!
+  //! Returns the number of bytes written or zero on failure.
+  ASMJIT_API size_t buildEhFrame(uint8_t* dst, uint64_t funcAddress, size_t funcSize, size_t epilogEnd = Globals::kInvalidIndex) const noexcept;
+
   // --------------------------------------------------------------------------
   // [Accessors]
   // --------------------------------------------------------------------------
 
+  //! Get the architecture type the layout was calculated for, see \ref ArchInfo::Type.
+  ASMJIT_INLINE uint32_t getArchType() const noexcept { return _archType; }
+
   ASMJIT_INLINE bool hasPreservedFP() const noexcept { return static_cast<bool>(_preservedFP); }
   ASMJIT_INLINE bool hasDsaSlotUsed() const noexcept { return static_cast<bool>(_dsaSlotUsed); }
   ASMJIT_INLINE bool hasAlignedVecSR() const noexcept { return static_cast<bool>(_alignedVecSR); }
@@ -1107,6 +1129,7 @@ struct FuncFrameLayout {
   uint8_t _stackAlignment;               //!< Final stack alignment of the functions.
   uint8_t _stackBaseRegId;               //!< GP register that holds address of base stack address.
   uint8_t _stackArgsRegId;               //!< GP register that holds address of the first argument passed by stack.
+  uint8_t _archType;                     //!< Architecture type, see \ref ArchInfo::Type.
 
   uint32_t _savedRegs[kMaxVRegKinds];    //!< Registers that will be saved/restored in prolog/epilog.
 
@@ -78,6 +78,8 @@ static const char errorMessages[] =
   "No more physical registers\0"
   "Overlapped registers\0"
   "Overlapping register and arguments base-address register\0"
+  "Queue full\0"
+  "Cancelled\0"
   "Unknown error\0";
 #endif // ASMJIT_DISABLE_TEXT
 
@@ -221,6 +221,11 @@ ASMJIT_ENUM(ErrorCode) {
   //! Invalid register to hold stack arguments offset.
   kErrorOverlappingStackRegWithRegArg,
 
+  //! The queue is full (JitCompileQueue).
+  kErrorQueueFull,
+  //! The operation was cancelled (JitCompileQueue).
+  kErrorCancelled,
+
   //! Count of AsmJit error codes.
   kErrorCount
 };
@@ -82,6 +82,77 @@ struct Inst {
     RegOnly extraReg;
   };
 
+  // --------------------------------------------------------------------------
+  // [Record]
+  // --------------------------------------------------------------------------
+
+  //! Instruction record - instruction id, options, extraReg, and operands that
+  //! can be stored in an array and emitted by \ref CodeEmitter::emitBatch().
+  //!
+  //! Unused operands must be none, which is guaranteed by `init()`.
+  struct Record {
+    ASMJIT_ENUM(Limits) {
+      kMaxOpCount = 6                    //!< Maximum number of operands.
+    };
+
+    // ------------------------------------------------------------------------
+    // [Init / Reset]
+    // ------------------------------------------------------------------------
+
+    //! Initialize the record to `instId` having `opCount` operands of `opArray`.
+    ASMJIT_INLINE void init(uint32_t instId, const Operand_* opArray, uint32_t opCount, uint32_t options = 0) noexcept {
+      ASMJIT_ASSERT(opCount <= kMaxOpCount);
+
+      this->instId = instId;
+      this->options = options;
+      this->opCount = opCount;
+      this->reserved = 0;
+      extraReg.reset();
+
+      for (uint32_t i = 0; i < kMaxOpCount; i++) {
+        if (i < opCount)
+          operands[i].copyFrom(opArray[i]);
+        else
+          operands[i].reset();
+      }
+    }
+
+    //! \overload
+    ASMJIT_INLINE void init(uint32_t instId) noexcept {
+      init(instId, static_cast<const Operand_*>(nullptr), 0);
+    }
+    //! \overload
+    ASMJIT_INLINE void init(uint32_t instId, const Operand_& o0) noexcept {
+      init(instId, &o0, 1);
+    }
+    //! \overload
+    ASMJIT_INLINE void init(uint32_t instId, const Operand_& o0, const Operand_& o1) noexcept {
+      Operand_ opArray[] = { o0, o1 };
+      init(instId, opArray, 2);
+    }
+    //! \overload
+    ASMJIT_INLINE void init(uint32_t instId, const Operand_& o0, const Operand_& o1, const Operand_& o2) noexcept {
+      Operand_ opArray[] = { o0, o1, o2 };
+      init(instId, opArray, 3);
+    }
+    //! \overload
+    ASMJIT_INLINE void init(uint32_t instId, const Operand_& o0, const Operand_& o1, const Operand_& o2, const Operand_& o3) noexcept {
+      Operand_ opArray[] = { o0, o1, o2, o3 };
+      init(instId, opArray, 4);
+    }
+
+    // ------------------------------------------------------------------------
+    // [Members]
+    // ------------------------------------------------------------------------
+
+    uint32_t instId;                     //!< Instruction id.
+    uint32_t options;                    //!< Instruction options.
+    RegOnly extraReg;                    //!< Extra register.
+    uint32_t opCount;                    //!< Count of operands.
+    uint32_t reserved;                   //!< Reserved.
+    Operand_ operands[kMaxOpCount];      //!< Operands.
+  };
+
   // --------------------------------------------------------------------------
   // [API]
   // --------------------------------------------------------------------------
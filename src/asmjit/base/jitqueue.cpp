@@ -0,0 +1,491 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Export]
+#define ASMJIT_EXPORTS
+
+// [Dependencies]
+#include "../base/codeemitter.h"
+#include "../base/jitqueue.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+// ============================================================================
+// [asmjit::JitCompileTask - Construction / Destruction]
+// ============================================================================
+
+JitCompileTask::JitCompileTask(uint32_t priority) noexcept
+  : _next(nullptr),
+    _code(nullptr),
+    _func(nullptr),
+    _state(kStateIdle),
+    _error(kErrorOk),
+    _priority(static_cast<uint8_t>(priority)) {
+  ASMJIT_ASSERT(priority < kPriorityCount);
+}
+
+JitCompileTask::JitCompileTask(CodeHolder* code, uint32_t priority) noexcept
+  : _next(nullptr),
+    _code(code),
+    _func(nullptr),
+    _state(kStateIdle),
+    _error(kErrorOk),
+    _priority(static_cast<uint8_t>(priority)) {
+  ASMJIT_ASSERT(priority < kPriorityCount);
+}
+
+JitCompileTask::~JitCompileTask() noexcept {}
+
+// ============================================================================
+// [asmjit::JitCompileTask - Interface]
+// ============================================================================
+
+Error JitCompileTask::build(CodeHolder* code) noexcept {
+  // Tasks created without `CodeHolder` must override `build()`.
+  ASMJIT_UNUSED(code);
+  return DebugUtils::errored(kErrorInvalidState);
+}
+
+void JitCompileTask::onComplete() noexcept {}
+
+// ============================================================================
+// [asmjit::JitCompileQueue - Helpers]
+// ============================================================================
+
+#if ASMJIT_OS_WINDOWS
+typedef HANDLE JitCompileThread;
+#else
+typedef pthread_t JitCompileThread;
+#endif
+
+static Error JitCompileQueue_compile(JitRuntime* runtime, JitCompileTask* task) noexcept {
+  CodeHolder localCode;
+  CodeHolder* code = task->_code;
+
+  if (!code) {
+    code = &localCode;
+    ASMJIT_PROPAGATE(code->init(runtime->getCodeInfo()));
+    ASMJIT_PROPAGATE(task->build(code));
+  }
+
+  // Finalize `CodeBuilder` and `CodeCompiler` emitters that are still attached.
+  for (CodeEmitter* emitter = code->_emitters; emitter; emitter = emitter->_nextEmitter) {
+    if (!emitter->_finalized)
+      ASMJIT_PROPAGATE(emitter->finalize());
+  }
+
+  return runtime->_add(&task->_func, code);
+}
+
+// Complete `task` that was removed from the queue. Must be called without lock.
+static void JitCompileQueue_complete(JitCompileQueue* self, JitCompileTask* task, uint32_t state) noexcept {
+  task->onComplete();
+
+  AutoLock locked(self->_lock);
+  Atomic::store(&task->_state, static_cast<intptr_t>(state));
+  self->_doneCond.broadcast();
+}
+
+// Remove the first pending task of the highest priority. Must be called with lock held.
+static JitCompileTask* JitCompileQueue_pop(JitCompileQueue* self) noexcept {
+  uint32_t priority = JitCompileTask::kPriorityCount;
+  while (priority) {
+    priority--;
+
+    JitCompileTask* task = self->_first[priority];
+    if (task) {
+      self->_first[priority] = task->_next;
+      if (!task->_next)
+        self->_last[priority] = nullptr;
+
+      task->_next = nullptr;
+      self->_pendingCount--;
+      return task;
+    }
+  }
+  return nullptr;
+}
+
+static void JitCompileQueue_work(JitCompileQueue* self) noexcept {
+  for (;;) {
+    JitCompileTask* task;
+
+    {
+      AutoLock locked(self->_lock);
+      for (;;) {
+        if (self->_stopping)
+          return;
+
+        task = JitCompileQueue_pop(self);
+        if (task)
+          break;
+
+        self->_workCond.wait(self->_lock);
+      }
+
+      Atomic::store(&task->_state, static_cast<intptr_t>(JitCompileTask::kStateRunning));
+      self->_runningCount++;
+    }
+
+    task->_error = JitCompileQueue_compile(self->_runtime, task);
+    if (task->_error)
+      task->_func = nullptr;
+    task->onComplete();
+
+    AutoLock locked(self->_lock);
+    Atomic::store(&task->_state, static_cast<intptr_t>(JitCompileTask::kStateDone));
+    self->_runningCount--;
+    self->_doneCond.broadcast();
+  }
+}
+
+#if ASMJIT_OS_WINDOWS
+static DWORD WINAPI JitCompileQueue_threadEntry(LPVOID arg) noexcept {
+  JitCompileQueue_work(static_cast<JitCompileQueue*>(arg));
+  return 0;
+}
+
+static ASMJIT_INLINE bool JitCompileQueue_startThread(JitCompileThread* thread, JitCompileQueue* self) noexcept {
+  *thread = ::CreateThread(nullptr, 0, JitCompileQueue_threadEntry, self, 0, nullptr);
+  return *thread != nullptr;
+}
+
+static ASMJIT_INLINE void JitCompileQueue_joinThread(JitCompileThread thread) noexcept {
+  ::WaitForSingleObject(thread, INFINITE);
+  ::CloseHandle(thread);
+}
+#else
+static void* JitCompileQueue_threadEntry(void* arg) noexcept {
+  JitCompileQueue_work(static_cast<JitCompileQueue*>(arg));
+  return nullptr;
+}
+
+static ASMJIT_INLINE bool JitCompileQueue_startThread(JitCompileThread* thread, JitCompileQueue* self) noexcept {
+  return ::pthread_create(thread, nullptr, JitCompileQueue_threadEntry, self) == 0;
+}
+
+static ASMJIT_INLINE void JitCompileQueue_joinThread(JitCompileThread thread) noexcept {
+  ::pthread_join(thread, nullptr);
+}
+#endif
+
+// ============================================================================
+// [asmjit::JitCompileQueue - Construction / Destruction]
+// ============================================================================
+
+JitCompileQueue::JitCompileQueue() noexcept
+  : _runtime(nullptr),
+    _threads(nullptr),
+    _threadCount(0),
+    _maxPending(0),
+    _pendingCount(0),
+    _runningCount(0),
+    _stopping(false) {
+
+  for (uint32_t i = 0; i < JitCompileTask::kPriorityCount; i++) {
+    _first[i] = nullptr;
+    _last[i] = nullptr;
+  }
+}
+
+JitCompileQueue::~JitCompileQueue() noexcept {
+  reset();
+}
+
+// ============================================================================
+// [asmjit::JitCompileQueue - Init / Reset]
+// ============================================================================
+
+Error JitCompileQueue::init(JitRuntime* runtime, uint32_t threadCount, uint32_t maxPending) noexcept {
+  if (ASMJIT_UNLIKELY(isInitialized()))
+    return DebugUtils::errored(kErrorAlreadyInitialized);
+
+  if (ASMJIT_UNLIKELY(!runtime || !threadCount || threadCount > kMaxThreadCount || !maxPending))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  JitCompileThread* threads = static_cast<JitCompileThread*>(
+    Internal::allocMemory(threadCount * sizeof(JitCompileThread)));
+
+  if (ASMJIT_UNLIKELY(!threads))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  _runtime = runtime;
+  _threads = threads;
+  _maxPending = maxPending;
+  _stopping = false;
+
+  for (uint32_t i = 0; i < threadCount; i++) {
+    if (ASMJIT_UNLIKELY(!JitCompileQueue_startThread(&threads[i], this))) {
+      reset();
+      return DebugUtils::errored(kErrorInvalidState);
+    }
+    _threadCount++;
+  }
+
+  return kErrorOk;
+}
+
+void JitCompileQueue::reset() noexcept {
+  if (!isInitialized())
+    return;
+
+  JitCompileTask* cancelled = nullptr;
+
+  {
+    AutoLock locked(_lock);
+
+    // Pending tasks are cancelled, running tasks are waited for.
+    JitCompileTask* task;
+    while ((task = JitCompileQueue_pop(this)) != nullptr) {
+      Atomic::store(&task->_state, static_cast<intptr_t>(JitCompileTask::kStateRunning));
+      task->_next = cancelled;
+      cancelled = task;
+    }
+
+    while (_runningCount)
+      _doneCond.wait(_lock);
+
+    _stopping = true;
+    _workCond.broadcast();
+  }
+
+  while (cancelled) {
+    JitCompileTask* next = cancelled->_next;
+    cancelled->_next = nullptr;
+    cancelled->_func = nullptr;
+    cancelled->_error = DebugUtils::errored(kErrorCancelled);
+    JitCompileQueue_complete(this, cancelled, JitCompileTask::kStateCancelled);
+    cancelled = next;
+  }
+
+  JitCompileThread* threads = static_cast<JitCompileThread*>(_threads);
+  for (uint32_t i = 0; i < _threadCount; i++)
+    JitCompileQueue_joinThread(threads[i]);
+  Internal::releaseMemory(threads);
+
+  _runtime = nullptr;
+  _threads = nullptr;
+  _threadCount = 0;
+  _maxPending = 0;
+  _stopping = false;
+}
+
+// ============================================================================
+// [asmjit::JitCompileQueue - Interface]
+// ============================================================================
+
+Error JitCompileQueue::submit(JitCompileTask* task) noexcept {
+  if (ASMJIT_UNLIKELY(!isInitialized()))
+    return DebugUtils::errored(kErrorNotInitialized);
+
+  AutoLock locked(_lock);
+
+  uint32_t state = task->getState();
+  if (ASMJIT_UNLIKELY(state == JitCompileTask::kStatePending || state == JitCompileTask::kStateRunning))
+    return DebugUtils::errored(kErrorInvalidState);
+
+  if (ASMJIT_UNLIKELY(_pendingCount >= _maxPending))
+    return DebugUtils::errored(kErrorQueueFull);
+
+  uint32_t priority = task->getPriority();
+  task->_next = nullptr;
+  task->_func = nullptr;
+  task->_error = kErrorOk;
+  Atomic::store(&task->_state, static_cast<intptr_t>(JitCompileTask::kStatePending));
+
+  if (_last[priority])
+    _last[priority]->_next = task;
+  else
+    _first[priority] = task;
+  _last[priority] = task;
+
+  _pendingCount++;
+  _workCond.signal();
+  return kErrorOk;
+}
+
+bool JitCompileQueue::cancel(JitCompileTask* task) noexcept {
+  {
+    AutoLock locked(_lock);
+    if (task->getState() != JitCompileTask::kStatePending)
+      return false;
+
+    uint32_t priority = task->getPriority();
+    JitCompileTask* prev = nullptr;
+    JitCompileTask* cur = _first[priority];
+
+    while (cur != task) {
+      prev = cur;
+      cur = cur->_next;
+    }
+
+    if (prev)
+      prev->_next = task->_next;
+    else
+      _first[priority] = task->_next;
+
+    if (_last[priority] == task)
+      _last[priority] = prev;
+
+    task->_next = nullptr;
+    _pendingCount--;
+    Atomic::store(&task->_state, static_cast<intptr_t>(JitCompileTask::kStateRunning));
+  }
+
+  task->_func = nullptr;
+  task->_error = DebugUtils::errored(kErrorCancelled);
+  JitCompileQueue_complete(this, task, JitCompileTask::kStateCancelled);
+  return true;
+}
+
+Error JitCompileQueue::wait(JitCompileTask* task) noexcept {
+  AutoLock locked(_lock);
+
+  for (;;) {
+    uint32_t state = task->getState();
+    if (state != JitCompileTask::kStatePending && state != JitCompileTask::kStateRunning)
+      break;
+    _doneCond.wait(_lock);
+  }
+
+  return task->getError();
+}
+
+void JitCompileQueue::waitAll() noexcept {
+  AutoLock locked(_lock);
+  while (_pendingCount || _runningCount)
+    _doneCond.wait(_lock);
+}
+
+// ============================================================================
+// [asmjit::JitCompileQueue - Test]
+// ============================================================================
+
+#if defined(ASMJIT_TEST) && (ASMJIT_ARCH_X86 || ASMJIT_ARCH_X64)
+struct JitCompileQueueTestGate {
+  ASMJIT_INLINE JitCompileQueueTestGate() noexcept : entered(false), open(false) {}
+
+  Lock lock;
+  CondVar cond;
+  bool entered;
+  bool open;
+};
+
+// Task that generates a function returning `value` - 'mov eax, value' and 'ret'.
+class JitCompileQueueTestTask : public JitCompileTask {
+public:
+  JitCompileQueueTestTask(uint32_t value, uint32_t priority, intptr_t* counter, JitCompileQueueTestGate* gate = nullptr) noexcept
+    : JitCompileTask(priority),
+      _value(value),
+      _order(0),
+      _counter(counter),
+      _gate(gate) {}
+
+  virtual Error build(CodeHolder* code) noexcept override {
+    _order = static_cast<uint32_t>(Atomic::add(_counter, 1));
+
+    if (_gate) {
+      AutoLock locked(_gate->lock);
+      _gate->entered = true;
+      _gate->cond.broadcast();
+      while (!_gate->open)
+        _gate->cond.wait(_gate->lock);
+    }
+
+    CodeBuffer& buf = code->getSectionEntry(0)->_buffer;
+    ASMJIT_PROPAGATE(code->growBuffer(&buf, 6));
+
+    buf._data[0] = 0xB8;
+    Utils::writeU32u(buf._data + 1, _value);
+    buf._data[5] = 0xC3;
+    buf._length = 6;
+    return kErrorOk;
+  }
+
+  uint32_t _value;
+  uint32_t _order;
+  intptr_t* _counter;
+  JitCompileQueueTestGate* _gate;
+};
+
+UNIT(base_jitqueue) {
+  typedef int (*Func)(void);
+
+  JitRuntime rt;
+  JitCompileQueue queue;
+  JitCompileQueueTestGate gate;
+  intptr_t counter = 0;
+
+  INFO("Checking JitCompileQueue compiles tasks");
+  EXPECT(queue.init(&rt, 2, 16) == kErrorOk);
+
+  {
+    JitCompileQueueTestTask t1(1, JitCompileTask::kPriorityNormal, &counter);
+    JitCompileQueueTestTask t2(2, JitCompileTask::kPriorityNormal, &counter);
+
+    EXPECT(queue.submit(&t1) == kErrorOk);
+    EXPECT(queue.submit(&t2) == kErrorOk);
+    EXPECT(queue.wait(&t1) == kErrorOk);
+    EXPECT(queue.wait(&t2) == kErrorOk);
+
+    EXPECT(t1.getState() == JitCompileTask::kStateDone);
+    EXPECT(t1.getFunc<Func>()() == 1);
+    EXPECT(t2.getFunc<Func>()() == 2);
+  }
+  queue.reset();
+
+  INFO("Checking JitCompileQueue priorities, bounds, and cancellation");
+  EXPECT(queue.init(&rt, 1, 2) == kErrorOk);
+
+  {
+    JitCompileQueueTestTask tGate(0, JitCompileTask::kPriorityNormal, &counter, &gate);
+    JitCompileQueueTestTask tLow(1, JitCompileTask::kPriorityLow, &counter);
+    JitCompileQueueTestTask tHigh(2, JitCompileTask::kPriorityHigh, &counter);
+    JitCompileQueueTestTask tFull(3, JitCompileTask::kPriorityNormal, &counter);
+
+    // Block the only worker thread.
+    EXPECT(queue.submit(&tGate) == kErrorOk);
+    {
+      AutoLock locked(gate.lock);
+      while (!gate.entered)
+        gate.cond.wait(gate.lock);
+    }
+
+    EXPECT(queue.submit(&tLow) == kErrorOk);
+    EXPECT(queue.submit(&tHigh) == kErrorOk);
+    EXPECT(queue.submit(&tFull) == kErrorQueueFull);
+    EXPECT(queue.submit(&tLow) == kErrorInvalidState);
+
+    EXPECT(queue.cancel(&tFull) == false);
+    EXPECT(queue.cancel(&tLow) == true);
+    EXPECT(tLow.getState() == JitCompileTask::kStateCancelled);
+    EXPECT(tLow.getError() == kErrorCancelled);
+    EXPECT(queue.submit(&tLow) == kErrorOk);
+
+    {
+      AutoLock locked(gate.lock);
+      gate.open = true;
+      gate.cond.broadcast();
+    }
+
+    queue.waitAll();
+    EXPECT(tGate.getState() == JitCompileTask::kStateDone);
+    EXPECT(tLow.getState() == JitCompileTask::kStateDone);
+    EXPECT(tHigh.getState() == JitCompileTask::kStateDone);
+    EXPECT(tHigh._order < tLow._order, "Task of a higher priority must be compiled first");
+    EXPECT(tLow.getFunc<Func>()() == 1);
+    EXPECT(tHigh.getFunc<Func>()() == 2);
+  }
+}
+#endif // ASMJIT_TEST && (ASMJIT_ARCH_X86 || ASMJIT_ARCH_X64)
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
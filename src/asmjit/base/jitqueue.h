@@ -0,0 +1,231 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _ASMJIT_BASE_JITQUEUE_H
+#define _ASMJIT_BASE_JITQUEUE_H
+
+// [Dependencies]
+#include "../base/runtime.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+//! \addtogroup asmjit_base
+//! \{
+
+// ============================================================================
+// [Forward Declarations]
+// ============================================================================
+
+class JitCompileQueue;
+
+// ============================================================================
+// [asmjit::JitCompileTask]
+// ============================================================================
+
+//! Task compiled asynchronously by \ref JitCompileQueue.
+//!
+//! The task either generates code by overriding `build()`, or wraps a
+//! \ref CodeHolder that has been already built. In both cases a worker thread
+//! finalizes all emitters attached to the `CodeHolder`, adds the code to the
+//! \ref JitRuntime, and calls `onComplete()`. The task is owned by the user
+//! and must stay valid until it's done (see `JitCompileQueue::wait()`).
+class ASMJIT_VIRTAPI JitCompileTask {
+public:
+  ASMJIT_NONCOPYABLE(JitCompileTask)
+
+  //! Task priority.
+  ASMJIT_ENUM(Priority) {
+    kPriorityLow     = 0,                //!< Low priority.
+    kPriorityNormal  = 1,                //!< Normal priority (default).
+    kPriorityHigh    = 2,                //!< High priority.
+    kPriorityCount   = 3                 //!< Count of priorities.
+  };
+
+  //! Task state.
+  ASMJIT_ENUM(State) {
+    kStateIdle       = 0,                //!< Not submitted.
+    kStatePending    = 1,                //!< Waiting in the queue.
+    kStateRunning    = 2,                //!< Being compiled or completed (`onComplete()` not returned yet).
+    kStateDone       = 3,                //!< Done, see `getError()` and `getFunc()`.
+    kStateCancelled  = 4                 //!< Cancelled before it started.
+  };
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  //! Create a task that generates code by `build()`.
+  ASMJIT_API explicit JitCompileTask(uint32_t priority = kPriorityNormal) noexcept;
+  //! Create a task that finalizes and adds an already built `code`.
+  ASMJIT_API explicit JitCompileTask(CodeHolder* code, uint32_t priority = kPriorityNormal) noexcept;
+  //! Destroy the `JitCompileTask` instance.
+  ASMJIT_API virtual ~JitCompileTask() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  //! Get the task priority, see \ref Priority.
+  ASMJIT_INLINE uint32_t getPriority() const noexcept { return _priority; }
+  //! Set the task priority, see \ref Priority (only before the task is submitted).
+  ASMJIT_INLINE void setPriority(uint32_t priority) noexcept {
+    ASMJIT_ASSERT(priority < kPriorityCount);
+    _priority = static_cast<uint8_t>(priority);
+  }
+
+  //! Get the task state, see \ref State.
+  ASMJIT_INLINE uint32_t getState() const noexcept { return static_cast<uint32_t>(Atomic::load(&_state)); }
+  //! Get if the task is done or cancelled.
+  ASMJIT_INLINE bool isComplete() const noexcept { return getState() >= kStateDone; }
+
+  //! Get the `CodeHolder` passed to the constructor (null if the task uses `build()`).
+  ASMJIT_INLINE CodeHolder* getCode() const noexcept { return _code; }
+
+  //! Get the result of the task (valid when the task is complete).
+  ASMJIT_INLINE Error getError() const noexcept { return _error; }
+
+  //! Get the function added to \ref JitRuntime (valid when the task is done).
+  template<typename Func>
+  ASMJIT_INLINE Func getFunc() const noexcept { return Internal::ptr_cast<Func, void*>(_func); }
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  //! Generate code into `code`, called by a worker thread.
+  //!
+  //! The `code` is initialized to match the runtime. Emitters that are still
+  //! attached to `code` when `build()` returns are finalized by the queue.
+  ASMJIT_API virtual Error build(CodeHolder* code) noexcept;
+
+  //! Called when the task completes, cancelled tasks included.
+  //!
+  //! Called by the thread that completed the task, `getError()` and `getFunc()`
+  //! are already valid, and `JitCompileQueue::wait()` doesn't return before
+  //! `onComplete()` returns.
+  ASMJIT_API virtual void onComplete() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  JitCompileTask* _next;                 //!< Next task in the queue.
+  CodeHolder* _code;                     //!< Already built code or null.
+  void* _func;                           //!< Function added to the runtime.
+  intptr_t _state;                       //!< Task state (accessed atomically).
+  Error _error;                          //!< Task result.
+  uint8_t _priority;                     //!< Task priority.
+  uint8_t _reserved[3];                  //!< \internal
+};
+
+// ============================================================================
+// [asmjit::JitCompileQueue]
+// ============================================================================
+
+//! Compiles \ref JitCompileTask instances by a pool of worker threads and adds
+//! the generated code to \ref JitRuntime.
+//!
+//! The queue has a bounded number of pending tasks, tasks of higher priority
+//! are compiled first and tasks of the same priority in FIFO order. Pending
+//! tasks can be cancelled.
+class ASMJIT_VIRTAPI JitCompileQueue {
+public:
+  ASMJIT_NONCOPYABLE(JitCompileQueue)
+
+  ASMJIT_ENUM(Limits) {
+    kMaxThreadCount = 64                 //!< Maximum number of worker threads.
+  };
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  //! Create an uninitialized `JitCompileQueue`, see `init()`.
+  ASMJIT_API JitCompileQueue() noexcept;
+  //! Destroy the `JitCompileQueue`, calls `reset()`.
+  ASMJIT_API ~JitCompileQueue() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Init / Reset]
+  // --------------------------------------------------------------------------
+
+  //! Get if the queue is initialized.
+  ASMJIT_INLINE bool isInitialized() const noexcept { return _runtime != nullptr; }
+
+  //! Initialize the queue to add code to `runtime` by `threadCount` worker
+  //! threads and to accept at most `maxPending` pending tasks.
+  ASMJIT_API Error init(JitRuntime* runtime, uint32_t threadCount = 1, uint32_t maxPending = 256) noexcept;
+
+  //! Cancel all pending tasks, wait for running tasks, and stop all threads.
+  ASMJIT_API void reset() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  //! Get the runtime the queue adds code to.
+  ASMJIT_INLINE JitRuntime* getRuntime() const noexcept { return _runtime; }
+  //! Get the number of worker threads.
+  ASMJIT_INLINE uint32_t getThreadCount() const noexcept { return _threadCount; }
+  //! Get the maximum number of pending tasks.
+  ASMJIT_INLINE uint32_t getMaxPending() const noexcept { return _maxPending; }
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  //! Submit `task` to the queue.
+  //!
+  //! Returns `kErrorQueueFull` if the queue already has `getMaxPending()`
+  //! tasks or `kErrorInvalidState` if the task is pending or running.
+  ASMJIT_API Error submit(JitCompileTask* task) noexcept;
+
+  //! Cancel `task` if it's still pending.
+  //!
+  //! Returns true if the task was cancelled, in that case its error is set to
+  //! `kErrorCancelled` and `onComplete()` is called before `cancel()` returns.
+  //! A task that is already running cannot be cancelled.
+  ASMJIT_API bool cancel(JitCompileTask* task) noexcept;
+
+  //! Wait until `task` is complete and return its error.
+  ASMJIT_API Error wait(JitCompileTask* task) noexcept;
+
+  //! Wait until all submitted tasks are complete.
+  ASMJIT_API void waitAll() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  JitRuntime* _runtime;                  //!< Runtime the code is added to.
+  void* _threads;                        //!< Native thread handles.
+  uint32_t _threadCount;                 //!< Number of worker threads.
+  uint32_t _maxPending;                  //!< Maximum number of pending tasks.
+  uint32_t _pendingCount;                //!< Number of pending tasks.
+  uint32_t _runningCount;                //!< Number of running tasks.
+  bool _stopping;                        //!< True if worker threads should terminate.
+
+  Lock _lock;                            //!< Lock that guards the queue.
+  CondVar _workCond;                     //!< Signaled when a task is submitted.
+  CondVar _doneCond;                     //!< Signaled when a task is complete.
+
+  JitCompileTask* _first[JitCompileTask::kPriorityCount]; //!< First pending task of each priority.
+  JitCompileTask* _last[JitCompileTask::kPriorityCount];  //!< Last pending task of each priority.
+};
+
+//! \}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // _ASMJIT_BASE_JITQUEUE_H
@@ -11,6 +11,10 @@
 // [Dependencies]
 #include "../base/globals.h"
 
+#if ASMJIT_CC_MSC
+# include <intrin.h>
+#endif // ASMJIT_CC_MSC
+
 // [Api-Begin]
 #include "../asmjit_apibegin.h"
 
@@ -142,6 +146,64 @@ struct Lock {
   Handle _handle;
 };
 
+// ============================================================================
+// [asmjit::CondVar]
+// ============================================================================
+
+//! \internal
+//!
+//! Condition variable, used together with \ref Lock.
+struct CondVar {
+  ASMJIT_NONCOPYABLE(CondVar)
+
+  // --------------------------------------------------------------------------
+  // [Windows]
+  // --------------------------------------------------------------------------
+
+#if ASMJIT_OS_WINDOWS
+  typedef CONDITION_VARIABLE Handle;
+
+  //! Create a new `CondVar` instance.
+  ASMJIT_INLINE CondVar() noexcept { InitializeConditionVariable(&_handle); }
+  //! Destroy the `CondVar` instance.
+  ASMJIT_INLINE ~CondVar() noexcept {}
+
+  //! Unlock `lock`, wait until signaled, and lock `lock` again.
+  ASMJIT_INLINE void wait(Lock& lock) noexcept { SleepConditionVariableCS(&_handle, &lock._handle, INFINITE); }
+  //! Wake up a single waiting thread.
+  ASMJIT_INLINE void signal() noexcept { WakeConditionVariable(&_handle); }
+  //! Wake up all waiting threads.
+  ASMJIT_INLINE void broadcast() noexcept { WakeAllConditionVariable(&_handle); }
+#endif // ASMJIT_OS_WINDOWS
+
+  // --------------------------------------------------------------------------
+  // [Posix]
+  // --------------------------------------------------------------------------
+
+#if ASMJIT_OS_POSIX
+  typedef pthread_cond_t Handle;
+
+  //! Create a new `CondVar` instance.
+  ASMJIT_INLINE CondVar() noexcept { pthread_cond_init(&_handle, nullptr); }
+  //! Destroy the `CondVar` instance.
+  ASMJIT_INLINE ~CondVar() noexcept { pthread_cond_destroy(&_handle); }
+
+  //! Unlock `lock`, wait until signaled, and lock `lock` again.
+  ASMJIT_INLINE void wait(Lock& lock) noexcept { pthread_cond_wait(&_handle, &lock._handle); }
+  //! Wake up a single waiting thread.
+  ASMJIT_INLINE void signal() noexcept { pthread_cond_signal(&_handle); }
+  //! Wake up all waiting threads.
+  ASMJIT_INLINE void broadcast() noexcept { pthread_cond_broadcast(&_handle); }
+#endif // ASMJIT_OS_POSIX
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  //! Native handle.
+  Handle _handle;
+};
+
 // ============================================================================
 // [asmjit::AutoLock]
 // ============================================================================
@@ -167,6 +229,80 @@ struct AutoLock {
   Lock& _target;
 };
 
+// ============================================================================
+// [asmjit::Atomic]
+// ============================================================================
+
+//! \internal
+//!
+//! Atomic operations.
+//!
+//! Only types of the size of a pointer (pointers and `intptr_t`/`uintptr_t`)
+//! are supported. All operations are lock-free and can be used by signal
+//! handlers. Loads have acquire semantics, stores have release semantics, and
+//! read-modify-write operations are sequentially consistent.
+struct Atomic {
+#if !ASMJIT_CC_MSC
+  // GCC, Clang, and compatible compilers.
+  template<typename T>
+  static ASMJIT_INLINE T load(const T* p) noexcept { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+
+  template<typename T>
+  static ASMJIT_INLINE void store(T* p, T value) noexcept { __atomic_store_n(p, value, __ATOMIC_RELEASE); }
+
+  template<typename T>
+  static ASMJIT_INLINE T exchange(T* p, T value) noexcept { return __atomic_exchange_n(p, value, __ATOMIC_SEQ_CST); }
+
+  template<typename T>
+  static ASMJIT_INLINE bool compareExchange(T* p, T expected, T value) noexcept {
+    return __atomic_compare_exchange_n(p, &expected, value, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+  }
+
+  //! Add `value` to `*p` and return the new value.
+  static ASMJIT_INLINE intptr_t add(intptr_t* p, intptr_t value) noexcept { return __atomic_add_fetch(p, value, __ATOMIC_SEQ_CST); }
+#else
+  template<typename T>
+  static ASMJIT_INLINE T load(const T* p) noexcept {
+    T value = *static_cast<const volatile T*>(p);
+    _ReadWriteBarrier();
+    return value;
+  }
+
+  template<typename T>
+  static ASMJIT_INLINE void store(T* p, T value) noexcept {
+    _ReadWriteBarrier();
+    *static_cast<volatile T*>(p) = value;
+  }
+
+  template<typename T>
+  static ASMJIT_INLINE T exchange(T* p, T value) noexcept {
+    ASMJIT_ASSERT(sizeof(T) == sizeof(void*));
+    union { T t; void* p; } src, dst;
+    src.t = value;
+    dst.p = _InterlockedExchangePointer(reinterpret_cast<void* volatile*>(p), src.p);
+    return dst.t;
+  }
+
+  template<typename T>
+  static ASMJIT_INLINE bool compareExchange(T* p, T expected, T value) noexcept {
+    ASMJIT_ASSERT(sizeof(T) == sizeof(void*));
+    union { T t; void* p; } e, v;
+    e.t = expected;
+    v.t = value;
+    return _InterlockedCompareExchangePointer(reinterpret_cast<void* volatile*>(p), v.p, e.p) == e.p;
+  }
+
+  //! Add `value` to `*p` and return the new value.
+  static ASMJIT_INLINE intptr_t add(intptr_t* p, intptr_t value) noexcept {
+# if ASMJIT_ARCH_64BIT
+    return _InterlockedExchangeAdd64(reinterpret_cast<volatile __int64*>(p), value) + value;
+# else
+    return _InterlockedExchangeAdd(reinterpret_cast<volatile long*>(p), value) + value;
+# endif
+  }
+#endif
+};
+
 //! \}
 
 } // asmjit namespace
@@ -120,6 +120,7 @@ Error RAPass::prepare(CCFunc* func) noexcept {
 
   _memMaxAlign = 0;
   _memVarTotal = 0;
+  _memVarUnsharedTotal = 0;
   _memStackTotal = 0;
   _memAllTotal = 0;
   _annotationLength = 12;
@@ -244,7 +245,150 @@ RACell* RAPass::_newStackCell(uint32_t size, uint32_t alignment) {
   return cell;
 }
 
+//! \internal
+//!
+//! Extend the range `[start, end]` of positions where the cell of `vreg` is in use.
+static ASMJIT_INLINE void RAPass_extendCellRange(VirtReg* vreg, uint32_t pos, uint32_t* start, uint32_t* end) {
+  uint32_t raId = vreg->_raId;
+  if (raId == kInvalidValue)
+    return;
+
+  if (start[raId] == kInvalidValue)
+    start[raId] = pos;
+  end[raId] = pos;
+}
+
+Error RAPass::shareVarCells() {
+  VirtReg** vregs = _contextVd.getData();
+  uint32_t vregCount = static_cast<uint32_t>(_contextVd.getLength());
+
+  _memVarUnsharedTotal = _memVarTotal;
+  if (!_memVarCells || vregCount == 0)
+    return kErrorOk;
+
+  uint32_t i;
+  uint32_t* start = static_cast<uint32_t*>(_zone->alloc(vregCount * sizeof(uint32_t)));
+  uint32_t* end = static_cast<uint32_t*>(_zone->alloc(vregCount * sizeof(uint32_t)));
+
+  if (ASMJIT_UNLIKELY(!start || !end))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  for (i = 0; i < vregCount; i++)
+    start[i] = kInvalidValue;
+
+  // Cells created by this pass are marked so cells that belong to another
+  // function are never shared, all offsets are assigned later anyway.
+  RACell* cell;
+  for (cell = _memVarCells; cell; cell = cell->next)
+    cell->offset = -1;
+
+  // Calculate the range of positions where each variable is live or where
+  // its home is accessed, which includes loads and saves emitted by `translate()`.
+  CBNode* node = getFunc();
+  CBNode* stop = getStop();
+  uint32_t pos = 0;
+
+  for (; node != stop; node = node->getNext(), pos++) {
+    if (node->hasPassData()) {
+      RABits* liveness = node->getPassData<RAData>()->liveness;
+      if (liveness) {
+        for (i = 0; i < vregCount; i++)
+          if (liveness->getBit(i))
+            RAPass_extendCellRange(vregs[i], pos, start, end);
+      }
+    }
+
+    if (node->getType() == CBNode::kNodeInst || node->getType() == CBNode::kNodeFuncCall) {
+      CBInst* inst = static_cast<CBInst*>(node);
+      if (inst->hasMemOp()) {
+        Mem* m = inst->getMemOp();
+        if (m->isRegHome() && cc()->isVirtRegValid(m->getBaseId()))
+          RAPass_extendCellRange(cc()->getVirtRegById(m->getBaseId()), pos, start, end);
+      }
+    }
+  }
+
+  // Order variables by the start of their ranges (counting sort).
+  uint32_t posCount = pos + 1;
+  uint32_t* count = static_cast<uint32_t*>(_zone->allocZeroed((posCount + 1) * sizeof(uint32_t)));
+  uint32_t* order = static_cast<uint32_t*>(_zone->alloc(vregCount * sizeof(uint32_t)));
+
+  if (ASMJIT_UNLIKELY(!count || !order))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  uint32_t orderCount = 0;
+  for (i = 0; i < vregCount; i++) {
+    cell = vregs[i]->getMemCell();
+    if (cell && cell->offset == -1 && start[i] != kInvalidValue) {
+      count[start[i] + 1]++;
+      orderCount++;
+    }
+  }
+
+  for (pos = 0; pos < posCount; pos++)
+    count[pos + 1] += count[pos];
+
+  for (i = 0; i < vregCount; i++) {
+    cell = vregs[i]->getMemCell();
+    if (cell && cell->offset == -1 && start[i] != kInvalidValue)
+      order[count[start[i]]++] = i;
+  }
+
+  // Linear scan - a variable takes over a cell of the same size that is no
+  // longer used by any other variable, otherwise it keeps its own cell.
+  RACell** active = static_cast<RACell**>(_zone->alloc(orderCount * sizeof(RACell*)));
+  uint32_t* activeEnd = static_cast<uint32_t*>(_zone->alloc(orderCount * sizeof(uint32_t)));
+
+  if (ASMJIT_UNLIKELY(!active || !activeEnd))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  uint32_t activeCount = 0;
+  for (uint32_t k = 0; k < orderCount; k++) {
+    uint32_t raId = order[k];
+    VirtReg* vreg = vregs[raId];
+    RACell* own = vreg->getMemCell();
+
+    for (i = 0; i < activeCount; i++)
+      if (active[i]->size == own->size && activeEnd[i] < start[raId])
+        break;
+
+    if (i < activeCount) {
+      // Mark `own` as unused, it's removed from the list of cells below.
+      vreg->setMemCell(active[i]);
+      own->offset = -2;
+      _memVarTotal -= own->size;
+
+      switch (own->size) {
+        case  1: _mem1ByteVarsUsed-- ; break;
+        case  2: _mem2ByteVarsUsed-- ; break;
+        case  4: _mem4ByteVarsUsed-- ; break;
+        case  8: _mem8ByteVarsUsed-- ; break;
+        case 16: _mem16ByteVarsUsed--; break;
+        case 32: _mem32ByteVarsUsed--; break;
+        case 64: _mem64ByteVarsUsed--; break;
+      }
+    }
+    else {
+      active[activeCount++] = own;
+    }
+
+    activeEnd[i] = end[raId];
+  }
+
+  RACell** pPrev = &_memVarCells;
+  while ((cell = *pPrev) != nullptr) {
+    if (cell->offset == -2)
+      *pPrev = cell->next;
+    else
+      pPrev = &cell->next;
+  }
+
+  return kErrorOk;
+}
+
 Error RAPass::resolveCellOffsets() {
+  ASMJIT_PROPAGATE(shareVarCells());
+
   RACell* varCell = _memVarCells;
   RACell* stackCell = _memStackCells;
 
@@ -293,6 +437,14 @@ Error RAPass::resolveCellOffsets() {
   }
 
   _memAllTotal = stackPos;
+
+  if (_emitComments && _memVarUnsharedTotal != 0) {
+    CBNode* oldCursor = cc()->setCursor(getFunc());
+    cc()->commentf("[Frame] %u bytes, spill slots %u bytes (%u bytes without sharing)",
+      _memAllTotal, _memVarTotal, _memVarUnsharedTotal);
+    cc()->_setCursor(oldCursor);
+  }
+
   return kErrorOk;
 }
 
@@ -408,6 +408,8 @@ public:
     return cell ? cell : _newVarCell(vreg);
   }
 
+  //! Share cells of variables whose stack homes are never used at the same time.
+  Error shareVarCells();
   virtual Error resolveCellOffsets();
 
   // --------------------------------------------------------------------------
@@ -549,6 +551,7 @@ public:
 
   uint32_t _memMaxAlign;                 //!< Maximum memory alignment used by the function.
   uint32_t _memVarTotal;                 //!< Count of bytes used by variables.
+  uint32_t _memVarUnsharedTotal;         //!< Count of bytes used by variables if their cells were not shared.
   uint32_t _memStackTotal;               //!< Count of bytes used by stack.
   uint32_t _memAllTotal;                 //!< Count of bytes used by variables and stack after alignment.
 
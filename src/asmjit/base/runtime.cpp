@@ -15,6 +15,19 @@
 // [Api-Begin]
 #include "../asmjit_apibegin.h"
 
+// Unwind information of JIT functions is registered through `__register_frame()`
+// provided by the unwinder (libgcc or libunwind). The symbols are weak so AsmJit
+// doesn't fail to link if they are not available, in that case nothing is done.
+#if (ASMJIT_ARCH_X86 || ASMJIT_ARCH_X64) && !ASMJIT_OS_WINDOWS && (ASMJIT_CC_GCC || ASMJIT_CC_CLANG)
+# define ASMJIT_RUNTIME_EH_FRAME 1
+extern "C" {
+void __register_frame(void* p) __attribute__((weak));
+void __deregister_frame(void* p) __attribute__((weak));
+}
+#else
+# define ASMJIT_RUNTIME_EH_FRAME 0
+#endif
+
 namespace asmjit {
 
 static ASMJIT_INLINE void hostFlushInstructionCache(const void* p, size_t size) noexcept {
@@ -96,12 +109,367 @@ void HostRuntime::flush(const void* p, size_t size) noexcept {
   hostFlushInstructionCache(p, size);
 }
 
+// ============================================================================
+// [asmjit::JitRuntime - EhFrame]
+// ============================================================================
+
+//! \internal
+//!
+//! `.eh_frame` data of a single function registered by `JitRuntime`.
+struct JitRuntime::EhFrame {
+  EhFrame* next;                         //!< Next registered frame.
+  void* p;                               //!< Pointer returned by `add()` the frame belongs to.
+  uint8_t data[FuncFrameLayout::kMaxEhFrameSize];
+};
+
+#if ASMJIT_RUNTIME_EH_FRAME
+static ASMJIT_INLINE bool JitRuntime_canRegisterEhFrame() noexcept {
+  return __register_frame != nullptr && __deregister_frame != nullptr;
+}
+
+// libgcc expects the whole `.eh_frame` section (CIE + FDE + terminator), but
+// libunwind (OSX) expects only a single FDE, which follows the CIE.
+static ASMJIT_INLINE void* JitRuntime_getEhFrameEntry(JitRuntime::EhFrame* frame) noexcept {
+#if ASMJIT_OS_MAC
+  return frame->data + Utils::readU32u(frame->data) + 4;
+#else
+  return frame->data;
+#endif
+}
+#endif // ASMJIT_RUNTIME_EH_FRAME
+
+static Error JitRuntime_registerEhFrames(JitRuntime* self, CodeHolder* code, void* p, size_t codeSize) noexcept {
+#if ASMJIT_RUNTIME_EH_FRAME
+  if (!JitRuntime_canRegisterEhFrame())
+    return kErrorOk;
+
+  const ZoneVector<UnwindEntry*>& entries = code->getUnwindEntries();
+  uint64_t base = static_cast<uint64_t>((uintptr_t)p);
+
+  JitRuntime::EhFrame* first = nullptr;
+  JitRuntime::EhFrame* last = nullptr;
+
+  for (size_t i = 0, len = entries.getLength(); i < len; i++) {
+    const UnwindEntry* ue = entries[i];
+    const LabelEntry* start = code->getLabelEntry(ue->getStartLabelId());
+    const LabelEntry* end = code->getLabelEntry(ue->getEndLabelId());
+
+    // Functions that were not serialized (or whose labels were not bound by
+    // the user) are skipped, there is no code to describe.
+    if (!start || !end || !start->isBound() || !end->isBound() || start->getOffset() >= end->getOffset())
+      continue;
+
+    size_t funcOffset = static_cast<size_t>(start->getOffset());
+    size_t funcSize = static_cast<size_t>(end->getOffset()) - funcOffset;
+    if (funcOffset + funcSize > codeSize)
+      continue;
+
+    // Code placed after the epilog (if any) is still part of the function.
+    size_t epilogEnd = funcSize;
+    if (ue->getEpilogLabelId()) {
+      const LabelEntry* epilog = code->getLabelEntry(ue->getEpilogLabelId());
+      if (!epilog || !epilog->isBound() || epilog->getOffset() < start->getOffset() || epilog->getOffset() > end->getOffset())
+        continue;
+      epilogEnd = static_cast<size_t>(epilog->getOffset()) - funcOffset;
+    }
+
+    JitRuntime::EhFrame* frame = static_cast<JitRuntime::EhFrame*>(Internal::allocMemory(sizeof(JitRuntime::EhFrame)));
+    if (ASMJIT_UNLIKELY(!frame)) {
+      while (first) {
+        JitRuntime::EhFrame* next = first->next;
+        Internal::releaseMemory(first);
+        first = next;
+      }
+      return DebugUtils::errored(kErrorNoHeapMemory);
+    }
+
+    frame->next = nullptr;
+    frame->p = p;
+
+    if (!ue->getLayout().buildEhFrame(frame->data, base + funcOffset, funcSize, epilogEnd)) {
+      Internal::releaseMemory(frame);
+      continue;
+    }
+
+    if (last)
+      last->next = frame;
+    else
+      first = frame;
+    last = frame;
+  }
+
+  if (!first)
+    return kErrorOk;
+
+  for (JitRuntime::EhFrame* frame = first; frame; frame = frame->next)
+    __register_frame(JitRuntime_getEhFrameEntry(frame));
+
+  AutoLock locked(self->_ehFrameLock);
+  last->next = self->_ehFrames;
+  self->_ehFrames = first;
+#else
+  ASMJIT_UNUSED(self);
+  ASMJIT_UNUSED(code);
+  ASMJIT_UNUSED(p);
+  ASMJIT_UNUSED(codeSize);
+#endif // ASMJIT_RUNTIME_EH_FRAME
+
+  return kErrorOk;
+}
+
+// Deregister and free all frames that belong to `p` or all frames if `p` is null.
+static void JitRuntime_releaseEhFrames(JitRuntime* self, void* p) noexcept {
+  JitRuntime::EhFrame* released = nullptr;
+
+  {
+    AutoLock locked(self->_ehFrameLock);
+    JitRuntime::EhFrame** pPrev = &self->_ehFrames;
+
+    while (*pPrev) {
+      JitRuntime::EhFrame* frame = *pPrev;
+      if (p && frame->p != p) {
+        pPrev = &frame->next;
+        continue;
+      }
+
+      *pPrev = frame->next;
+      frame->next = released;
+      released = frame;
+    }
+  }
+
+  while (released) {
+    JitRuntime::EhFrame* next = released->next;
+#if ASMJIT_RUNTIME_EH_FRAME
+    __deregister_frame(JitRuntime_getEhFrameEntry(released));
+#endif // ASMJIT_RUNTIME_EH_FRAME
+    Internal::releaseMemory(released);
+    released = next;
+  }
+}
+
+// ============================================================================
+// [asmjit::JitRuntime - FuncIndex]
+// ============================================================================
+
+//! \internal
+//!
+//! Immutable snapshot of functions sorted by their start address.
+//!
+//! Writers never modify a published index. They create an updated copy,
+//! publish it, and retire the old one, which is freed when there are no
+//! readers (RCU-like scheme that doesn't require readers to lock).
+struct JitRuntime::FuncIndex {
+  FuncIndex* next;                       //!< Next retired index.
+  size_t length;                         //!< Number of functions.
+  JitFuncInfo data[1];                   //!< Functions sorted by `start`.
+};
+
+#if defined(ASMJIT_TEST)
+//! \internal
+//!
+//! Number of function index allocations that fail (used to test failures).
+static uint32_t JitRuntime_testFailFuncIndexAlloc = 0;
+#endif // ASMJIT_TEST
+
+static ASMJIT_INLINE JitRuntime::FuncIndex* JitRuntime_allocFuncIndex(size_t length) noexcept {
+#if defined(ASMJIT_TEST)
+  if (JitRuntime_testFailFuncIndexAlloc) {
+    JitRuntime_testFailFuncIndexAlloc--;
+    return nullptr;
+  }
+#endif // ASMJIT_TEST
+
+  size_t size = sizeof(JitRuntime::FuncIndex) + (length ? length - 1 : 0) * sizeof(JitFuncInfo);
+  JitRuntime::FuncIndex* index = static_cast<JitRuntime::FuncIndex*>(Internal::allocMemory(size));
+
+  if (ASMJIT_LIKELY(index)) {
+    index->next = nullptr;
+    index->length = length;
+  }
+  return index;
+}
+
+static void JitRuntime_freeFuncIndexList(JitRuntime::FuncIndex* index) noexcept {
+  while (index) {
+    JitRuntime::FuncIndex* next = index->next;
+    Internal::releaseMemory(index);
+    index = next;
+  }
+}
+
+// Get the number of functions that start at or before `addr`.
+static ASMJIT_INLINE size_t JitRuntime_searchFuncIndex(const JitRuntime::FuncIndex* index, uintptr_t addr) noexcept {
+  size_t lo = 0;
+  size_t hi = index->length;
+
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (index->data[mid].start <= addr)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// Publish `index` and retire the current one. Must be called with `_funcIndexLock` held.
+static void JitRuntime_publishFuncIndex(JitRuntime* self, JitRuntime::FuncIndex* index) noexcept {
+  JitRuntime::FuncIndex* old = Atomic::exchange(&self->_funcIndex, index);
+  if (old) {
+    old->next = self->_funcIndexRetired;
+    self->_funcIndexRetired = old;
+  }
+
+  // A reader that enters after the exchange above can only see the new index,
+  // so all retired indexes can be freed if there is no reader at the moment.
+  if (Atomic::add(&self->_funcIndexReaders, 0) == 0) {
+    JitRuntime_freeFuncIndexList(self->_funcIndexRetired);
+    self->_funcIndexRetired = nullptr;
+  }
+}
+
+static Error JitRuntime_insertFunc(JitRuntime* self, void* p, size_t size) noexcept {
+  AutoLock locked(self->_funcIndexLock);
+
+  const JitRuntime::FuncIndex* cur = self->_funcIndex;
+  size_t curLength = cur ? cur->length : 0;
+
+  JitRuntime::FuncIndex* index = JitRuntime_allocFuncIndex(curLength + 1);
+  if (ASMJIT_UNLIKELY(!index))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  uintptr_t start = (uintptr_t)p;
+  uintptr_t end = start + size;
+
+  JitFuncInfo info;
+  info.start = start;
+  info.size = size;
+  info.name = nullptr;
+  info.userData = nullptr;
+
+  // Functions that overlap the new one are dropped. They belong to code that
+  // was released without being removed from the index, see `_release()`.
+  size_t length = 0;
+  bool inserted = false;
+
+  for (size_t i = 0; i < curLength; i++) {
+    const JitFuncInfo& src = cur->data[i];
+    if (src.start < end && start < src.start + src.size)
+      continue;
+
+    if (!inserted && src.start > start) {
+      index->data[length++] = info;
+      inserted = true;
+    }
+    index->data[length++] = src;
+  }
+
+  if (!inserted)
+    index->data[length++] = info;
+
+  index->length = length;
+  JitRuntime_publishFuncIndex(self, index);
+  return kErrorOk;
+}
+
+static Error JitRuntime_removeFunc(JitRuntime* self, void* p) noexcept {
+  AutoLock locked(self->_funcIndexLock);
+
+  const JitRuntime::FuncIndex* cur = self->_funcIndex;
+  uintptr_t start = (uintptr_t)p;
+
+  size_t i = cur ? JitRuntime_searchFuncIndex(cur, start) : 0;
+  if (!i || cur->data[--i].start != start)
+    return kErrorOk;
+
+  size_t length = cur->length - 1;
+  JitRuntime::FuncIndex* index = JitRuntime_allocFuncIndex(length);
+  if (ASMJIT_UNLIKELY(!index))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  ::memcpy(index->data, cur->data, i * sizeof(JitFuncInfo));
+  ::memcpy(index->data + i, cur->data + i + 1, (length - i) * sizeof(JitFuncInfo));
+
+  JitRuntime_publishFuncIndex(self, index);
+  return kErrorOk;
+}
+
+// ============================================================================
+// [asmjit::JitRuntime - RetiredCode]
+// ============================================================================
+
+//! \internal
+//!
+//! Code retired by `JitRuntime`, released when no attached thread is inside
+//! an epoch that started before `epoch`.
+struct JitRuntime::RetiredCode {
+  RetiredCode* next;                     //!< Next retired code.
+  void* p;                               //!< Pointer to release.
+  intptr_t epoch;                        //!< Epoch in which `p` was retired.
+};
+
+// Retire `p` by using a preallocated `retired` record.
+static void JitRuntime_retire(JitRuntime* self, JitRuntime::RetiredCode* retired, void* p) noexcept {
+  retired->p = p;
+
+  AutoLock locked(self->_epochLock);
+  retired->epoch = Atomic::add(&self->_epoch, 1);
+  retired->next = self->_retiredCode;
+  self->_retiredCode = retired;
+}
+
+// ============================================================================
+// [asmjit::JitRuntime - CounterBlock]
+// ============================================================================
+
+//! \internal
+//!
+//! Counters allocated by `JitRuntime::allocCounters()`, followed by `count`
+//! 64-bit counters.
+struct JitRuntime::CounterBlock {
+  CounterBlock* next;                    //!< Next counter block.
+  size_t count;                          //!< Number of counters.
+
+  ASMJIT_INLINE uint64_t* getCounters() noexcept {
+    return reinterpret_cast<uint64_t*>(this + 1);
+  }
+};
+
 // ============================================================================
 // [asmjit::JitRuntime - Construction / Destruction]
 // ============================================================================
 
-JitRuntime::JitRuntime() noexcept {}
-JitRuntime::~JitRuntime() noexcept {}
+JitRuntime::JitRuntime() noexcept
+  : _ehFrames(nullptr),
+    _funcIndex(nullptr),
+    _funcIndexRetired(nullptr),
+    _funcIndexReaders(0),
+    _epoch(1),
+    _epochThreads(nullptr),
+    _retiredCode(nullptr),
+    _counters(nullptr) {}
+
+JitRuntime::~JitRuntime() noexcept {
+  // Retired code is released together with `_memMgr`.
+  RetiredCode* retired = _retiredCode;
+  while (retired) {
+    RetiredCode* next = retired->next;
+    Internal::releaseMemory(retired);
+    retired = next;
+  }
+
+  JitRuntime_releaseEhFrames(this, nullptr);
+  JitRuntime_freeFuncIndexList(_funcIndex);
+  JitRuntime_freeFuncIndexList(_funcIndexRetired);
+
+  CounterBlock* block = _counters;
+  while (block) {
+    CounterBlock* next = block->next;
+    Internal::releaseMemory(block);
+    block = next;
+  }
+}
 
 // ============================================================================
 // [asmjit::JitRuntime - Interface]
@@ -114,33 +482,580 @@ Error JitRuntime::_add(void** dst, CodeHolder* code) noexcept {
     return DebugUtils::errored(kErrorNoCodeGenerated);
   }
 
-  void* p = _memMgr.alloc(codeSize, getAllocType());
-  if (ASMJIT_UNLIKELY(!p)) {
-    *dst = nullptr;
-    return DebugUtils::errored(kErrorNoVirtualMemory);
+  CodeBuffer& buf = code->getSectionEntry(0)->_buffer;
+  size_t allocSize = codeSize;
+  void* p;
+
+  if (buf.isExecutable()) {
+    // Emit-in-place - the code is already in the memory reserved by `reserve()`,
+    // which must have room for trampolines as well.
+    allocSize = buf.getCapacity();
+    if (ASMJIT_UNLIKELY(codeSize > allocSize)) {
+      *dst = nullptr;
+      return DebugUtils::errored(kErrorCodeTooLarge);
+    }
+    p = buf._data;
+  }
+  else {
+    p = _memMgr.alloc(codeSize, getAllocType());
+    if (ASMJIT_UNLIKELY(!p)) {
+      *dst = nullptr;
+      return DebugUtils::errored(kErrorNoVirtualMemory);
+    }
   }
 
-  // Relocate the code and release the unused memory back to `VMemMgr`.
+  // Relocate the code and release the unused memory back to `VMemMgr`. The
+  // memory reserved by `reserve()` belongs to the function from now.
   size_t relocSize = code->relocate(p);
+  if (buf.isExecutable())
+    code->_setExecutableBuffer(&buf, nullptr, 0);
   if (ASMJIT_UNLIKELY(relocSize == 0)) {
     *dst = nullptr;
     _memMgr.release(p);
     return DebugUtils::errored(kErrorInvalidState);
   }
 
-  if (relocSize < codeSize)
+  if (relocSize < allocSize)
     _memMgr.shrink(p, relocSize);
 
   flush(p, relocSize);
-  *dst = p;
 
+  if (code->hasUnwindEntries()) {
+    Error err = JitRuntime_registerEhFrames(this, code, p, relocSize);
+    if (ASMJIT_UNLIKELY(err)) {
+      *dst = nullptr;
+      _memMgr.release(p);
+      return err;
+    }
+  }
+
+  Error err = JitRuntime_insertFunc(this, p, relocSize);
+  if (ASMJIT_UNLIKELY(err)) {
+    *dst = nullptr;
+    if (_ehFrames)
+      JitRuntime_releaseEhFrames(this, p);
+    _memMgr.release(p);
+    return err;
+  }
+
+  *dst = p;
   return kErrorOk;
 }
 
 Error JitRuntime::_release(void* p) noexcept {
+  // The code is released even if the function can't be removed from the index.
+  // Its entry is dropped when the memory is reused by another function.
+  Error err = JitRuntime_removeFunc(this, p);
+
+  if (_ehFrames)
+    JitRuntime_releaseEhFrames(this, p);
+
+  Error releaseErr = _memMgr.release(p);
+  return releaseErr ? releaseErr : err;
+}
+
+// ============================================================================
+// [asmjit::JitRuntime - Emit-In-Place]
+// ============================================================================
+
+Error JitRuntime::reserve(CodeHolder* code, size_t size) noexcept {
+  if (ASMJIT_UNLIKELY(!code->isInitialized() || size == 0))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  code->sync();
+  CodeBuffer& buf = code->getSectionEntry(0)->_buffer;
+  if (ASMJIT_UNLIKELY(buf.hasData() || buf.getLength() != 0))
+    return DebugUtils::errored(kErrorInvalidState);
+
+  void* p = _memMgr.alloc(size, getAllocType());
+  if (ASMJIT_UNLIKELY(!p))
+    return DebugUtils::errored(kErrorNoVirtualMemory);
+
+  code->_setExecutableBuffer(&buf, static_cast<uint8_t*>(p), size);
+  return kErrorOk;
+}
+
+Error JitRuntime::unreserve(CodeHolder* code) noexcept {
+  if (ASMJIT_UNLIKELY(!code->isInitialized()))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  CodeBuffer& buf = code->getSectionEntry(0)->_buffer;
+  if (ASMJIT_UNLIKELY(!buf.isExecutable()))
+    return DebugUtils::errored(kErrorInvalidState);
+
+  void* p = buf._data;
+  code->_setExecutableBuffer(&buf, nullptr, 0);
   return _memMgr.release(p);
 }
 
+// ============================================================================
+// [asmjit::JitRuntime - Function Index]
+// ============================================================================
+
+bool JitRuntime::findFunc(const void* pc, JitFuncInfo* out) const noexcept {
+  bool found = false;
+  Atomic::add(&_funcIndexReaders, 1);
+
+  const FuncIndex* index = Atomic::load(&_funcIndex);
+  if (index) {
+    uintptr_t addr = (uintptr_t)pc;
+    size_t i = JitRuntime_searchFuncIndex(index, addr);
+
+    if (i && addr - index->data[i - 1].start < index->data[i - 1].size) {
+      *out = index->data[i - 1];
+      found = true;
+    }
+  }
+
+  Atomic::add(&_funcIndexReaders, -1);
+  return found;
+}
+
+Error JitRuntime::setFuncInfo(void* p, const char* name, void* userData) noexcept {
+  AutoLock locked(_funcIndexLock);
+
+  const FuncIndex* cur = _funcIndex;
+  uintptr_t start = (uintptr_t)p;
+
+  size_t i = cur ? JitRuntime_searchFuncIndex(cur, start) : 0;
+  if (!i || cur->data[--i].start != start)
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  FuncIndex* index = JitRuntime_allocFuncIndex(cur->length);
+  if (ASMJIT_UNLIKELY(!index))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  ::memcpy(index->data, cur->data, cur->length * sizeof(JitFuncInfo));
+  index->data[i].name = name;
+  index->data[i].userData = userData;
+
+  JitRuntime_publishFuncIndex(this, index);
+  return kErrorOk;
+}
+
+size_t JitRuntime::getFuncCount() const noexcept {
+  AutoLock locked(const_cast<JitRuntime*>(this)->_funcIndexLock);
+  return _funcIndex ? _funcIndex->length : size_t(0);
+}
+
+// ============================================================================
+// [asmjit::JitRuntime - Entries]
+// ============================================================================
+
+// The entry is `jmp [slot]` followed by an aligned pointer-sized `slot`, which
+// holds the target. Retargeting is a single atomic store to the slot, the code
+// itself is never modified.
+static ASMJIT_INLINE void** JitRuntime_getEntrySlot(void* entry) noexcept {
+  return reinterpret_cast<void**>(static_cast<uint8_t*>(entry) + 8);
+}
+
+Error JitRuntime::_newEntry(void** dst, void* target) noexcept {
+  *dst = nullptr;
+
+#if ASMJIT_ARCH_X86 || ASMJIT_ARCH_X64
+  uint8_t* entry = static_cast<uint8_t*>(_memMgr.alloc(kEntrySize, VMemMgr::kAllocFreeable));
+  if (ASMJIT_UNLIKELY(!entry))
+    return DebugUtils::errored(kErrorNoVirtualMemory);
+
+  void** slot = JitRuntime_getEntrySlot(entry);
+  ASMJIT_ASSERT(Utils::isAligned<uintptr_t>((uintptr_t)slot, sizeof(void*)));
+
+  // 'jmp [rip + 2]' (X64) or 'jmp [slot]' (X86).
+  entry[0] = 0xFF;
+  entry[1] = 0x25;
+# if ASMJIT_ARCH_X64
+  Utils::writeU32u(entry + 2, 2);
+# else
+  Utils::writeU32u(entry + 2, static_cast<uint32_t>((uintptr_t)slot));
+# endif
+  entry[6] = 0xCC;
+  entry[7] = 0xCC;
+  Atomic::store(slot, target);
+
+  flush(entry, kEntrySize);
+  *dst = entry;
+  return kErrorOk;
+#else
+  ASMJIT_UNUSED(target);
+  return DebugUtils::errored(kErrorInvalidArch);
+#endif
+}
+
+void* JitRuntime::_getEntryTarget(void* entry) const noexcept {
+  return Atomic::load(JitRuntime_getEntrySlot(entry));
+}
+
+Error JitRuntime::_setEntryTarget(void* entry, void* target) noexcept {
+  RetiredCode* retired = static_cast<RetiredCode*>(Internal::allocMemory(sizeof(RetiredCode)));
+  if (ASMJIT_UNLIKELY(!retired))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  void* prev = Atomic::exchange(JitRuntime_getEntrySlot(entry), target);
+  if (prev == target) {
+    Internal::releaseMemory(retired);
+    return kErrorOk;
+  }
+
+  JitRuntime_retire(this, retired, prev);
+  reclaim();
+  return kErrorOk;
+}
+
+Error JitRuntime::_releaseEntry(void* entry) noexcept {
+  RetiredCode* retired[2];
+  retired[0] = static_cast<RetiredCode*>(Internal::allocMemory(sizeof(RetiredCode)));
+  retired[1] = static_cast<RetiredCode*>(Internal::allocMemory(sizeof(RetiredCode)));
+
+  if (ASMJIT_UNLIKELY(!retired[0] || !retired[1])) {
+    if (retired[0]) Internal::releaseMemory(retired[0]);
+    if (retired[1]) Internal::releaseMemory(retired[1]);
+    return DebugUtils::errored(kErrorNoHeapMemory);
+  }
+
+  JitRuntime_retire(this, retired[0], _getEntryTarget(entry));
+  JitRuntime_retire(this, retired[1], entry);
+  reclaim();
+  return kErrorOk;
+}
+
+// ============================================================================
+// [asmjit::JitRuntime - Reclamation]
+// ============================================================================
+
+Error JitRuntime::attachThread(JitThreadEpoch* te) noexcept {
+  AutoLock locked(_epochLock);
+
+  for (JitThreadEpoch* cur = _epochThreads; cur; cur = cur->next)
+    if (cur == te)
+      return DebugUtils::errored(kErrorInvalidState);
+
+  te->epoch = 0;
+  te->next = _epochThreads;
+  _epochThreads = te;
+  return kErrorOk;
+}
+
+void JitRuntime::detachThread(JitThreadEpoch* te) noexcept {
+  {
+    AutoLock locked(_epochLock);
+    JitThreadEpoch** pPrev = &_epochThreads;
+
+    while (*pPrev) {
+      if (*pPrev == te) {
+        *pPrev = te->next;
+        te->next = nullptr;
+        break;
+      }
+      pPrev = &(*pPrev)->next;
+    }
+  }
+
+  reclaim();
+}
+
+Error JitRuntime::_retire(void* p) noexcept {
+  RetiredCode* retired = static_cast<RetiredCode*>(Internal::allocMemory(sizeof(RetiredCode)));
+  if (ASMJIT_UNLIKELY(!retired))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  JitRuntime_retire(this, retired, p);
+  reclaim();
+  return kErrorOk;
+}
+
+void JitRuntime::reclaim() noexcept {
+  RetiredCode* released = nullptr;
+
+  {
+    AutoLock locked(_epochLock);
+    if (!_retiredCode)
+      return;
+
+    // The oldest epoch an attached thread is in, all code retired up to this
+    // epoch was retired before the thread entered, so it cannot execute it.
+    intptr_t minEpoch = Atomic::load(&_epoch);
+
+    for (JitThreadEpoch* te = _epochThreads; te; te = te->next) {
+      intptr_t epoch = Atomic::add(&te->epoch, 0);
+      if (epoch && epoch < minEpoch)
+        minEpoch = epoch;
+    }
+
+    RetiredCode** pPrev = &_retiredCode;
+    while (*pPrev) {
+      RetiredCode* retired = *pPrev;
+      if (retired->epoch <= minEpoch) {
+        *pPrev = retired->next;
+        retired->next = released;
+        released = retired;
+      }
+      else {
+        pPrev = &retired->next;
+      }
+    }
+  }
+
+  while (released) {
+    RetiredCode* next = released->next;
+    _release(released->p);
+    Internal::releaseMemory(released);
+    released = next;
+  }
+}
+
+// ============================================================================
+// [asmjit::JitRuntime - Counters]
+// ============================================================================
+
+uint64_t* JitRuntime::allocCounters(size_t count) noexcept {
+  if (ASMJIT_UNLIKELY(count == 0 || count > (~static_cast<size_t>(0) - sizeof(CounterBlock)) / sizeof(uint64_t)))
+    return nullptr;
+
+  size_t size = sizeof(CounterBlock) + count * sizeof(uint64_t);
+  CounterBlock* block = static_cast<CounterBlock*>(Internal::allocMemory(size));
+  if (ASMJIT_UNLIKELY(!block))
+    return nullptr;
+
+  block->count = count;
+  uint64_t* counters = block->getCounters();
+  ::memset(counters, 0, count * sizeof(uint64_t));
+
+  AutoLock locked(_counterLock);
+  block->next = _counters;
+  _counters = block;
+  return counters;
+}
+
+Error JitRuntime::releaseCounters(uint64_t* counters) noexcept {
+  CounterBlock* block = nullptr;
+
+  {
+    AutoLock locked(_counterLock);
+    CounterBlock** pPrev = &_counters;
+
+    while (*pPrev) {
+      if ((*pPrev)->getCounters() == counters) {
+        block = *pPrev;
+        *pPrev = block->next;
+        break;
+      }
+      pPrev = &(*pPrev)->next;
+    }
+  }
+
+  if (ASMJIT_UNLIKELY(!block))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  Internal::releaseMemory(block);
+  return kErrorOk;
+}
+
+// ============================================================================
+// [asmjit::JitRuntime - Test]
+// ============================================================================
+
+#if defined(ASMJIT_TEST)
+static void* JitRuntime_testAdd(JitRuntime& rt, size_t size, const void* data = nullptr) {
+  CodeHolder code;
+  code.init(rt.getCodeInfo());
+
+  CodeBuffer& buf = code.getSectionEntry(0)->_buffer;
+  EXPECT(code.growBuffer(&buf, size) == kErrorOk);
+  if (data)
+    ::memcpy(buf._data, data, size);
+  else
+    ::memset(buf._data, 0xCC, size);
+  buf._length = size;
+
+  void* p;
+  EXPECT(rt._add(&p, &code) == kErrorOk);
+  return p;
+}
+
+UNIT(base_jitruntime) {
+  JitRuntime rt;
+  JitFuncInfo info;
+
+  enum { kCount = 16 };
+  void* funcs[kCount];
+  size_t sizes[kCount];
+
+  INFO("Checking JitRuntime function index");
+  for (size_t i = 0; i < kCount; i++) {
+    sizes[i] = 16 + i * 8;
+    funcs[i] = JitRuntime_testAdd(rt, sizes[i]);
+  }
+  EXPECT(rt.getFuncCount() == kCount);
+  EXPECT(!rt.findFunc(nullptr, &info));
+
+  for (size_t i = 0; i < kCount; i++) {
+    const uint8_t* p = static_cast<const uint8_t*>(funcs[i]);
+
+    EXPECT(rt.findFunc(p, &info) && info.start == (uintptr_t)p && info.size == sizes[i],
+      "Function #%u must be found by its start address", unsigned(i));
+    EXPECT(rt.findFunc(p + sizes[i] - 1, &info) && info.start == (uintptr_t)p,
+      "Function #%u must be found by its last byte", unsigned(i));
+    EXPECT(!rt.findFunc(p + sizes[i], &info) || info.start != (uintptr_t)p,
+      "Function #%u must not be found past its end", unsigned(i));
+  }
+
+  INFO("Checking JitRuntime::setFuncInfo()");
+  EXPECT(rt.setFuncInfo(funcs[3], "func3", funcs[3]) == kErrorOk);
+  EXPECT(rt.findFunc(static_cast<uint8_t*>(funcs[3]) + 5, &info));
+  EXPECT(info.name != nullptr && ::strcmp(info.name, "func3") == 0 && info.userData == funcs[3]);
+  EXPECT(rt.setFuncInfo(&info, "none") != kErrorOk);
+
+  INFO("Checking JitRuntime::release() removes functions from the index");
+  for (size_t i = 0; i < kCount; i += 2) {
+    EXPECT(rt.release(funcs[i]) == kErrorOk);
+    EXPECT(!rt.findFunc(funcs[i], &info) || info.start != (uintptr_t)funcs[i]);
+  }
+  EXPECT(rt.getFuncCount() == kCount / 2);
+
+  for (size_t i = 1; i < kCount; i += 2)
+    EXPECT(rt.findFunc(funcs[i], &info) && info.start == (uintptr_t)funcs[i]);
+
+  INFO("Checking JitRuntime::release() if the function index can't be updated");
+  {
+    size_t usedBytes = rt.getMemMgr()->getUsedBytes();
+    size_t funcCount = rt.getFuncCount();
+    void* p = JitRuntime_testAdd(rt, 40);
+
+    JitRuntime_testFailFuncIndexAlloc = 1;
+    EXPECT(rt.release(p) == kErrorNoHeapMemory);
+    EXPECT(rt.getMemMgr()->getUsedBytes() == usedBytes,
+      "JitRuntime::release() must release the code even if the index can't be updated");
+
+    // The stale entry is dropped when its memory is reused.
+    void* q = JitRuntime_testAdd(rt, 40);
+    EXPECT(q == p, "Released memory must be reused by a function of the same size");
+    EXPECT(rt.getFuncCount() == funcCount + 1);
+    EXPECT(rt.findFunc(q, &info) && info.start == (uintptr_t)q && info.size == 40);
+    EXPECT(rt.release(q) == kErrorOk);
+    EXPECT(rt.getFuncCount() == funcCount);
+  }
+
+  INFO("Checking JitRuntime::allocCounters()");
+  uint64_t* c0 = rt.allocCounters(4);
+  uint64_t* c1 = rt.allocCounters(100);
+  EXPECT(c0 != nullptr && c1 != nullptr && c0 != c1);
+  EXPECT(rt.allocCounters(0) == nullptr);
+  for (size_t i = 0; i < 100; i++)
+    EXPECT(c1[i] == 0, "Counter #%u must be zero-initialized", unsigned(i));
+
+  EXPECT(rt.releaseCounters(c0) == kErrorOk);
+  EXPECT(rt.releaseCounters(c0) != kErrorOk);
+  // `c1` is released by the destructor.
+
+  INFO("Checking JitRuntime::reserve()");
+  {
+    CodeHolder code;
+    EXPECT(rt.reserve(&code, 64) != kErrorOk);
+    code.init(rt.getCodeInfo());
+
+    EXPECT(rt.reserve(&code, 64) == kErrorOk);
+    EXPECT(rt.reserve(&code, 64) != kErrorOk);
+
+    CodeBuffer& buf = code.getSectionEntry(0)->_buffer;
+    EXPECT(buf.isExecutable() && buf.isFixedSize() && buf.getCapacity() == 64);
+    EXPECT(code.growBuffer(&buf, 65) == kErrorCodeTooLarge);
+
+    uint8_t* data = buf._data;
+    ::memset(data, 0xCC, 24);
+    buf._length = 24;
+
+    void* p;
+    EXPECT(rt._add(&p, &code) == kErrorOk);
+    EXPECT(p == data, "Code emitted in place must not be copied");
+    EXPECT(!buf.hasData() && !buf.isExecutable() && buf.getLength() == 0);
+    EXPECT(rt.findFunc(data + 23, &info) && info.start == (uintptr_t)data && info.size == 24);
+
+    INFO("Checking that unused reserved memory is released by JitRuntime::add()");
+    CodeHolder big;
+    big.init(rt.getCodeInfo());
+
+    size_t usedBytes = rt.getMemMgr()->getUsedBytes();
+    EXPECT(rt.reserve(&big, 65536) == kErrorOk);
+
+    CodeBuffer& bigBuf = big.getSectionEntry(0)->_buffer;
+    ::memset(bigBuf._data, 0xCC, 6);
+    bigBuf._length = 6;
+
+    void* q;
+    EXPECT(rt._add(&q, &big) == kErrorOk);
+    EXPECT(rt.getMemMgr()->getUsedBytes() < usedBytes + 65536,
+      "Unused reserved memory must be released, %u bytes used after add",
+      static_cast<unsigned int>(rt.getMemMgr()->getUsedBytes() - usedBytes));
+    EXPECT(rt.release(q) == kErrorOk);
+    EXPECT(rt.getMemMgr()->getUsedBytes() == usedBytes);
+
+    EXPECT(rt.unreserve(&code) != kErrorOk);
+    EXPECT(rt.reserve(&code, 32) == kErrorOk);
+    EXPECT(rt.unreserve(&code) == kErrorOk);
+    EXPECT(!buf.hasData());
+
+    EXPECT(rt.release(p) == kErrorOk);
+  }
+}
+
+#if ASMJIT_ARCH_X86 || ASMJIT_ARCH_X64
+// Add a function that returns `value` - 'mov eax, value' and 'ret'.
+static void* JitRuntime_testAddReturn(JitRuntime& rt, uint32_t value) {
+  uint8_t code[6] = { 0xB8, 0, 0, 0, 0, 0xC3 };
+  Utils::writeU32u(code + 1, value);
+  return JitRuntime_testAdd(rt, sizeof(code), code);
+}
+
+UNIT(base_jitruntime_entry) {
+  typedef int (*Func)(void);
+
+  JitRuntime rt;
+  JitFuncInfo info;
+  JitThreadEpoch te;
+
+  Func f1 = ptr_as_func<Func>(JitRuntime_testAddReturn(rt, 1));
+  Func f2 = ptr_as_func<Func>(JitRuntime_testAddReturn(rt, 2));
+  Func f3 = ptr_as_func<Func>(JitRuntime_testAddReturn(rt, 3));
+
+  INFO("Checking JitRuntime entries");
+  Func entry = nullptr;
+  EXPECT(rt.newEntry(&entry, f1) == kErrorOk);
+  EXPECT(rt.getEntryTarget(entry) == f1);
+  EXPECT(entry() == 1);
+
+  EXPECT(rt.setEntryTarget(entry, f2) == kErrorOk);
+  EXPECT(rt.getEntryTarget(entry) == f2);
+  EXPECT(entry() == 2);
+  EXPECT(!rt.findFunc(func_as_ptr(f1), &info),
+    "Retired function must be released if no thread is attached");
+
+  INFO("Checking JitRuntime epoch-based reclamation");
+  EXPECT(rt.attachThread(&te) == kErrorOk);
+  rt.enterEpoch(&te);
+  EXPECT(entry() == 2);
+
+  EXPECT(rt.setEntryTarget(entry, f3) == kErrorOk);
+  EXPECT(entry() == 3);
+  EXPECT(rt.findFunc(func_as_ptr(f2), &info),
+    "Retired function must not be released while a thread is in an older epoch");
+
+  rt.leaveEpoch(&te);
+  rt.reclaim();
+  EXPECT(!rt.findFunc(func_as_ptr(f2), &info),
+    "Retired function must be released after all threads left older epochs");
+
+  rt.enterEpoch(&te);
+  EXPECT(rt.releaseEntry(entry) == kErrorOk);
+  EXPECT(rt.findFunc(func_as_ptr(f3), &info));
+  rt.leaveEpoch(&te);
+
+  rt.detachThread(&te);
+  EXPECT(!rt.findFunc(func_as_ptr(f3), &info));
+  EXPECT(rt.getFuncCount() == 0);
+}
+#endif // ASMJIT_ARCH_X86 || ASMJIT_ARCH_X64
+#endif // ASMJIT_TEST
+
 } // asmjit namespace
 
 // [Api-End]
@@ -142,6 +142,36 @@ public:
   ASMJIT_API virtual void flush(const void* p, size_t size) noexcept;
 };
 
+// ============================================================================
+// [asmjit::JitFuncInfo]
+// ============================================================================
+
+//! Information about a function added to \ref JitRuntime.
+struct JitFuncInfo {
+  uintptr_t start;                       //!< Address of the function.
+  size_t size;                           //!< Size of the function (in bytes).
+  const char* name;                      //!< Name of the function or null (not owned by JitRuntime).
+  void* userData;                        //!< User data associated with the function.
+};
+
+// ============================================================================
+// [asmjit::JitThreadEpoch]
+// ============================================================================
+
+//! Per-thread state used by \ref JitRuntime to reclaim retired code.
+//!
+//! A thread that calls code which can be retired (for example a target of an
+//! entry created by `JitRuntime::newEntry()`) attaches its `JitThreadEpoch`
+//! to the runtime and wraps such calls by `JitRuntime::enterEpoch()` and
+//! `JitRuntime::leaveEpoch()`. Retired code is released only after all
+//! threads that could see it have left their epoch.
+struct JitThreadEpoch {
+  ASMJIT_INLINE JitThreadEpoch() noexcept : next(nullptr), epoch(0) {}
+
+  JitThreadEpoch* next;                  //!< Next attached thread.
+  intptr_t epoch;                        //!< Epoch the thread entered or zero if it's outside.
+};
+
 // ============================================================================
 // [asmjit::JitRuntime]
 // ============================================================================
@@ -179,12 +209,184 @@ public:
   ASMJIT_API Error _add(void** dst, CodeHolder* code) noexcept override;
   ASMJIT_API Error _release(void* p) noexcept override;
 
+  // --------------------------------------------------------------------------
+  // [Emit-In-Place]
+  // --------------------------------------------------------------------------
+
+  //! Reserve `size` bytes of executable memory and use it as a fixed-size
+  //! buffer of the `.text` section of `code`.
+  //!
+  //! The code is then emitted directly into the executable memory and `add()`
+  //! only patches relocations in place instead of copying the whole code, the
+  //! unused memory is returned to the runtime. The `size` must include space
+  //! for trampolines (`CodeHolder::getCodeSize()` after the code is emitted),
+  //! emitting more fails with `kErrorCodeTooLarge`.
+  //!
+  //! `code` must be initialized and its `.text` section must be empty. After
+  //! `add()` the section is empty again and the code belongs to the runtime.
+  ASMJIT_API Error reserve(CodeHolder* code, size_t size) noexcept;
+  //! Release memory reserved by `reserve()` that was not passed to `add()`.
+  //!
+  //! The memory is also released when the runtime is destroyed.
+  ASMJIT_API Error unreserve(CodeHolder* code) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Function Index]
+  // --------------------------------------------------------------------------
+
+  //! Find a function that contains `pc` and copy its information to `out`.
+  //!
+  //! Returns true if found. The lookup is lock-free and doesn't allocate, so
+  //! it can be called from signal handlers (for example by a sampling profiler
+  //! that needs to map an instruction pointer to a JIT function).
+  ASMJIT_API bool findFunc(const void* pc, JitFuncInfo* out) const noexcept;
+
+  //! Associate `name` and `userData` with a function `p` returned by `add()`.
+  //!
+  //! The `name` is not copied, it must stay valid until `p` is released.
+  ASMJIT_API Error setFuncInfo(void* p, const char* name, void* userData = nullptr) noexcept;
+
+  //! Get the number of functions that can be found by `findFunc()`.
+  ASMJIT_API size_t getFuncCount() const noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Entries]
+  // --------------------------------------------------------------------------
+
+  //! Size of an entry created by `newEntry()` (in bytes).
+  ASMJIT_ENUM(EntryLimits) {
+    kEntrySize = 16
+  };
+
+  //! Create a stable entry `dst` that jumps to `target`.
+  //!
+  //! The entry is a small stub that performs an indirect jump through an
+  //! aligned pointer, which can be retargeted by `setEntryTarget()` while
+  //! other threads are executing it. Pointers to the entry can be handed out
+  //! in place of the function itself (tiered compilation).
+  template<typename Func>
+  ASMJIT_INLINE Error newEntry(Func* dst, Func target) noexcept {
+    return _newEntry(Internal::ptr_cast<void**, Func*>(dst), Internal::ptr_cast<void*, Func>(target));
+  }
+
+  //! Get the current target of `entry`.
+  template<typename Func>
+  ASMJIT_INLINE Func getEntryTarget(Func entry) const noexcept {
+    return Internal::ptr_cast<Func, void*>(_getEntryTarget(Internal::ptr_cast<void*, Func>(entry)));
+  }
+
+  //! Atomically retarget `entry` to `target`, the previous target is retired.
+  template<typename Func>
+  ASMJIT_INLINE Error setEntryTarget(Func entry, Func target) noexcept {
+    return _setEntryTarget(Internal::ptr_cast<void*, Func>(entry), Internal::ptr_cast<void*, Func>(target));
+  }
+
+  //! Release `entry`, the entry and its current target are retired.
+  template<typename Func>
+  ASMJIT_INLINE Error releaseEntry(Func entry) noexcept {
+    return _releaseEntry(Internal::ptr_cast<void*, Func>(entry));
+  }
+
+  ASMJIT_API Error _newEntry(void** dst, void* target) noexcept;
+  ASMJIT_API void* _getEntryTarget(void* entry) const noexcept;
+  ASMJIT_API Error _setEntryTarget(void* entry, void* target) noexcept;
+  ASMJIT_API Error _releaseEntry(void* entry) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Reclamation]
+  // --------------------------------------------------------------------------
+
+  //! Attach a thread that calls code which can be retired.
+  ASMJIT_API Error attachThread(JitThreadEpoch* te) noexcept;
+  //! Detach a thread previously attached by `attachThread()`.
+  ASMJIT_API void detachThread(JitThreadEpoch* te) noexcept;
+
+  //! Enter the current epoch, must be called before calling code that can be
+  //! retired. Epochs don't nest, `leaveEpoch()` must be called first.
+  ASMJIT_INLINE void enterEpoch(JitThreadEpoch* te) noexcept {
+    Atomic::exchange(&te->epoch, Atomic::load(&_epoch));
+  }
+
+  //! Leave the epoch entered by `enterEpoch()`.
+  ASMJIT_INLINE void leaveEpoch(JitThreadEpoch* te) noexcept {
+    Atomic::store(&te->epoch, intptr_t(0));
+  }
+
+  //! Release `p` allocated by `add()` once no attached thread can execute it.
+  template<typename Func>
+  ASMJIT_INLINE Error retire(Func p) noexcept {
+    return _retire(Internal::ptr_cast<void*, Func>(p));
+  }
+
+  ASMJIT_API Error _retire(void* p) noexcept;
+
+  //! Release all retired code that cannot be executed anymore.
+  //!
+  //! Called implicitly by functions that retire code.
+  ASMJIT_API void reclaim() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Counters]
+  // --------------------------------------------------------------------------
+
+  //! Allocate `count` zero-initialized 64-bit counters.
+  //!
+  //! Counters are used by instrumented code (see `X86ProfilePass`), they are
+  //! owned by the runtime and stay valid until released by `releaseCounters()`
+  //! or until the runtime is destroyed. Returns null on failure.
+  ASMJIT_API uint64_t* allocCounters(size_t count) noexcept;
+  //! Release counters allocated by `allocCounters()`.
+  //!
+  //! Code that increments the counters must not be executed anymore.
+  ASMJIT_API Error releaseCounters(uint64_t* counters) noexcept;
+
   // --------------------------------------------------------------------------
   // [Members]
   // --------------------------------------------------------------------------
 
   //! Virtual memory manager.
   VMemMgr _memMgr;
+
+  //! \internal
+  //! \{
+
+  struct EhFrame;
+
+  //! Lock that guards `_ehFrames`.
+  Lock _ehFrameLock;
+  //! Unwind information registered by `_add()` (single-linked list).
+  EhFrame* _ehFrames;
+
+  struct FuncIndex;
+
+  //! Lock that serializes updates of `_funcIndex`.
+  Lock _funcIndexLock;
+  //! Sorted index of all functions, replaced (never modified) on update.
+  FuncIndex* _funcIndex;
+  //! Replaced indexes that cannot be freed yet as readers may still use them.
+  FuncIndex* _funcIndexRetired;
+  //! Number of readers currently accessing `_funcIndex`.
+  mutable intptr_t _funcIndexReaders;
+
+  struct RetiredCode;
+
+  //! Lock that guards `_epochThreads` and `_retiredCode`.
+  Lock _epochLock;
+  //! Global epoch, incremented each time code is retired.
+  intptr_t _epoch;
+  //! Attached threads (single-linked list).
+  JitThreadEpoch* _epochThreads;
+  //! Retired code waiting to be released (single-linked list).
+  RetiredCode* _retiredCode;
+
+  struct CounterBlock;
+
+  //! Lock that guards `_counters`.
+  Lock _counterLock;
+  //! Counters allocated by `allocCounters()` (single-linked list).
+  CounterBlock* _counters;
+
+  //! \}
 };
 
 //! \}
@@ -134,6 +134,12 @@ UNIT(base_utils) {
       "Utils::findFirstBit(%X) should return %u", (1 << i), i);
   }
 
+  INFO("Utils::findLastBit()");
+  for (i = 0; i < 32; i++) {
+    EXPECT(Utils::findLastBit((1U << i) | 1U) == i,
+      "Utils::findLastBit(%X) should return %u", (1U << i) | 1U, i);
+  }
+
   INFO("Utils::keepNOnesFromRight()");
   EXPECT(Utils::keepNOnesFromRight(0xF, 1) == 0x1, "");
   EXPECT(Utils::keepNOnesFromRight(0xF, 2) == 0x3, "");
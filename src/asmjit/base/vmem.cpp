@@ -31,77 +31,46 @@
 //   some environments (i.e. iOS) allow to generate and run JIT code, but this
 //   code has to be set to [Executable, but not Writable].
 //
-// - Keep implementation simple and easy to follow.
+// - Allocation and release must not slow down when the memory manager keeps
+//   many chunks or when its memory gets fragmented, which happens when a lot
+//   of functions are added to and removed from the runtime.
 //
-// Implementation is based on bit arrays and binary trees. Bit arrays contain
-// information related to allocated and unused blocks of memory. The size of
-// a block is described by `MemNode::density`. Count of blocks is stored in
-// `MemNode::blocks`. For example if density is 64 and count of blocks is 20,
-// memory node contains 64*20 bytes of memory and the smallest possible allocation
-// (and also alignment) is 64 bytes. So density is also related to memory
-// alignment. Binary trees (RB) are used to enable fast lookup into all addresses
-// allocated by memory manager instance. This is used mainly by `VMemPrivate::release()`.
+// Small allocations (up to `kSlabMaxSize` bytes) are served by slab chunks.
+// Each slab chunk is dedicated to a single size-class and keeps a stack of its
+// free slots, so allocation and release within a chunk is O(1). Slab chunks
+// that have at least one free slot are linked per size-class.
 //
-// Bit array looks like this (empty = unused, X = used) - Size of block 64:
+// Large allocations are served by large chunks split into blocks. Free blocks
+// are kept in segregated free-lists indexed by two levels (TLSF-like) - the
+// first level is the position of the most significant bit of the block size
+// and the second level splits that range into 4 sub-ranges. A non-empty list
+// of large enough blocks is found by two bit-scans in O(1). Adjacent free
+// blocks of the same chunk are coalesced when a block is released.
 //
-//   -------------------------------------------------------------------------
-//   | |X|X| | | | | |X|X|X|X|X|X| | | | | | | | | | | | |X| | | | |X|X|X| | |
-//   -------------------------------------------------------------------------
-//                               (Maximum continuous block)
-//
-// These bits show that there are 12 allocated blocks (X) of 64 bytes, so total
-// size allocated is 768 bytes. Maximum count of continuous memory is 12 * 64.
+// Slab chunks and used large blocks are kept in a Red-Black tree ordered by
+// address, which is used by `release()` and `shrink()` to find the chunk or
+// block the pointer belongs to.
 
 namespace asmjit {
 
-// ============================================================================
-// [asmjit::VMemMgr - BitOps]
-// ============================================================================
-
-#define M_DIV(x, y) ((x) / (y))
-#define M_MOD(x, y) ((x) % (y))
-
-//! \internal
-enum { kBitsPerEntity = (sizeof(size_t) * 8) };
-
-//! \internal
-//!
-//! Set `len` bits in `buf` starting at `index` bit index.
-static void _SetBits(size_t* buf, size_t index, size_t len) noexcept {
-  if (len == 0)
-    return;
-
-  size_t i = index / kBitsPerEntity; // size_t[]
-  size_t j = index % kBitsPerEntity; // size_t[][] bit index
-
-  // How many bytes process in the first group.
-  size_t c = kBitsPerEntity - j;
-  if (c > len)
-    c = len;
-
-  // Offset.
-  buf += i;
-
-  *buf++ |= ((~(size_t)0) >> (kBitsPerEntity - c)) << j;
-  len -= c;
-
-  while (len >= kBitsPerEntity) {
-    *buf++ = ~(size_t)0;
-    len -= kBitsPerEntity;
-  }
-
-  if (len)
-    *buf |= ((~(size_t)0) >> (kBitsPerEntity - len));
-}
-
 // ============================================================================
 // [asmjit::VMemMgr::TypeDefs]
 // ============================================================================
 
 typedef VMemMgr::RbNode RbNode;
-typedef VMemMgr::MemNode MemNode;
+typedef VMemMgr::SlabNode SlabNode;
+typedef VMemMgr::LargeChunk LargeChunk;
+typedef VMemMgr::LargeNode LargeNode;
 typedef VMemMgr::PermanentNode PermanentNode;
 
+//! \internal
+//!
+//! Type of `RbNode`.
+enum VMemNodeType {
+  kVMemNodeSlab  = 0,                    //!< Node is `SlabNode`.
+  kVMemNodeLarge = 1                     //!< Node is `LargeNode`.
+};
+
 // ============================================================================
 // [asmjit::VMemMgr::RbNode]
 // ============================================================================
@@ -115,7 +84,9 @@ struct VMemMgr::RbNode {
 
   RbNode* node[2];                       //!< Left[0] and right[1] nodes.
   uint8_t* mem;                          //!< Virtual memory address.
+  size_t size;                           //!< Size of virtual memory.
   uint32_t red;                          //!< Node color (red vs. black).
+  uint32_t type;                         //!< Node type, see \ref VMemNodeType.
 };
 
 //! \internal
@@ -178,39 +149,85 @@ static ASMJIT_INLINE RbNode* rbRotateDouble(RbNode* root, int dir) noexcept {
 }
 
 // ============================================================================
-// [asmjit::VMemMgr::MemNode]
+// [asmjit::VMemMgr::SlabNode]
 // ============================================================================
 
-struct VMemMgr::MemNode : public RbNode {
-  ASMJIT_INLINE void init(MemNode* other) noexcept {
-    mem = other->mem;
-
-    size = other->size;
-    used = other->used;
-    blocks = other->blocks;
-    density = other->density;
-    largestBlock = other->largestBlock;
+//! \internal
+//!
+//! Slab chunk, divided into slots of the same size.
+struct VMemMgr::SlabNode : public RbNode {
+  SlabNode* prev;        // Prev slab of the same size-class that has a free slot.
+  SlabNode* next;        // Next slab of the same size-class that has a free slot.
+
+  uint32_t classId;      // Size-class.
+  uint32_t slotSize;     // Size of a single slot.
+  uint32_t slotCount;    // Count of slots.
+  uint32_t freeCount;    // Count of free slots (also the size of `freeSlots` stack).
+  uint32_t* freeSlots;   // Stack of free slot indexes (allocated together with the node).
+};
 
-    baUsed = other->baUsed;
-    baCont = other->baCont;
-  }
+//! \internal
+//!
+//! Slot sizes of slab size-classes.
+static const uint16_t vMemSlabClassSize[VMemMgr::kSlabClassCount] = {
+  64  , 128 , 192 , 256 , 320 , 384 , 448 , 512 ,
+  640 , 768 , 896 , 1024,
+  1280, 1536, 1792, 2048
+};
 
-  // Get available space.
-  ASMJIT_INLINE size_t getAvailable() const noexcept { return size - used; }
+//! \internal
+//!
+//! Get the slab size-class of `size` (has to be in range [1, kSlabMaxSize]).
+static ASMJIT_INLINE uint32_t vMemSlabClassOf(size_t size) noexcept {
+  ASMJIT_ASSERT(size > 0 && size <= VMemMgr::kSlabMaxSize);
+
+  uint32_t x = static_cast<uint32_t>(size) - 1;
+  if (x < 512)
+    return x >> 6;
+  else if (x < 1024)
+    return 8 + ((x - 512) >> 7);
+  else
+    return 12 + ((x - 1024) >> 8);
+}
 
-  MemNode* prev;         // Prev node in list.
-  MemNode* next;         // Next node in list.
+// ============================================================================
+// [asmjit::VMemMgr::LargeChunk / LargeNode]
+// ============================================================================
 
-  size_t size;           // How many bytes contain this node.
-  size_t used;           // How many bytes are used in this node.
-  size_t blocks;         // How many blocks are here.
-  size_t density;        // Minimum count of allocated bytes in this node (also alignment).
-  size_t largestBlock;   // Contains largest block that can be allocated.
+//! \internal
+//!
+//! Large chunk, divided into used and free blocks (`LargeNode`).
+struct VMemMgr::LargeChunk {
+  LargeChunk* prev;      // Prev large chunk.
+  LargeChunk* next;      // Next large chunk.
+  uint8_t* mem;          // Virtual memory address.
+  size_t size;           // Size of virtual memory.
+};
 
-  size_t* baUsed;        // Contains bits about used blocks       (0 = unused, 1 = used).
-  size_t* baCont;        // Contains bits about continuous blocks (0 = stop  , 1 = continue).
+//! \internal
+//!
+//! Block of a large chunk, either used (in RB-tree) or free (in a free-list).
+struct VMemMgr::LargeNode : public RbNode {
+  LargeChunk* chunk;     // Chunk this block belongs to.
+  LargeNode* physPrev;   // Previous block in the chunk (lower address).
+  LargeNode* physNext;   // Next block in the chunk (higher address).
+  LargeNode* binPrev;    // Previous free block in the same free-list.
+  LargeNode* binNext;    // Next free block in the same free-list.
+  uint32_t isFree;       // True if the block is free.
 };
 
+//! \internal
+//!
+//! Map `size` of a large block into first-level `fl` and second-level `sl`
+//! indexes of the free-list it belongs to.
+static ASMJIT_INLINE void vMemLargeMapping(size_t size, uint32_t& fl, uint32_t& sl) noexcept {
+  uint32_t granules = static_cast<uint32_t>(size / VMemMgr::kGranularity);
+  ASMJIT_ASSERT(granules != 0);
+
+  fl = Utils::findLastBit(granules);
+  sl = fl >= 2 ? (granules >> (fl - 2)) & (VMemMgr::kLargeSlCount - 1) : 0;
+}
+
 // ============================================================================
 // [asmjit::VMemMgr::PermanentNode]
 // ============================================================================
@@ -262,61 +279,22 @@ static bool vMemMgrCheckTree(VMemMgr* self) noexcept {
   return rbAssert(self->_root) > 0;
 }
 
-//! \internal
-//!
-//! Alloc virtual memory including a heap memory needed for `MemNode` data.
-//!
-//! Returns set-up `MemNode*` or nullptr if allocation failed.
-static MemNode* vMemMgrCreateNode(VMemMgr* self, size_t size, size_t density) noexcept {
-  size_t vSize;
-  uint8_t* vmem = vMemMgrAllocVMem(self, size, &vSize);
-  if (!vmem) return nullptr;
-
-  size_t blocks = (vSize / density);
-  size_t bsize = (((blocks + 7) >> 3) + sizeof(size_t) - 1) & ~(size_t)(sizeof(size_t) - 1);
-
-  MemNode* node = static_cast<MemNode*>(Internal::allocMemory(sizeof(MemNode)));
-  uint8_t* data = static_cast<uint8_t*>(Internal::allocMemory(bsize * 2));
-
-  // Out of memory.
-  if (!node || !data) {
-    vMemMgrReleaseVMem(self, vmem, vSize);
-    if (node) Internal::releaseMemory(node);
-    if (data) Internal::releaseMemory(data);
-    return nullptr;
-  }
+// ============================================================================
+// [asmjit::VMemMgr - RB-Tree]
+// ============================================================================
 
-  // Initialize RbNode data.
+static void vMemMgrInsertNode(VMemMgr* self, RbNode* node) noexcept {
   node->node[0] = nullptr;
   node->node[1] = nullptr;
-  node->mem = vmem;
   node->red = 1;
 
-  // Initialize MemNode data.
-  node->prev = nullptr;
-  node->next = nullptr;
-
-  node->size = vSize;
-  node->used = 0;
-  node->blocks = blocks;
-  node->density = density;
-  node->largestBlock = vSize;
-
-  ::memset(data, 0, bsize * 2);
-  node->baUsed = reinterpret_cast<size_t*>(data);
-  node->baCont = reinterpret_cast<size_t*>(data + bsize);
-
-  return node;
-}
-
-static void vMemMgrInsertNode(VMemMgr* self, MemNode* node) noexcept {
   if (!self->_root) {
     // Empty tree case.
     self->_root = node;
   }
   else {
     // False tree root.
-    RbNode head = { { nullptr, nullptr }, 0, 0 };
+    RbNode head = { { nullptr, nullptr }, nullptr, 0, 0, 0 };
 
     // Grandparent & parent.
     RbNode* g = nullptr;
@@ -365,36 +343,23 @@ static void vMemMgrInsertNode(VMemMgr* self, MemNode* node) noexcept {
     }
 
     // Update root.
-    self->_root = static_cast<MemNode*>(head.node[1]);
+    self->_root = head.node[1];
   }
 
   // Make root black.
   self->_root->red = 0;
-
-  // Link with others.
-  node->prev = self->_last;
-
-  if (!self->_first) {
-    self->_first = node;
-    self->_last = node;
-    self->_optimal = node;
-  }
-  else {
-    node->prev = self->_last;
-    self->_last->next = node;
-    self->_last = node;
-  }
 }
 
 //! \internal
 //!
-//! Remove node from Red-Black tree.
+//! Remove `node` from Red-Black tree.
 //!
-//! Returns node that should be freed, but it doesn't have to be necessarily
-//! the `node` passed.
-static MemNode* vMemMgrRemoveNode(VMemMgr* self, MemNode* node) noexcept {
+//! Nodes are referenced from outside of the tree (free-lists, physical links),
+//! so the node that is unlinked from the bottom of the tree is moved to the
+//! place of `node` instead of copying its data into `node`.
+static void vMemMgrRemoveNode(VMemMgr* self, RbNode* node) noexcept {
   // False tree root.
-  RbNode head = { { nullptr, nullptr }, 0, 0 };
+  RbNode head = { { nullptr, nullptr }, nullptr, 0, 0, 0 };
 
   // Helpers.
   RbNode* q = &head;
@@ -460,52 +425,44 @@ static MemNode* vMemMgrRemoveNode(VMemMgr* self, MemNode* node) noexcept {
   ASMJIT_ASSERT(f != &head);
   ASMJIT_ASSERT(q != &head);
 
-  if (f != q) {
-    ASMJIT_ASSERT(f != &head);
-    static_cast<MemNode*>(f)->init(static_cast<MemNode*>(q));
-  }
-
   p->node[p->node[1] == q] = q->node[q->node[0] == nullptr];
 
-  // Update root and make it black.
-  self->_root = static_cast<MemNode*>(head.node[1]);
-  if (self->_root) self->_root->red = 0;
-
-  // Unlink.
-  MemNode* next = static_cast<MemNode*>(q)->next;
-  MemNode* prev = static_cast<MemNode*>(q)->prev;
-
-  if (prev)
-    prev->next = next;
-  else
-    self->_first = next;
+  if (f != q) {
+    // Find the parent of `f` and move `q` to its place.
+    RbNode* fp = &head;
+    int fdir = 1;
 
-  if (next)
-    next->prev = prev;
-  else
-    self->_last  = prev;
+    while (fp->node[fdir] != f) {
+      fp = fp->node[fdir];
+      fdir = fp->mem < f->mem;
+    }
 
-  if (self->_optimal == q)
-    self->_optimal = prev ? prev : next;
+    q->node[0] = f->node[0];
+    q->node[1] = f->node[1];
+    q->red = f->red;
+    fp->node[fdir] = q;
+  }
 
-  return static_cast<MemNode*>(q);
+  // Update root and make it black.
+  self->_root = head.node[1];
+  if (self->_root) self->_root->red = 0;
 }
 
-static MemNode* vMemMgrFindNodeByPtr(VMemMgr* self, uint8_t* mem) noexcept {
-  MemNode* node = self->_root;
+static RbNode* vMemMgrFindNodeByPtr(VMemMgr* self, uint8_t* mem) noexcept {
+  RbNode* node = self->_root;
   while (node) {
     uint8_t* nodeMem = node->mem;
 
     // Go left.
     if (mem < nodeMem) {
-      node = static_cast<MemNode*>(node->node[0]);
+      node = node->node[0];
       continue;
     }
 
     // Go right.
     uint8_t* nodeEnd = nodeMem + node->size;
     if (mem >= nodeEnd) {
-      node = static_cast<MemNode*>(node->node[1]);
+      node = node->node[1];
       continue;
     }
 
@@ -515,6 +472,402 @@ static MemNode* vMemMgrFindNodeByPtr(VMemMgr* self, uint8_t* mem) noexcept {
   return node;
 }
 
+// ============================================================================
+// [asmjit::VMemMgr - Slab]
+// ============================================================================
+
+//! \internal
+//!
+//! Alloc virtual memory of a slab chunk including a heap memory needed for
+//! `SlabNode` data.
+//!
+//! Returns set-up `SlabNode*` or nullptr if allocation failed.
+static SlabNode* vMemMgrCreateSlab(VMemMgr* self, uint32_t classId) noexcept {
+  size_t vSize;
+  uint8_t* vmem = vMemMgrAllocVMem(self, self->_blockSize, &vSize);
+  if (!vmem) return nullptr;
+
+  uint32_t slotSize = vMemSlabClassSize[classId];
+  uint32_t slotCount = static_cast<uint32_t>(vSize / slotSize);
+
+  SlabNode* node = static_cast<SlabNode*>(
+    Internal::allocMemory(sizeof(SlabNode) + slotCount * sizeof(uint32_t)));
+
+  // Out of memory.
+  if (!node) {
+    vMemMgrReleaseVMem(self, vmem, vSize);
+    return nullptr;
+  }
+
+  // Initialize RbNode data.
+  node->node[0] = nullptr;
+  node->node[1] = nullptr;
+  node->mem = vmem;
+  node->size = vSize;
+  node->red = 1;
+  node->type = kVMemNodeSlab;
+
+  // Initialize SlabNode data.
+  node->prev = nullptr;
+  node->next = nullptr;
+
+  node->classId = classId;
+  node->slotSize = slotSize;
+  node->slotCount = slotCount;
+  node->freeCount = slotCount;
+  node->freeSlots = reinterpret_cast<uint32_t*>(node + 1);
+
+  // Slots at lower addresses are allocated first.
+  for (uint32_t i = 0; i < slotCount; i++)
+    node->freeSlots[i] = slotCount - 1 - i;
+
+  self->_allocatedBytes += vSize;
+  return node;
+}
+
+static ASMJIT_INLINE void vMemMgrLinkSlab(VMemMgr* self, SlabNode* node) noexcept {
+  SlabNode* head = self->_slabs[node->classId];
+
+  node->prev = nullptr;
+  node->next = head;
+
+  if (head) head->prev = node;
+  self->_slabs[node->classId] = node;
+}
+
+static ASMJIT_INLINE void vMemMgrUnlinkSlab(VMemMgr* self, SlabNode* node) noexcept {
+  SlabNode* prev = node->prev;
+  SlabNode* next = node->next;
+
+  if (prev)
+    prev->next = next;
+  else
+    self->_slabs[node->classId] = next;
+
+  if (next)
+    next->prev = prev;
+
+  node->prev = nullptr;
+  node->next = nullptr;
+}
+
+static void* vMemMgrAllocSlab(VMemMgr* self, size_t vSize) noexcept {
+  uint32_t classId = vMemSlabClassOf(vSize);
+  SlabNode* node = self->_slabs[classId];
+
+  if (!node) {
+    node = vMemMgrCreateSlab(self, classId);
+    if (!node) return nullptr;
+
+    vMemMgrInsertNode(self, node);
+    vMemMgrLinkSlab(self, node);
+    ASMJIT_ASSERT(vMemMgrCheckTree(self));
+  }
+
+  uint32_t slot = node->freeSlots[--node->freeCount];
+  if (node->freeCount == 0)
+    vMemMgrUnlinkSlab(self, node);
+
+  self->_usedBytes += node->slotSize;
+  return node->mem + static_cast<size_t>(slot) * node->slotSize;
+}
+
+static Error vMemMgrReleaseSlab(VMemMgr* self, SlabNode* node, uint8_t* p) noexcept {
+  size_t offset = (size_t)(p - node->mem);
+  uint32_t slot = static_cast<uint32_t>(offset / node->slotSize);
+
+  if (ASMJIT_UNLIKELY(offset % node->slotSize != 0 || slot >= node->slotCount))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  // The slab had no free slot, make it available again.
+  if (node->freeCount == 0)
+    vMemMgrLinkSlab(self, node);
+
+  node->freeSlots[node->freeCount++] = slot;
+  self->_usedBytes -= node->slotSize;
+
+  // Release an empty slab, but keep it if it's the only slab of its size-class
+  // that has free slots, otherwise a single alloc/release would map and unmap
+  // virtual memory each time.
+  if (node->freeCount == node->slotCount && (node->prev || node->next)) {
+    vMemMgrUnlinkSlab(self, node);
+    vMemMgrRemoveNode(self, node);
+    ASMJIT_ASSERT(vMemMgrCheckTree(self));
+
+    vMemMgrReleaseVMem(self, node->mem, node->size);
+    self->_allocatedBytes -= node->size;
+    Internal::releaseMemory(node);
+  }
+
+  return kErrorOk;
+}
+
+// ============================================================================
+// [asmjit::VMemMgr - Large]
+// ============================================================================
+
+static void vMemMgrInsertFree(VMemMgr* self, LargeNode* node) noexcept {
+  uint32_t fl, sl;
+  vMemLargeMapping(node->size, fl, sl);
+
+  LargeNode* head = self->_largeBins[fl][sl];
+  node->isFree = 1;
+  node->binPrev = nullptr;
+  node->binNext = head;
+
+  if (head) head->binPrev = node;
+  self->_largeBins[fl][sl] = node;
+
+  self->_largeFlBitmap |= 1U << fl;
+  self->_largeSlBitmap[fl] |= 1U << sl;
+}
+
+static void vMemMgrRemoveFree(VMemMgr* self, LargeNode* node) noexcept {
+  uint32_t fl, sl;
+  vMemLargeMapping(node->size, fl, sl);
+
+  LargeNode* prev = node->binPrev;
+  LargeNode* next = node->binNext;
+
+  if (prev)
+    prev->binNext = next;
+  else
+    self->_largeBins[fl][sl] = next;
+
+  if (next)
+    next->binPrev = prev;
+
+  if (!self->_largeBins[fl][sl]) {
+    self->_largeSlBitmap[fl] &= ~(1U << sl);
+    if (!self->_largeSlBitmap[fl])
+      self->_largeFlBitmap &= ~(1U << fl);
+  }
+
+  node->isFree = 0;
+  node->binPrev = nullptr;
+  node->binNext = nullptr;
+}
+
+//! \internal
+//!
+//! Find a free block of at least `vSize` bytes.
+static LargeNode* vMemMgrFindFree(VMemMgr* self, size_t vSize) noexcept {
+  uint32_t fl, sl;
+  vMemLargeMapping(vSize, fl, sl);
+
+  // The first block of the free-list `vSize` maps to is checked first, it's
+  // often large enough.
+  LargeNode* node = self->_largeBins[fl][sl];
+  if (node && node->size >= vSize)
+    return node;
+
+  // All blocks of the following free-lists are large enough.
+  if (fl >= 2 && sl + 1 < VMemMgr::kLargeSlCount) {
+    sl++;
+  }
+  else {
+    fl++;
+    sl = 0;
+  }
+
+  if (fl >= VMemMgr::kLargeFlCount)
+    return nullptr;
+
+  uint32_t slMap = self->_largeSlBitmap[fl] & (~0U << sl);
+  if (!slMap) {
+    uint32_t flMap = fl + 1 < VMemMgr::kLargeFlCount ? self->_largeFlBitmap & (~0U << (fl + 1)) : 0U;
+    if (!flMap)
+      return nullptr;
+
+    fl = Utils::findFirstBit(flMap);
+    slMap = self->_largeSlBitmap[fl];
+  }
+
+  sl = Utils::findFirstBit(slMap);
+  return self->_largeBins[fl][sl];
+}
+
+//! \internal
+//!
+//! Alloc virtual memory of a large chunk of at least `size` bytes.
+//!
+//! Returns a single (used) block that spans the whole chunk or nullptr if
+//! allocation failed.
+static LargeNode* vMemMgrCreateLarge(VMemMgr* self, size_t size) noexcept {
+  size_t vSize;
+  uint8_t* vmem = vMemMgrAllocVMem(self, size, &vSize);
+  if (!vmem) return nullptr;
+
+  LargeChunk* chunk = static_cast<LargeChunk*>(Internal::allocMemory(sizeof(LargeChunk)));
+  LargeNode* node = static_cast<LargeNode*>(Internal::allocMemory(sizeof(LargeNode)));
+
+  // Out of memory.
+  if (!chunk || !node) {
+    vMemMgrReleaseVMem(self, vmem, vSize);
+    if (chunk) Internal::releaseMemory(chunk);
+    if (node) Internal::releaseMemory(node);
+    return nullptr;
+  }
+
+  chunk->prev = nullptr;
+  chunk->next = self->_largeChunks;
+  chunk->mem = vmem;
+  chunk->size = vSize;
+
+  if (chunk->next) chunk->next->prev = chunk;
+  self->_largeChunks = chunk;
+
+  node->node[0] = nullptr;
+  node->node[1] = nullptr;
+  node->mem = vmem;
+  node->size = vSize;
+  node->red = 1;
+  node->type = kVMemNodeLarge;
+
+  node->chunk = chunk;
+  node->physPrev = nullptr;
+  node->physNext = nullptr;
+  node->binPrev = nullptr;
+  node->binNext = nullptr;
+  node->isFree = 0;
+
+  self->_allocatedBytes += vSize;
+  return node;
+}
+
+//! \internal
+//!
+//! Split `node` at `offset` and make the tail a free block.
+//!
+//! The tail is kept as a part of `node` if there is no memory for a new block,
+//! which is safe, it just stays used until `node` is released.
+static void vMemMgrSplitLarge(VMemMgr* self, LargeNode* node, size_t offset) noexcept {
+  ASMJIT_ASSERT(offset < node->size);
+
+  size_t rest = node->size - offset;
+  LargeNode* next = node->physNext;
+
+  // Merge the tail with the next block if it's free.
+  if (next && next->isFree) {
+    vMemMgrRemoveFree(self, next);
+    next->mem -= rest;
+    next->size += rest;
+    vMemMgrInsertFree(self, next);
+
+    node->size = offset;
+    return;
+  }
+
+  LargeNode* tail = static_cast<LargeNode*>(Internal::allocMemory(sizeof(LargeNode)));
+  if (!tail) return;
+
+  tail->node[0] = nullptr;
+  tail->node[1] = nullptr;
+  tail->mem = node->mem + offset;
+  tail->size = rest;
+  tail->red = 1;
+  tail->type = kVMemNodeLarge;
+
+  tail->chunk = node->chunk;
+  tail->physPrev = node;
+  tail->physNext = next;
+
+  if (next) next->physPrev = tail;
+  node->physNext = tail;
+  node->size = offset;
+
+  vMemMgrInsertFree(self, tail);
+}
+
+static void* vMemMgrAllocLarge(VMemMgr* self, size_t vSize) noexcept {
+  // Free-list mapping works with 32-bit granule counts.
+  if (ASMJIT_UNLIKELY(static_cast<uint64_t>(vSize) / VMemMgr::kGranularity > 0x7FFFFFFFU))
+    return nullptr;
+
+  LargeNode* node = vMemMgrFindFree(self, vSize);
+  if (node) {
+    vMemMgrRemoveFree(self, node);
+  }
+  else {
+    size_t chunkSize = Utils::alignTo<size_t>(vSize, self->_blockSize);
+    if (chunkSize < self->_largeBlockSize)
+      chunkSize = self->_largeBlockSize;
+
+    node = vMemMgrCreateLarge(self, chunkSize);
+    if (!node) return nullptr;
+  }
+
+  if (node->size > vSize)
+    vMemMgrSplitLarge(self, node, vSize);
+
+  vMemMgrInsertNode(self, node);
+  ASMJIT_ASSERT(vMemMgrCheckTree(self));
+
+  self->_usedBytes += node->size;
+  return node->mem;
+}
+
+static Error vMemMgrReleaseLarge(VMemMgr* self, LargeNode* node, uint8_t* p) noexcept {
+  if (ASMJIT_UNLIKELY(p != node->mem))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  vMemMgrRemoveNode(self, node);
+  ASMJIT_ASSERT(vMemMgrCheckTree(self));
+
+  self->_usedBytes -= node->size;
+
+  // Coalesce with the next block.
+  LargeNode* next = node->physNext;
+  if (next && next->isFree) {
+    vMemMgrRemoveFree(self, next);
+
+    node->size += next->size;
+    node->physNext = next->physNext;
+    if (node->physNext) node->physNext->physPrev = node;
+
+    Internal::releaseMemory(next);
+  }
+
+  // Coalesce with the previous block.
+  LargeNode* prev = node->physPrev;
+  if (prev && prev->isFree) {
+    vMemMgrRemoveFree(self, prev);
+
+    prev->size += node->size;
+    prev->physNext = node->physNext;
+    if (prev->physNext) prev->physNext->physPrev = prev;
+
+    Internal::releaseMemory(node);
+    node = prev;
+  }
+
+  // Release the chunk if it's empty, but keep the last one.
+  LargeChunk* chunk = node->chunk;
+  if (!node->physPrev && !node->physNext && (chunk->prev || chunk->next)) {
+    if (chunk->prev)
+      chunk->prev->next = chunk->next;
+    else
+      self->_largeChunks = chunk->next;
+
+    if (chunk->next)
+      chunk->next->prev = chunk->prev;
+
+    vMemMgrReleaseVMem(self, chunk->mem, chunk->size);
+    self->_allocatedBytes -= chunk->size;
+
+    Internal::releaseMemory(node);
+    Internal::releaseMemory(chunk);
+    return kErrorOk;
+  }
+
+  vMemMgrInsertFree(self, node);
+  return kErrorOk;
+}
+
+// ============================================================================
+// [asmjit::VMemMgr - Alloc]
+// ============================================================================
+
 static void* vMemMgrAllocPermanent(VMemMgr* self, size_t vSize) noexcept {
   static const size_t permanentAlignment = 32;
   static const size_t permanentNodeSize  = 32768;
@@ -559,128 +912,32 @@ static void* vMemMgrAllocPermanent(VMemMgr* self, size_t vSize) noexcept {
 }
 
 static void* vMemMgrAllocFreeable(VMemMgr* self, size_t vSize) noexcept {
-  // Current index.
-  size_t i;
-
-  // How many we need to be freed.
-  size_t need;
-  size_t minVSize;
-
-  // Align to 32 bytes by default.
-  vSize = Utils::alignTo<size_t>(vSize, 32);
+  vSize = Utils::alignTo<size_t>(vSize, VMemMgr::kGranularity);
   if (vSize == 0)
     return nullptr;
 
   AutoLock locked(self->_lock);
-  MemNode* node = self->_optimal;
-  minVSize = self->_blockSize;
-
-  // Try to find memory block in existing nodes.
-  while (node) {
-    // Skip this node?
-    if ((node->getAvailable() < vSize) || (node->largestBlock < vSize && node->largestBlock != 0)) {
-      MemNode* next = node->next;
-
-      if (node->getAvailable() < minVSize && node == self->_optimal && next)
-        self->_optimal = next;
-
-      node = next;
-      continue;
-    }
-
-    size_t* up = node->baUsed;     // Current ubits address.
-    size_t ubits;                  // Current ubits[0] value.
-    size_t bit;                    // Current bit mask.
-    size_t blocks = node->blocks;  // Count of blocks in node.
-    size_t cont = 0;               // How many bits are currently freed in find loop.
-    size_t maxCont = 0;            // Largest continuous block (bits count).
-    size_t j;
-
-    need = M_DIV((vSize + node->density - 1), node->density);
-    i = 0;
-
-    // Try to find node that is large enough.
-    while (i < blocks) {
-      ubits = *up++;
-
-      // Fast skip used blocks.
-      if (ubits == ~(size_t)0) {
-        if (cont > maxCont)
-          maxCont = cont;
-        cont = 0;
-
-        i += kBitsPerEntity;
-        continue;
-      }
-
-      size_t max = kBitsPerEntity;
-      if (i + max > blocks)
-        max = blocks - i;
-
-      for (j = 0, bit = 1; j < max; bit <<= 1) {
-        j++;
-        if ((ubits & bit) == 0) {
-          if (++cont == need) {
-            i += j;
-            i -= cont;
-            goto L_Found;
-          }
-
-          continue;
-        }
-
-        if (cont > maxCont) maxCont = cont;
-        cont = 0;
-      }
-
-      i += kBitsPerEntity;
-    }
-
-    // Because we traversed the entire node, we can set largest node size that
-    // will be used to cache next traversing.
-    node->largestBlock = maxCont * node->density;
-
-    node = node->next;
-  }
-
-  // If we are here, we failed to find existing memory block and we must
-  // allocate a new one.
-  {
-    size_t blockSize = self->_blockSize;
-    if (blockSize < vSize) blockSize = vSize;
+  if (vSize <= VMemMgr::kSlabMaxSize)
+    return vMemMgrAllocSlab(self, vSize);
+  else
+    return vMemMgrAllocLarge(self, vSize);
+}
 
-    node = vMemMgrCreateNode(self, blockSize, self->_blockDensity);
-    if (!node) return nullptr;
+// ============================================================================
+// [asmjit::VMemMgr - Reset]
+// ============================================================================
 
-    // Update binary tree.
-    vMemMgrInsertNode(self, node);
-    ASMJIT_ASSERT(vMemMgrCheckTree(self));
+static void vMemMgrResetTree(VMemMgr* self, RbNode* node, bool keepVirtualMemory) noexcept {
+  if (!node) return;
 
-    // Alloc first node at start.
-    i = 0;
-    need = (vSize + node->density - 1) / node->density;
+  vMemMgrResetTree(self, node->node[0], keepVirtualMemory);
+  vMemMgrResetTree(self, node->node[1], keepVirtualMemory);
 
-    // Update statistics.
-    self->_allocatedBytes += node->size;
-  }
+  // Virtual memory of large blocks is released together with their chunks.
+  if (node->type == kVMemNodeSlab && !keepVirtualMemory)
+    vMemMgrReleaseVMem(self, node->mem, node->size);
 
-L_Found:
-  // Update bits.
-  _SetBits(node->baUsed, i, need);
-  _SetBits(node->baCont, i, need - 1);
-
-  // Update statistics.
-  {
-    size_t u = need * node->density;
-    node->used += u;
-    node->largestBlock = 0;
-    self->_usedBytes += u;
-  }
-
-  // And return pointer to allocated memory.
-  uint8_t* result = node->mem + i * node->density;
-  ASMJIT_ASSERT(result >= node->mem && result <= node->mem + node->size - vSize);
-  return result;
+  Internal::releaseMemory(node);
 }
 
 //! \internal
@@ -689,27 +946,46 @@ L_Found:
 //! virtual memory allocated unless `keepVirtualMemory` is true (and this is
 //! only used when writing data to a remote process).
 static void vMemMgrReset(VMemMgr* self, bool keepVirtualMemory) noexcept {
-  MemNode* node = self->_first;
+  uint32_t i, j;
+
+  // Slab chunks and used large blocks.
+  vMemMgrResetTree(self, self->_root, keepVirtualMemory);
+
+  // Free large blocks.
+  for (i = 0; i < VMemMgr::kLargeFlCount; i++) {
+    for (j = 0; j < VMemMgr::kLargeSlCount; j++) {
+      LargeNode* node = self->_largeBins[i][j];
+      while (node) {
+        LargeNode* next = node->binNext;
+        Internal::releaseMemory(node);
+        node = next;
+      }
+      self->_largeBins[i][j] = nullptr;
+    }
+    self->_largeSlBitmap[i] = 0;
+  }
+  self->_largeFlBitmap = 0;
 
-  while (node) {
-    MemNode* next = node->next;
+  // Large chunks.
+  LargeChunk* chunk = self->_largeChunks;
+  while (chunk) {
+    LargeChunk* next = chunk->next;
 
     if (!keepVirtualMemory)
-      vMemMgrReleaseVMem(self, node->mem, node->size);
+      vMemMgrReleaseVMem(self, chunk->mem, chunk->size);
 
-    Internal::releaseMemory(node->baUsed);
-    Internal::releaseMemory(node);
-
-    node = next;
+    Internal::releaseMemory(chunk);
+    chunk = next;
   }
 
+  for (i = 0; i < VMemMgr::kSlabClassCount; i++)
+    self->_slabs[i] = nullptr;
+
   self->_allocatedBytes = 0;
   self->_usedBytes = 0;
 
   self->_root = nullptr;
-  self->_first = nullptr;
-  self->_last = nullptr;
-  self->_optimal = nullptr;
+  self->_largeChunks = nullptr;
 }
 
 // ============================================================================
@@ -729,15 +1005,18 @@ VMemMgr::VMemMgr(HANDLE hProcess) noexcept {
 #endif // ASMJIT_OS_WINDOWS
 
   _blockSize = vm.pageGranularity;
-  _blockDensity = 64;
+  _largeBlockSize = vm.pageGranularity * 4;
 
   _allocatedBytes = 0;
   _usedBytes = 0;
 
   _root = nullptr;
-  _first = nullptr;
-  _last = nullptr;
-  _optimal = nullptr;
+  ::memset(_slabs, 0, sizeof(_slabs));
+
+  _largeChunks = nullptr;
+  ::memset(_largeBins, 0, sizeof(_largeBins));
+  _largeFlBitmap = 0;
+  ::memset(_largeSlBitmap, 0, sizeof(_largeSlBitmap));
 
   _permanent = nullptr;
   _keepVirtualMemory = false;
@@ -761,102 +1040,79 @@ VMemMgr::~VMemMgr() noexcept {
 // ============================================================================
 
 void VMemMgr::reset() noexcept {
+  AutoLock locked(_lock);
   vMemMgrReset(this, false);
 }
 
 // ============================================================================
-// [asmjit::VMemMgr - Alloc / Release]
+// [asmjit::VMemMgr - Stats]
 // ============================================================================
 
-void* VMemMgr::alloc(size_t size, uint32_t type) noexcept {
-  if (type == kAllocPermanent)
-    return vMemMgrAllocPermanent(this, size);
-  else
-    return vMemMgrAllocFreeable(this, size);
-}
-
-Error VMemMgr::release(void* p) noexcept {
-  if (!p) return kErrorOk;
-
-  AutoLock locked(_lock);
-  MemNode* node = vMemMgrFindNodeByPtr(this, static_cast<uint8_t*>(p));
-  if (!node) return DebugUtils::errored(kErrorInvalidArgument);
+static void vMemMgrStatsTree(RbNode* node, VMemStats* out) noexcept {
+  if (!node) return;
 
-  size_t offset = (size_t)((uint8_t*)p - (uint8_t*)node->mem);
-  size_t bitpos = M_DIV(offset, node->density);
-  size_t i = (bitpos / kBitsPerEntity);
+  vMemMgrStatsTree(node->node[0], out);
+  vMemMgrStatsTree(node->node[1], out);
 
-  size_t* up = node->baUsed + i;  // Current ubits address.
-  size_t* cp = node->baCont + i;  // Current cbits address.
-  size_t ubits = *up;             // Current ubits[0] value.
-  size_t cbits = *cp;             // Current cbits[0] value.
-  size_t bit = (size_t)1 << (bitpos % kBitsPerEntity);
-
-  size_t cont = 0;
-  bool stop;
+  if (node->type == kVMemNodeSlab) {
+    SlabNode* slab = static_cast<SlabNode*>(node);
+    out->slabCount++;
+    out->slabBytes += slab->size;
+    out->slabUsedBytes += static_cast<size_t>(slab->slotCount - slab->freeCount) * slab->slotSize;
+  }
+  else {
+    out->largeUsedBytes += node->size;
+  }
+}
 
-  for (;;) {
-    stop = (cbits & bit) == 0;
-    ubits &= ~bit;
-    cbits &= ~bit;
+void VMemMgr::getStats(VMemStats* out) const noexcept {
+  VMemMgr* self = const_cast<VMemMgr*>(this);
+  AutoLock locked(self->_lock);
 
-    bit <<= 1;
-    cont++;
+  ::memset(out, 0, sizeof(VMemStats));
+  out->allocatedBytes = _allocatedBytes;
+  out->usedBytes = _usedBytes;
 
-    if (stop || bit == 0) {
-      *up = ubits;
-      *cp = cbits;
-      if (stop)
-        break;
+  vMemMgrStatsTree(_root, out);
 
-      ubits = *++up;
-      cbits = *++cp;
-      bit = 1;
-    }
+  for (LargeChunk* chunk = _largeChunks; chunk; chunk = chunk->next) {
+    out->largeCount++;
+    out->largeBytes += chunk->size;
   }
 
-  // If the freed block is fully allocated node then it's needed to
-  // update 'optimal' pointer in memory manager.
-  if (node->used == node->size) {
-    MemNode* cur = _optimal;
-
-    do {
-      cur = cur->prev;
-      if (cur == node) {
-        _optimal = node;
-        break;
+  for (uint32_t i = 0; i < kLargeFlCount; i++) {
+    for (uint32_t j = 0; j < kLargeSlCount; j++) {
+      for (LargeNode* node = _largeBins[i][j]; node; node = node->binNext) {
+        out->largeFreeBlocks++;
+        if (out->largestFreeBlock < node->size)
+          out->largestFreeBlock = node->size;
       }
-    } while (cur);
+    }
   }
+}
 
-  // Statistics.
-  cont *= node->density;
-  if (node->largestBlock < cont)
-    node->largestBlock = cont;
-
-  node->used -= cont;
-  _usedBytes -= cont;
-
-  // If page is empty, we can free it.
-  if (node->used == 0) {
-    // Free memory associated with node (this memory is not accessed
-    // anymore so it's safe).
-    vMemMgrReleaseVMem(this, node->mem, node->size);
-    Internal::releaseMemory(node->baUsed);
+// ============================================================================
+// [asmjit::VMemMgr - Alloc / Release]
+// ============================================================================
 
-    node->baUsed = nullptr;
-    node->baCont = nullptr;
+void* VMemMgr::alloc(size_t size, uint32_t type) noexcept {
+  if (type == kAllocPermanent)
+    return vMemMgrAllocPermanent(this, size);
+  else
+    return vMemMgrAllocFreeable(this, size);
+}
 
-    // Statistics.
-    _allocatedBytes -= node->size;
+Error VMemMgr::release(void* p) noexcept {
+  if (!p) return kErrorOk;
 
-    // Remove node. This function can return different node than
-    // passed into, but data is copied into previous node if needed.
-    Internal::releaseMemory(vMemMgrRemoveNode(this, node));
-    ASMJIT_ASSERT(vMemMgrCheckTree(this));
-  }
+  AutoLock locked(_lock);
+  RbNode* node = vMemMgrFindNodeByPtr(this, static_cast<uint8_t*>(p));
+  if (!node) return DebugUtils::errored(kErrorInvalidArgument);
 
-  return kErrorOk;
+  if (node->type == kVMemNodeSlab)
+    return vMemMgrReleaseSlab(this, static_cast<SlabNode*>(node), static_cast<uint8_t*>(p));
+  else
+    return vMemMgrReleaseLarge(this, static_cast<LargeNode*>(node), static_cast<uint8_t*>(p));
 }
 
 Error VMemMgr::shrink(void* p, size_t used) noexcept {
@@ -865,74 +1121,24 @@ Error VMemMgr::shrink(void* p, size_t used) noexcept {
     return release(p);
 
   AutoLock locked(_lock);
-  MemNode* node = vMemMgrFindNodeByPtr(this, (uint8_t*)p);
+  RbNode* node = vMemMgrFindNodeByPtr(this, static_cast<uint8_t*>(p));
   if (!node) return DebugUtils::errored(kErrorInvalidArgument);
 
-  size_t offset = (size_t)((uint8_t*)p - (uint8_t*)node->mem);
-  size_t bitpos = M_DIV(offset, node->density);
-  size_t i = (bitpos / kBitsPerEntity);
-
-  size_t* up = node->baUsed + i;  // Current ubits address.
-  size_t* cp = node->baCont + i;  // Current cbits address.
-  size_t ubits = *up;             // Current ubits[0] value.
-  size_t cbits = *cp;             // Current cbits[0] value.
-  size_t bit = (size_t)1 << (bitpos % kBitsPerEntity);
+  // Slots of slab chunks have a fixed size.
+  if (node->type == kVMemNodeSlab)
+    return kErrorOk;
 
-  size_t cont = 0;
-  size_t usedBlocks = (used + node->density - 1) / node->density;
-
-  bool stop;
-
-  // Find the first block we can mark as free.
-  for (;;) {
-    stop = (cbits & bit) == 0;
-    if (stop)
-      return kErrorOk;
-
-    if (++cont == usedBlocks)
-      break;
-
-    bit <<= 1;
-    if (bit == 0) {
-      ubits = *++up;
-      cbits = *++cp;
-      bit = 1;
-    }
-  }
+  LargeNode* large = static_cast<LargeNode*>(node);
+  if (ASMJIT_UNLIKELY(static_cast<uint8_t*>(p) != large->mem))
+    return DebugUtils::errored(kErrorInvalidArgument);
 
-  // Free the tail blocks.
-  cont = ~(size_t)0;
-  goto _EnterFreeLoop;
+  size_t newSize = Utils::alignTo<size_t>(used, kGranularity);
+  if (newSize >= large->size)
+    return kErrorOk;
 
-  for (;;) {
-    stop = (cbits & bit) == 0;
-    ubits &= ~bit;
-
-_EnterFreeLoop:
-    cbits &= ~bit;
-
-    bit <<= 1;
-    cont++;
-
-    if (stop || bit == 0) {
-      *up = ubits;
-      *cp = cbits;
-      if (stop)
-        break;
-
-      ubits = *++up;
-      cbits = *++cp;
-      bit = 1;
-    }
-  }
-
-  // Statistics.
-  cont *= node->density;
-  if (node->largestBlock < cont)
-    node->largestBlock = cont;
-
-  node->used -= cont;
-  _usedBytes -= cont;
+  size_t oldSize = large->size;
+  vMemMgrSplitLarge(this, large, newSize);
+  _usedBytes -= oldSize - large->size;
 
   return kErrorOk;
 }
@@ -1069,6 +1275,50 @@ UNIT(base_vmem) {
   }
   VMemTest_stats(memmgr);
 
+  EXPECT(memmgr.getUsedBytes() == 0,
+    "All memory should be released, but %u bytes are still used", static_cast<unsigned int>(memmgr.getUsedBytes()));
+
+  INFO("Large blocks - split, shrink, and coalesce");
+  size_t kLargeSize = 8192;
+  for (i = 0; i < 64; i++) {
+    a[i] = memmgr.alloc(kLargeSize + static_cast<size_t>(i) * 64);
+    EXPECT(a[i] != nullptr,
+      "Couldn't allocate %d bytes of virtual memory", static_cast<int>(kLargeSize + i * 64));
+    ::memset(a[i], 0xCC, kLargeSize + static_cast<size_t>(i) * 64);
+  }
+
+  for (i = 0; i < 64; i += 2) {
+    EXPECT(memmgr.shrink(a[i], 100) == kErrorOk,
+      "Failed to shrink %p", a[i]);
+  }
+
+  VMemStats stats;
+  memmgr.getStats(&stats);
+  EXPECT(stats.largeUsedBytes == stats.usedBytes,
+    "Used bytes of large blocks (%u) don't match used bytes (%u)",
+    static_cast<unsigned int>(stats.largeUsedBytes), static_cast<unsigned int>(stats.usedBytes));
+  EXPECT(stats.largeFreeBlocks != 0,
+    "Shrinking large blocks should create free blocks");
+
+  // Release in different order so both neighbours get coalesced.
+  for (i = 1; i < 64; i += 2) {
+    EXPECT(memmgr.release(a[i]) == kErrorOk,
+      "Failed to free %p", a[i]);
+  }
+  for (i = 0; i < 64; i += 2) {
+    EXPECT(memmgr.release(a[i]) == kErrorOk,
+      "Failed to free %p", a[i]);
+  }
+
+  memmgr.getStats(&stats);
+  EXPECT(stats.usedBytes == 0,
+    "All memory should be released, but %u bytes are still used", static_cast<unsigned int>(stats.usedBytes));
+  EXPECT(stats.largeCount == 1 && stats.largeFreeBlocks == 1 && stats.largestFreeBlock == stats.largeBytes,
+    "Free blocks should be coalesced into a single chunk (chunks=%u, blocks=%u)",
+    static_cast<unsigned int>(stats.largeCount), static_cast<unsigned int>(stats.largeFreeBlocks));
+  EXPECT(stats.getLargeFragmentation() == 0.0,
+    "Large chunks shouldn't be fragmented");
+
   Internal::releaseMemory(a);
   Internal::releaseMemory(b);
 }
@@ -20,12 +20,42 @@ namespace asmjit {
 //! \addtogroup asmjit_base
 //! \{
 
+// ============================================================================
+// [asmjit::VMemStats]
+// ============================================================================
+
+//! Statistics of \ref VMemMgr, see `VMemMgr::getStats()`.
+struct VMemStats {
+  //! Get fragmentation of free memory in large chunks, in range [0, 1].
+  //!
+  //! Zero means that all free memory is a single block, values close to one
+  //! mean that the largest free block is only a small part of free memory.
+  ASMJIT_INLINE double getLargeFragmentation() const noexcept {
+    size_t freeBytes = largeBytes - largeUsedBytes;
+    return freeBytes ? 1.0 - static_cast<double>(largestFreeBlock) / static_cast<double>(freeBytes) : 0.0;
+  }
+
+  size_t allocatedBytes;                 //!< Bytes of virtual memory allocated (freeable memory).
+  size_t usedBytes;                      //!< Bytes of virtual memory used.
+
+  size_t slabCount;                      //!< Number of slab chunks.
+  size_t slabBytes;                      //!< Bytes of virtual memory allocated by slab chunks.
+  size_t slabUsedBytes;                  //!< Bytes of slab chunks used.
+
+  size_t largeCount;                     //!< Number of large chunks.
+  size_t largeBytes;                     //!< Bytes of virtual memory allocated by large chunks.
+  size_t largeUsedBytes;                 //!< Bytes of large chunks used.
+  size_t largeFreeBlocks;                //!< Number of free blocks in large chunks.
+  size_t largestFreeBlock;               //!< Size of the largest free block in large chunks.
+};
+
 // ============================================================================
 // [asmjit::VMemMgr]
 // ============================================================================
 
-//! Reference implementation of memory manager that uses `VMemUtil` to allocate
-//! chunks of virtual memory and bit arrays to manage it.
+//! Reference implementation of memory manager that uses `OSUtils` to allocate
+//! chunks of virtual memory and manages them by using size-class (slab) chunks
+//! for small allocations and segregated free-lists for large allocations.
 class VMemMgr {
 public:
   //! Type of virtual memory allocation, see `VMemMgr::alloc()`.
@@ -36,6 +66,15 @@ public:
     kAllocPermanent = 1
   };
 
+  //! \internal
+  ASMJIT_ENUM(Limits) {
+    kGranularity      = 64,              //!< Granularity (and alignment) of all allocations.
+    kSlabClassCount   = 16,              //!< Number of slab size-classes.
+    kSlabMaxSize      = 2048,            //!< Largest allocation served by slab chunks.
+    kLargeFlCount     = 32,              //!< Number of first-level free-list bins (large allocations).
+    kLargeSlCount     = 4                //!< Number of second-level free-list bins (large allocations).
+  };
+
   // --------------------------------------------------------------------------
   // [Construction / Destruction]
   // --------------------------------------------------------------------------
@@ -76,6 +115,9 @@ public:
   //! Get how many bytes are currently used.
   ASMJIT_INLINE size_t getUsedBytes() const noexcept { return _usedBytes; }
 
+  //! Get detailed statistics, including fragmentation of large chunks.
+  ASMJIT_API void getStats(VMemStats* out) const noexcept;
+
   //! Get whether to keep allocated memory after the `VMemMgr` is destroyed.
   //!
   //! \sa \ref setKeepVirtualMemory.
@@ -117,8 +159,8 @@ public:
 #endif // ASMJIT_OS_WINDOWS
   Lock _lock;                            //!< Lock to enable thread-safe functionality.
 
-  size_t _blockSize;                     //!< Default block size.
-  size_t _blockDensity;                  //!< Default block density.
+  size_t _blockSize;                     //!< Size of a slab chunk.
+  size_t _largeBlockSize;                //!< Default size of a large chunk.
   bool _keepVirtualMemory;               //!< Keep virtual memory after destroyed.
 
   size_t _allocatedBytes;                //!< How many bytes are currently allocated.
@@ -128,15 +170,21 @@ public:
   //! \{
 
   struct RbNode;
-  struct MemNode;
+  struct SlabNode;
+  struct LargeChunk;
+  struct LargeNode;
   struct PermanentNode;
 
-  // Memory nodes root.
-  MemNode* _root;
-  // Memory nodes list.
-  MemNode* _first;
-  MemNode* _last;
-  MemNode* _optimal;
+  // Slab chunks and used large blocks (RB-tree ordered by address).
+  RbNode* _root;
+  // Slab chunks that have at least one free slot (per size-class).
+  SlabNode* _slabs[kSlabClassCount];
+  // Large chunks.
+  LargeChunk* _largeChunks;
+  // Free large blocks (segregated free-lists and bitmaps of non-empty lists).
+  LargeNode* _largeBins[kLargeFlCount][kLargeSlCount];
+  uint32_t _largeFlBitmap;
+  uint32_t _largeSlBitmap[kLargeFlCount];
   // Permanent memory.
   PermanentNode* _permanent;
 
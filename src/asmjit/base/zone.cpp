@@ -8,6 +8,7 @@
 #define ASMJIT_EXPORTS
 
 // [Dependencies]
+#include "../base/osutils.h"
 #include "../base/utils.h"
 #include "../base/zone.h"
 
@@ -33,6 +34,206 @@ static ASMJIT_INLINE uint32_t Zone_getAlignmentOffsetFromAlignment(uint32_t x) n
   }
 }
 
+// ============================================================================
+// [asmjit::ZoneBlockCache]
+// ============================================================================
+
+#if !defined(ASMJIT_DISABLE_ZONE_CACHE) && \
+    ((defined(__cplusplus) && __cplusplus >= 201103L) || ASMJIT_CC_MSC_GE(19, 0, 0))
+# define ASMJIT_ZONE_CACHE 1
+#else
+# define ASMJIT_ZONE_CACHE 0
+#endif
+
+#if ASMJIT_ZONE_CACHE
+enum { kZoneCacheSlots = 8 };
+
+//! \internal
+//!
+//! Cached blocks of the same size.
+struct ZoneCacheSlot {
+  size_t size;                           //!< Size of blocks in this slot.
+  Zone::Block* blocks;                   //!< Single-linked list of blocks (by `next`).
+};
+
+//! \internal
+//!
+//! Per-thread cache, must be trivial so it stays valid until the thread exits.
+struct ZoneCacheData {
+  ZoneCacheSlot slots[kZoneCacheSlots];  //!< Cached blocks.
+  size_t cachedSize;                     //!< Size of cached blocks.
+  size_t cachedCount;                    //!< Count of cached blocks.
+  size_t hitCount;                       //!< Count of blocks provided by the cache.
+  size_t allocCount;                     //!< Count of blocks provided by the allocator.
+  bool registered;                       //!< `Zone_cacheCleaner` was constructed.
+  bool destroyed;                        //!< `Zone_cacheCleaner` was destroyed (thread exit).
+};
+
+//! \internal
+//!
+//! Releases cached blocks when the thread exits.
+struct ZoneCacheCleaner {
+  ASMJIT_INLINE ZoneCacheCleaner() noexcept {}
+  ~ZoneCacheCleaner() noexcept;
+
+  ASMJIT_INLINE void touch() noexcept {}
+};
+
+static thread_local ZoneCacheData Zone_cache;
+static thread_local ZoneCacheCleaner Zone_cacheCleaner;
+
+static size_t Zone_cacheEnabled = 1;
+static size_t Zone_cacheLimit = ZoneBlockCache::kDefaultLimit;
+
+ZoneCacheCleaner::~ZoneCacheCleaner() noexcept {
+  ZoneBlockCache::trim(0);
+  Zone_cache.destroyed = true;
+}
+#endif // ASMJIT_ZONE_CACHE
+
+//! \internal
+//!
+//! Allocate a new block that has `size` bytes of data.
+static Zone::Block* Zone_newBlock(size_t size) noexcept {
+#if ASMJIT_ZONE_CACHE
+  ZoneCacheData& cache = Zone_cache;
+  if (size <= ZoneBlockCache::kMaxBlockSize && cache.cachedCount) {
+    for (uint32_t i = 0; i < kZoneCacheSlots; i++) {
+      ZoneCacheSlot& slot = cache.slots[i];
+      Zone::Block* block = slot.blocks;
+
+      if (slot.size == size && block) {
+        slot.blocks = block->next;
+        cache.cachedSize -= size;
+        cache.cachedCount--;
+        cache.hitCount++;
+        return block;
+      }
+    }
+  }
+  cache.allocCount++;
+#endif // ASMJIT_ZONE_CACHE
+
+  return static_cast<Zone::Block*>(Internal::allocMemory(sizeof(Zone::Block) + size));
+}
+
+//! \internal
+//!
+//! Release `block` allocated by `Zone_newBlock()`.
+static void Zone_releaseBlock(Zone::Block* block) noexcept {
+#if ASMJIT_ZONE_CACHE
+  ZoneCacheData& cache = Zone_cache;
+  size_t size = block->size;
+
+  if (size <= ZoneBlockCache::kMaxBlockSize && !cache.destroyed &&
+      cache.cachedSize + size <= Atomic::load(&Zone_cacheLimit) &&
+      Atomic::load(&Zone_cacheEnabled)) {
+    ZoneCacheSlot* target = nullptr;
+
+    for (uint32_t i = 0; i < kZoneCacheSlots; i++) {
+      ZoneCacheSlot& slot = cache.slots[i];
+      if (slot.size == size) {
+        target = &slot;
+        break;
+      }
+      if (!slot.blocks && !target)
+        target = &slot;
+    }
+
+    if (target) {
+      // Constructs the cleaner (once per thread), which registers its
+      // destructor to be called when the thread exits.
+      if (!cache.registered) {
+        cache.registered = true;
+        Zone_cacheCleaner.touch();
+      }
+
+      target->size = size;
+      block->prev = nullptr;
+      block->next = target->blocks;
+      target->blocks = block;
+
+      cache.cachedSize += size;
+      cache.cachedCount++;
+      return;
+    }
+  }
+#endif // ASMJIT_ZONE_CACHE
+
+  Internal::releaseMemory(block);
+}
+
+bool ZoneBlockCache::isEnabled() noexcept {
+#if ASMJIT_ZONE_CACHE
+  return Atomic::load(&Zone_cacheEnabled) != 0;
+#else
+  return false;
+#endif
+}
+
+void ZoneBlockCache::setEnabled(bool enabled) noexcept {
+#if ASMJIT_ZONE_CACHE
+  Atomic::store(&Zone_cacheEnabled, static_cast<size_t>(enabled));
+#else
+  ASMJIT_UNUSED(enabled);
+#endif
+}
+
+size_t ZoneBlockCache::getLimit() noexcept {
+#if ASMJIT_ZONE_CACHE
+  return Atomic::load(&Zone_cacheLimit);
+#else
+  return 0;
+#endif
+}
+
+void ZoneBlockCache::setLimit(size_t limit) noexcept {
+#if ASMJIT_ZONE_CACHE
+  Atomic::store(&Zone_cacheLimit, limit);
+#else
+  ASMJIT_UNUSED(limit);
+#endif
+}
+
+void ZoneBlockCache::trim(size_t keepSize) noexcept {
+#if ASMJIT_ZONE_CACHE
+  ZoneCacheData& cache = Zone_cache;
+
+  for (uint32_t i = 0; i < kZoneCacheSlots && cache.cachedSize > keepSize; i++) {
+    ZoneCacheSlot& slot = cache.slots[i];
+    while (slot.blocks && cache.cachedSize > keepSize) {
+      Zone::Block* block = slot.blocks;
+      slot.blocks = block->next;
+
+      cache.cachedSize -= slot.size;
+      cache.cachedCount--;
+      Internal::releaseMemory(block);
+    }
+  }
+#else
+  ASMJIT_UNUSED(keepSize);
+#endif
+}
+
+void ZoneBlockCache::getStats(Stats* out) noexcept {
+#if ASMJIT_ZONE_CACHE
+  const ZoneCacheData& cache = Zone_cache;
+  out->cachedSize = cache.cachedSize;
+  out->cachedCount = cache.cachedCount;
+  out->hitCount = cache.hitCount;
+  out->allocCount = cache.allocCount;
+#else
+  ::memset(out, 0, sizeof(Stats));
+#endif
+}
+
+void ZoneBlockCache::resetStats() noexcept {
+#if ASMJIT_ZONE_CACHE
+  Zone_cache.hitCount = 0;
+  Zone_cache.allocCount = 0;
+#endif
+}
+
 // ============================================================================
 // [asmjit::Zone - Construction / Destruction]
 // ============================================================================
@@ -65,14 +266,14 @@ void Zone::reset(bool releaseMemory) noexcept {
     Block* next = cur->next;
     do {
       Block* prev = cur->prev;
-      Internal::releaseMemory(cur);
+      Zone_releaseBlock(cur);
       cur = prev;
     } while (cur);
 
     cur = next;
     while (cur) {
       next = cur->next;
-      Internal::releaseMemory(cur);
+      Zone_releaseBlock(cur);
       cur = next;
     }
 
@@ -90,6 +291,21 @@ void Zone::reset(bool releaseMemory) noexcept {
   }
 }
 
+// ============================================================================
+// [asmjit::Zone - Accessors]
+// ============================================================================
+
+size_t Zone::getUsedSize() const noexcept {
+  const Block* cur = _block;
+  if (cur == &Zone_zeroBlock)
+    return 0;
+
+  size_t size = (size_t)(_ptr - cur->data);
+  while ((cur = cur->prev) != nullptr)
+    size += cur->size;
+  return size;
+}
+
 // ============================================================================
 // [asmjit::Zone - Alloc]
 // ============================================================================
@@ -125,7 +341,7 @@ void* Zone::_alloc(size_t size) noexcept {
     return nullptr;
 
   blockSize += blockAlignment;
-  Block* newBlock = static_cast<Block*>(Internal::allocMemory(sizeof(Block) + blockSize));
+  Block* newBlock = Zone_newBlock(blockSize);
 
   if (ASMJIT_UNLIKELY(!newBlock))
     return nullptr;
@@ -828,11 +1044,219 @@ ZoneHashNode* ZoneHashBase::_del(ZoneHashNode* node) noexcept {
   return nullptr;
 }
 
+// ============================================================================
+// [asmjit::ZoneOpenHashBase - Reset]
+// ============================================================================
+
+void ZoneOpenHashBase::reset(ZoneHeap* heap) noexcept {
+  if (_capacity)
+    _heap->release(_slots, static_cast<size_t>(_capacity) * (sizeof(ZoneHashNode*) + 1));
+
+  _heap = heap;
+  _size = 0;
+  _used = 0;
+  _capacity = 0;
+  _groupMask = 0;
+  _growAt = 0;
+  _slots = nullptr;
+  _ctrl = nullptr;
+}
+
+// ============================================================================
+// [asmjit::ZoneOpenHashBase - Rehash]
+// ============================================================================
+
+bool ZoneOpenHashBase::_rehash(uint32_t newCapacity) noexcept {
+  ASMJIT_ASSERT(isInitialized());
+  ASMJIT_ASSERT(Utils::isPowerOf2(newCapacity) && newCapacity >= kGroupSize);
+  ASMJIT_ASSERT(newCapacity > _size);
+
+  // Slots and control bytes share a single block, slots come first as they
+  // need a pointer alignment.
+  ZoneHashNode** newSlots = static_cast<ZoneHashNode**>(
+    _heap->alloc(static_cast<size_t>(newCapacity) * (sizeof(ZoneHashNode*) + 1)));
+
+  if (ASMJIT_UNLIKELY(newSlots == nullptr))
+    return false;
+
+  uint8_t* newCtrl = reinterpret_cast<uint8_t*>(newSlots + newCapacity);
+  uint32_t newGroupMask = newCapacity / kGroupSize - 1;
+  ::memset(newCtrl, kCtrlEmpty, newCapacity);
+
+  ZoneHashNode** oldSlots = _slots;
+  uint8_t* oldCtrl = _ctrl;
+  uint32_t oldCapacity = _capacity;
+
+  for (uint32_t i = 0; i < oldCapacity; i++) {
+    if (oldCtrl[i] & 0x80)
+      continue;
+
+    ZoneHashNode* node = oldSlots[i];
+    uint32_t hMix = _mix(node->_hVal);
+    uint32_t group = hMix & newGroupMask;
+
+    // The new table doesn't contain deleted slots, so the first free slot
+    // is always an empty one.
+    uint32_t step = 1;
+    uint32_t bits;
+    while (!(bits = _matchFree(newCtrl + group * kGroupSize)))
+      group = (group + step++) & newGroupMask;
+
+    uint32_t index = group * kGroupSize + Utils::findFirstBit(bits);
+    newCtrl[index] = static_cast<uint8_t>(hMix >> 25);
+    newSlots[index] = node;
+  }
+
+  if (oldCapacity)
+    _heap->release(oldSlots, static_cast<size_t>(oldCapacity) * (sizeof(ZoneHashNode*) + 1));
+
+  // 87.5% is the maximum occupancy including deleted slots, which guarantees
+  // that each probe sequence terminates at an empty slot.
+  _used = static_cast<uint32_t>(_size);
+  _capacity = newCapacity;
+  _groupMask = newGroupMask;
+  _growAt = newCapacity - newCapacity / 8;
+
+  _slots = newSlots;
+  _ctrl = newCtrl;
+  return true;
+}
+
+// ============================================================================
+// [asmjit::ZoneOpenHashBase - Ops]
+// ============================================================================
+
+ZoneHashNode* ZoneOpenHashBase::_put(ZoneHashNode* node) noexcept {
+  if (_used >= _growAt) {
+    // Grow if the table is at least half full, otherwise there are many
+    // deleted slots and rehashing to the same capacity removes them.
+    uint32_t newCapacity = _capacity;
+    if (_size >= _capacity / 2)
+      newCapacity = _capacity ? _capacity * 2 : uint32_t(kGroupSize);
+
+    // The table can still be used if it's not completely full, it degrades.
+    if (!_rehash(newCapacity) && _used + 1 >= _capacity)
+      return nullptr;
+  }
+
+  uint32_t hMix = _mix(node->_hVal);
+  uint32_t group = hMix & _groupMask;
+
+  uint32_t step = 1;
+  uint32_t bits;
+  while (!(bits = _matchFree(_ctrl + group * kGroupSize)))
+    group = (group + step++) & _groupMask;
+
+  uint32_t index = group * kGroupSize + Utils::findFirstBit(bits);
+  if (_ctrl[index] == kCtrlEmpty)
+    _used++;
+
+  _ctrl[index] = static_cast<uint8_t>(hMix >> 25);
+  _slots[index] = node;
+  _size++;
+
+  return node;
+}
+
+ZoneHashNode* ZoneOpenHashBase::_del(ZoneHashNode* node) noexcept {
+  if (!_size) return nullptr;
+
+  uint32_t hMix = _mix(node->_hVal);
+  uint32_t tag = hMix >> 25;
+  uint32_t group = hMix & _groupMask;
+
+  for (uint32_t step = 1; step <= _groupMask + 1; step++) {
+    uint8_t* ctrl = _ctrl + group * kGroupSize;
+    uint32_t bits = _match(ctrl, tag);
+
+    while (bits) {
+      uint32_t i = Utils::findFirstBit(bits);
+      if (_slots[group * kGroupSize + i] == node) {
+        // Probing never continues past a group that has an empty slot, so
+        // the slot can be made empty instead of deleted in such case.
+        if (_match(ctrl, kCtrlEmpty)) {
+          ctrl[i] = kCtrlEmpty;
+          _used--;
+        }
+        else {
+          ctrl[i] = kCtrlDeleted;
+        }
+
+        _size--;
+        return node;
+      }
+      bits &= bits - 1;
+    }
+
+    if (_match(ctrl, kCtrlEmpty))
+      break;
+    group = (group + step) & _groupMask;
+  }
+
+  return nullptr;
+}
+
 // ============================================================================
 // [asmjit::Zone - Test]
 // ============================================================================
 
 #if defined(ASMJIT_TEST)
+UNIT(base_zoneblockcache) {
+  if (!ZoneBlockCache::isEnabled()) {
+    INFO("ZoneBlockCache is not available");
+    return;
+  }
+
+  ZoneBlockCache::Stats stats;
+  ZoneBlockCache::trim(0);
+  ZoneBlockCache::resetStats();
+
+  INFO("Releasing Zone blocks to the cache");
+  {
+    Zone zone(8192 - Zone::kZoneOverhead);
+    EXPECT(zone.alloc(4000) != nullptr);
+    EXPECT(zone.alloc(4000) != nullptr);
+    EXPECT(zone.alloc(4000) != nullptr);
+  }
+
+  ZoneBlockCache::getStats(&stats);
+  EXPECT(stats.allocCount == 2);
+  EXPECT(stats.hitCount == 0);
+  EXPECT(stats.cachedCount == 2);
+
+  INFO("Reusing cached blocks");
+  {
+    Zone zone(8192 - Zone::kZoneOverhead);
+    EXPECT(zone.alloc(4000) != nullptr);
+
+    // Different block size, can't use cached blocks.
+    Zone other(4096 - Zone::kZoneOverhead);
+    EXPECT(other.alloc(1000) != nullptr);
+
+    ZoneBlockCache::getStats(&stats);
+    EXPECT(stats.allocCount == 3);
+    EXPECT(stats.hitCount == 1);
+    EXPECT(stats.cachedCount == 1);
+  }
+
+  INFO("Checking the limit");
+  size_t limit = ZoneBlockCache::getLimit();
+  ZoneBlockCache::setLimit(0);
+  {
+    Zone zone(1024 - Zone::kZoneOverhead);
+    EXPECT(zone.alloc(64) != nullptr);
+  }
+  ZoneBlockCache::getStats(&stats);
+  EXPECT(stats.cachedCount == 3);
+  ZoneBlockCache::setLimit(limit);
+
+  INFO("Trimming the cache");
+  ZoneBlockCache::trim(0);
+  ZoneBlockCache::getStats(&stats);
+  EXPECT(stats.cachedCount == 0);
+  EXPECT(stats.cachedSize == 0);
+}
+
 UNIT(base_zonevector) {
   Zone zone(8096 - Zone::kZoneOverhead);
   ZoneHeap heap(&zone);
@@ -861,6 +1285,26 @@ UNIT(base_zonevector) {
   EXPECT(vec.isEmpty() == false);
   EXPECT(vec.getLength() == static_cast<size_t>(kMax));
   EXPECT(vec.indexOf(kMax - 1) == static_cast<size_t>(kMax - 1));
+
+  INFO("ZoneVector<int> insert and remove");
+  vec.clear();
+  for (i = 0; i < 8; i++) {
+    EXPECT(vec.append(&heap, i * 2) == kErrorOk);
+  }
+  EXPECT(vec.insert(&heap, 1, 1) == kErrorOk);
+  EXPECT(vec.insert(&heap, 0, -1) == kErrorOk);
+  EXPECT(vec.getLength() == 10);
+  EXPECT(vec[0] == -1);
+  EXPECT(vec[1] == 0);
+  EXPECT(vec[2] == 1);
+  EXPECT(vec[9] == 14);
+
+  vec.removeAt(0);
+  vec.removeAt(1);
+  EXPECT(vec.getLength() == 8);
+  for (i = 0; i < 8; i++) {
+    EXPECT(vec[i] == i * 2);
+  }
 }
 
 UNIT(base_ZoneBitVector) {
@@ -954,6 +1398,77 @@ UNIT(base_zonestack) {
   }
   EXPECT(stack.isEmpty());
 }
+
+class ZoneHashTestKey {
+public:
+  ASMJIT_INLINE ZoneHashTestKey(uint32_t value) noexcept
+    : value(value),
+      hVal(value % 509) {}
+
+  ASMJIT_INLINE bool matches(const ZoneHashNode* node) const noexcept {
+    return node->_customData == value;
+  }
+
+  uint32_t value;
+  uint32_t hVal;
+};
+
+UNIT(base_zoneopenhash) {
+  Zone zone(8096 - Zone::kZoneOverhead);
+  ZoneHeap heap(&zone);
+  ZoneOpenHash<ZoneHashNode> hash(&heap);
+
+  uint32_t i;
+  uint32_t kMax = 20000;
+
+  ZoneHashNode* nodes = static_cast<ZoneHashNode*>(zone.alloc(kMax * sizeof(ZoneHashNode)));
+  EXPECT(nodes != nullptr);
+
+  INFO("ZoneOpenHash<> basic tests");
+  EXPECT(hash.get(ZoneHashTestKey(0)) == nullptr);
+  EXPECT(hash.del(&nodes[0]) == nullptr);
+
+  INFO("Inserting %u nodes (keys have colliding hashes)", kMax);
+  for (i = 0; i < kMax; i++) {
+    ZoneHashNode* node = new(&nodes[i]) ZoneHashNode(ZoneHashTestKey(i).hVal);
+    node->_customData = i;
+    EXPECT(hash.put(node) == node);
+  }
+  EXPECT(hash.getSize() == kMax);
+  EXPECT(hash.getCapacity() >= kMax);
+
+  INFO("Validating get()");
+  for (i = 0; i < kMax; i++)
+    EXPECT(hash.get(ZoneHashTestKey(i)) == &nodes[i], "Node '%u' not found", i);
+  EXPECT(hash.get(ZoneHashTestKey(kMax)) == nullptr);
+
+  INFO("Deleting odd nodes");
+  for (i = 1; i < kMax; i += 2)
+    EXPECT(hash.del(&nodes[i]) == &nodes[i]);
+  EXPECT(hash.del(&nodes[1]) == nullptr);
+  EXPECT(hash.getSize() == kMax / 2);
+
+  for (i = 0; i < kMax; i++) {
+    ZoneHashNode* expected = (i & 1) ? static_cast<ZoneHashNode*>(nullptr) : &nodes[i];
+    EXPECT(hash.get(ZoneHashTestKey(i)) == expected, "Node '%u' doesn't match", i);
+  }
+
+  INFO("Reinserting and deleting nodes repeatedly (reuses deleted slots)");
+  uint32_t capacity = hash.getCapacity();
+  for (uint32_t n = 0; n < 8; n++) {
+    for (i = 1; i < kMax; i += 2) EXPECT(hash.put(&nodes[i]) == &nodes[i]);
+    for (i = 1; i < kMax; i += 2) EXPECT(hash.del(&nodes[i]) == &nodes[i]);
+  }
+  EXPECT(hash.getCapacity() == capacity);
+  EXPECT(hash.getSize() == kMax / 2);
+
+  for (i = 0; i < kMax; i += 2)
+    EXPECT(hash.get(ZoneHashTestKey(i)) == &nodes[i], "Node '%u' not found", i);
+
+  hash.reset(&heap);
+  EXPECT(hash.getSize() == 0);
+  EXPECT(hash.get(ZoneHashTestKey(0)) == nullptr);
+}
 #endif // ASMJIT_TEST
 
 } // asmjit namespace
@@ -11,6 +11,13 @@
 // [Dependencies]
 #include "../base/utils.h"
 
+#if ASMJIT_ARCH_X64 || (ASMJIT_ARCH_X86 && (defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)))
+# include <emmintrin.h>
+# define ASMJIT_ZONE_HAS_SSE2 1
+#else
+# define ASMJIT_ZONE_HAS_SSE2 0
+#endif
+
 // [Api-Begin]
 #include "../asmjit_apibegin.h"
 
@@ -91,6 +98,9 @@ public:
   ASMJIT_INLINE uint32_t getBlockAlignment() const noexcept { return (uint32_t)1 << _blockAlignmentShift; }
   //! Get remaining size of the current block.
   ASMJIT_INLINE size_t getRemainingSize() const noexcept { return (size_t)(_end - _ptr); }
+  //! Get the number of bytes used since the last `reset()`, including unused
+  //! space at the end of all blocks except the current one.
+  ASMJIT_API size_t getUsedSize() const noexcept;
 
   //! Get the current zone cursor (dangerous).
   //!
@@ -235,6 +245,60 @@ public:
 #endif
 };
 
+// ============================================================================
+// [asmjit::ZoneBlockCache]
+// ============================================================================
+
+//! Thread-local cache of `Zone` blocks.
+//!
+//! Blocks released by `Zone::reset(true)` (and `Zone` destructor) are kept by
+//! the calling thread and reused by the next `Zone` of the same block size
+//! that needs a new block, so short-lived zones (each compilation creates
+//! several) don't call the allocator. Only blocks of up to `kMaxBlockSize`
+//! bytes are cached and the cache of each thread is limited by `getLimit()`
+//! bytes, cached blocks are released when the thread exits or by `trim()`.
+//!
+//! The cache is not available if AsmJit was compiled with
+//! `ASMJIT_DISABLE_ZONE_CACHE` or by a compiler without `thread_local`.
+struct ZoneBlockCache {
+  ASMJIT_ENUM(Limits) {
+    //! Maximum size of a cached block (without `Zone::Block` header).
+    kMaxBlockSize = 65536,
+    //! Default per-thread limit of cached bytes.
+    kDefaultLimit = 524288
+  };
+
+  //! Statistics of the calling thread.
+  struct Stats {
+    size_t cachedSize;                   //!< Size of cached blocks (in bytes).
+    size_t cachedCount;                  //!< Count of cached blocks.
+    size_t hitCount;                     //!< Count of blocks provided by the cache.
+    size_t allocCount;                   //!< Count of blocks provided by the allocator.
+  };
+
+  //! Get whether the cache is available and enabled.
+  static ASMJIT_API bool isEnabled() noexcept;
+  //! Enable or disable the cache (process-wide, enabled by default).
+  //!
+  //! Blocks already cached are not released, call `trim()` in threads that
+  //! may have some.
+  static ASMJIT_API void setEnabled(bool enabled) noexcept;
+
+  //! Get the maximum size of blocks cached by a single thread.
+  static ASMJIT_API size_t getLimit() noexcept;
+  //! Set the maximum size of blocks cached by a single thread (process-wide).
+  static ASMJIT_API void setLimit(size_t limit) noexcept;
+
+  //! Release cached blocks of the calling thread until at most `keepSize`
+  //! bytes remain cached. Should be called by threads that become idle.
+  static ASMJIT_API void trim(size_t keepSize = 0) noexcept;
+
+  //! Get statistics of the calling thread.
+  static ASMJIT_API void getStats(Stats* out) noexcept;
+  //! Reset `hitCount` and `allocCount` of the calling thread.
+  static ASMJIT_API void resetStats() noexcept;
+};
+
 // ============================================================================
 // [asmjit::ZoneHeap]
 // ============================================================================
@@ -685,7 +749,7 @@ public:
       ASMJIT_PROPAGATE(grow(heap, 1));
 
     T* dst = static_cast<T*>(_data) + index;
-    ::memmove(dst + 1, dst, _length - index);
+    ::memmove(dst + 1, dst, (_length - index) * sizeof(T));
     ::memcpy(dst, &item, sizeof(T));
 
     _length++;
@@ -774,7 +838,7 @@ public:
 
     T* data = static_cast<T*>(_data) + i;
     _length--;
-    ::memmove(data, data + 1, _length - i);
+    ::memmove(data, data + 1, (_length - i) * sizeof(T));
   }
 
   //! Swap this pod-vector with `other`.
@@ -1318,6 +1382,180 @@ public:
   ASMJIT_INLINE Node* del(Node* node) noexcept { return static_cast<Node*>(_del(node)); }
 };
 
+// ============================================================================
+// [asmjit::ZoneOpenHashBase]
+// ============================================================================
+
+//! Base of \ref ZoneOpenHash<>.
+//!
+//! Open-addressing hash table that stores pointers to nodes in a slot array
+//! and a 7-bit tag of each hash in a separate control byte array. Slots are
+//! probed in groups of `kGroupSize` and the control bytes of a group are
+//! compared at once (by using SSE2 if available), so keys are only compared
+//! with nodes that have the same tag.
+class ZoneOpenHashBase {
+public:
+  ASMJIT_NONCOPYABLE(ZoneOpenHashBase)
+
+  ASMJIT_ENUM(Ctrl) {
+    kGroupSize = 16,                     //!< Number of slots probed at once.
+    kCtrlEmpty = 0x80,                   //!< Slot was never used.
+    kCtrlDeleted = 0xFE                  //!< Slot was used, but the node was deleted.
+  };
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  ASMJIT_INLINE ZoneOpenHashBase(ZoneHeap* heap) noexcept {
+    _heap = heap;
+    _size = 0;
+    _used = 0;
+    _capacity = 0;
+    _groupMask = 0;
+    _growAt = 0;
+    _slots = nullptr;
+    _ctrl = nullptr;
+  }
+  ASMJIT_INLINE ~ZoneOpenHashBase() noexcept { reset(nullptr); }
+
+  // --------------------------------------------------------------------------
+  // [Reset]
+  // --------------------------------------------------------------------------
+
+  ASMJIT_INLINE bool isInitialized() const noexcept { return _heap != nullptr; }
+  ASMJIT_API void reset(ZoneHeap* heap) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  //! Get a `ZoneHeap` attached to this container.
+  ASMJIT_INLINE ZoneHeap* getHeap() const noexcept { return _heap; }
+
+  ASMJIT_INLINE size_t getSize() const noexcept { return _size; }
+  ASMJIT_INLINE uint32_t getCapacity() const noexcept { return _capacity; }
+
+  // --------------------------------------------------------------------------
+  // [Helpers]
+  // --------------------------------------------------------------------------
+
+  //! \internal
+  //!
+  //! Mix `hVal` so both the low bits (group index) and the high bits (tag)
+  //! depend on all its bits.
+  static ASMJIT_INLINE uint32_t _mix(uint32_t hVal) noexcept {
+    hVal ^= hVal >> 16; hVal *= 0x85EBCA6BU;
+    hVal ^= hVal >> 13; hVal *= 0xC2B2AE35U;
+    hVal ^= hVal >> 16;
+    return hVal;
+  }
+
+  //! \internal
+  //!
+  //! Get a mask of control bytes of `group` equal to `ctrl`.
+  static ASMJIT_INLINE uint32_t _match(const uint8_t* group, uint32_t ctrl) noexcept {
+#if ASMJIT_ZONE_HAS_SSE2
+    __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(static_cast<char>(ctrl)))));
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < kGroupSize; i++)
+      mask |= static_cast<uint32_t>(group[i] == ctrl) << i;
+    return mask;
+#endif
+  }
+
+  //! \internal
+  //!
+  //! Get a mask of control bytes of `group` that are empty or deleted.
+  static ASMJIT_INLINE uint32_t _matchFree(const uint8_t* group) noexcept {
+#if ASMJIT_ZONE_HAS_SSE2
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(group))));
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < kGroupSize; i++)
+      mask |= static_cast<uint32_t>(group[i] >> 7) << i;
+    return mask;
+#endif
+  }
+
+  // --------------------------------------------------------------------------
+  // [Ops]
+  // --------------------------------------------------------------------------
+
+  ASMJIT_API bool _rehash(uint32_t newCapacity) noexcept;
+  ASMJIT_API ZoneHashNode* _put(ZoneHashNode* node) noexcept;
+  ASMJIT_API ZoneHashNode* _del(ZoneHashNode* node) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  ZoneHeap* _heap;                       //!< ZoneHeap used to allocate data.
+  size_t _size;                          //!< Count of records inserted into the hash table.
+  uint32_t _used;                        //!< Count of slots that are not empty (records and deleted).
+  uint32_t _capacity;                    //!< Count of slots, a power of 2 and a multiple of `kGroupSize`.
+  uint32_t _groupMask;                   //!< Count of groups minus one.
+  uint32_t _growAt;                      //!< When the table must be rehashed.
+
+  ZoneHashNode** _slots;                 //!< Slots data (also the start of the allocated block).
+  uint8_t* _ctrl;                        //!< Control bytes, one per slot.
+};
+
+// ============================================================================
+// [asmjit::ZoneOpenHash<Node>]
+// ============================================================================
+
+//! Open-addressing variant of \ref ZoneHash<>.
+//!
+//! Provides the same interface and semantics (duplicates are allowed), and
+//! uses the same `Node` and `Key` types, so it can replace `ZoneHash<>` in
+//! places where lookups dominate. The only difference is that `put()` can
+//! fail and return null if the table couldn't grow. `ZoneHashNode::_hashNext`
+//! is not used.
+//!
+//! NOTE: The `_hVal` of a node must be equal to `Key::hVal` of keys that
+//! match it, nodes with a different hash are never passed to `matches()`.
+template<typename Node>
+class ZoneOpenHash : public ZoneOpenHashBase {
+public:
+  explicit ASMJIT_INLINE ZoneOpenHash(ZoneHeap* heap = nullptr) noexcept
+    : ZoneOpenHashBase(heap) {}
+  ASMJIT_INLINE ~ZoneOpenHash() noexcept {}
+
+  template<typename Key>
+  ASMJIT_INLINE Node* get(const Key& key) const noexcept {
+    if (!_size) return nullptr;
+
+    uint32_t hVal = key.hVal;
+    uint32_t hMix = _mix(hVal);
+    uint32_t tag = hMix >> 25;
+    uint32_t group = hMix & _groupMask;
+
+    for (uint32_t step = 1; step <= _groupMask + 1; step++) {
+      const uint8_t* ctrl = _ctrl + group * kGroupSize;
+      uint32_t bits = _match(ctrl, tag);
+
+      while (bits) {
+        Node* node = static_cast<Node*>(_slots[group * kGroupSize + Utils::findFirstBit(bits)]);
+        if (node->_hVal == hVal && key.matches(node))
+          return node;
+        bits &= bits - 1;
+      }
+
+      if (_match(ctrl, kCtrlEmpty))
+        break;
+      group = (group + step) & _groupMask;
+    }
+
+    return nullptr;
+  }
+
+  ASMJIT_INLINE Node* put(Node* node) noexcept { return static_cast<Node*>(_put(node)); }
+  ASMJIT_INLINE Node* del(Node* node) noexcept { return static_cast<Node*>(_del(node)); }
+};
+
 //! \}
 
 } // asmjit namespace
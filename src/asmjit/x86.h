@@ -14,10 +14,16 @@
 #include "./x86/x86assembler.h"
 #include "./x86/x86builder.h"
 #include "./x86/x86compiler.h"
+#include "./x86/x86cse.h"
 #include "./x86/x86emitter.h"
+#include "./x86/x86inline.h"
 #include "./x86/x86inst.h"
+#include "./x86/x86jump.h"
 #include "./x86/x86misc.h"
 #include "./x86/x86operand.h"
+#include "./x86/x86profile.h"
+#include "./x86/x86sched.h"
+#include "./x86/x86stencil.h"
 
 // [Guard]
 #endif // _ASMJIT_X86_H
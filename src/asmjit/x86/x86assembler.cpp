@@ -15,9 +15,11 @@
 #include "../base/cpuinfo.h"
 #include "../base/logging.h"
 #include "../base/misc_p.h"
+#include "../base/runtime.h"
 #include "../base/utils.h"
 #include "../x86/x86assembler.h"
 #include "../x86/x86logging_p.h"
+#include "../x86/x86stencil.h"
 
 // [Api-Begin]
 #include "../asmjit_apibegin.h"
@@ -567,6 +569,7 @@ Error X86Assembler::_emit(uint32_t instId, const Operand_& o0, const Operand_& o
 #if !defined(ASMJIT_DISABLE_VALIDATION)
     if (options & CodeEmitter::kOptionStrictValidation) {
       Operand_ opArray[6];
+      uint32_t opCount = 4;
 
       opArray[0].copyFrom(o0);
       opArray[1].copyFrom(o1);
@@ -576,13 +579,10 @@ Error X86Assembler::_emit(uint32_t instId, const Operand_& o0, const Operand_& o
       if (options & kOptionOp4Op5Used) {
         opArray[4].copyFrom(_op4);
         opArray[5].copyFrom(_op5);
-      }
-      else {
-        opArray[4].reset();
-        opArray[5].reset();
+        opCount = 6;
       }
 
-      err = Inst::validate(getArchType(), Inst::Detail(instId, options, _extraReg), opArray, 6);
+      err = Inst::validate(getArchType(), Inst::Detail(instId, options, _extraReg), opArray, opCount);
       if (ASMJIT_UNLIKELY(err)) goto Failed;
     }
 #endif // !ASMJIT_DISABLE_VALIDATION
@@ -4522,11 +4522,71 @@ Failed:
   return _emitFailed(err, instId, options, o0, o1, o2, o3);
 }
 
+// ============================================================================
+// [asmjit::X86Assembler - Emit Batch]
+// ============================================================================
+
+//! \internal
+//!
+//! Number of records the buffer is reserved for at once by `_emitBatch()`.
+static const size_t kX86BatchChunkSize = 256;
+
+Error X86Assembler::_emitBatch(const Inst::Record* records, size_t count, size_t* failedIndex) {
+  size_t i = 0;
+  Error err = _lastError;
+
+  if (ASMJIT_LIKELY(!err)) {
+    resetInlineComment();
+
+    while (i < count) {
+      // Reserve 16 bytes (more than the longest instruction) for each record
+      // of the chunk, so `_emit()` never has to grow the buffer. A fixed-size
+      // buffer can't grow, `_emit()` reports the record that doesn't fit.
+      size_t end = count - i > kX86BatchChunkSize ? i + kX86BatchChunkSize : count;
+      size_t required = (end - i) * 16;
+
+      if (getRemainingSpace() < required && !_section->_buffer.isFixedSize()) {
+        err = _code->growBuffer(&_section->_buffer, required);
+        if (ASMJIT_UNLIKELY(err)) {
+          setLastError(err);
+          break;
+        }
+      }
+
+      // Called directly, not through the vtable.
+      for (; i < end; i++) {
+        const Inst::Record& record = records[i];
+        const Operand_* op = record.operands;
+
+        _options = record.options;
+        _extraReg.init(record.extraReg);
+
+        if (record.opCount > 4) {
+          _op4 = op[4];
+          _op5 = op[5];
+          _options |= kOptionOp4Op5Used;
+        }
+
+        err = X86Assembler::_emit(record.instId, op[0], op[1], op[2], op[3]);
+        if (ASMJIT_UNLIKELY(err)) goto Done;
+      }
+    }
+  }
+
+Done:
+  if (failedIndex) *failedIndex = i;
+  return err;
+}
+
 // ============================================================================
 // [asmjit::X86Assembler - Align]
 // ============================================================================
 
 Error X86Assembler::align(uint32_t mode, uint32_t alignment) {
+  return _align(mode, alignment, (_globalHints & kHintOptimizedAlign) != 0);
+}
+
+Error X86Assembler::_align(uint32_t mode, uint32_t alignment, bool optimizedNops) {
 #if !defined(ASMJIT_DISABLE_LOGGING)
   if (_globalOptions & kOptionLoggingEnabled)
     _code->_logger->logf("%s.align %u\n", _code->_logger->getIndentation(), alignment);
@@ -4555,7 +4615,7 @@ Error X86Assembler::align(uint32_t mode, uint32_t alignment) {
 
   switch (mode) {
     case kAlignCode: {
-      if (_globalHints & kHintOptimizedAlign) {
+      if (optimizedNops) {
         // Intel 64 and IA-32 Architectures Software Developer's Manual - Volume 2B (NOP).
         enum { kMaxNopSize = 9 };
 
@@ -4604,6 +4664,279 @@ Error X86Assembler::align(uint32_t mode, uint32_t alignment) {
   return kErrorOk;
 }
 
+// ============================================================================
+// [asmjit::X86Assembler - Stencil]
+// ============================================================================
+
+Error X86Assembler::emitStencil(const X86Stencil& stencil, const Operand_* args, uint32_t argCount) {
+  if (_lastError) return _lastError;
+
+  uint32_t i;
+  uint32_t paramCount = stencil.getParamCount();
+
+  if (ASMJIT_UNLIKELY(!stencil.isInitialized() || stencil.getArchType() != getArchType() || argCount != paramCount))
+    return setLastError(DebugUtils::errored(kErrorInvalidArgument));
+
+  // Check arguments first, the stencil is emitted completely or not at all.
+  uint64_t values[X86Stencil::kMaxParams];
+  const uint64_t* regTables[X86Stencil::kMaxParams];
+  uint32_t regIndex = 0;
+
+  for (i = 0; i < paramCount; i++) {
+    const Operand_& arg = args[i];
+
+    switch (stencil._paramTypes[i]) {
+      case X86Stencil::kParamImm32:
+        if (ASMJIT_UNLIKELY(!arg.isImm() || !Utils::isInt32(arg.as<Imm>().getInt64())))
+          return setLastError(DebugUtils::errored(kErrorInvalidImmediate));
+        values[i] = arg.as<Imm>().getUInt64();
+        break;
+
+      case X86Stencil::kParamImm64:
+        if (ASMJIT_UNLIKELY(!arg.isImm()))
+          return setLastError(DebugUtils::errored(kErrorInvalidImmediate));
+        values[i] = arg.as<Imm>().getUInt64();
+        break;
+
+      case X86Stencil::kParamGpd:
+      case X86Stencil::kParamGpq: {
+        uint32_t regType = stencil._paramTypes[i] == X86Stencil::kParamGpd ? X86Reg::kRegGpd : X86Reg::kRegGpq;
+        if (ASMJIT_UNLIKELY(!arg.isReg(regType)))
+          return setLastError(DebugUtils::errored(kErrorInvalidRegType));
+
+        uint32_t id = arg.getId();
+        if (ASMJIT_UNLIKELY(id >= 16 || !(stencil._regMasks[i] & Utils::mask(id))))
+          return setLastError(DebugUtils::errored(kErrorInvalidPhysId));
+
+        regTables[regIndex] = stencil.getRegTable(regIndex, id);
+        regIndex++;
+        break;
+      }
+
+      case X86Stencil::kParamLabel: {
+        LabelEntry* le = arg.isLabel() ? _code->getLabelEntry(arg.getId()) : static_cast<LabelEntry*>(nullptr);
+        if (ASMJIT_UNLIKELY(!le || (le->isBound() && le->getSectionId() != _section->getId())))
+          return setLastError(DebugUtils::errored(kErrorInvalidLabel));
+        values[i] = static_cast<uint64_t>((uintptr_t)le);
+        break;
+      }
+    }
+  }
+
+  // The stencil is copied by 64-bit words, the padding is written after the
+  // end of the stencil, but it's not part of the code. A fixed-size buffer
+  // can't grow, only the stencil itself has to fit, the last word is copied
+  // partially if the padding doesn't.
+  uint32_t size = stencil.getSize();
+  uint32_t wordCount = stencil.getWordCount();
+
+  if (getRemainingSpace() < wordCount * 8) {
+    if (!_section->_buffer.isFixedSize()) {
+      Error err = _code->growBuffer(&_section->_buffer, wordCount * 8);
+      if (ASMJIT_UNLIKELY(err)) return setLastError(err);
+    }
+    else if (getRemainingSpace() < size) {
+      return setLastError(DebugUtils::errored(kErrorCodeTooLarge));
+    }
+  }
+
+  bool isPadded = getRemainingSpace() >= wordCount * 8;
+
+  uint8_t* cursor = _bufferPtr;
+  size_t pos = (size_t)(cursor - _bufferData);
+  const uint64_t* words = reinterpret_cast<const uint64_t*>(stencil.getData());
+
+  // Register fields are OR-ed by words, independently of the register type.
+  for (i = 0; i < wordCount; i++) {
+    uint64_t word = words[i];
+    for (uint32_t j = 0; j < regIndex; j++)
+      word |= regTables[j][i];
+
+    if (ASMJIT_LIKELY(isPadded || (i + 1) * 8 <= size)) {
+      Utils::writeU64u(cursor + i * 8, word);
+    }
+    else {
+      uint8_t tail[8];
+      Utils::writeU64u(tail, word);
+      ::memcpy(cursor + i * 8, tail, size - i * 8);
+    }
+  }
+
+  const X86Stencil::Patch* patches = stencil.getPatches();
+  uint32_t patchCount = stencil.getPatchCount();
+
+  for (i = 0; i < patchCount; i++) {
+    const X86Stencil::Patch& patch = patches[i];
+    uint64_t value = values[patch.param];
+    uint8_t* p = cursor + patch.offset;
+
+    switch (patch.type) {
+      case X86Stencil::Patch::kTypeImm32:
+        Utils::writeU32uLE(p, static_cast<uint32_t>(value & 0xFFFFFFFFU));
+        break;
+
+      case X86Stencil::Patch::kTypeImm64:
+        Utils::writeU64uLE(p, value);
+        break;
+
+      case X86Stencil::Patch::kTypeRel32: {
+        LabelEntry* le = reinterpret_cast<LabelEntry*>((uintptr_t)value);
+        size_t offset = pos + patch.offset;
+
+        if (le->isBound()) {
+          int32_t rel32 = static_cast<int32_t>(le->getOffset() - static_cast<intptr_t>(offset) + patch.rel);
+          Utils::writeI32uLE(p, rel32);
+        }
+        else {
+          // Keep the placeholder, it's patched by `bind()`.
+          LabelLink* link = _code->newLabelLink(le, _section->getId(), offset, patch.rel);
+          if (ASMJIT_UNLIKELY(!link))
+            return setLastError(DebugUtils::errored(kErrorNoHeapMemory));
+        }
+        break;
+      }
+    }
+  }
+
+  _bufferPtr = cursor + size;
+
+#if !defined(ASMJIT_DISABLE_LOGGING)
+  if (_globalOptions & kOptionLoggingEnabled)
+    _code->_logger->logBinary(cursor, size);
+#endif // !ASMJIT_DISABLE_LOGGING
+
+  return kErrorOk;
+}
+
+// ============================================================================
+// [asmjit::X86Assembler - Test]
+// ============================================================================
+
+#if defined(ASMJIT_TEST)
+UNIT(x86_assembler_emit_batch) {
+  using namespace x86;
+
+  // Enough records to reserve the buffer multiple times.
+  const size_t kCount = 1000;
+  Inst::Record* records = static_cast<Inst::Record*>(Internal::allocMemory(kCount * sizeof(Inst::Record)));
+  EXPECT(records != nullptr, "Out of memory");
+
+  CodeHolder code0, code1;
+  code0.init(CodeInfo(ArchInfo::kTypeX64));
+  code1.init(CodeInfo(ArchInfo::kTypeX64));
+
+  X86Assembler a0(&code0);
+  X86Assembler a1(&code1);
+
+  Label L0 = a0.newLabel();
+  Label L1 = a1.newLabel();
+
+  a0.bind(L0);
+  a1.bind(L1);
+
+  size_t i;
+  for (i = 0; i < kCount; i++) {
+    Inst::Record& record = records[i];
+    switch (i % 6) {
+      case 0: record.init(X86Inst::kIdMov, rax, imm(static_cast<int64_t>(i) << 40)); break;
+      case 1: record.init(X86Inst::kIdAdd, ecx, dword_ptr(rsi, rdi, 2, static_cast<int32_t>(i))); break;
+      case 2: record.init(X86Inst::kIdVpaddd, ymm1, ymm2, ymm3); break;
+      case 3: record.init(X86Inst::kIdImul, r8, r9, imm(100)); break;
+      case 4: record.init(X86Inst::kIdMovs, byte_ptr(rdi), byte_ptr(rsi)); record.options = X86Inst::kOptionRep; break;
+      case 5: record.init(X86Inst::kIdJnz, L1); break;
+    }
+
+    // Labels have the same id in both code holders.
+    const Operand_* op = record.operands;
+    a0.setOptions(record.options);
+    a0.emit(record.instId, op[0], op[1], op[2], op[3]);
+  }
+
+  INFO("Checking X86Assembler::emitBatch() output");
+  {
+    size_t failedIndex = 0;
+    EXPECT(a1.emitBatch(records, kCount, &failedIndex) == kErrorOk,
+      "X86Assembler::emitBatch() failed");
+    EXPECT(failedIndex == kCount,
+      "X86Assembler::emitBatch() returned failedIndex %u instead of %u", unsigned(failedIndex), unsigned(kCount));
+
+    code0.sync();
+    code1.sync();
+
+    const CodeBuffer& b0 = code0.getSectionEntry(0)->getBuffer();
+    const CodeBuffer& b1 = code1.getSectionEntry(0)->getBuffer();
+
+    EXPECT(b0.getLength() == b1.getLength() && ::memcmp(b0.getData(), b1.getData(), b0.getLength()) == 0,
+      "X86Assembler::emitBatch() output doesn't match X86Assembler::emit()");
+  }
+
+  INFO("Checking X86Assembler::emitBatch() with a fixed-size buffer");
+  {
+    // Records that fit are emitted even if the reservation of the whole chunk
+    // doesn't fit, the first record that doesn't fit fails.
+    JitRuntime rt;
+    const CodeBuffer& b0 = code0.getSectionEntry(0)->getBuffer();
+
+    for (uint32_t size = 64; size <= 1024; size *= 16) {
+      CodeHolder code;
+      code.init(CodeInfo(ArchInfo::kTypeX64));
+      EXPECT(rt.reserve(&code, size) == kErrorOk,
+        "JitRuntime::reserve() failed");
+
+      X86Assembler a(&code);
+      Label L = a.newLabel();
+      a.bind(L);
+
+      size_t failedIndex = 0;
+      Error err = a.emitBatch(records, 100, &failedIndex);
+
+      if (size == 64) {
+        EXPECT(err == kErrorCodeTooLarge && failedIndex > 0 && failedIndex < 100,
+          "X86Assembler::emitBatch() returned %u and failedIndex %u", err, unsigned(failedIndex));
+      }
+      else {
+        EXPECT(err == kErrorOk && failedIndex == 100,
+          "X86Assembler::emitBatch() returned %u and failedIndex %u", err, unsigned(failedIndex));
+      }
+
+      code.sync();
+      const CodeBuffer& b = code.getSectionEntry(0)->getBuffer();
+      EXPECT(b.getLength() > 0 && ::memcmp(b.getData(), b0.getData(), b.getLength()) == 0,
+        "X86Assembler::emitBatch() output doesn't match X86Assembler::emit()");
+
+      rt.unreserve(&code);
+    }
+  }
+
+  INFO("Checking X86Assembler::emitBatch() failure");
+  {
+    // Invalid instruction (`mov` of two memory operands) at index 3.
+    records[3].init(X86Inst::kIdMov, qword_ptr(rax), qword_ptr(rbx));
+
+    CodeHolder code;
+    code.init(CodeInfo(ArchInfo::kTypeX64));
+
+    X86Assembler a(&code);
+    Label L = a.newLabel();
+    a.bind(L);
+
+    size_t failedIndex = 0;
+    Error err = a.emitBatch(records, kCount, &failedIndex);
+
+    EXPECT(err != kErrorOk,
+      "X86Assembler::emitBatch() must fail");
+    EXPECT(failedIndex == 3,
+      "X86Assembler::emitBatch() returned failedIndex %u instead of 3", unsigned(failedIndex));
+
+    // The emitter is in error state, nothing is emitted.
+    EXPECT(a.emitBatch(records, 1, &failedIndex) == err && failedIndex == 0,
+      "X86Assembler::emitBatch() must return the last error");
+  }
+
+  Internal::releaseMemory(records);
+}
+#endif // ASMJIT_TEST
+
 } // asmjit namespace
 
 // [Api-End]
@@ -19,6 +19,12 @@
 
 namespace asmjit {
 
+// ============================================================================
+// [Forward Declarations]
+// ============================================================================
+
+class X86Stencil;
+
 //! \addtogroup asmjit_x86
 //! \{
 
@@ -82,7 +88,26 @@ public:
   using CodeEmitter::_emit;
 
   ASMJIT_API Error _emit(uint32_t instId, const Operand_& o0, const Operand_& o1, const Operand_& o2, const Operand_& o3) override;
+  ASMJIT_API Error _emitBatch(const Inst::Record* records, size_t count, size_t* failedIndex) override;
   ASMJIT_API Error align(uint32_t mode, uint32_t alignment) override;
+
+  //! \internal
+  //!
+  //! Align the code, `optimizedNops` overrides `kHintOptimizedAlign`, which
+  //! is used by the code layout that always pads by multi-byte NOPs.
+  ASMJIT_API Error _align(uint32_t mode, uint32_t alignment, bool optimizedNops);
+
+  // --------------------------------------------------------------------------
+  // [Stencil]
+  // --------------------------------------------------------------------------
+
+  //! Emit `stencil` with `args` by copying its bytes and patching them.
+  //!
+  //! The `args` must match the parameter types of the stencil. Register ids
+  //! must be allowed by `X86Stencil::getRegMask()`. Instruction options, the
+  //! strict validation, and the branch alignment hint are not used, and the
+  //! stencil is logged as binary data.
+  ASMJIT_API Error emitStencil(const X86Stencil& stencil, const Operand_* args, uint32_t argCount);
 };
 
 //! \}
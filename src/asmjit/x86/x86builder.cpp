@@ -13,6 +13,7 @@
 
 // [Dependencies]
 #include "../x86/x86builder.h"
+#include "../x86/x86internal_p.h"
 
 // [Api-Begin]
 #include "../asmjit_apibegin.h"
@@ -48,6 +49,14 @@ Error X86Builder::onAttach(CodeHolder* code) noexcept {
   return kErrorOk;
 }
 
+// ============================================================================
+// [asmjit::X86Builder - Serialization]
+// ============================================================================
+
+Error X86Builder::serialize(CodeEmitter* dst) {
+  return X86Internal::serialize(this, dst);
+}
+
 // ============================================================================
 // [asmjit::X86Builder - Inst]
 // ============================================================================
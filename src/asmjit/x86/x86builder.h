@@ -67,6 +67,14 @@ public:
 
   ASMJIT_API virtual Error onAttach(CodeHolder* code) noexcept override;
 
+  // --------------------------------------------------------------------------
+  // [Serialization]
+  // --------------------------------------------------------------------------
+
+  //! Serialize all nodes to `dst`, aligns loops and branches if `dst` is an
+  //! `X86Assembler` that has `kHintAlignLoops` or `kHintAlignBranches` set.
+  ASMJIT_API virtual Error serialize(CodeEmitter* dst) override;
+
   // --------------------------------------------------------------------------
   // [Code-Generation]
   // --------------------------------------------------------------------------
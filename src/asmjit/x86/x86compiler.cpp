@@ -14,6 +14,7 @@
 // [Dependencies]
 #include "../base/utils.h"
 #include "../x86/x86compiler.h"
+#include "../x86/x86internal_p.h"
 #include "../x86/x86regalloc_p.h"
 
 // [Api-Begin]
@@ -53,39 +54,83 @@ Error X86Compiler::onAttach(CodeHolder* code) noexcept {
 }
 
 // ============================================================================
-// [asmjit::X86Compiler - Finalize]
+// [asmjit::X86Compiler - Serialization]
 // ============================================================================
 
-Error X86Compiler::finalize() {
-  if (_lastError) return _lastError;
+Error X86Compiler::serialize(CodeEmitter* dst) {
+  return X86Internal::serialize(this, dst);
+}
 
-  // Flush the global constant pool.
-  if (_globalConstPool) {
-    addNode(_globalConstPool);
-    _globalConstPool = nullptr;
-  }
+// ============================================================================
+// [asmjit::X86Compiler - Finalize]
+// ============================================================================
 
+//! \internal
+//!
+//! Run all passes and serialize all nodes into the attached assembler or into
+//! a temporary one.
+static Error X86Compiler_processAndSerialize(X86Compiler* self) {
   Error err = kErrorOk;
-  ZoneVector<CBPass*>& passes = _cbPasses;
+  ZoneVector<CBPass*>& passes = self->_cbPasses;
 
   for (size_t i = 0, len = passes.getLength(); i < len; i++) {
     CBPass* pass = passes[i];
-    err = pass->process(&_cbPassZone);
-    _cbPassZone.reset();
+    err = pass->process(&self->_cbPassZone);
+    self->_cbPassZone.reset();
     if (err) break;
   }
 
-  _cbPassZone.reset();
-  if (ASMJIT_UNLIKELY(err)) return setLastError(err);
+  self->_cbPassZone.reset();
+  if (ASMJIT_UNLIKELY(err)) return self->setLastError(err);
 
   // TODO: There must be possibility to attach more assemblers, this is not so nice.
-  if (_code->_cgAsm) {
-    return serialize(_code->_cgAsm);
+  CodeHolder* code = self->getCode();
+  if (code->_cgAsm) {
+    err = self->serialize(code->_cgAsm);
   }
   else {
-    X86Assembler a(_code);
-    return serialize(&a);
+    X86Assembler a(code);
+    err = self->serialize(&a);
   }
+
+  if (ASMJIT_UNLIKELY(err)) return self->setLastError(err);
+  return kErrorOk;
+}
+
+Error X86Compiler::flush() {
+  if (_lastError) return _lastError;
+  if (_func) return setLastError(DebugUtils::errored(kErrorInvalidState));
+
+  // Nodes are released even on failure, passes must not see them again.
+  Error err = X86Compiler_processAndSerialize(this);
+
+  _releaseNodes();
+  _vRegArray.clear();
+  _vRegZone.reset(false);
+
+  // The global constant pool is not a node in the list, keep its label.
+  if (_globalConstPool)
+    _cbLabels[Operand::unpackId(_globalConstPool->getId())] = _globalConstPool;
+
+  return err;
+}
+
+Error X86Compiler::finalize() {
+  if (_lastError) return _lastError;
+
+  // Flush the global constant pool.
+  if (_globalConstPool) {
+    addNode(_globalConstPool);
+    _globalConstPool = nullptr;
+  }
+
+  // Nothing left if all functions were flushed in streaming mode.
+  Error err = kErrorOk;
+  if (getFirstNode())
+    err = X86Compiler_processAndSerialize(this);
+
+  if (!err) _finalized = true;
+  return err;
 }
 
 // ============================================================================
@@ -150,7 +195,7 @@ Error X86Compiler::_emit(uint32_t instId, const Operand_& o0, const Operand_& o1
 
   // decide between `CBInst` and `CBJump`.
   if (isJumpInst(instId)) {
-    CBJump* node = _cbHeap.allocT<CBJump>(sizeof(CBJump) + opCount * sizeof(Operand));
+    CBJump* node = static_cast<CBJump*>(_newNodeMem(sizeof(CBJump) + opCount * sizeof(Operand)));
     Operand* opArray = reinterpret_cast<Operand*>(reinterpret_cast<uint8_t*>(node) + sizeof(CBJump));
 
     if (ASMJIT_UNLIKELY(!node))
@@ -202,7 +247,7 @@ Error X86Compiler::_emit(uint32_t instId, const Operand_& o0, const Operand_& o1
     return kErrorOk;
   }
   else {
-    CBInst* node = _cbHeap.allocT<CBInst>(sizeof(CBInst) + opCount * sizeof(Operand));
+    CBInst* node = static_cast<CBInst*>(_newNodeMem(sizeof(CBInst) + opCount * sizeof(Operand)));
     Operand* opArray = reinterpret_cast<Operand*>(reinterpret_cast<uint8_t*>(node) + sizeof(CBInst));
 
     if (ASMJIT_UNLIKELY(!node))
@@ -286,7 +331,7 @@ Error X86Compiler::_emit(uint32_t instId, const Operand_& o0, const Operand_& o1
 
   // decide between `CBInst` and `CBJump`.
   if (isJumpInst(instId)) {
-    CBJump* node = _cbHeap.allocT<CBJump>(sizeof(CBJump) + opCount * sizeof(Operand));
+    CBJump* node = static_cast<CBJump*>(_newNodeMem(sizeof(CBJump) + opCount * sizeof(Operand)));
     Operand* opArray = reinterpret_cast<Operand*>(reinterpret_cast<uint8_t*>(node) + sizeof(CBJump));
 
     if (ASMJIT_UNLIKELY(!node))
@@ -340,7 +385,7 @@ Error X86Compiler::_emit(uint32_t instId, const Operand_& o0, const Operand_& o1
     return kErrorOk;
   }
   else {
-    CBInst* node = _cbHeap.allocT<CBInst>(sizeof(CBInst) + opCount * sizeof(Operand));
+    CBInst* node = static_cast<CBInst*>(_newNodeMem(sizeof(CBInst) + opCount * sizeof(Operand)));
     Operand* opArray = reinterpret_cast<Operand*>(reinterpret_cast<uint8_t*>(node) + sizeof(CBInst));
 
     if (ASMJIT_UNLIKELY(!node))
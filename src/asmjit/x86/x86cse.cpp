@@ -0,0 +1,549 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Export]
+#define ASMJIT_EXPORTS
+
+// [Guard]
+#include "../asmjit_build.h"
+#if defined(ASMJIT_BUILD_X86) && !defined(ASMJIT_DISABLE_COMPILER)
+
+// [Dependencies]
+#include "../base/utils.h"
+#include "../x86/x86cse.h"
+#include "../x86/x86inst.h"
+#include "../x86/x86operand.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+// ============================================================================
+// [asmjit::X86CsePass - Data]
+// ============================================================================
+
+enum {
+  //! Maximum number of operands of `CBInst` (including `CBInstEx`).
+  kX86CseMaxOps = 6,
+
+  //! Status flags that an eliminated instruction may write.
+  kX86CseFlagsMask = x86::kSpecialReg_FLAGS_CF | x86::kSpecialReg_FLAGS_PF |
+                     x86::kSpecialReg_FLAGS_AF | x86::kSpecialReg_FLAGS_ZF |
+                     x86::kSpecialReg_FLAGS_SF | x86::kSpecialReg_FLAGS_OF,
+
+  //! Options that prevent an instruction from being eliminated.
+  kX86CseOptionsMask = X86Inst::kOptionLock     | X86Inst::kOptionRep       |
+                       X86Inst::kOptionRepnz    | X86Inst::kOptionXAcquire  |
+                       X86Inst::kOptionXRelease
+};
+
+//! \internal
+//!
+//! Instruction and its inputs, register ids are replaced by value numbers.
+struct X86CseData {
+  uint32_t instId;                       //!< Instruction id.
+  uint32_t options;                      //!< Instruction options.
+  uint32_t opCount;                      //!< Number of operands.
+  uint32_t memVersion;                   //!< Memory version if the instruction loads, zero otherwise.
+  Operand_ opArray[kX86CseMaxOps];       //!< Operands (first operand only has a value number if it's read).
+};
+
+//! \internal
+//!
+//! Value computed by an instruction in the current basic block.
+class X86CseEntry : public ZoneHashNode {
+public:
+  ASMJIT_INLINE X86CseEntry(uint32_t hVal, const X86CseData& data, uint32_t vn, uint32_t holderId) noexcept
+    : ZoneHashNode(hVal),
+      _data(data),
+      _vn(vn),
+      _holderId(holderId) {}
+
+  X86CseData _data;                      //!< Instruction and its inputs.
+  uint32_t _vn;                          //!< Value number of the result.
+  uint32_t _holderId;                    //!< Virtual register that received the result.
+};
+
+//! \internal
+struct X86CseKey {
+  ASMJIT_INLINE X86CseKey(const X86CseData& data) noexcept : data(data) {
+    const uint32_t* p = reinterpret_cast<const uint32_t*>(&data);
+    uint32_t h = 0;
+
+    for (size_t i = 0; i < sizeof(X86CseData) / sizeof(uint32_t); i++)
+      h = Utils::hashRound(h, p[i]);
+    hVal = h;
+  }
+
+  ASMJIT_INLINE bool matches(const X86CseEntry* entry) const noexcept {
+    return entry->_hVal == hVal && ::memcmp(&data, &entry->_data, sizeof(X86CseData)) == 0;
+  }
+
+  uint32_t hVal;
+  const X86CseData& data;
+};
+
+//! \internal
+//!
+//! State of the value numbering.
+//!
+//! Value numbers are never reused, a virtual register that didn't receive a
+//! value number in the current block gets a new one when it's first used, so
+//! starting a new block doesn't require clearing anything.
+struct X86CseState {
+  ASMJIT_INLINE X86CseState(ZoneHeap* heap) noexcept
+    : hash(heap),
+      vnArray(nullptr),
+      blockArray(nullptr),
+      vRegCount(0),
+      blockId(1),
+      vnCount(0),
+      memVersion(1) {}
+
+  ASMJIT_INLINE bool isTracked(const Operand_& op) const noexcept {
+    return op.isReg() && Operand::isPackedId(op.getId()) && Operand::unpackId(op.getId()) < vRegCount;
+  }
+
+  ASMJIT_INLINE bool isTrackedId(uint32_t id) const noexcept {
+    return Operand::isPackedId(id) && Operand::unpackId(id) < vRegCount;
+  }
+
+  ASMJIT_INLINE uint32_t getVn(uint32_t id) noexcept {
+    uint32_t index = Operand::unpackId(id);
+    if (blockArray[index] != blockId) {
+      blockArray[index] = blockId;
+      vnArray[index] = ++vnCount;
+    }
+    return vnArray[index];
+  }
+
+  ASMJIT_INLINE void setVn(uint32_t id, uint32_t vn) noexcept {
+    uint32_t index = Operand::unpackId(id);
+    blockArray[index] = blockId;
+    vnArray[index] = vn;
+  }
+
+  ASMJIT_INLINE void kill(uint32_t id) noexcept {
+    if (isTrackedId(id))
+      setVn(id, ++vnCount);
+  }
+
+  ASMJIT_INLINE void newBlock() noexcept {
+    blockId++;
+    memVersion++;
+  }
+
+  ZoneOpenHash<X86CseEntry> hash;        //!< Values computed in the current block.
+  uint32_t* vnArray;                     //!< Value number of each virtual register.
+  uint32_t* blockArray;                  //!< Block where the value number was assigned.
+  uint32_t vRegCount;                    //!< Count of virtual registers.
+  uint32_t blockId;                      //!< Current block.
+  uint32_t vnCount;                      //!< Last value number.
+  uint32_t memVersion;                   //!< Incremented each time memory is (or may be) written.
+};
+
+// ============================================================================
+// [asmjit::X86CsePass - Analysis]
+// ============================================================================
+
+static ASMJIT_INLINE bool X86CsePass_isMoveId(uint32_t instId) noexcept {
+  switch (instId) {
+    case X86Inst::kIdMov:
+    case X86Inst::kIdMovaps:
+    case X86Inst::kIdMovapd:
+    case X86Inst::kIdMovdqa:
+    case X86Inst::kIdMovups:
+    case X86Inst::kIdMovupd:
+    case X86Inst::kIdMovdqu:
+    case X86Inst::kIdVmovaps:
+    case X86Inst::kIdVmovapd:
+    case X86Inst::kIdVmovdqa:
+    case X86Inst::kIdVmovups:
+    case X86Inst::kIdVmovupd:
+    case X86Inst::kIdVmovdqu:
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+//! \internal
+//!
+//! Get whether `inst` is a move of a whole virtual register to another one.
+static bool X86CsePass_isCopy(X86CseState& s, CodeCompiler* cc, const CBInst* inst) noexcept {
+  if (!X86CsePass_isMoveId(inst->getInstId()) || inst->getOpCount() != 2 || inst->hasExtraReg())
+    return false;
+
+  const Operand* opArray = inst->getOpArray();
+  if (!s.isTracked(opArray[0]) || !s.isTracked(opArray[1]))
+    return false;
+
+  const Reg& dst = opArray[0].as<Reg>();
+  const Reg& src = opArray[1].as<Reg>();
+
+  return dst.getSignature() == src.getSignature() &&
+         cc->getVirtRegById(dst.getId())->getSize() == dst.getSize() &&
+         cc->getVirtRegById(src.getId())->getSize() == src.getSize();
+}
+
+//! \internal
+//!
+//! Get whether a legacy SSE instruction may preserve some bits of its
+//! destination. These are scalar operations, which have a scalar memory
+//! form like `xmm, xmm/m32`, so the operand signatures are checked.
+static bool X86CsePass_mayMerge(const X86Inst::CommonData& commonData) noexcept {
+#if !defined(ASMJIT_DISABLE_VALIDATION)
+  const X86Inst::ISignature* iSig = commonData.getISignatureData();
+  const X86Inst::ISignature* iEnd = commonData.getISignatureEnd();
+
+  const uint32_t kScalarMem = X86Inst::kMemOpM8  | X86Inst::kMemOpM16 |
+                              X86Inst::kMemOpM32 | X86Inst::kMemOpM64 ;
+
+  for (; iSig != iEnd; iSig++) {
+    for (uint32_t i = 1; i < iSig->opCount; i++) {
+      const X86Inst::OSignature& oSig = X86InstDB::oSignatureData[iSig->operands[i]];
+      if ((oSig.flags & X86Inst::kOpMem) && (oSig.memFlags & kScalarMem))
+        return true;
+    }
+  }
+
+  return false;
+#else
+  return true;
+#endif // ASMJIT_DISABLE_VALIDATION
+}
+
+//! \internal
+//!
+//! Build a key of `inst` if it's an instruction that can be eliminated.
+//!
+//! Returns flags written by the instruction in `flagsOut`.
+static bool X86CsePass_makeKey(X86CseState& s, CodeCompiler* cc, const CBInst* inst, X86CseData& data, uint32_t& flagsOut) noexcept {
+  uint32_t instId = inst->getInstId();
+  uint32_t opCount = inst->getOpCount();
+
+  if (!X86Inst::isDefinedId(instId) || opCount == 0 || opCount > kX86CseMaxOps)
+    return false;
+
+  if (inst->hasFlag(CBNode::kFlagIsJmp | CBNode::kFlagIsJcc) || inst->hasExtraReg())
+    return false;
+
+  const X86Inst& x86Inst = X86Inst::getInst(instId);
+  const X86Inst::CommonData& commonData = x86Inst.getCommonData();
+  const X86Inst::OperationData& operationData = x86Inst.getOperationData();
+
+  // The instruction must write the first operand, and nothing else.
+  if (!commonData.isUseW() && !commonData.isUseX())
+    return false;
+
+  if (commonData.hasFlag(X86Inst::kFlagUseA  | X86Inst::kFlagUseXX |
+                         X86Inst::kFlagFixedRM | X86Inst::kFlagFpu  |
+                         X86Inst::kFlagVsib  | X86Inst::kFlagMib))
+    return false;
+
+  if (operationData.isVolatile() || operationData.isBarrier() || operationData.isPrefetch())
+    return false;
+
+  if (operationData.getSpecialRegsR() != 0 || (operationData.getSpecialRegsW() & ~kX86CseFlagsMask) != 0)
+    return false;
+
+  uint32_t options = inst->getOptions() & ~CodeEmitter::kOptionReservedMask;
+  if (options & kX86CseOptionsMask)
+    return false;
+
+  const Operand* opArray = inst->getOpArray();
+  const Operand& dst = opArray[0];
+
+  if (!s.isTracked(dst))
+    return false;
+
+  uint32_t dstType = dst.as<Reg>().getType();
+  bool isVec = dstType == X86Reg::kRegXmm || dstType == X86Reg::kRegYmm || dstType == X86Reg::kRegZmm;
+
+  if (!isVec && dstType != X86Reg::kRegGpd && dstType != X86Reg::kRegGpq)
+    return false;
+
+  ::memset(&data, 0, sizeof(X86CseData));
+  data.instId = instId;
+  data.options = options;
+  data.opCount = opCount;
+
+  // Legacy SSE instructions preserve bits of the destination they don't write
+  // (upper lanes of scalar operations and upper halves of YMM|ZMM registers),
+  // in that case the previous value of the destination is an input as well.
+  bool readsDst = commonData.isUseX();
+  if (isVec && !commonData.isVexOrEvex())
+    readsDst |= cc->getVirtRegById(dst.getId())->getSize() > dst.getSize() || X86CsePass_mayMerge(commonData);
+
+  data.opArray[0]._any.signature = dst._any.signature;
+  if (readsDst)
+    data.opArray[0]._any.id = s.getVn(dst.getId());
+
+  for (uint32_t i = 1; i < opCount; i++) {
+    const Operand& op = opArray[i];
+    Operand_& out = data.opArray[i];
+
+    if (op.isReg()) {
+      if (!s.isTracked(op))
+        return false;
+
+      out._any.signature = op._any.signature;
+      out._any.id = s.getVn(op.getId());
+    }
+    else if (op.isMem()) {
+      const X86Mem& mem = op.as<X86Mem>();
+      if (mem.isRegHome() || mem.hasSegment())
+        return false;
+
+      out.copyFrom(op);
+      if (mem.hasBaseReg()) {
+        if (!s.isTrackedId(mem.getBaseId()))
+          return false;
+        out._mem.base = s.getVn(mem.getBaseId());
+      }
+
+      if (mem.hasIndexReg()) {
+        if (!s.isTrackedId(mem.getIndexId()))
+          return false;
+        out._mem.index = s.getVn(mem.getIndexId());
+      }
+
+      if (instId != X86Inst::kIdLea)
+        data.memVersion = s.memVersion;
+    }
+    else {
+      out.copyFrom(op);
+    }
+  }
+
+  flagsOut = operationData.getSpecialRegsW();
+  return true;
+}
+
+//! \internal
+//!
+//! Get whether `flags` written by `node` are overwritten before being read.
+static bool X86CsePass_areFlagsDead(CBNode* node, uint32_t flags) noexcept {
+  while (flags) {
+    node = node->getNext();
+    if (!node) return false;
+
+    if (node->getType() == CBNode::kNodeComment)
+      continue;
+
+    if (node->getType() != CBNode::kNodeInst)
+      return false;
+
+    CBInst* inst = node->as<CBInst>();
+    uint32_t instId = inst->getInstId();
+
+    if (!X86Inst::isDefinedId(instId) || inst->hasFlag(CBNode::kFlagIsJmp | CBNode::kFlagIsJcc))
+      return false;
+
+    const X86Inst::OperationData& operationData = X86Inst::getInst(instId).getOperationData();
+    if (operationData.getSpecialRegsR() & flags)
+      return false;
+
+    flags &= ~operationData.getSpecialRegsW();
+  }
+
+  return true;
+}
+
+//! \internal
+//!
+//! Update the state after `inst` that can't be eliminated.
+static void X86CsePass_clobber(X86CseState& s, const CBInst* inst) noexcept {
+  uint32_t instId = inst->getInstId();
+  uint32_t opCount = inst->getOpCount();
+  const Operand* opArray = inst->getOpArray();
+
+  bool precise = false;
+  bool writesMem = true;
+
+  if (X86Inst::isDefinedId(instId)) {
+    const X86Inst& x86Inst = X86Inst::getInst(instId);
+    const X86Inst::CommonData& commonData = x86Inst.getCommonData();
+    const X86Inst::OperationData& operationData = x86Inst.getOperationData();
+
+    // Only the first operand is written if the instruction says so and there
+    // are no implicit operands.
+    precise = !commonData.hasFlag(X86Inst::kFlagUseA  | X86Inst::kFlagUseXX |
+                                  X86Inst::kFlagFixedRM | X86Inst::kFlagVsib |
+                                  X86Inst::kFlagMib) &&
+              !operationData.isVolatile() && !inst->hasExtraReg();
+
+    writesMem = !precise || x86Inst.isFpu() || operationData.isBarrier() ||
+                (opCount > 0 && opArray[0].isMem() && !commonData.isUseR()) ||
+                (inst->getOptions() & X86Inst::kOptionLock) != 0;
+  }
+
+  if (writesMem)
+    s.memVersion++;
+
+  if (precise) {
+    const X86Inst::CommonData& commonData = X86Inst::getInst(instId).getCommonData();
+    if (opCount > 0 && !commonData.isUseR() && opArray[0].isReg())
+      s.kill(opArray[0].getId());
+    return;
+  }
+
+  for (uint32_t i = 0; i < opCount; i++) {
+    const Operand& op = opArray[i];
+    if (op.isReg()) {
+      s.kill(op.getId());
+    }
+    else if (op.isMem()) {
+      const X86Mem& mem = op.as<X86Mem>();
+      if (mem.hasBaseReg()) s.kill(mem.getBaseId());
+      if (mem.hasIndexReg()) s.kill(mem.getIndexId());
+    }
+  }
+
+  if (inst->hasExtraReg())
+    s.kill(inst->getExtraReg().getId());
+}
+
+// ============================================================================
+// [asmjit::X86CsePass - Construction / Destruction]
+// ============================================================================
+
+X86CsePass::X86CsePass() noexcept
+  : CBPass("X86CsePass"),
+    _removedCount(0),
+    _replacedCount(0) {}
+X86CsePass::~X86CsePass() noexcept {}
+
+// ============================================================================
+// [asmjit::X86CsePass - Interface]
+// ============================================================================
+
+Error X86CsePass::process(Zone* zone) noexcept {
+  _removedCount = 0;
+  _replacedCount = 0;
+
+  CodeCompiler* cc = static_cast<CodeCompiler*>(_cb);
+  uint32_t vRegCount = static_cast<uint32_t>(cc->getVirtRegArray().getLength());
+  if (!vRegCount) return kErrorOk;
+
+  ZoneHeap heap(zone);
+  X86CseState s(&heap);
+
+  s.vnArray = zone->allocT<uint32_t>(vRegCount * sizeof(uint32_t));
+  s.blockArray = zone->allocZeroedT<uint32_t>(vRegCount * sizeof(uint32_t));
+  s.vRegCount = vRegCount;
+
+  if (ASMJIT_UNLIKELY(!s.vnArray || !s.blockArray))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  X86CseData data;
+  CBNode* node_ = cc->getFirstNode();
+
+  while (node_) {
+    CBNode* next = node_->getNext();
+    uint32_t nodeType = node_->getType();
+
+    if (nodeType == CBNode::kNodeComment) {
+      node_ = next;
+      continue;
+    }
+
+    // Labels, calls, function boundaries, and hints end the block.
+    if (nodeType != CBNode::kNodeInst) {
+      s.newBlock();
+      node_ = next;
+      continue;
+    }
+
+    CBInst* inst = node_->as<CBInst>();
+    Operand* opArray = inst->getOpArray();
+    uint32_t flags = 0;
+
+    if (X86CsePass_isCopy(s, cc, inst)) {
+      uint32_t vn = s.getVn(opArray[1].getId());
+      if (s.getVn(opArray[0].getId()) == vn) {
+        cc->removeNode(inst);
+        _removedCount++;
+      }
+      else {
+        s.setVn(opArray[0].getId(), vn);
+      }
+    }
+    else if (X86CsePass_makeKey(s, cc, inst, data, flags)) {
+      X86CseKey key(data);
+      X86CseEntry* entry = s.hash.get(key);
+      uint32_t dstId = opArray[0].getId();
+
+      if (entry && s.getVn(entry->_holderId) == entry->_vn) {
+        uint32_t vn = entry->_vn;
+
+        // The instruction must stay if it computes flags that are consumed.
+        if (flags && !X86CsePass_areFlagsDead(inst, flags)) {
+          // Nothing to do, the result is still the same value.
+        }
+        else if (s.getVn(dstId) == vn) {
+          cc->removeNode(inst);
+          _removedCount++;
+        }
+        else {
+          uint32_t dstType = opArray[0].as<Reg>().getType();
+          uint32_t moveId = X86Inst::kIdMov;
+
+          if (dstType != X86Reg::kRegGpd && dstType != X86Reg::kRegGpq)
+            moveId = X86Inst::getInst(inst->getInstId()).getCommonData().isVexOrEvex() ? X86Inst::kIdVmovaps : X86Inst::kIdMovaps;
+
+          opArray[1].copyFrom(opArray[0]);
+          opArray[1].as<Reg>().setId(entry->_holderId);
+
+          inst->setInstId(moveId);
+          inst->setOpCount(2);
+          inst->andOptions(CodeEmitter::kOptionReservedMask);
+          inst->_updateMemOp();
+          _replacedCount++;
+        }
+
+        s.setVn(dstId, vn);
+      }
+      else {
+        uint32_t vn = ++s.vnCount;
+        s.setVn(dstId, vn);
+
+        if (entry) {
+          // The register that held the value was overwritten.
+          entry->_vn = vn;
+          entry->_holderId = dstId;
+        }
+        else {
+          entry = zone->allocT<X86CseEntry>();
+          if (ASMJIT_UNLIKELY(!entry))
+            return DebugUtils::errored(kErrorNoHeapMemory);
+          s.hash.put(new(entry) X86CseEntry(key.hVal, data, vn, dstId));
+        }
+      }
+    }
+    else {
+      X86CsePass_clobber(s, inst);
+    }
+
+    // Jumps end the block.
+    if (inst->hasFlag(CBNode::kFlagIsJmp | CBNode::kFlagIsJcc))
+      s.newBlock();
+
+    node_ = next;
+  }
+
+  return kErrorOk;
+}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // ASMJIT_BUILD_X86 && !ASMJIT_DISABLE_COMPILER
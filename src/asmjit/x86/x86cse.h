@@ -0,0 +1,96 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _ASMJIT_X86_X86CSE_H
+#define _ASMJIT_X86_X86CSE_H
+
+#include "../asmjit_build.h"
+#if !defined(ASMJIT_DISABLE_COMPILER)
+
+// [Dependencies]
+#include "../base/codecompiler.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+//! \addtogroup asmjit_x86
+//! \{
+
+// ============================================================================
+// [asmjit::X86CsePass]
+// ============================================================================
+
+//! X86/X64 local value numbering (common subexpression elimination).
+//!
+//! Assigns a value number to each virtual register within a basic block and
+//! finds instructions that compute a value that is already available in
+//! another virtual register - for example the same `lea` address computation
+//! or the same `vpshufb` of the same inputs. Such instruction is replaced by a
+//! register move (or removed if its destination already holds the value).
+//!
+//! Only instructions that write their first operand and have no other side
+//! effects are considered (no volatile, barrier, memory writing, fixed register,
+//! and flags reading instructions). Loads are only eliminated if no memory was
+//! written in between, and instructions that write flags are only eliminated if
+//! the flags are overwritten before they are read.
+//!
+//! The pass works on virtual registers, so it must run before the register
+//! allocator that `X86Compiler` adds when attached:
+//!
+//! ~~~
+//! X86Compiler cc(&code);
+//! cc.insertPass(0, cc.newPassT<X86CsePass>());
+//! ~~~
+class ASMJIT_VIRTAPI X86CsePass : public CBPass {
+public:
+  ASMJIT_NONCOPYABLE(X86CsePass)
+  typedef CBPass Base;
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  //! Create a new `X86CsePass` instance.
+  ASMJIT_API X86CsePass() noexcept;
+  //! Destroy the `X86CsePass` instance.
+  ASMJIT_API virtual ~X86CsePass() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  ASMJIT_API virtual Error process(Zone* zone) noexcept override;
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  //! Get number of instructions removed by the last `process()`.
+  ASMJIT_INLINE uint32_t getRemovedCount() const noexcept { return _removedCount; }
+  //! Get number of instructions replaced by a move by the last `process()`.
+  ASMJIT_INLINE uint32_t getReplacedCount() const noexcept { return _replacedCount; }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  uint32_t _removedCount;                //!< Number of removed instructions.
+  uint32_t _replacedCount;               //!< Number of instructions replaced by a move.
+};
+
+//! \}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // !ASMJIT_DISABLE_COMPILER
+#endif // _ASMJIT_X86_X86CSE_H
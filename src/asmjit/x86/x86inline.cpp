@@ -0,0 +1,425 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Export]
+#define ASMJIT_EXPORTS
+
+// [Guard]
+#include "../asmjit_build.h"
+#if defined(ASMJIT_BUILD_X86) && !defined(ASMJIT_DISABLE_COMPILER)
+
+// [Dependencies]
+#include "../x86/x86compiler.h"
+#include "../x86/x86inline.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+// ============================================================================
+// [asmjit::X86InlineMap]
+// ============================================================================
+
+enum {
+  kX86InlineMaxIterations = 4            //!< Maximum number of iterations over all nodes.
+};
+
+//! \internal
+//!
+//! Maps virtual registers and labels of the callee to the copy.
+struct X86InlineMap {
+  uint32_t* vRegMap;                     //!< New virtual register ids (indexed by unpacked id) or zero.
+  uint32_t vRegCount;                    //!< Number of virtual registers when the map was created.
+
+  uint32_t* labelMap;                    //!< Pairs of callee label id and new label id.
+  uint32_t labelCount;                   //!< Number of pairs in `labelMap`.
+};
+
+// ============================================================================
+// [asmjit::X86InlinePass - Helpers]
+// ============================================================================
+
+//! \internal
+//!
+//! Get the move instruction that copies `src` to `dst` or `kInvalidValue`.
+static uint32_t X86InlinePass_getMoveId(const Operand& dst, const Operand& src) noexcept {
+  if (!dst.isReg()) return kInvalidValue;
+
+  const Reg& dReg = dst.as<Reg>();
+  if (dReg.getKind() == X86Reg::kKindGp) {
+    if (src.isImm()) return X86Inst::kIdMov;
+
+    // The source is read in the size of `dst`, it can't be smaller.
+    if (src.isReg() && src.as<Reg>().getKind() == X86Reg::kKindGp && src.getSize() >= dReg.getSize())
+      return X86Inst::kIdMov;
+
+    return kInvalidValue;
+  }
+
+  if (!src.isReg() || src.as<Reg>().getType() != dReg.getType())
+    return kInvalidValue;
+
+  switch (dReg.getType()) {
+    case X86Reg::kRegXmm: return X86Inst::kIdMovaps;
+    case X86Reg::kRegYmm: return X86Inst::kIdVmovaps;
+    case X86Reg::kRegZmm: return X86Inst::kIdVmovaps;
+    default:
+      return kInvalidValue;
+  }
+}
+
+//! \internal
+//!
+//! Get whether a virtual register `id` used by the callee can be copied.
+static ASMJIT_INLINE bool X86InlinePass_isCopyable(X86Compiler* cc, uint32_t id) noexcept {
+  if (!Operand::isPackedId(id)) return true;
+  if (!cc->isVirtRegValid(id)) return false;
+
+  VirtReg* vreg = cc->getVirtRegById(id);
+  return !vreg->isStack() && !vreg->isFixed();
+}
+
+//! \internal
+//!
+//! Get the callee of `call` if it can be inlined into `caller`, or null.
+static CCFunc* X86InlinePass_getCallee(X86Compiler* cc, CCFunc* caller, CCFuncCall* call, uint32_t maxSize) noexcept {
+  const Operand& target = call->getTarget();
+  if (!target.isLabel()) return nullptr;
+
+  CBLabel* node = nullptr;
+  if (cc->getCBLabel(&node, target.getId()) != kErrorOk || node->getType() != CBNode::kNodeFunc)
+    return nullptr;
+
+  CCFunc* callee = node->as<CCFunc>();
+  if (callee == caller || !callee->_isFinished)
+    return nullptr;
+
+  // Arguments and the return value must be copyable by a single move.
+  uint32_t argCount = callee->getArgCount();
+  if (call->getDetail().getArgCount() != argCount || callee->getRetCount() > 1)
+    return nullptr;
+
+  for (uint32_t i = 0; i < argCount; i++) {
+    if (call->getDetail().hasArg(i + kFuncArgHi))
+      return nullptr;
+
+    VirtReg* vreg = callee->getArg(i);
+    if (!vreg) continue;
+
+    Reg dst = Reg::fromSignature(vreg->getSignature(), vreg->getId());
+    if (X86InlinePass_getMoveId(dst, call->getArg(i)) == kInvalidValue)
+      return nullptr;
+  }
+
+  if (!call->getRet(1).isNone())
+    return nullptr;
+
+  // Only straight code without calls, data, and hints can be copied.
+  uint32_t size = 0;
+  CBNode* stop = callee->getExitNode();
+
+  for (CBNode* node_ = callee->getNext(); node_ != stop; node_ = node_->getNext()) {
+    if (!node_) return nullptr;
+
+    switch (node_->getType()) {
+      case CBNode::kNodeLabel:
+      case CBNode::kNodeComment:
+        break;
+
+      case CBNode::kNodeInst: {
+        CBInst* inst = node_->as<CBInst>();
+        const Operand* opArray = inst->getOpArray();
+
+        for (uint32_t i = 0, opCount = inst->getOpCount(); i < opCount; i++) {
+          const Operand& op = opArray[i];
+          if (op.isReg() && !X86InlinePass_isCopyable(cc, op.getId()))
+            return nullptr;
+
+          if (op.isMem()) {
+            const Mem& mem = op.as<Mem>();
+            if (mem.hasBaseReg() && !X86InlinePass_isCopyable(cc, mem.getBaseId()))
+              return nullptr;
+            if (mem.hasIndexReg() && !X86InlinePass_isCopyable(cc, mem.getIndexId()))
+              return nullptr;
+          }
+        }
+
+        if (inst->hasExtraReg() && !X86InlinePass_isCopyable(cc, inst->getExtraReg().getId()))
+          return nullptr;
+
+        size++;
+        break;
+      }
+
+      case CBNode::kNodeFuncExit: {
+        CCFuncRet* ret = node_->as<CCFuncRet>();
+        if (!ret->getSecond().isNone())
+          return nullptr;
+
+        const Operand& src = ret->getFirst();
+        if (!call->getRet(0).isNone() && !src.isNone()) {
+          if (src.isReg() && !X86InlinePass_isCopyable(cc, src.getId()))
+            return nullptr;
+          if (X86InlinePass_getMoveId(call->getRet(0), src) == kInvalidValue)
+            return nullptr;
+        }
+
+        size++;
+        break;
+      }
+
+      default:
+        return nullptr;
+    }
+  }
+
+  return size <= maxSize ? callee : nullptr;
+}
+
+//! \internal
+//!
+//! Get the id of the copy of a virtual register `id`.
+static uint32_t X86InlinePass_mapVirtReg(X86Compiler* cc, X86InlineMap& map, uint32_t id) noexcept {
+  if (!Operand::isPackedId(id)) return id;
+
+  uint32_t index = Operand::unpackId(id);
+  ASMJIT_ASSERT(index < map.vRegCount);
+
+  if (!map.vRegMap[index]) {
+    VirtReg* src = cc->getVirtRegById(id);
+    VirtReg* dst = cc->newVirtReg(src->getTypeId(), src->getSignature(), src->getName());
+    if (ASMJIT_UNLIKELY(!dst)) return id;
+    map.vRegMap[index] = dst->getId();
+  }
+
+  return map.vRegMap[index];
+}
+
+//! \internal
+//!
+//! Get the id of the copy of a label `id`, or `id` if the label is not local.
+static uint32_t X86InlinePass_mapLabel(const X86InlineMap& map, uint32_t id) noexcept {
+  for (uint32_t i = 0; i < map.labelCount; i++)
+    if (map.labelMap[i * 2] == id)
+      return map.labelMap[i * 2 + 1];
+  return id;
+}
+
+//! \internal
+//!
+//! Replace virtual registers and labels of `op` by their copies.
+static void X86InlinePass_mapOperand(X86Compiler* cc, X86InlineMap& map, Operand& op) noexcept {
+  if (op.isReg()) {
+    op.as<Reg>().setId(X86InlinePass_mapVirtReg(cc, map, op.getId()));
+  }
+  else if (op.isMem()) {
+    Mem& mem = op.as<Mem>();
+    if (mem.hasBaseReg())
+      mem._setBase(mem.getBaseType(), X86InlinePass_mapVirtReg(cc, map, mem.getBaseId()));
+    else if (mem.hasBaseLabel())
+      mem._setBase(mem.getBaseType(), X86InlinePass_mapLabel(map, mem.getBaseId()));
+
+    if (mem.hasIndexReg())
+      mem._setIndex(mem.getIndexType(), X86InlinePass_mapVirtReg(cc, map, mem.getIndexId()));
+  }
+  else if (op.isLabel()) {
+    op.as<Label>().setId(X86InlinePass_mapLabel(map, op.getId()));
+  }
+}
+
+//! \internal
+//!
+//! Emit a move of `src` to `dst`, `src` is read in the size of `dst`.
+static void X86InlinePass_emitMove(X86Compiler* cc, const Operand& dst, const Operand& src) noexcept {
+  uint32_t instId = X86InlinePass_getMoveId(dst, src);
+  ASMJIT_ASSERT(instId != kInvalidValue);
+
+  if (src.isReg())
+    cc->emit(instId, dst, Reg::fromSignature(dst.getSignature(), src.getId()));
+  else
+    cc->emit(instId, dst, src);
+}
+
+//! \internal
+//!
+//! Get whether only labels and comments are between `node` and `stop`.
+static bool X86InlinePass_isLast(CBNode* node, CBNode* stop) noexcept {
+  for (node = node->getNext(); node != stop; node = node->getNext())
+    if (node->getType() != CBNode::kNodeLabel && node->getType() != CBNode::kNodeComment)
+      return false;
+  return true;
+}
+
+//! \internal
+//!
+//! Replace `call` by a copy of `callee`.
+static Error X86InlinePass_inline(X86Compiler* cc, ZoneHeap* heap, CCFuncCall* call, CCFunc* callee) noexcept {
+  CBNode* stop = callee->getExitNode();
+
+  // Create the maps, labels are created upfront as jumps can go forward.
+  X86InlineMap map;
+  map.vRegCount = static_cast<uint32_t>(cc->getVirtRegArray().getLength());
+  map.labelCount = 1;
+
+  for (CBNode* node = callee->getNext(); node != stop; node = node->getNext())
+    map.labelCount += node->getType() == CBNode::kNodeLabel;
+
+  map.vRegMap = static_cast<uint32_t*>(heap->alloc(map.vRegCount * sizeof(uint32_t)));
+  map.labelMap = static_cast<uint32_t*>(heap->alloc(map.labelCount * 2 * sizeof(uint32_t)));
+
+  if (ASMJIT_UNLIKELY(!map.vRegMap || !map.labelMap)) {
+    if (map.vRegMap) heap->release(map.vRegMap, map.vRegCount * sizeof(uint32_t));
+    if (map.labelMap) heap->release(map.labelMap, map.labelCount * 2 * sizeof(uint32_t));
+    return DebugUtils::errored(kErrorNoHeapMemory);
+  }
+
+  ::memset(map.vRegMap, 0, map.vRegCount * sizeof(uint32_t));
+
+  // The exit label of the callee is mapped to the end of the copy.
+  uint32_t i = 0;
+  map.labelMap[i * 2] = stop->as<CBLabel>()->getId();
+  map.labelMap[i * 2 + 1] = cc->newLabel().getId();
+
+  for (CBNode* node = callee->getNext(); node != stop; node = node->getNext()) {
+    if (node->getType() != CBNode::kNodeLabel) continue;
+    i++;
+    map.labelMap[i * 2] = node->as<CBLabel>()->getId();
+    map.labelMap[i * 2 + 1] = cc->newLabel().getId();
+  }
+
+  Label exitLabel(map.labelMap[1]);
+  cc->_setCursor(call->getPrev());
+
+  // Pass arguments.
+  for (i = 0; i < callee->getArgCount(); i++) {
+    VirtReg* vreg = callee->getArg(i);
+    if (!vreg) continue;
+
+    Reg dst = Reg::fromSignature(vreg->getSignature(), X86InlinePass_mapVirtReg(cc, map, vreg->getId()));
+    X86InlinePass_emitMove(cc, dst, call->getArg(i));
+  }
+
+  // Copy the body.
+  for (CBNode* node = callee->getNext(); node != stop; node = node->getNext()) {
+    switch (node->getType()) {
+      case CBNode::kNodeLabel: {
+        cc->bind(Label(X86InlinePass_mapLabel(map, node->as<CBLabel>()->getId())));
+        break;
+      }
+
+      case CBNode::kNodeInst: {
+        CBInst* inst = node->as<CBInst>();
+        Operand opArray[6];
+
+        uint32_t opCount = inst->getOpCount();
+        for (i = 0; i < opCount; i++) {
+          opArray[i].copyFrom(inst->getOpArray()[i]);
+          X86InlinePass_mapOperand(cc, map, opArray[i]);
+        }
+
+        if (inst->hasExtraReg()) {
+          RegOnly extraReg(inst->getExtraReg());
+          extraReg._id = X86InlinePass_mapVirtReg(cc, map, extraReg.getId());
+          cc->setExtraReg(extraReg);
+        }
+
+        cc->setOptions(inst->getOptions() & ~(CodeEmitter::kOptionReservedMask | CodeEmitter::kOptionOp4Op5Used));
+        cc->setInlineComment(inst->getInlineComment());
+        cc->emit(inst->getInstId(), opArray[0], opArray[1], opArray[2], opArray[3], opArray[4], opArray[5]);
+        break;
+      }
+
+      case CBNode::kNodeFuncExit: {
+        CCFuncRet* ret = node->as<CCFuncRet>();
+        Operand src(ret->getFirst());
+
+        if (!call->getRet(0).isNone() && !src.isNone()) {
+          X86InlinePass_mapOperand(cc, map, src);
+          X86InlinePass_emitMove(cc, call->getRet(0), src);
+        }
+
+        if (!X86InlinePass_isLast(node, stop))
+          cc->jmp(exitLabel);
+        break;
+      }
+
+      default:
+        break;
+    }
+  }
+
+  cc->bind(exitLabel);
+
+  heap->release(map.vRegMap, map.vRegCount * sizeof(uint32_t));
+  heap->release(map.labelMap, map.labelCount * 2 * sizeof(uint32_t));
+
+  ASMJIT_PROPAGATE(cc->getLastError());
+  cc->removeNode(call);
+  return kErrorOk;
+}
+
+// ============================================================================
+// [asmjit::X86InlinePass - Construction / Destruction]
+// ============================================================================
+
+X86InlinePass::X86InlinePass() noexcept
+  : CBPass("X86InlinePass"),
+    _maxSize(kDefaultMaxSize),
+    _inlinedCount(0) {}
+X86InlinePass::~X86InlinePass() noexcept {}
+
+// ============================================================================
+// [asmjit::X86InlinePass - Interface]
+// ============================================================================
+
+Error X86InlinePass::process(Zone* zone) noexcept {
+  _inlinedCount = 0;
+
+  X86Compiler* cc = static_cast<X86Compiler*>(_cb);
+  ZoneHeap heap(zone);
+  CBNode* oldCursor = cc->getCursor();
+
+  for (uint32_t iteration = 0; iteration < kX86InlineMaxIterations; iteration++) {
+    bool changed = false;
+    CCFunc* caller = nullptr;
+
+    CBNode* node_ = cc->getFirstNode();
+    while (node_) {
+      CBNode* next = node_->getNext();
+
+      if (node_->getType() == CBNode::kNodeFunc) {
+        caller = node_->as<CCFunc>();
+      }
+      else if (node_->getType() == CBNode::kNodeFuncCall && caller) {
+        CCFuncCall* call = node_->as<CCFuncCall>();
+        CCFunc* callee = X86InlinePass_getCallee(cc, caller, call, _maxSize);
+
+        if (callee) {
+          ASMJIT_PROPAGATE(X86InlinePass_inline(cc, &heap, call, callee));
+          _inlinedCount++;
+          changed = true;
+        }
+      }
+
+      node_ = next;
+    }
+
+    if (!changed)
+      break;
+  }
+
+  cc->_setCursor(oldCursor);
+  return kErrorOk;
+}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // ASMJIT_BUILD_X86 && !ASMJIT_DISABLE_COMPILER
@@ -0,0 +1,104 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _ASMJIT_X86_X86INLINE_H
+#define _ASMJIT_X86_X86INLINE_H
+
+#include "../asmjit_build.h"
+#if !defined(ASMJIT_DISABLE_COMPILER)
+
+// [Dependencies]
+#include "../base/codecompiler.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+//! \addtogroup asmjit_x86
+//! \{
+
+// ============================================================================
+// [asmjit::X86InlinePass]
+// ============================================================================
+
+//! X86/X64 inlining of small functions.
+//!
+//! Replaces a `CCFuncCall` to a function defined by the same compiler with a
+//! copy of its body if the function has at most `getMaxSize()` instructions.
+//! Virtual registers of the callee are replaced by new virtual registers and
+//! its labels by new labels, arguments and the return value are passed by
+//! register moves, and each `ret` becomes a jump to the end of the copy.
+//!
+//! Only functions that don't call other functions and that use only register
+//! and immediate arguments and return values are inlined. Functions that call
+//! other functions become candidates once their calls were inlined (the pass
+//! repeats until nothing changes). The callee is kept, as it can be called by
+//! other means (its label can be used as a function pointer).
+//!
+//! The pass works on virtual registers, so it must run before the register
+//! allocator that `X86Compiler` adds when attached:
+//!
+//! ~~~
+//! X86Compiler cc(&code);
+//! cc.insertPass(0, cc.newPassT<X86InlinePass>());
+//! ~~~
+class ASMJIT_VIRTAPI X86InlinePass : public CBPass {
+public:
+  ASMJIT_NONCOPYABLE(X86InlinePass)
+  typedef CBPass Base;
+
+  //! Default maximum number of instructions of an inlined function.
+  ASMJIT_ENUM(Limits) {
+    kDefaultMaxSize = 32
+  };
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  //! Create a new `X86InlinePass` instance.
+  ASMJIT_API X86InlinePass() noexcept;
+  //! Destroy the `X86InlinePass` instance.
+  ASMJIT_API virtual ~X86InlinePass() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  ASMJIT_API virtual Error process(Zone* zone) noexcept override;
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  //! Get the maximum number of instructions of an inlined function.
+  ASMJIT_INLINE uint32_t getMaxSize() const noexcept { return _maxSize; }
+  //! Set the maximum number of instructions of an inlined function.
+  ASMJIT_INLINE void setMaxSize(uint32_t maxSize) noexcept { _maxSize = maxSize; }
+
+  //! Get number of calls inlined by the last `process()`.
+  ASMJIT_INLINE uint32_t getInlinedCount() const noexcept { return _inlinedCount; }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  uint32_t _maxSize;                     //!< Maximum number of instructions of an inlined function.
+  uint32_t _inlinedCount;                //!< Number of inlined calls.
+};
+
+//! \}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // !ASMJIT_DISABLE_COMPILER
+#endif // _ASMJIT_X86_X86INLINE_H
@@ -19,7 +19,7 @@
 namespace asmjit {
 
 // ============================================================================
-// [asmjit::X86InstImpl - Validate]
+// [asmjit::X86InstImpl - Validate - Data]
 // ============================================================================
 
 #if !defined(ASMJIT_DISABLE_VALIDATION)
@@ -146,7 +146,569 @@ static ASMJIT_INLINE bool x86CheckOSig(const X86Inst::OSignature& op, const X86I
   return true;
 }
 
-ASMJIT_FAVOR_SIZE Error X86InstImpl::validate(uint32_t archType, const Inst::Detail& detail, const Operand_* operands, uint32_t count) noexcept {
+// ============================================================================
+// [asmjit::X86InstImpl - Validate - Operand Classes]
+// ============================================================================
+
+//! \internal
+//!
+//! Operand class.
+//!
+//! Operands of the same class are translated to the same `X86Inst::OSignature`
+//! except the register mask and memory addressing flags. Each instruction has
+//! a precomputed table of signatures that accept a class at each position, so
+//! matching all signatures of an instruction takes a single AND per operand.
+enum X86OpClass {
+  kX86OpClassNone       = 0,                                   //!< No operand.
+  kX86OpClassVm         = 1,                                   //!< Vector memory (never matched by class).
+  kX86OpClassReg        = 2,                                   //!< Register (+ register type).
+  kX86OpClassMem        = kX86OpClassReg + X86Reg::kRegCount,  //!< Memory (+ size index).
+  kX86OpClassImm        = kX86OpClassMem + 10,                 //!< Immediate (+ range index).
+  kX86OpClassLabel      = kX86OpClassImm + 13,                 //!< Label.
+  kX86OpClassCount      = kX86OpClassLabel + 1                 //!< Count of operand classes.
+};
+
+//! \internal
+//!
+//! Memory flags of a memory operand class.
+static const uint16_t _x86MemFlagsFromSizeIndex[10] = {
+  X86Inst::kMemOpAny , X86Inst::kMemOpM8  , X86Inst::kMemOpM16 , X86Inst::kMemOpM32 ,
+  X86Inst::kMemOpM48 , X86Inst::kMemOpM64 , X86Inst::kMemOpM80 , X86Inst::kMemOpM128,
+  X86Inst::kMemOpM256, X86Inst::kMemOpM512
+};
+
+//! \internal
+//!
+//! Operand flags of an immediate operand class.
+static const uint32_t _x86ImmFlagsFromRangeIndex[13] = {
+  // Positive values.
+  X86Inst::kOpU4 | X86Inst::kOpI8 | X86Inst::kOpU8 | X86Inst::kOpI16 | X86Inst::kOpU16 | X86Inst::kOpI32 | X86Inst::kOpU32 | X86Inst::kOpI64 | X86Inst::kOpU64, // [0x0, 0xF]
+  X86Inst::kOpI8 | X86Inst::kOpU8 | X86Inst::kOpI16 | X86Inst::kOpU16 | X86Inst::kOpI32 | X86Inst::kOpU32 | X86Inst::kOpI64 | X86Inst::kOpU64,                 // [0x10, 0x7F]
+  X86Inst::kOpU8 | X86Inst::kOpI16 | X86Inst::kOpU16 | X86Inst::kOpI32 | X86Inst::kOpU32 | X86Inst::kOpI64 | X86Inst::kOpU64,                                  // [0x80, 0xFF]
+  X86Inst::kOpI16 | X86Inst::kOpU16 | X86Inst::kOpI32 | X86Inst::kOpU32 | X86Inst::kOpI64 | X86Inst::kOpU64,                                                   // [0x100, 0x7FFF]
+  X86Inst::kOpU16 | X86Inst::kOpI32 | X86Inst::kOpU32 | X86Inst::kOpI64 | X86Inst::kOpU64,                                                                     // [0x8000, 0xFFFF]
+  X86Inst::kOpI32 | X86Inst::kOpU32 | X86Inst::kOpI64 | X86Inst::kOpU64,                                                                                       // [0x10000, 0x7FFFFFFF]
+  X86Inst::kOpU32 | X86Inst::kOpI64 | X86Inst::kOpU64,                                                                                                         // [0x80000000, 0xFFFFFFFF]
+  X86Inst::kOpI64 | X86Inst::kOpU64,                                                                                                                           // [0x100000000, 0x7FFFFFFFFFFFFFFF]
+  X86Inst::kOpU64,                                                                                                                                             // [0x8000000000000000, 0xFFFFFFFFFFFFFFFF]
+
+  // Negative values.
+  X86Inst::kOpI8 | X86Inst::kOpI16 | X86Inst::kOpI32 | X86Inst::kOpI64,                                                                                       // [-0x80, -1]
+  X86Inst::kOpI16 | X86Inst::kOpI32 | X86Inst::kOpI64,                                                                                                         // [-0x8000, -0x81]
+  X86Inst::kOpI32 | X86Inst::kOpI64,                                                                                                                           // [-0x80000000, -0x8001]
+  X86Inst::kOpI64                                                                                                                                              // [..., -0x80000001]
+};
+
+//! \internal
+//!
+//! Get a mask of operand classes accepted by `ref`.
+//!
+//! Each class is checked by an operand that has no register id and no memory
+//! addressing flags, which is accepted by `ref` only if all operands of the
+//! class are.
+static uint64_t x86GetOpClassMask(const X86Inst::OSignature& ref) noexcept {
+  uint64_t mask = 0;
+
+  for (uint32_t opClass = kX86OpClassReg; opClass < kX86OpClassCount; opClass++) {
+    X86Inst::OSignature op;
+    op.flags = 0;
+    op.memFlags = 0;
+    op.extFlags = 0;
+    op.regMask = 0;
+
+    if (opClass < kX86OpClassMem) {
+      op.flags = _x86OpFlagFromRegType[opClass - kX86OpClassReg];
+    }
+    else if (opClass < kX86OpClassImm) {
+      op.flags = X86Inst::kOpMem;
+      op.memFlags = _x86MemFlagsFromSizeIndex[opClass - kX86OpClassMem];
+    }
+    else if (opClass < kX86OpClassLabel) {
+      op.flags = _x86ImmFlagsFromRangeIndex[opClass - kX86OpClassImm];
+    }
+    else {
+      op.flags = X86Inst::kOpRel8 | X86Inst::kOpRel32;
+    }
+
+    bool immOutOfRange = false;
+    if (x86CheckOSig(op, ref, immOutOfRange) && !immOutOfRange)
+      mask |= uint64_t(1) << opClass;
+  }
+
+  return mask;
+}
+
+//! \internal
+//!
+//! Signature tables of all instructions.
+//!
+//! Each `X86Inst::ISignature` forms one or two rows (the second one without
+//! implicit operands). Instructions sharing the same signatures share a table
+//! that contains:
+//!
+//!   - `[0]` - Rows available in 32-bit mode.
+//!   - `[1]` - Rows available in 64-bit mode.
+//!   - `[2]` - Maximum count of operands (`N`).
+//!   - `[3]` - Reserved.
+//!   - `N * kX86OpClassCount` - Rows that accept an operand class at each
+//!     position, `kX86OpClassNone` is accepted by rows having less operands.
+//!
+//! Instructions that have more than 16 rows don't have a table.
+struct X86SignatureTables {
+  enum {
+    kMaxRows = 16,
+    kHeaderSize = 4
+  };
+
+  X86SignatureTables() noexcept;
+  ~X86SignatureTables() noexcept;
+
+  //! Get rows of signatures from `iSig` to `iEnd`, returns `kInvalidValue` if
+  //! there are too many.
+  static uint32_t getRows(const X86Inst::ISignature* iSig, const X86Inst::ISignature* iEnd, uint8_t* rowSig, uint8_t* rowCount, uint32_t& maxCount) noexcept;
+
+  ASMJIT_INLINE const uint16_t* get(uint32_t instId) const noexcept {
+    uint32_t offset = _offsets ? _offsets[instId] : kInvalidValue;
+    return offset != kInvalidValue ? _data + offset : nullptr;
+  }
+
+  uint32_t* _offsets;                    //!< Offset of the table of each instruction.
+  uint16_t* _data;                       //!< Data of all tables.
+};
+
+uint32_t X86SignatureTables::getRows(const X86Inst::ISignature* iSig, const X86Inst::ISignature* iEnd, uint8_t* rowSig, uint8_t* rowCount, uint32_t& maxCount) noexcept {
+  uint32_t n = 0;
+  maxCount = 0;
+
+  for (uint32_t i = 0; iSig != iEnd; iSig++, i++) {
+    if (n + 1 + (iSig->implicit != 0) > kMaxRows)
+      return kInvalidValue;
+
+    rowSig[n] = static_cast<uint8_t>(i);
+    rowCount[n++] = iSig->opCount;
+
+    if (maxCount < iSig->opCount)
+      maxCount = iSig->opCount;
+
+    if (iSig->implicit) {
+      rowSig[n] = static_cast<uint8_t>(i);
+      rowCount[n++] = static_cast<uint8_t>(iSig->opCount - iSig->implicit);
+    }
+  }
+  return n;
+}
+
+X86SignatureTables::X86SignatureTables() noexcept
+  : _offsets(nullptr),
+    _data(nullptr) {
+
+  // Tables are shared by instructions that start at the same `ISignature`,
+  // `tableIndex` points to the instruction that has the table. Signatures
+  // past its end are never shared, which only costs memory.
+  uint32_t tableIndex[1024];
+  bool isOwner[X86Inst::_kIdCount];
+
+  for (uint32_t i = 0; i < ASMJIT_ARRAY_SIZE(tableIndex); i++)
+    tableIndex[i] = kInvalidValue;
+
+  uint32_t* offsets = static_cast<uint32_t*>(Internal::allocMemory(X86Inst::_kIdCount * sizeof(uint32_t)));
+  if (ASMJIT_UNLIKELY(!offsets)) return;
+
+  uint8_t rowSig[kMaxRows];
+  uint8_t rowCount[kMaxRows];
+
+  uint32_t instId;
+  uint32_t dataSize = 0;
+
+  for (instId = 0; instId < X86Inst::_kIdCount; instId++) {
+    const X86Inst::CommonData& commonData = X86InstDB::instData[instId].getCommonData();
+    uint32_t index = commonData.getISignatureIndex();
+    uint32_t count = commonData.getISignatureCount();
+
+    offsets[instId] = kInvalidValue;
+    isOwner[instId] = false;
+    if (!count) continue;
+
+    bool isIndexed = index < ASMJIT_ARRAY_SIZE(tableIndex);
+    ASMJIT_ASSERT(isIndexed);
+
+    uint32_t other = isIndexed ? tableIndex[index] : kInvalidValue;
+    if (other != kInvalidValue && X86InstDB::instData[other].getCommonData().getISignatureCount() == count) {
+      offsets[instId] = offsets[other];
+      continue;
+    }
+
+    uint32_t maxCount;
+    uint32_t rows = getRows(commonData.getISignatureData(), commonData.getISignatureEnd(), rowSig, rowCount, maxCount);
+    if (rows == kInvalidValue) continue;
+
+    offsets[instId] = dataSize;
+    isOwner[instId] = true;
+    if (other == kInvalidValue && isIndexed)
+      tableIndex[index] = instId;
+    dataSize += kHeaderSize + maxCount * kX86OpClassCount;
+  }
+
+  uint16_t* data = static_cast<uint16_t*>(Internal::allocMemory(dataSize * sizeof(uint16_t)));
+  if (ASMJIT_UNLIKELY(!data)) {
+    Internal::releaseMemory(offsets);
+    return;
+  }
+  ::memset(data, 0, dataSize * sizeof(uint16_t));
+
+  for (instId = 0; instId < X86Inst::_kIdCount; instId++) {
+    if (!isOwner[instId]) continue;
+
+    const X86Inst::CommonData& commonData = X86InstDB::instData[instId].getCommonData();
+    const X86Inst::ISignature* iSigData = commonData.getISignatureData();
+    uint32_t maxCount;
+    uint32_t rows = getRows(iSigData, commonData.getISignatureEnd(), rowSig, rowCount, maxCount);
+
+    uint16_t* table = data + offsets[instId];
+    table[2] = static_cast<uint16_t>(maxCount);
+    for (uint32_t r = 0; r < rows; r++) {
+      const X86Inst::ISignature* iSig = iSigData + rowSig[r];
+      uint32_t rowBit = Utils::mask(r);
+
+      if (iSig->archMask & X86Inst::kArchMaskX86) table[0] |= rowBit;
+      if (iSig->archMask & X86Inst::kArchMaskX64) table[1] |= rowBit;
+
+      // Rows without implicit operands skip them.
+      bool skipImplicit = rowCount[r] != iSig->opCount;
+      uint32_t j = 0;
+
+      for (uint32_t i = 0; i < iSig->opCount; i++) {
+        const X86Inst::OSignature& ref = X86InstDB::oSignatureData[iSig->operands[i]];
+        if (skipImplicit && (ref.flags & X86Inst::kOpImplicit))
+          continue;
+
+        uint16_t* classes = table + kHeaderSize + j * kX86OpClassCount;
+        uint64_t mask = x86GetOpClassMask(ref);
+
+        for (uint32_t opClass = 0; opClass < kX86OpClassCount; opClass++)
+          if (mask & (uint64_t(1) << opClass))
+            classes[opClass] |= rowBit;
+        j++;
+      }
+
+      for (; j < maxCount; j++)
+        table[kHeaderSize + j * kX86OpClassCount + kX86OpClassNone] |= rowBit;
+    }
+  }
+
+  _offsets = offsets;
+  _data = data;
+}
+
+X86SignatureTables::~X86SignatureTables() noexcept {
+  Internal::releaseMemory(_offsets);
+  Internal::releaseMemory(_data);
+}
+
+static ASMJIT_INLINE const X86SignatureTables& x86GetSignatureTables() noexcept {
+  static X86SignatureTables tables;
+  return tables;
+}
+
+// ============================================================================
+// [asmjit::X86InstImpl - Validate - Helpers]
+// ============================================================================
+
+//! \internal
+//!
+//! Translate `op` to `X86Inst::OSignature` and get the mask of its class (zero
+//! if it doesn't have one).
+static ASMJIT_INLINE Error x86TranslateOp(
+  const X86ValidationData* vd, uint32_t archMask, const Operand_& op,
+  X86Inst::OSignature& oSig, uint32_t& opClass, uint32_t& combinedRegMask) noexcept {
+
+  uint32_t opFlags = 0;
+  uint32_t memFlags = 0;
+  uint32_t regMask = 0;
+
+  switch (op.getOp()) {
+    case Operand::kOpReg: {
+      uint32_t regType = op.as<Reg>().getType();
+      if (ASMJIT_UNLIKELY(regType >= X86Reg::kRegCount))
+        return DebugUtils::errored(kErrorInvalidRegType);
+
+      opFlags = _x86OpFlagFromRegType[regType];
+      if (ASMJIT_UNLIKELY(opFlags == 0))
+        return DebugUtils::errored(kErrorInvalidRegType);
+
+      // If `regId` is equal or greater than Operand::kPackedIdMin it means
+      // that the register is virtual and its index will be assigned later
+      // by the register allocator. We must pass unless asked to disallow
+      // virtual registers.
+      // TODO: We need an option to refuse virtual regs here.
+      uint32_t regId = op.getId();
+      if (regId < Operand::kPackedIdMin) {
+        if (ASMJIT_UNLIKELY(regId >= 32))
+          return DebugUtils::errored(kErrorInvalidPhysId);
+
+        regMask = Utils::mask(regId);
+        if (ASMJIT_UNLIKELY((vd->allowedRegMask[regType] & regMask) == 0))
+          return DebugUtils::errored(kErrorInvalidPhysId);
+
+        combinedRegMask |= regMask;
+      }
+      else {
+        regMask = 0xFFFFFFFFU;
+      }
+
+      opClass = kX86OpClassReg + regType;
+      break;
+    }
+
+    // TODO: Validate base and index and combine with `combinedRegMask`.
+    case Operand::kOpMem: {
+      const X86Mem& m = op.as<X86Mem>();
+
+      uint32_t baseType = m.getBaseType();
+      uint32_t indexType = m.getIndexType();
+
+      if (m.getSegmentId() > 6)
+        return DebugUtils::errored(kErrorInvalidSegment);
+
+      if (baseType) {
+        uint32_t baseId = m.getBaseId();
+
+        if (m.isRegHome()) {
+          // Home address of virtual register. In such case we don't want to
+          // validate the type of the base register as it will always be patched
+          // to ESP|RSP.
+        }
+        else {
+          if (ASMJIT_UNLIKELY((vd->allowedMemBaseRegs & (1U << baseType)) == 0))
+            return DebugUtils::errored(kErrorInvalidAddress);
+        }
+
+        // Create information that will be validated only if this is an implicit
+        // memory operand. Basically only usable for string instructions and other
+        // instructions where memory operand is implicit and has 'seg:[reg]' form.
+        if (baseId < Operand::kPackedIdMin) {
+          // Physical base id.
+          regMask = Utils::mask(baseId);
+          combinedRegMask |= regMask;
+        }
+        else {
+          // Virtual base id - will the whole mask for implicit mem validation.
+          // The register is not assigned yet, so we cannot predict the phys id.
+          regMask = 0xFFFFFFFFU;
+        }
+
+        if (!indexType && !m.getOffsetLo32())
+          memFlags |= X86Inst::kMemOpBaseOnly;
+      }
+      else {
+        // Base is an address, make sure that the address doesn't overflow 32-bit
+        // integer (either int32_t or uint32_t) in 32-bit targets.
+        int64_t offset = m.getOffset();
+        if (archMask == X86Inst::kArchMaskX86 && !Utils::isInt32(offset) && !Utils::isUInt32(offset))
+          return DebugUtils::errored(kErrorInvalidAddress);
+      }
+
+      if (indexType) {
+        if (ASMJIT_UNLIKELY((vd->allowedMemIndexRegs & (1U << indexType)) == 0))
+          return DebugUtils::errored(kErrorInvalidAddress);
+
+        if (indexType == X86Reg::kRegXmm) {
+          opFlags |= X86Inst::kOpVm;
+          memFlags |= X86Inst::kMemOpVm32x | X86Inst::kMemOpVm64x;
+        }
+        else if (indexType == X86Reg::kRegYmm) {
+          opFlags |= X86Inst::kOpVm;
+          memFlags |= X86Inst::kMemOpVm32y | X86Inst::kMemOpVm64y;
+        }
+        else if (indexType == X86Reg::kRegZmm) {
+          opFlags |= X86Inst::kOpVm;
+          memFlags |= X86Inst::kMemOpVm32z | X86Inst::kMemOpVm64z;
+        }
+        else {
+          opFlags |= X86Inst::kOpMem;
+          if (baseType)
+            memFlags |= X86Inst::kMemOpMib;
+        }
+
+        // [RIP + {XMM|YMM|ZMM}] is not allowed.
+        if (baseType == X86Reg::kRegRip && (opFlags & X86Inst::kOpVm))
+          return DebugUtils::errored(kErrorInvalidAddress);
+
+        uint32_t indexId = m.getIndexId();
+        if (indexId < Operand::kPackedIdMin)
+          combinedRegMask |= Utils::mask(indexId);
+
+        // Only used for implicit memory operands having 'seg:[reg]' form, so clear it.
+        regMask = 0;
+      }
+      else {
+        opFlags |= X86Inst::kOpMem;
+      }
+
+      uint32_t sizeIndex;
+      switch (m.getSize()) {
+        case  0: sizeIndex = 0; break;
+        case  1: sizeIndex = 1; break;
+        case  2: sizeIndex = 2; break;
+        case  4: sizeIndex = 3; break;
+        case  6: sizeIndex = 4; break;
+        case  8: sizeIndex = 5; break;
+        case 10: sizeIndex = 6; break;
+        case 16: sizeIndex = 7; break;
+        case 32: sizeIndex = 8; break;
+        case 64: sizeIndex = 9; break;
+        default:
+          return DebugUtils::errored(kErrorInvalidOperandSize);
+      }
+
+      memFlags |= _x86MemFlagsFromSizeIndex[sizeIndex];
+      opClass = (opFlags & X86Inst::kOpVm) ? uint32_t(kX86OpClassVm) : kX86OpClassMem + sizeIndex;
+      break;
+    }
+
+    case Operand::kOpImm: {
+      uint64_t immValue = op.as<Imm>().getUInt64();
+      uint32_t rangeIndex;
+
+      if (static_cast<int64_t>(immValue) >= 0) {
+        if (immValue <= 0xFU)
+          rangeIndex = 0;
+        else if (immValue <= 0x7FU)
+          rangeIndex = 1;
+        else if (immValue <= 0xFFU)
+          rangeIndex = 2;
+        else if (immValue <= 0x7FFFU)
+          rangeIndex = 3;
+        else if (immValue <= 0xFFFFU)
+          rangeIndex = 4;
+        else if (immValue <= 0x7FFFFFFFU)
+          rangeIndex = 5;
+        else if (immValue <= 0xFFFFFFFFU)
+          rangeIndex = 6;
+        else if (immValue <= ASMJIT_UINT64_C(0x7FFFFFFFFFFFFFFF))
+          rangeIndex = 7;
+        else
+          rangeIndex = 8;
+      }
+      else {
+        // 2s complement negation, as our number is unsigned...
+        immValue = (~immValue + 1);
+
+        if (immValue <= 0x80U)
+          rangeIndex = 9;
+        else if (immValue <= 0x8000U)
+          rangeIndex = 10;
+        else if (immValue <= 0x80000000U)
+          rangeIndex = 11;
+        else
+          rangeIndex = 12;
+      }
+
+      opFlags |= _x86ImmFlagsFromRangeIndex[rangeIndex];
+      opClass = kX86OpClassImm + rangeIndex;
+      break;
+    }
+
+    case Operand::kOpLabel: {
+      opFlags |= X86Inst::kOpRel8 | X86Inst::kOpRel32;
+      opClass = kX86OpClassLabel;
+      break;
+    }
+
+    default:
+      return DebugUtils::errored(kErrorInvalidState);
+  }
+
+  oSig.flags = opFlags;
+  oSig.memFlags = static_cast<uint16_t>(memFlags);
+  oSig.regMask = static_cast<uint8_t>(regMask & 0xFFU);
+  return kErrorOk;
+}
+
+//! \internal
+//!
+//! Get whether operands of classes `opClasses` match a row of `table`. If they
+//! don't, the operands may still match a signature that requires specific
+//! registers or addressing, see `x86MatchOSigs()`.
+static ASMJIT_INLINE bool x86MatchOpClasses(const uint16_t* table, uint32_t archMask, const uint32_t* opClasses, uint32_t count) noexcept {
+  uint32_t maxCount = table[2];
+  if (count > maxCount)
+    return false;
+
+  uint32_t rows = table[archMask - 1];
+  table += X86SignatureTables::kHeaderSize;
+
+  for (uint32_t j = 0; j < maxCount; j++, table += kX86OpClassCount)
+    rows &= table[j < count ? opClasses[j] : uint32_t(kX86OpClassNone)];
+  return rows != 0;
+}
+
+//! \internal
+//!
+//! Match translated operands `oSigTranslated` with signatures from `iSig` to
+//! `iEnd`.
+static ASMJIT_FAVOR_SIZE Error x86MatchOSigs(
+  const X86Inst::ISignature* iSig, const X86Inst::ISignature* iEnd, uint32_t archMask,
+  const X86Inst::OSignature* oSigTranslated, uint32_t count) noexcept {
+
+  const X86Inst::OSignature* oSigData = X86InstDB::oSignatureData;
+
+  // If set it means that we matched a signature where only immediate value
+  // was out of bounds. We can return a more descriptive error if we know this.
+  bool globalImmOutOfRange = false;
+
+  do {
+    // Check if the architecture is compatible.
+    if ((iSig->archMask & archMask) == 0) continue;
+
+    // Compare the operands table with reference operands.
+    uint32_t j = 0;
+    uint32_t iSigCount = iSig->opCount;
+    bool localImmOutOfRange = false;
+
+    if (iSigCount == count) {
+      for (j = 0; j < count; j++)
+        if (!x86CheckOSig(oSigTranslated[j], oSigData[iSig->operands[j]], localImmOutOfRange))
+          break;
+    }
+    else if (iSigCount - iSig->implicit == count) {
+      uint32_t r = 0;
+      for (j = 0; j < count && r < iSigCount; j++, r++) {
+        const X86Inst::OSignature* oChk = oSigTranslated + j;
+        const X86Inst::OSignature* oRef;
+Next:
+        oRef = oSigData + iSig->operands[r];
+        // Skip implicit.
+        if ((oRef->flags & X86Inst::kOpImplicit) != 0) {
+          if (++r >= iSigCount)
+            break;
+          else
+            goto Next;
+        }
+
+        if (!x86CheckOSig(*oChk, *oRef, localImmOutOfRange))
+          break;
+      }
+    }
+
+    if (j == count) {
+      if (!localImmOutOfRange)
+        return kErrorOk;
+      globalImmOutOfRange = localImmOutOfRange;
+    }
+  } while (++iSig != iEnd);
+
+  if (globalImmOutOfRange)
+    return DebugUtils::errored(kErrorInvalidImmediate);
+  else
+    return DebugUtils::errored(kErrorInvalidInstruction);
+}
+
+// ============================================================================
+// [asmjit::X86InstImpl - Validate]
+// ============================================================================
+
+Error X86InstImpl::validate(uint32_t archType, const Inst::Detail& detail, const Operand_* operands, uint32_t count) noexcept {
   uint32_t i;
   uint32_t archMask;
   const X86ValidationData* vd;
@@ -213,6 +775,7 @@ ASMJIT_FAVOR_SIZE Error X86InstImpl::validate(uint32_t archType, const Inst::Det
 
   // Translate the given operands to `X86Inst::OSignature`.
   X86Inst::OSignature oSigTranslated[6];
+  uint32_t opClasses[6];
   uint32_t combinedOpFlags = 0;
   uint32_t combinedRegMask = 0;
 
@@ -222,205 +785,10 @@ ASMJIT_FAVOR_SIZE Error X86InstImpl::validate(uint32_t archType, const Inst::Det
     const Operand_& op = operands[i];
     if (op.getOp() == Operand::kOpNone) break;
 
-    uint32_t opFlags = 0;
-    uint32_t memFlags = 0;
-    uint32_t regMask = 0;
-
-    switch (op.getOp()) {
-      case Operand::kOpReg: {
-        uint32_t regType = op.as<Reg>().getType();
-        if (ASMJIT_UNLIKELY(regType >= X86Reg::kRegCount))
-          return DebugUtils::errored(kErrorInvalidRegType);
-
-        opFlags = _x86OpFlagFromRegType[regType];
-        if (ASMJIT_UNLIKELY(opFlags == 0))
-          return DebugUtils::errored(kErrorInvalidRegType);
-
-        // If `regId` is equal or greater than Operand::kPackedIdMin it means
-        // that the register is virtual and its index will be assigned later
-        // by the register allocator. We must pass unless asked to disallow
-        // virtual registers.
-        // TODO: We need an option to refuse virtual regs here.
-        uint32_t regId = op.getId();
-        if (regId < Operand::kPackedIdMin) {
-          if (ASMJIT_UNLIKELY(regId >= 32))
-            return DebugUtils::errored(kErrorInvalidPhysId);
-
-          regMask = Utils::mask(regId);
-          if (ASMJIT_UNLIKELY((vd->allowedRegMask[regType] & regMask) == 0))
-            return DebugUtils::errored(kErrorInvalidPhysId);
-
-          combinedRegMask |= regMask;
-        }
-        else {
-          regMask = 0xFFFFFFFFU;
-        }
-        break;
-      }
-
-      // TODO: Validate base and index and combine with `combinedRegMask`.
-      case Operand::kOpMem: {
-        const X86Mem& m = op.as<X86Mem>();
-
-        uint32_t baseType = m.getBaseType();
-        uint32_t indexType = m.getIndexType();
-
-        memOp = &m;
-
-        if (m.getSegmentId() > 6)
-          return DebugUtils::errored(kErrorInvalidSegment);
-
-        if (baseType) {
-          uint32_t baseId = m.getBaseId();
-
-          if (m.isRegHome()) {
-            // Home address of virtual register. In such case we don't want to
-            // validate the type of the base register as it will always be patched
-            // to ESP|RSP.
-          }
-          else {
-            if (ASMJIT_UNLIKELY((vd->allowedMemBaseRegs & (1U << baseType)) == 0))
-              return DebugUtils::errored(kErrorInvalidAddress);
-          }
-
-          // Create information that will be validated only if this is an implicit
-          // memory operand. Basically only usable for string instructions and other
-          // instructions where memory operand is implicit and has 'seg:[reg]' form.
-          if (baseId < Operand::kPackedIdMin) {
-            // Physical base id.
-            regMask = Utils::mask(baseId);
-            combinedRegMask |= regMask;
-          }
-          else {
-            // Virtual base id - will the whole mask for implicit mem validation.
-            // The register is not assigned yet, so we cannot predict the phys id.
-            regMask = 0xFFFFFFFFU;
-          }
-
-          if (!indexType && !m.getOffsetLo32())
-            memFlags |= X86Inst::kMemOpBaseOnly;
-        }
-        else {
-          // Base is an address, make sure that the address doesn't overflow 32-bit
-          // integer (either int32_t or uint32_t) in 32-bit targets.
-          int64_t offset = m.getOffset();
-          if (archMask == X86Inst::kArchMaskX86 && !Utils::isInt32(offset) && !Utils::isUInt32(offset))
-            return DebugUtils::errored(kErrorInvalidAddress);
-        }
-
-        if (indexType) {
-          if (ASMJIT_UNLIKELY((vd->allowedMemIndexRegs & (1U << indexType)) == 0))
-            return DebugUtils::errored(kErrorInvalidAddress);
-
-          if (indexType == X86Reg::kRegXmm) {
-            opFlags |= X86Inst::kOpVm;
-            memFlags |= X86Inst::kMemOpVm32x | X86Inst::kMemOpVm64x;
-          }
-          else if (indexType == X86Reg::kRegYmm) {
-            opFlags |= X86Inst::kOpVm;
-            memFlags |= X86Inst::kMemOpVm32y | X86Inst::kMemOpVm64y;
-          }
-          else if (indexType == X86Reg::kRegZmm) {
-            opFlags |= X86Inst::kOpVm;
-            memFlags |= X86Inst::kMemOpVm32z | X86Inst::kMemOpVm64z;
-          }
-          else {
-            opFlags |= X86Inst::kOpMem;
-            if (baseType)
-              memFlags |= X86Inst::kMemOpMib;
-          }
-
-          // [RIP + {XMM|YMM|ZMM}] is not allowed.
-          if (baseType == X86Reg::kRegRip && (opFlags & X86Inst::kOpVm))
-            return DebugUtils::errored(kErrorInvalidAddress);
-
-          uint32_t indexId = m.getIndexId();
-          if (indexId < Operand::kPackedIdMin)
-            combinedRegMask |= Utils::mask(indexId);
-
-          // Only used for implicit memory operands having 'seg:[reg]' form, so clear it.
-          regMask = 0;
-        }
-        else {
-          opFlags |= X86Inst::kOpMem;
-        }
-
-        switch (m.getSize()) {
-          case  0: memFlags |= X86Inst::kMemOpAny ; break;
-          case  1: memFlags |= X86Inst::kMemOpM8  ; break;
-          case  2: memFlags |= X86Inst::kMemOpM16 ; break;
-          case  4: memFlags |= X86Inst::kMemOpM32 ; break;
-          case  6: memFlags |= X86Inst::kMemOpM48 ; break;
-          case  8: memFlags |= X86Inst::kMemOpM64 ; break;
-          case 10: memFlags |= X86Inst::kMemOpM80 ; break;
-          case 16: memFlags |= X86Inst::kMemOpM128; break;
-          case 32: memFlags |= X86Inst::kMemOpM256; break;
-          case 64: memFlags |= X86Inst::kMemOpM512; break;
-          default:
-            return DebugUtils::errored(kErrorInvalidOperandSize);
-        }
-
-        break;
-      }
-
-      case Operand::kOpImm: {
-        uint64_t immValue = op.as<Imm>().getUInt64();
-        uint32_t immFlags = 0;
-
-        if (static_cast<int64_t>(immValue) >= 0) {
-          const uint32_t k32AndMore = X86Inst::kOpI32 | X86Inst::kOpU32 |
-                                      X86Inst::kOpI64 | X86Inst::kOpU64 ;
-
-          if (immValue <= 0xFU)
-            immFlags = X86Inst::kOpU4 | X86Inst::kOpI8 | X86Inst::kOpU8 | X86Inst::kOpI16 | X86Inst::kOpU16 | k32AndMore;
-          else if (immValue <= 0x7FU)
-            immFlags = X86Inst::kOpI8 | X86Inst::kOpU8 | X86Inst::kOpI16 | X86Inst::kOpU16 | k32AndMore;
-          else if (immValue <= 0xFFU)
-            immFlags = X86Inst::kOpU8 | X86Inst::kOpI16 | X86Inst::kOpU16 | k32AndMore;
-          else if (immValue <= 0x7FFFU)
-            immFlags = X86Inst::kOpI16 | X86Inst::kOpU16 | k32AndMore;
-          else if (immValue <= 0xFFFFU)
-            immFlags = X86Inst::kOpU16 | k32AndMore;
-          else if (immValue <= 0x7FFFFFFFU)
-            immFlags = k32AndMore;
-          else if (immValue <= 0xFFFFFFFFU)
-            immFlags = X86Inst::kOpU32 | X86Inst::kOpI64 | X86Inst::kOpU64;
-          else if (immValue <= ASMJIT_UINT64_C(0x7FFFFFFFFFFFFFFF))
-            immFlags = X86Inst::kOpI64 | X86Inst::kOpU64;
-          else
-            immFlags = X86Inst::kOpU64;
-        }
-        else {
-          // 2s complement negation, as our number is unsigned...
-          immValue = (~immValue + 1);
-
-          if (immValue <= 0x80U)
-            immFlags = X86Inst::kOpI8 | X86Inst::kOpI16 | X86Inst::kOpI32 | X86Inst::kOpI64;
-          else if (immValue <= 0x8000U)
-            immFlags = X86Inst::kOpI16 | X86Inst::kOpI32 | X86Inst::kOpI64;
-          else if (immValue <= 0x80000000U)
-            immFlags = X86Inst::kOpI32 | X86Inst::kOpI64;
-          else
-            immFlags = X86Inst::kOpI64;
-        }
-        opFlags |= immFlags;
-        break;
-      }
-
-      case Operand::kOpLabel: {
-        opFlags |= X86Inst::kOpRel8 | X86Inst::kOpRel32;
-        break;
-      }
-
-      default:
-        return DebugUtils::errored(kErrorInvalidState);
-    }
-
-    X86Inst::OSignature& tod = oSigTranslated[i];
-    tod.flags = opFlags;
-    tod.memFlags = static_cast<uint16_t>(memFlags);
-    tod.regMask = static_cast<uint8_t>(regMask & 0xFFU);
-    combinedOpFlags |= opFlags;
+    ASMJIT_PROPAGATE(x86TranslateOp(vd, archMask, op, oSigTranslated[i], opClasses[i], combinedRegMask));
+    if (op.isMem())
+      memOp = &op.as<X86Mem>();
+    combinedOpFlags |= oSigTranslated[i].flags;
   }
 
   // Decrease the number of operands of those that are none. This is important
@@ -445,68 +813,16 @@ ASMJIT_FAVOR_SIZE Error X86InstImpl::validate(uint32_t archType, const Inst::Det
       return DebugUtils::errored(kErrorInvalidUseOfGpbHi);
   }
 
-  // Validate instruction operands.
+  // Validate instruction operands. Operand classes match most instructions,
+  // `x86MatchOSigs()` is used for the rest and to report the right error.
   const X86Inst::CommonData* commonData = &iData->getCommonData();
   const X86Inst::ISignature* iSig = X86InstDB::iSignatureData + commonData->_iSignatureIndex;
   const X86Inst::ISignature* iEnd = iSig                      + commonData->_iSignatureCount;
 
   if (iSig != iEnd) {
-    const X86Inst::OSignature* oSigData = X86InstDB::oSignatureData;
-
-    // If set it means that we matched a signature where only immediate value
-    // was out of bounds. We can return a more descriptive error if we know this.
-    bool globalImmOutOfRange = false;
-
-    do {
-      // Check if the architecture is compatible.
-      if ((iSig->archMask & archMask) == 0) continue;
-
-      // Compare the operands table with reference operands.
-      uint32_t j = 0;
-      uint32_t iSigCount = iSig->opCount;
-      bool localImmOutOfRange = false;
-
-      if (iSigCount == count) {
-        for (j = 0; j < count; j++)
-          if (!x86CheckOSig(oSigTranslated[j], oSigData[iSig->operands[j]], localImmOutOfRange))
-            break;
-      }
-      else if (iSigCount - iSig->implicit == count) {
-        uint32_t r = 0;
-        for (j = 0; j < count && r < iSigCount; j++, r++) {
-          const X86Inst::OSignature* oChk = oSigTranslated + j;
-          const X86Inst::OSignature* oRef;
-Next:
-          oRef = oSigData + iSig->operands[r];
-          // Skip implicit.
-          if ((oRef->flags & X86Inst::kOpImplicit) != 0) {
-            if (++r >= iSigCount)
-              break;
-            else
-              goto Next;
-          }
-
-          if (!x86CheckOSig(*oChk, *oRef, localImmOutOfRange))
-            break;
-        }
-      }
-
-      if (j == count) {
-        if (!localImmOutOfRange) {
-          // Match, must clear possible `globalImmOutOfRange`.
-          globalImmOutOfRange = false;
-          break;
-        }
-        globalImmOutOfRange = localImmOutOfRange;
-      }
-    } while (++iSig != iEnd);
-
-    if (iSig == iEnd) {
-      if (globalImmOutOfRange)
-        return DebugUtils::errored(kErrorInvalidImmediate);
-      else
-        return DebugUtils::errored(kErrorInvalidInstruction);
-    }
+    const uint16_t* table = x86GetSignatureTables().get(instId);
+    if (!table || !x86MatchOpClasses(table, archMask, opClasses, count))
+      ASMJIT_PROPAGATE(x86MatchOSigs(iSig, iEnd, archMask, oSigTranslated, count));
   }
 
   // Validate AVX-512 options:
@@ -725,6 +1041,103 @@ ASMJIT_FAVOR_SIZE Error X86InstImpl::checkFeatures(uint32_t archType, const Inst
 }
 #endif
 
+// ============================================================================
+// [asmjit::X86InstImpl - Test]
+// ============================================================================
+
+#if defined(ASMJIT_TEST) && !defined(ASMJIT_DISABLE_VALIDATION)
+UNIT(x86_inst_validate_tables) {
+  INFO("Checking whether operands matched by X86SignatureTables match signatures");
+
+  Label label(Operand::packId(0));
+  X86Gp virtGpd = x86::eax;
+  virtGpd.setId(Operand::packId(1));
+
+  const Operand operands[] = {
+    x86::al, x86::ah, x86::cl, x86::ax, x86::dx, x86::eax, x86::ecx, x86::r9d,
+    x86::rax, x86::r10, virtGpd, x86::xmm0, x86::xmm1, x86::xmm12, x86::ymm2,
+    x86::zmm3, x86::mm1, x86::k1, x86::es, x86::fp0, x86::bnd0, x86::cr0, x86::dr0,
+    x86::ptr(x86::eax), x86::byte_ptr(x86::esi), x86::word_ptr(x86::edi, 8),
+    x86::dword_ptr(x86::eax, x86::ecx, 2, 4), x86::qword_ptr(x86::rsi), x86::qword_ptr(x86::rax, x86::rcx),
+    x86::tword_ptr(x86::ebx), x86::dqword_ptr(x86::rdx), x86::yword_ptr(x86::eax, 32),
+    x86::zword_ptr(x86::rax), x86::ptr(x86::eax, x86::xmm1), x86::dword_ptr(0x1000),
+    imm(0), imm(1), imm(0x7F), imm(0x80), imm(0xFF), imm(0x7FFF), imm(0xFFFF), imm(0x10000),
+    imm(0x80000000), imm(ASMJIT_UINT64_C(0x100000000)), imm(-1), imm(-0x81), imm(-0x8001),
+    imm(-int64_t(0x80000001)), label
+  };
+
+  const uint32_t kOpCount = ASMJIT_ARRAY_SIZE(operands);
+  const X86SignatureTables& tables = x86GetSignatureTables();
+
+  EXPECT(tables._data != nullptr);
+
+  for (uint32_t archType = ArchInfo::kTypeX86; archType <= ArchInfo::kTypeX64; archType++) {
+    uint32_t archMask = archType == ArchInfo::kTypeX86 ? X86Inst::kArchMaskX86 : X86Inst::kArchMaskX64;
+    const X86ValidationData* vd = archType == ArchInfo::kTypeX86 ? &_x86ValidationData : &_x64ValidationData;
+
+    // Translate all operands, keep only those that are valid.
+    X86Inst::OSignature oSigs[kOpCount];
+    uint32_t opClasses[kOpCount];
+    uint32_t n = 0;
+
+    for (uint32_t i = 0; i < kOpCount; i++) {
+      uint32_t combinedRegMask = 0;
+      if (x86TranslateOp(vd, archMask, operands[i], oSigs[n], opClasses[n], combinedRegMask) == kErrorOk)
+        n++;
+    }
+
+    uint32_t classMatches = 0;
+    uint32_t sigMatches = 0;
+
+    for (uint32_t instId = 1; instId < X86Inst::_kIdCount; instId++) {
+      const X86Inst::CommonData& commonData = X86InstDB::instData[instId].getCommonData();
+      const X86Inst::ISignature* iSig = commonData.getISignatureData();
+      const X86Inst::ISignature* iEnd = commonData.getISignatureEnd();
+      if (iSig == iEnd) continue;
+
+      const uint16_t* table = tables.get(instId);
+      EXPECT(table != nullptr, "Instruction #%u doesn't have a signature table", instId);
+
+      // All combinations of up to 2 operands and every third operand of 3 and
+      // 4 operand combinations (4 only if the instruction has such signature).
+      uint32_t maxCount = table[2];
+      for (uint32_t count = 0; count <= 4 && count <= maxCount; count++) {
+        uint32_t step = count <= 2 ? 1 : 3;
+        uint32_t index[4] = { 0, 0, 0, 0 };
+
+        for (;;) {
+          X86Inst::OSignature oSigTranslated[4];
+          uint32_t classes[4];
+
+          for (uint32_t j = 0; j < count; j++) {
+            oSigTranslated[j] = oSigs[index[j]];
+            classes[j] = opClasses[index[j]];
+          }
+
+          bool classMatch = x86MatchOpClasses(table, archMask, classes, count);
+          bool sigMatch = x86MatchOSigs(iSig, iEnd, archMask, oSigTranslated, count) == kErrorOk;
+
+          EXPECT(!classMatch || sigMatch,
+            "Instruction #%u matched operands by class that don't match its signatures", instId);
+
+          classMatches += classMatch;
+          sigMatches += sigMatch;
+
+          uint32_t j = 0;
+          while (j < count && (index[j] += step) >= n)
+            index[j++] = 0;
+          if (j == count) break;
+        }
+      }
+    }
+
+    INFO("  %s: %u of %u valid combinations matched by class",
+      archType == ArchInfo::kTypeX86 ? "X86" : "X64", classMatches, sigMatches);
+    EXPECT(classMatches * 4 >= sigMatches * 3);
+  }
+}
+#endif // ASMJIT_TEST && !ASMJIT_DISABLE_VALIDATION
+
 } // asmjit namespace
 
 // [Api-End]
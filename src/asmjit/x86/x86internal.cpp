@@ -12,8 +12,21 @@
 #if defined(ASMJIT_BUILD_X86)
 
 // [Dependencies]
+#include "../x86/x86assembler.h"
 #include "../x86/x86internal_p.h"
 
+#if !defined(ASMJIT_DISABLE_BUILDER)
+#include "../base/codebuilder.h"
+#endif // !ASMJIT_DISABLE_BUILDER
+
+#if !defined(ASMJIT_DISABLE_COMPILER)
+#include "../base/codecompiler.h"
+#endif // !ASMJIT_DISABLE_COMPILER
+
+#if defined(ASMJIT_TEST) && !defined(ASMJIT_DISABLE_COMPILER)
+#include "../x86/x86compiler.h"
+#endif // ASMJIT_TEST && !ASMJIT_DISABLE_COMPILER
+
 // [Api-Begin]
 #include "../asmjit_apibegin.h"
 
@@ -591,6 +604,7 @@ ASMJIT_FAVOR_SIZE Error X86Internal::initFrameLayout(FuncFrameLayout& layout, co
         ffi.getCallFrameAlignment()),
       func.getCallConv().getNaturalStackAlignment());
   layout._stackAlignment = static_cast<uint8_t>(stackAlignment);
+  layout._archType = static_cast<uint8_t>(func.getCallConv().getArchType());
 
   // Calculate if dynamic stack alignment is required. If true the function has
   // to align stack dynamically to match `_stackAlignment` and would require to
@@ -1176,6 +1190,347 @@ ASMJIT_FAVOR_SIZE Error X86Internal::emitEpilog(X86Emitter* emitter, const FuncF
   return kErrorOk;
 }
 
+// ============================================================================
+// [asmjit::X86Internal - EhFrame]
+// ============================================================================
+
+//! \internal
+//!
+//! DWARF call frame instructions and expression opcodes used by `.eh_frame`.
+ASMJIT_ENUM(X86DwarfOp) {
+  kX86DwCfaNop              = 0x00,
+  kX86DwCfaAdvanceLoc1      = 0x02,
+  kX86DwCfaAdvanceLoc2      = 0x03,
+  kX86DwCfaAdvanceLoc4      = 0x04,
+  kX86DwCfaRememberState    = 0x0A,
+  kX86DwCfaRestoreState     = 0x0B,
+  kX86DwCfaDefCfa           = 0x0C,
+  kX86DwCfaDefCfaRegister   = 0x0D,
+  kX86DwCfaDefCfaOffset     = 0x0E,
+  kX86DwCfaDefCfaExpression = 0x0F,
+  kX86DwCfaAdvanceLoc       = 0x40,
+  kX86DwCfaOffset           = 0x80,
+
+  kX86DwOpDeref             = 0x06,
+  kX86DwOpPlusUConst        = 0x23,
+  kX86DwOpBReg0             = 0x70
+};
+
+//! \internal
+//!
+//! Maps X86 GP register id to a DWARF register number (X86).
+static const uint8_t x86DwarfRegX86[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+
+//! \internal
+//!
+//! Maps X86 GP register id to a DWARF register number (X64).
+static const uint8_t x86DwarfRegX64[16] = { 0, 2, 1, 3, 7, 6, 4, 5, 8, 9, 10, 11, 12, 13, 14, 15 };
+
+//! \internal
+//!
+//! Writes DWARF data and keeps track of the current code location.
+struct X86EhFrameWriter {
+  ASMJIT_INLINE X86EhFrameWriter(uint8_t* p, uint32_t gpSize) noexcept
+    : ptr(p),
+      loc(0),
+      gpSize(gpSize),
+      dwarfRegs(gpSize == 4 ? x86DwarfRegX86 : x86DwarfRegX64) {}
+
+  ASMJIT_INLINE void u8(uint32_t x) noexcept { *ptr++ = static_cast<uint8_t>(x); }
+  ASMJIT_INLINE void u32(uint32_t x) noexcept { Utils::writeU32u(ptr, x); ptr += 4; }
+
+  ASMJIT_INLINE void uptr(uint64_t x) noexcept {
+    if (gpSize == 4)
+      Utils::writeU32u(ptr, static_cast<uint32_t>(x));
+    else
+      Utils::writeU64u(ptr, x);
+    ptr += gpSize;
+  }
+
+  ASMJIT_INLINE void uleb(uint32_t x) noexcept {
+    do {
+      uint32_t b = x & 0x7F;
+      x >>= 7;
+      u8(x ? b | 0x80 : b);
+    } while (x);
+  }
+
+  ASMJIT_INLINE void sleb(int32_t x) noexcept {
+    for (;;) {
+      uint32_t b = static_cast<uint32_t>(x) & 0x7F;
+      x >>= 7;
+      if ((x == 0 && !(b & 0x40)) || (x == -1 && (b & 0x40))) {
+        u8(b);
+        break;
+      }
+      u8(b | 0x80);
+    }
+  }
+
+  ASMJIT_INLINE uint32_t dwReg(uint32_t regId) const noexcept { return dwarfRegs[regId]; }
+
+  // Emit `DW_CFA_advance_loc` so the following rules apply at `newLoc`.
+  ASMJIT_INLINE void advance(uint32_t newLoc) noexcept {
+    ASMJIT_ASSERT(newLoc >= loc);
+    uint32_t delta = newLoc - loc;
+    loc = newLoc;
+
+    if (delta == 0)
+      return;
+
+    if (delta < 0x40) {
+      u8(kX86DwCfaAdvanceLoc | delta);
+    }
+    else if (delta <= 0xFF) {
+      u8(kX86DwCfaAdvanceLoc1);
+      u8(delta);
+    }
+    else if (delta <= 0xFFFF) {
+      u8(kX86DwCfaAdvanceLoc2);
+      Utils::writeU16u(ptr, delta);
+      ptr += 2;
+    }
+    else {
+      u8(kX86DwCfaAdvanceLoc4);
+      u32(delta);
+    }
+  }
+
+  ASMJIT_INLINE void defCfa(uint32_t regId, uint32_t offset) noexcept {
+    u8(kX86DwCfaDefCfa);
+    uleb(dwReg(regId));
+    uleb(offset);
+  }
+
+  ASMJIT_INLINE void defCfaRegister(uint32_t regId) noexcept {
+    u8(kX86DwCfaDefCfaRegister);
+    uleb(dwReg(regId));
+  }
+
+  ASMJIT_INLINE void defCfaOffset(uint32_t offset) noexcept {
+    u8(kX86DwCfaDefCfaOffset);
+    uleb(offset);
+  }
+
+  // Register `regId` is saved at `CFA - slot * gpSize`.
+  ASMJIT_INLINE void offset(uint32_t regId, uint32_t slot) noexcept {
+    u8(kX86DwCfaOffset | dwReg(regId));
+    uleb(slot);
+  }
+
+  // Pad the current CIE/FDE that starts at `entry` by `DW_CFA_nop`s and patch its length.
+  ASMJIT_INLINE void finishEntry(uint8_t* entry) noexcept {
+    while ((size_t)(ptr - entry) & (gpSize - 1))
+      u8(kX86DwCfaNop);
+    Utils::writeU32u(entry, static_cast<uint32_t>((size_t)(ptr - entry) - 4));
+  }
+
+  uint8_t* ptr;
+  uint32_t loc;
+  uint32_t gpSize;
+  const uint8_t* dwarfRegs;
+};
+
+// NOTE: The unwind information depends on the exact size of each instruction
+// that modifies the stack, which is why the sizes below must be kept in sync
+// with the encodings `emitProlog()` and `emitEpilog()` produce. The prolog is
+// described from the beginning of the function, the epilog from its end.
+static ASMJIT_INLINE uint32_t x86PushPopSize(uint32_t regId) noexcept {
+  return 1 + (regId >= 8);
+}
+
+static ASMJIT_INLINE uint32_t x86SpImmSize(uint32_t gpSize, int32_t imm) noexcept {
+  // 'and|sub zsp, imm' -> [REX.W] 83|81 /r ib|id.
+  return (gpSize == 8) + 2 + (Utils::isInt8(imm) ? 1 : 4);
+}
+
+ASMJIT_FAVOR_SIZE size_t X86Internal::buildEhFrame(const FuncFrameLayout& layout, uint8_t* dst, uint64_t funcAddress, size_t funcSize, size_t epilogEnd) noexcept {
+  uint32_t archType = layout.getArchType();
+  if (archType != ArchInfo::kTypeX86 && archType != ArchInfo::kTypeX64)
+    return 0;
+
+  uint32_t gpSize = archType == ArchInfo::kTypeX86 ? 4 : 8;
+  uint32_t raRegId = archType == ArchInfo::kTypeX86 ? 8 : 16;
+
+  if (ASMJIT_UNLIKELY(funcSize > 0xFFFFFFFFU || epilogEnd > funcSize))
+    return 0;
+
+  X86EhFrameWriter w(dst, gpSize);
+
+  // CIE - Common to all functions, only the return address is on the stack.
+  uint8_t* cie = w.ptr;
+  w.u32(0);                              // Length (patched).
+  w.u32(0);                              // CIE id.
+  w.u8(1);                               // Version.
+  w.u8('z');                             // Augmentation "zR".
+  w.u8('R');
+  w.u8(0);
+  w.uleb(1);                             // Code alignment factor.
+  w.sleb(-static_cast<int32_t>(gpSize)); // Data alignment factor.
+  w.u8(raRegId);                         // Return address register.
+  w.uleb(1);                             // Augmentation data length.
+  w.u8(0);                               // FDE pointer encoding (DW_EH_PE_absptr).
+  w.defCfa(X86Gp::kIdSp, gpSize);        // CFA = zsp + gpSize.
+  w.u8(kX86DwCfaOffset | raRegId);       // Return address at CFA - gpSize.
+  w.uleb(1);
+  w.finishEntry(cie);
+
+  // FDE - Function specific.
+  uint8_t* fde = w.ptr;
+  w.u32(0);                              // Length (patched).
+  w.u32(static_cast<uint32_t>((size_t)(w.ptr - cie))); // CIE pointer.
+  w.uptr(funcAddress);                   // PC begin.
+  w.uptr(funcSize);                      // PC range.
+  w.uleb(0);                             // Augmentation data length.
+
+  uint32_t loc = 0;
+  uint32_t cfaRegId = X86Gp::kIdSp;
+  uint32_t gpSaved = layout.getSavedRegs(X86Reg::kKindGp);
+  uint32_t regId;
+
+  // Number of stack slots between CFA and zsp, the return address included.
+  uint32_t slots = 1;
+
+  // Prolog: 'push zbp' and 'mov zbp, zsp'.
+  if (layout.hasPreservedFP()) {
+    gpSaved &= ~Utils::mask(X86Gp::kIdBp);
+
+    loc += 1;
+    slots++;
+    w.advance(loc);
+    w.defCfaOffset(slots * gpSize);
+    w.offset(X86Gp::kIdBp, slots);
+
+    loc += gpSize == 8 ? 3 : 2;
+    w.advance(loc);
+    w.defCfaRegister(X86Gp::kIdBp);
+    cfaRegId = X86Gp::kIdBp;
+  }
+
+  // Prolog: 'push gp' sequence.
+  for (regId = 0; regId < 16; regId++) {
+    if (!(gpSaved & Utils::mask(regId))) continue;
+
+    loc += x86PushPopSize(regId);
+    slots++;
+    w.advance(loc);
+    if (cfaRegId == X86Gp::kIdSp)
+      w.defCfaOffset(slots * gpSize);
+    w.offset(regId, slots);
+  }
+
+  // Prolog: 'mov saReg, zsp'.
+  uint32_t saRegId = layout.getStackArgsRegId();
+  if (saRegId != Globals::kInvalidRegId && saRegId != X86Gp::kIdSp) {
+    if (!(layout.hasPreservedFP() && saRegId == X86Gp::kIdBp))
+      loc += gpSize == 8 ? 3 : 2;
+  }
+
+  // Prolog: 'and zsp, StackAlignment' - CFA can be only expressed relative
+  // to `saReg`, which holds the unaligned stack pointer now.
+  if (layout.hasDynamicAlignment()) {
+    loc += x86SpImmSize(gpSize, -static_cast<int32_t>(layout.getStackAlignment()));
+    if (cfaRegId == X86Gp::kIdSp) {
+      w.advance(loc);
+      w.defCfa(saRegId, slots * gpSize);
+      cfaRegId = saRegId;
+    }
+  }
+
+  // Prolog: 'sub zsp, StackAdjustment'.
+  if (layout.hasStackAdjustment()) {
+    loc += x86SpImmSize(gpSize, static_cast<int32_t>(layout.getStackAdjustment()));
+    if (cfaRegId == X86Gp::kIdSp) {
+      w.advance(loc);
+      w.defCfaOffset(slots * gpSize + layout.getStackAdjustment());
+    }
+  }
+
+  // Prolog: 'mov [zsp + dsaSlot], saReg' - CFA is `[zsp + dsaSlot] + slots * gpSize`
+  // from now as `saReg` can be reused by the function's body.
+  if (layout.hasDynamicAlignment() && layout.hasDsaSlotUsed()) {
+    int32_t dsaSlot = static_cast<int32_t>(layout._dsaSlot);
+    loc += (gpSize == 8) + 3 + (dsaSlot == 0 ? 0 : Utils::isInt8(dsaSlot) ? 1 : 4);
+
+    uint8_t expr[16];
+    X86EhFrameWriter e(expr, gpSize);
+    e.u8(kX86DwOpBReg0 + w.dwReg(X86Gp::kIdSp));
+    e.sleb(dsaSlot);
+    e.u8(kX86DwOpDeref);
+    e.u8(kX86DwOpPlusUConst);
+    e.uleb(slots * gpSize);
+
+    uint32_t exprSize = static_cast<uint32_t>((size_t)(e.ptr - expr));
+    w.advance(loc);
+    w.u8(kX86DwCfaDefCfaExpression);
+    w.uleb(exprSize);
+    ::memcpy(w.ptr, expr, exprSize);
+    w.ptr += exprSize;
+  }
+
+  // Epilog is described from its end. If there is code after the epilog (for
+  // example blocks injected by the register allocator) the rules of the body
+  // are remembered before the epilog and restored after its 'ret'.
+  uint32_t end = static_cast<uint32_t>(epilogEnd);
+  uint32_t retSize = layout.hasCalleeStackCleanup() ? 3 : 1;
+  bool hasTail = epilogEnd < funcSize;
+  bool hasEpilogRules = false;
+
+  if (layout.hasPreservedFP()) {
+    // Epilog: 'pop zbp' - CFA is relative to zsp again.
+    if (ASMJIT_UNLIKELY(end < retSize + loc))
+      return 0;
+
+    w.advance(end - retSize);
+    if (hasTail) w.u8(kX86DwCfaRememberState);
+    w.defCfa(X86Gp::kIdSp, gpSize);
+    hasEpilogRules = true;
+  }
+  else if (slots > 1 || cfaRegId != X86Gp::kIdSp || layout.hasStackAdjustment()) {
+    uint32_t popSize = 0;
+    for (regId = 0; regId < 16; regId++)
+      if (gpSaved & Utils::mask(regId))
+        popSize += x86PushPopSize(regId);
+
+    if (ASMJIT_UNLIKELY(end < retSize + popSize + loc))
+      return 0;
+
+    // Epilog: 'add zsp, StackAdjustment' or 'mov zsp, [zsp + dsaSlot]'.
+    loc = end - retSize - popSize;
+    w.advance(loc);
+    if (hasTail) w.u8(kX86DwCfaRememberState);
+    w.defCfa(X86Gp::kIdSp, slots * gpSize);
+    hasEpilogRules = true;
+
+    // Epilog: 'pop gp' sequence.
+    regId = 16;
+    do {
+      regId--;
+      if (!(gpSaved & Utils::mask(regId))) continue;
+
+      loc += x86PushPopSize(regId);
+      slots--;
+      w.advance(loc);
+      w.defCfaOffset(slots * gpSize);
+    } while (regId != 0);
+  }
+
+  // Code after 'ret' uses the rules of the body.
+  if (hasTail && hasEpilogRules) {
+    w.advance(end);
+    w.u8(kX86DwCfaRestoreState);
+  }
+
+  w.finishEntry(fde);
+
+  // Terminator.
+  w.u32(0);
+
+  size_t size = (size_t)(w.ptr - dst);
+  ASMJIT_ASSERT(size <= FuncFrameLayout::kMaxEhFrameSize);
+  return size;
+}
+
 // ============================================================================
 // [asmjit::X86Internal - AllocArgs]
 // ============================================================================
@@ -1351,6 +1706,561 @@ ASMJIT_FAVOR_SIZE Error X86Internal::allocArgs(X86Emitter* emitter, const FuncFr
   return kErrorOk;
 }
 
+
+// ============================================================================
+// [asmjit::X86Internal - Layout]
+// ============================================================================
+
+#if !defined(ASMJIT_DISABLE_BUILDER)
+enum X86LayoutLabelFlags {
+  kX86LayoutLabelSeen = 0x01,            //!< Label was already serialized.
+  kX86LayoutLabelLoop = 0x02             //!< Label is a target of a backward jump.
+};
+
+static ASMJIT_INLINE bool x86IsLayoutInst(const CBNode* node) noexcept {
+  return node->getType() == CBNode::kNodeInst || node->getType() == CBNode::kNodeFuncCall;
+}
+
+static ASMJIT_INLINE bool x86IsJcc(uint32_t instId) noexcept {
+  return X86Inst::getInst(instId).getEncodingType() == X86Inst::kEncodingX86Jcc;
+}
+
+static ASMJIT_INLINE bool x86IsJump(uint32_t instId) noexcept {
+  uint32_t encoding = X86Inst::getInst(instId).getEncodingType();
+  return encoding == X86Inst::kEncodingX86Jcc ||
+         encoding == X86Inst::kEncodingX86Jmp ||
+         encoding == X86Inst::kEncodingX86JecxzLoop;
+}
+
+static ASMJIT_INLINE bool x86IsBranch(uint32_t instId) noexcept {
+  return x86IsJump(instId) || instId == X86Inst::kIdCall || instId == X86Inst::kIdRet;
+}
+
+// Instructions that are macro-fused with a following jcc.
+static ASMJIT_INLINE bool x86IsFusable(uint32_t instId) noexcept {
+  switch (instId) {
+    case X86Inst::kIdCmp:
+    case X86Inst::kIdTest:
+    case X86Inst::kIdAdd:
+    case X86Inst::kIdSub:
+    case X86Inst::kIdAnd:
+    case X86Inst::kIdInc:
+    case X86Inst::kIdDec:
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+// Get if `op` is ESP|RSP register.
+static ASMJIT_INLINE bool x86IsStackPointer(const Operand& op) noexcept {
+  return X86Reg::isGpd(op, X86Gp::kIdSp) || X86Reg::isGpq(op, X86Gp::kIdSp);
+}
+
+// Get if an instruction of `size` bytes emitted at `offset` crosses or ends
+// on a 32-byte boundary.
+static ASMJIT_INLINE bool x86CrossesBoundary(size_t offset, uint32_t size) noexcept {
+  return (offset >> 5) != ((offset + size) >> 5);
+}
+
+// Get index of a label the `node` jumps to, or `Globals::kInvalidIndex`.
+static ASMJIT_INLINE size_t x86GetJumpTarget(const CBInst* node) noexcept {
+  uint32_t opCount = node->getOpCount();
+  if (!opCount || !x86IsJump(node->getInstId()))
+    return Globals::kInvalidIndex;
+
+  const Operand& op = node->getOpArray()[opCount - 1];
+  if (!op.isLabel())
+    return Globals::kInvalidIndex;
+
+  return Operand::unpackId(op.getId());
+}
+
+// Get the next node that may emit code, skips comments and sentinels.
+static ASMJIT_INLINE CBNode* x86GetNextCodeNode(CBNode* node) noexcept {
+  node = node->getNext();
+  while (node && (node->getType() == CBNode::kNodeComment || node->getType() == CBNode::kNodeSentinel))
+    node = node->getNext();
+  return node;
+}
+
+// Get size of jmp|jcc|call to `label` if emitted at `offset`. It mirrors the
+// selection of short and long forms done by `X86Assembler`, because the label
+// doesn't exist in the scratch assembler used to measure other instructions.
+static uint32_t x86GetJumpSize(Assembler* dst, const CBInst* node, const Label& label, size_t offset) noexcept {
+  uint32_t instId = node->getInstId();
+  uint32_t options = node->getOptions();
+
+  if (instId == X86Inst::kIdCall)
+    return 5;
+
+  bool isJcc = x86IsJcc(instId);
+  if (!isJcc && instId != X86Inst::kIdJmp)
+    return 0;
+
+  LabelEntry* le = dst->getCode()->getLabelEntry(label);
+  if (!le) return 0;
+
+  uint32_t prefix = 0;
+  if (isJcc && (dst->getGlobalHints() & CodeEmitter::kHintPredictedJumps))
+    prefix = static_cast<uint32_t>((options & X86Inst::kOptionTaken   ) != 0) +
+             static_cast<uint32_t>((options & X86Inst::kOptionNotTaken) != 0) ;
+
+  uint32_t longSize = isJcc ? 6 : 5;
+  if (le->isBound()) {
+    if (options & X86Inst::kOptionLongForm)
+      return prefix + longSize;
+
+    intptr_t rel = le->getOffset() - static_cast<intptr_t>(offset + prefix + 2);
+    return prefix + (Utils::isInt8(rel) ? 2 : longSize);
+  }
+  else {
+    return prefix + ((options & X86Inst::kOptionShortForm) ? 2 : longSize);
+  }
+}
+
+// Get size of `node` if emitted at `offset`, zero if unknown.
+static uint32_t x86GetInstSize(X86Assembler& scratch, Assembler* dst, const CBInst* node, size_t offset) noexcept {
+  uint32_t opCount = node->getOpCount();
+  const Operand* opArray = node->getOpArray();
+
+  if (opCount == 1 && opArray[0].isLabel())
+    return x86GetJumpSize(dst, node, opArray[0].as<Label>(), offset);
+
+  // Instructions that reference labels of `dst` fail in the scratch assembler.
+  // Reserved options are masked out as the scratch assembler has no logger.
+  scratch.setOffset(0);
+  scratch.setOptions(node->getOptions() & ~CodeEmitter::kOptionReservedMask);
+  scratch.setExtraReg(node->getExtraReg());
+
+  if (scratch.emitOpArray(node->getInstId(), opArray, opCount) != kErrorOk) {
+    scratch.resetLastError();
+    return 0;
+  }
+
+  return static_cast<uint32_t>(scratch.getOffset());
+}
+
+Error X86Internal::serializeWithLayout(CodeBuilder* cb, X86Assembler* dst) {
+  CodeHolder* code = dst->getCode();
+  uint32_t hints = dst->getGlobalHints();
+  uint32_t loopAlignment = code->getLoopAlignment();
+
+  CBNode* node_;
+  size_t labelsCount = code->getLabelsCount();
+  uint8_t* labelFlags = nullptr;
+
+  // Find loop headers - labels that are bound before a jump that targets them.
+  if ((hints & CodeEmitter::kHintAlignLoops) && loopAlignment > 1 && labelsCount) {
+    labelFlags = static_cast<uint8_t*>(Internal::allocMemory(labelsCount));
+    if (ASMJIT_UNLIKELY(!labelFlags))
+      return DebugUtils::errored(kErrorNoHeapMemory);
+
+    ::memset(labelFlags, 0, labelsCount);
+    for (node_ = cb->getFirstNode(); node_; node_ = node_->getNext()) {
+      if (node_->getType() == CBNode::kNodeLabel) {
+        size_t index = Operand::unpackId(node_->as<CBLabel>()->getId());
+        if (index < labelsCount)
+          labelFlags[index] |= kX86LayoutLabelSeen;
+      }
+      else if (node_->getType() == CBNode::kNodeInst) {
+        size_t index = x86GetJumpTarget(node_->as<CBInst>());
+        if (index < labelsCount && (labelFlags[index] & kX86LayoutLabelSeen))
+          labelFlags[index] |= kX86LayoutLabelLoop;
+      }
+    }
+  }
+
+  // Instructions are measured by a scratch assembler before they are emitted.
+  CodeHolder scratchCode;
+  X86Assembler scratch;
+
+  Error err = kErrorOk;
+  bool alignBranches = (hints & CodeEmitter::kHintAlignBranches) != 0;
+
+  if (alignBranches) {
+    err = scratchCode.init(code->getCodeInfo());
+    if (!err) {
+      scratchCode.addGlobalHints(hints & CodeEmitter::kHintPredictedJumps);
+      err = scratchCode.attach(&scratch);
+    }
+  }
+
+  size_t padding = 0;
+  CBNode* fusedJcc = nullptr;
+
+  // Unwind information describes the epilog by sizes of its instructions, so
+  // nothing is inserted from the function's exit label to the next label,
+  // which is bound by `X86RAPass` right after the epilog.
+  CBNode* exitNode = nullptr;
+  bool inEpilog = false;
+
+  node_ = cb->getFirstNode();
+  while (node_ && !err) {
+    size_t offset = dst->getOffset();
+
+#if !defined(ASMJIT_DISABLE_COMPILER)
+    if (node_->getType() == CBNode::kNodeFunc)
+      exitNode = node_->as<CCFunc>()->getExitNode();
+#endif // !ASMJIT_DISABLE_COMPILER
+
+    if (node_->getType() == CBNode::kNodeLabel)
+      inEpilog = node_ == exitNode;
+
+    if (labelFlags && !inEpilog && node_->getType() == CBNode::kNodeLabel) {
+      size_t index = Operand::unpackId(node_->as<CBLabel>()->getId());
+      if (index < labelsCount && (labelFlags[index] & kX86LayoutLabelLoop))
+        err = dst->_align(kAlignCode, loopAlignment, true);
+    }
+    else if (alignBranches && !inEpilog && x86IsLayoutInst(node_) && node_ != fusedJcc) {
+      CBInst* node = node_->as<CBInst>();
+      uint32_t instId = node->getInstId();
+      uint32_t size = 0;
+
+      // Stack pointer is only adjusted by the prolog, which must not be padded.
+      if (x86IsFusable(instId) && !x86IsStackPointer(node->getOpArray()[0])) {
+        // Macro-fused pair must be kept together, check both instructions.
+        CBNode* next = x86GetNextCodeNode(node_);
+        if (next && next->getType() == CBNode::kNodeInst && x86IsJcc(next->as<CBInst>()->getInstId())) {
+          uint32_t size0 = x86GetInstSize(scratch, dst, node, offset);
+          uint32_t size1 = size0 ? x86GetInstSize(scratch, dst, next->as<CBInst>(), offset + size0) : 0;
+
+          size = size1 ? size0 + size1 : 0;
+          fusedJcc = next;
+        }
+      }
+      else if (x86IsBranch(instId)) {
+        size = x86GetInstSize(scratch, dst, node, offset);
+      }
+
+      if (size && size < 32 && x86CrossesBoundary(offset, size))
+        err = dst->_align(kAlignCode, 32, true);
+    }
+
+    if (err) break;
+    padding += dst->getOffset() - offset;
+
+    err = cb->serializeNode(dst, node_);
+    node_ = node_->getNext();
+  }
+
+  if (labelFlags)
+    Internal::releaseMemory(labelFlags);
+
+  code->_layoutPaddingSize += static_cast<uint32_t>(padding);
+  return err;
+}
+
+Error X86Internal::serialize(CodeBuilder* cb, CodeEmitter* dst) {
+  // Code layout requires to know the position of each node in the output
+  // buffer, which is only possible when serializing to `X86Assembler`.
+  if (dst->getType() == CodeEmitter::kTypeAssembler &&
+      ArchInfo::isX86Family(dst->getArchType()) &&
+      (dst->getGlobalHints() & (CodeEmitter::kHintAlignLoops | CodeEmitter::kHintAlignBranches)) != 0)
+    return serializeWithLayout(cb, static_cast<X86Assembler*>(dst));
+
+  return cb->CodeBuilder::serialize(dst);
+}
+#endif // !ASMJIT_DISABLE_BUILDER
+
+// ============================================================================
+// [asmjit::X86Internal - Test]
+// ============================================================================
+
+#if defined(ASMJIT_TEST)
+//! \internal
+//!
+//! CFA rule at a particular code location, `regId` is a DWARF register number
+//! or `Globals::kInvalidRegId` if the CFA is described by an expression.
+struct X86EhFrameTestCfa {
+  uint32_t regId;
+  uint32_t offset;
+};
+
+static uint32_t x86EhFrameTestReadULeb(const uint8_t*& p) noexcept {
+  uint32_t x = 0;
+  uint32_t shift = 0;
+  uint32_t b;
+
+  do {
+    b = *p++;
+    x |= (b & 0x7F) << shift;
+    shift += 7;
+  } while (b & 0x80);
+
+  return x;
+}
+
+// Interpret the FDE's call frame instructions up to (and including) `at`.
+static X86EhFrameTestCfa x86EhFrameTestCfaAt(const uint8_t* data, uint32_t gpSize, uint32_t at) noexcept {
+  X86EhFrameTestCfa cfa = { gpSize == 8 ? 7U : 4U, gpSize };
+  X86EhFrameTestCfa saved = cfa;
+
+  const uint8_t* fde = data + 4 + Utils::readU32u(data);
+  const uint8_t* end = fde + 4 + Utils::readU32u(fde);
+  const uint8_t* p = fde + 8 + gpSize * 2;
+
+  p += x86EhFrameTestReadULeb(p);
+  uint32_t loc = 0;
+
+  while (p < end) {
+    uint32_t op = *p++;
+    uint32_t delta = 0;
+
+    if ((op & 0xC0) == kX86DwCfaAdvanceLoc) {
+      delta = op & 0x3F;
+    }
+    else if ((op & 0xC0) == kX86DwCfaOffset) {
+      x86EhFrameTestReadULeb(p);
+    }
+    else if (op == kX86DwCfaAdvanceLoc1) {
+      delta = *p++;
+    }
+    else if (op == kX86DwCfaAdvanceLoc2) {
+      delta = Utils::readU16u(p);
+      p += 2;
+    }
+    else if (op == kX86DwCfaAdvanceLoc4) {
+      delta = Utils::readU32u(p);
+      p += 4;
+    }
+    else if (op == kX86DwCfaDefCfa) {
+      cfa.regId = x86EhFrameTestReadULeb(p);
+      cfa.offset = x86EhFrameTestReadULeb(p);
+    }
+    else if (op == kX86DwCfaDefCfaRegister) {
+      cfa.regId = x86EhFrameTestReadULeb(p);
+    }
+    else if (op == kX86DwCfaDefCfaOffset) {
+      cfa.offset = x86EhFrameTestReadULeb(p);
+    }
+    else if (op == kX86DwCfaDefCfaExpression) {
+      p += x86EhFrameTestReadULeb(p);
+      cfa.regId = Globals::kInvalidRegId;
+      cfa.offset = 0;
+    }
+    else if (op == kX86DwCfaRememberState) {
+      saved = cfa;
+    }
+    else if (op == kX86DwCfaRestoreState) {
+      cfa = saved;
+    }
+
+    loc += delta;
+    if (loc > at)
+      break;
+  }
+
+  return cfa;
+}
+
+static void x86EhFrameTestFunc(uint32_t archType, uint32_t ccId, uint32_t gpRegs, uint32_t frameSize, uint32_t frameAlignment, bool preserveFP, uint32_t tailSize) {
+  FuncDetail func;
+  EXPECT(func.init(FuncSignature0<void>(ccId)) == kErrorOk);
+
+  FuncFrameInfo ffi;
+  ffi.setDirtyRegs(X86Reg::kKindGp, gpRegs);
+  ffi.setStackFrameSize(frameSize);
+  ffi.setStackFrameAlignment(frameAlignment);
+  if (preserveFP) ffi.enablePreservedFP();
+
+  FuncFrameLayout layout;
+  EXPECT(layout.init(func, ffi) == kErrorOk);
+
+  CodeHolder code;
+  code.init(CodeInfo(archType));
+  X86Assembler a(&code);
+
+  EXPECT(FuncUtils::emitProlog(&a, layout) == kErrorOk);
+  uint32_t prologEnd = static_cast<uint32_t>(a.getOffset());
+
+  a.nop();
+  a.nop();
+  uint32_t epilogStart = static_cast<uint32_t>(a.getOffset());
+
+  EXPECT(FuncUtils::emitEpilog(&a, layout) == kErrorOk);
+  uint32_t epilogEnd = static_cast<uint32_t>(a.getOffset());
+
+  // Code after the epilog, like blocks injected by the register allocator.
+  for (uint32_t i = 0; i < tailSize; i++)
+    a.nop();
+  uint32_t funcSize = static_cast<uint32_t>(a.getOffset());
+
+  uint8_t data[FuncFrameLayout::kMaxEhFrameSize];
+  EXPECT(layout.buildEhFrame(data, 0, funcSize, epilogEnd) != 0);
+
+  uint32_t gpSize = archType == ArchInfo::kTypeX86 ? 4 : 8;
+  uint32_t spId = gpSize == 8 ? 7 : 4;
+  uint32_t bpId = gpSize == 8 ? 6 : 5;
+
+  X86EhFrameTestCfa body = x86EhFrameTestCfaAt(data, gpSize, prologEnd);
+  if (preserveFP) {
+    EXPECT(body.regId == bpId && body.offset == gpSize * 2,
+      "CFA must be zbp + %u after the prolog, not {reg:%u off:%u}", gpSize * 2, body.regId, body.offset);
+  }
+  else if (layout.hasDynamicAlignment()) {
+    EXPECT(body.regId == Globals::kInvalidRegId,
+      "CFA must be described by an expression after the dynamically aligned prolog");
+  }
+  else {
+    uint32_t expected = gpSize * (1 + Utils::bitCount(layout.getSavedRegs(X86Reg::kKindGp))) + layout.getStackAdjustment();
+    EXPECT(body.regId == spId && body.offset == expected,
+      "CFA must be zsp + %u after the prolog, not {reg:%u off:%u}", expected, body.regId, body.offset);
+
+    // The last instruction of the prolog must be described exactly where it ends.
+    if (prologEnd) {
+      X86EhFrameTestCfa before = x86EhFrameTestCfaAt(data, gpSize, prologEnd - 1);
+      EXPECT(before.offset != body.offset, "CFA rule of the last prolog instruction is misplaced");
+    }
+  }
+
+  X86EhFrameTestCfa epilog = x86EhFrameTestCfaAt(data, gpSize, epilogStart);
+  EXPECT(epilog.regId == body.regId && epilog.offset == body.offset,
+    "CFA must not change before the epilog starts");
+
+  X86EhFrameTestCfa ret = x86EhFrameTestCfaAt(data, gpSize, epilogEnd - 1);
+  EXPECT(ret.regId == spId && ret.offset == gpSize,
+    "CFA must be zsp + %u at 'ret', not {reg:%u off:%u}", gpSize, ret.regId, ret.offset);
+
+  for (uint32_t i = epilogEnd; i < funcSize; i++) {
+    X86EhFrameTestCfa tail = x86EhFrameTestCfaAt(data, gpSize, i);
+    EXPECT(tail.regId == body.regId && tail.offset == body.offset,
+      "CFA after the epilog must match the body, not {reg:%u off:%u}", tail.regId, tail.offset);
+  }
+}
+
+UNIT(x86_eh_frame) {
+  uint32_t rbx = Utils::mask(X86Gp::kIdBx);
+  uint32_t rsi = Utils::mask(X86Gp::kIdSi);
+  uint32_t rdi = Utils::mask(X86Gp::kIdDi);
+  uint32_t r12 = Utils::mask(12);
+  uint32_t r15 = Utils::mask(15);
+
+  for (uint32_t tailSize = 0; tailSize <= 2; tailSize += 2) {
+    INFO("Checking .eh_frame of X64 functions (%u bytes after the epilog)", tailSize);
+    x86EhFrameTestFunc(ArchInfo::kTypeX64, CallConv::kIdX86SysV64, 0, 0, 0, false, tailSize);
+    x86EhFrameTestFunc(ArchInfo::kTypeX64, CallConv::kIdX86SysV64, rbx | r12 | r15, 40, 0, false, tailSize);
+    x86EhFrameTestFunc(ArchInfo::kTypeX64, CallConv::kIdX86SysV64, rbx | r15, 512, 0, false, tailSize);
+    x86EhFrameTestFunc(ArchInfo::kTypeX64, CallConv::kIdX86SysV64, rbx | r12, 200, 0, true, tailSize);
+    x86EhFrameTestFunc(ArchInfo::kTypeX64, CallConv::kIdX86SysV64, rbx, 64, 32, false, tailSize);
+    x86EhFrameTestFunc(ArchInfo::kTypeX64, CallConv::kIdX86Win64, rbx | rsi | rdi, 32, 0, false, tailSize);
+
+    INFO("Checking .eh_frame of X86 functions (%u bytes after the epilog)", tailSize);
+    x86EhFrameTestFunc(ArchInfo::kTypeX86, CallConv::kIdX86CDecl, rbx | rsi | rdi, 16, 0, false, tailSize);
+    x86EhFrameTestFunc(ArchInfo::kTypeX86, CallConv::kIdX86CDecl, rbx, 300, 0, true, tailSize);
+    x86EhFrameTestFunc(ArchInfo::kTypeX86, CallConv::kIdX86CDecl, rsi, 64, 32, false, tailSize);
+  }
+}
+
+#if !defined(ASMJIT_DISABLE_COMPILER)
+UNIT(x86_layout) {
+  INFO("Checking that loop alignment is padded by multi-byte NOPs");
+
+  CodeInfo ci(ArchInfo::kTypeX64);
+  CodeHolder code;
+  EXPECT(code.init(ci) == kErrorOk);
+
+  // `kHintOptimizedAlign` is not set, the layout pads by multi-byte NOPs anyway.
+  code.addGlobalHints(CodeEmitter::kHintAlignLoops);
+  code.setLoopAlignment(32);
+
+  X86Assembler a(&code);
+  X86Compiler cc(&code);
+
+  cc.addFunc(FuncSignature1<int, int>(CallConv::kIdX86SysV64));
+  X86Gp n = cc.newInt32("n");
+  X86Gp sum = cc.newInt32("sum");
+  Label L_Loop = cc.newLabel();
+
+  cc.setArg(0, n);
+  cc.mov(sum, 1);
+  cc.bind(L_Loop);
+  cc.add(sum, sum);
+  cc.dec(n);
+  cc.jnz(L_Loop);
+  cc.ret(sum);
+  cc.endFunc();
+  EXPECT(cc.finalize() == kErrorOk);
+  code.sync();
+
+  const CodeBuffer& buf = code.getSectionEntry(0)->getBuffer();
+  EXPECT(code.getLayoutPaddingSize() > 1,
+    "Loop header must be padded, not by %u bytes", static_cast<unsigned int>(code.getLayoutPaddingSize()));
+
+  for (size_t i = 1; i < buf.getLength(); i++)
+    EXPECT(buf.getData()[i - 1] != 0x90 || buf.getData()[i] != 0x90,
+      "Loop header must not be padded by single-byte NOPs");
+}
+
+//! \internal
+//!
+//! Compile a function that has a prolog and epilog with `nopCount` bytes long
+//! body and build its .eh_frame into `data`.
+struct X86LayoutTestFunc {
+  uint32_t epilogStart;
+  uint32_t epilogEnd;
+  uint8_t data[FuncFrameLayout::kMaxEhFrameSize];
+};
+
+static void x86LayoutTestFunc(X86LayoutTestFunc& out, uint32_t hints, uint32_t nopCount) {
+  CodeInfo ci(ArchInfo::kTypeX64);
+  CodeHolder code;
+  EXPECT(code.init(ci) == kErrorOk);
+  code.addGlobalHints(hints);
+
+  X86Assembler a(&code);
+  X86Compiler cc(&code);
+
+  CCFunc* func = cc.addFunc(FuncSignature0<void>(CallConv::kIdX86SysV64));
+  func->getFrameInfo().enablePreservedFP();
+  func->getFrameInfo().addDirtyRegs(X86Reg::kKindGp, Utils::mask(X86Gp::kIdBx));
+  Label exitLabel = func->getExitLabel();
+
+  for (uint32_t i = 0; i < nopCount; i++)
+    cc.nop();
+  cc.endFunc();
+
+  EXPECT(cc.finalize() == kErrorOk);
+  code.sync();
+
+  EXPECT(code.getUnwindEntries().getLength() == 1);
+  const UnwindEntry* entry = code.getUnwindEntries()[0];
+
+  out.epilogStart = static_cast<uint32_t>(code.getLabelOffset(exitLabel));
+  out.epilogEnd = static_cast<uint32_t>(code.getLabelOffset(entry->getEpilogLabelId()));
+
+  size_t funcSize = static_cast<size_t>(code.getLabelOffset(entry->getEndLabelId()));
+  EXPECT(entry->getLayout().buildEhFrame(out.data, 0, funcSize, out.epilogEnd) != 0);
+}
+
+UNIT(x86_layout_eh_frame) {
+  INFO("Checking that branch alignment doesn't pad the epilog described by .eh_frame");
+
+  // Each body size moves 'ret' to a different offset within 32 bytes, one
+  // of them ends exactly on a 32-byte boundary.
+  for (uint32_t nopCount = 0; nopCount < 32; nopCount++) {
+    X86LayoutTestFunc ref;
+    X86LayoutTestFunc aligned;
+
+    x86LayoutTestFunc(ref, 0, nopCount);
+    x86LayoutTestFunc(aligned, CodeEmitter::kHintAlignBranches, nopCount);
+
+    uint32_t epilogSize = ref.epilogEnd - ref.epilogStart;
+    EXPECT(aligned.epilogEnd - aligned.epilogStart == epilogSize,
+      "Epilog must not be padded (%u byte body)", nopCount);
+
+    for (uint32_t i = 1; i <= epilogSize; i++) {
+      X86EhFrameTestCfa refCfa = x86EhFrameTestCfaAt(ref.data, 8, ref.epilogEnd - i);
+      X86EhFrameTestCfa alignedCfa = x86EhFrameTestCfaAt(aligned.data, 8, aligned.epilogEnd - i);
+      EXPECT(refCfa.regId == alignedCfa.regId && refCfa.offset == alignedCfa.offset,
+        "CFA %u bytes before the end of the epilog doesn't match (%u byte body)", i, nopCount);
+    }
+  }
+}
+#endif // !ASMJIT_DISABLE_COMPILER
+#endif // ASMJIT_TEST
+
 } // asmjit namespace
 
 // [Api-End]
@@ -20,6 +20,13 @@
 
 namespace asmjit {
 
+// ============================================================================
+// [Forward Declarations]
+// ============================================================================
+
+class X86Assembler;
+class CodeBuilder;
+
 //! \addtogroup asmjit_base
 //! \{
 
@@ -48,6 +55,9 @@ struct X86Internal {
   //! Emit function epilog.
   static Error emitEpilog(X86Emitter* emitter, const FuncFrameLayout& layout);
 
+  //! Build DWARF `.eh_frame` data that matches `emitProlog()` and `emitEpilog()`.
+  static size_t buildEhFrame(const FuncFrameLayout& layout, uint8_t* dst, uint64_t funcAddress, size_t funcSize, size_t epilogEnd) noexcept;
+
   //! Emit a pure move operation between two registers or the same type or
   //! between a register and its home slot. This function does not handle
   //! register conversion.
@@ -66,6 +76,16 @@ struct X86Internal {
     const Operand_& src_, uint32_t srcTypeId, bool avxEnabled, const char* comment = nullptr);
 
   static Error allocArgs(X86Emitter* emitter, const FuncFrameLayout& layout, const FuncArgsMapper& args);
+
+#if !defined(ASMJIT_DISABLE_BUILDER)
+  //! Serialize `cb` to `dst` and align loop headers and branches as requested
+  //! by `CodeEmitter::kHintAlignLoops` and `CodeEmitter::kHintAlignBranches`.
+  static Error serializeWithLayout(CodeBuilder* cb, X86Assembler* dst);
+
+  //! Serialize `cb` to `dst`, uses `serializeWithLayout()` if `dst` is an
+  //! `X86Assembler` and loop or branch alignment was requested.
+  static Error serialize(CodeBuilder* cb, CodeEmitter* dst);
+#endif // !ASMJIT_DISABLE_BUILDER
 };
 
 //! \}
@@ -0,0 +1,249 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Export]
+#define ASMJIT_EXPORTS
+
+// [Guard]
+#include "../asmjit_build.h"
+#if defined(ASMJIT_BUILD_X86) && !defined(ASMJIT_DISABLE_BUILDER)
+
+// [Dependencies]
+#include "../x86/x86inst.h"
+#include "../x86/x86jump.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+// ============================================================================
+// [asmjit::X86JumpPass - Helpers]
+// ============================================================================
+
+enum {
+  kX86JumpMaxHops = 16,                  //!< Maximum number of jumps followed when threading.
+  kX86JumpMaxIterations = 8              //!< Maximum number of iterations over all nodes.
+};
+
+//! \internal
+//!
+//! Get whether `node` doesn't emit any code.
+static ASMJIT_INLINE bool X86JumpPass_isEmpty(const CBNode* node) noexcept {
+  uint32_t type = node->getType();
+  return type == CBNode::kNodeLabel || type == CBNode::kNodeComment;
+}
+
+//! \internal
+//!
+//! Get whether `jump` is a jump to a label that can be changed.
+static ASMJIT_INLINE bool X86JumpPass_isFollowed(const CBNode* node) noexcept {
+  if (!node->isJmpOrJcc()) return false;
+
+  const CBJump* jump = static_cast<const CBJump*>(node);
+  return jump->getTarget() != nullptr && jump->getOpCount() == 1 && jump->getOpArray()[0].isLabel();
+}
+
+//! \internal
+//!
+//! Get the condition of a `jcc` instruction or `kInvalidValue`.
+static uint32_t X86JumpPass_condFromJcc(uint32_t instId) noexcept {
+  for (uint32_t cond = 0; cond < x86::kCondCount; cond++)
+    if (X86Inst::condToJcc(cond) == instId)
+      return cond;
+  return kInvalidValue;
+}
+
+//! \internal
+//!
+//! Get the first node starting at `node` that emits code, or null.
+static ASMJIT_INLINE CBNode* X86JumpPass_skipEmpty(CBNode* node) noexcept {
+  while (node && X86JumpPass_isEmpty(node))
+    node = node->getNext();
+  return node;
+}
+
+//! \internal
+//!
+//! Get whether `label` is reached by falling through `node`.
+static ASMJIT_INLINE bool X86JumpPass_fallsTo(CBNode* node, CBLabel* label) noexcept {
+  node = node->getNext();
+  while (node && X86JumpPass_isEmpty(node)) {
+    if (node == label) return true;
+    node = node->getNext();
+  }
+  return false;
+}
+
+//! \internal
+//!
+//! Remove `jump` from the list of jumps of its target.
+//!
+//! The register allocator retargets jumps without updating these lists, so
+//! the jump doesn't have to be there.
+static void X86JumpPass_unlink(CBJump* jump) noexcept {
+  CBLabel* label = jump->_target;
+  if (!label) return;
+
+  CBJump** pPrev = &label->_from;
+  while (*pPrev) {
+    if (*pPrev == jump) {
+      *pPrev = jump->_jumpNext;
+      label->subNumRefs();
+      break;
+    }
+    pPrev = &(*pPrev)->_jumpNext;
+  }
+
+  jump->_target = nullptr;
+  jump->_jumpNext = nullptr;
+}
+
+//! \internal
+static void X86JumpPass_retarget(CBJump* jump, CBLabel* label) noexcept {
+  X86JumpPass_unlink(jump);
+
+  jump->getOpArray()[0].copyFrom(label->getLabel());
+  jump->_target = label;
+  jump->_jumpNext = label->_from;
+  label->_from = jump;
+  label->addNumRefs();
+
+  // The new target may be too far for a short jump.
+  jump->delOptions(X86Inst::kOptionShortForm);
+}
+
+//! \internal
+//!
+//! Get the label where `jump` ends up if the jumps it reaches are followed.
+static CBLabel* X86JumpPass_getFinalTarget(CBJump* jump) noexcept {
+  CBLabel* label = jump->getTarget();
+  uint32_t instId = jump->getInstId();
+
+  for (uint32_t i = 0; i < kX86JumpMaxHops; i++) {
+    CBNode* node = X86JumpPass_skipEmpty(label->getNext());
+    if (!node || !X86JumpPass_isFollowed(node))
+      break;
+
+    // A `jmp` is always taken, a `jcc` only if it has the same condition
+    // (flags can't change as no code is executed in between).
+    CBJump* next = static_cast<CBJump*>(node);
+    if (!next->isJmp() && next->getInstId() != instId)
+      break;
+
+    if (next->getTarget() == label)
+      break;
+    label = next->getTarget();
+  }
+
+  return label;
+}
+
+// ============================================================================
+// [asmjit::X86JumpPass - Construction / Destruction]
+// ============================================================================
+
+X86JumpPass::X86JumpPass() noexcept
+  : CBPass("X86JumpPass"),
+    _threadedCount(0),
+    _invertedCount(0),
+    _removedCount(0) {}
+X86JumpPass::~X86JumpPass() noexcept {}
+
+// ============================================================================
+// [asmjit::X86JumpPass - Interface]
+// ============================================================================
+
+Error X86JumpPass::process(Zone* zone) noexcept {
+  ASMJIT_UNUSED(zone);
+
+  _threadedCount = 0;
+  _invertedCount = 0;
+  _removedCount = 0;
+
+  CodeBuilder* cb = _cb;
+
+  for (uint32_t iteration = 0; iteration < kX86JumpMaxIterations; iteration++) {
+    bool changed = false;
+    CBNode* node_ = cb->getFirstNode();
+
+    while (node_) {
+      if (!X86JumpPass_isFollowed(node_)) {
+        node_ = node_->getNext();
+        continue;
+      }
+
+      CBJump* jump = static_cast<CBJump*>(node_);
+
+      // Jump threading.
+      CBLabel* target = X86JumpPass_getFinalTarget(jump);
+      if (target != jump->getTarget()) {
+        X86JumpPass_retarget(jump, target);
+        _threadedCount++;
+        changed = true;
+      }
+
+      // Jcc inversion - `jcc L1; jmp L2; L1:` -> `jncc L2; L1:`.
+      if (jump->isJcc()) {
+        CBNode* next = jump->getNext();
+        while (next && next->getType() == CBNode::kNodeComment)
+          next = next->getNext();
+
+        uint32_t cond = X86JumpPass_condFromJcc(jump->getInstId());
+        if (next && next->isJmp() && X86JumpPass_isFollowed(next) &&
+            cond != kInvalidValue &&
+            X86JumpPass_fallsTo(next, jump->getTarget())) {
+          CBJump* jmp = static_cast<CBJump*>(next);
+
+          uint32_t options = jump->getOptions();
+          uint32_t hints = options & (X86Inst::kOptionTaken | X86Inst::kOptionNotTaken);
+
+          options &= ~(X86Inst::kOptionTaken | X86Inst::kOptionNotTaken);
+          if (hints == X86Inst::kOptionTaken) options |= X86Inst::kOptionNotTaken;
+          if (hints == X86Inst::kOptionNotTaken) options |= X86Inst::kOptionTaken;
+
+          jump->setInstId(X86Inst::condToJcc(X86Inst::negateCond(cond)));
+          jump->setOptions(options);
+
+          if (options & X86Inst::kOptionTaken)
+            jump->orFlags(CBNode::kFlagIsTaken);
+          else
+            jump->andNotFlags(CBNode::kFlagIsTaken);
+
+          X86JumpPass_retarget(jump, jmp->getTarget());
+          X86JumpPass_unlink(jmp);
+          cb->removeNode(jmp);
+
+          _invertedCount++;
+          changed = true;
+        }
+      }
+
+      // Empty jump - `jmp L1; L1:`.
+      node_ = jump->getNext();
+      if (X86JumpPass_fallsTo(jump, jump->getTarget())) {
+        X86JumpPass_unlink(jump);
+        cb->removeNode(jump);
+
+        _removedCount++;
+        changed = true;
+      }
+    }
+
+    if (!changed)
+      break;
+  }
+
+  return kErrorOk;
+}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // ASMJIT_BUILD_X86 && !ASMJIT_DISABLE_BUILDER
@@ -0,0 +1,101 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _ASMJIT_X86_X86JUMP_H
+#define _ASMJIT_X86_X86JUMP_H
+
+#include "../asmjit_build.h"
+#if !defined(ASMJIT_DISABLE_BUILDER)
+
+// [Dependencies]
+#include "../base/codebuilder.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+//! \addtogroup asmjit_x86
+//! \{
+
+// ============================================================================
+// [asmjit::X86JumpPass]
+// ============================================================================
+
+//! X86/X64 jump threading and branch-to-branch elimination.
+//!
+//! Performs the following transformations until nothing changes:
+//!
+//!   - Jump threading - a jump to a label followed by an unconditional `jmp`
+//!     (or by a `jcc` of the same condition if the jump is that `jcc`) is
+//!     retargeted to the final destination.
+//!   - Jcc inversion - `jcc L1; jmp L2; L1:` becomes `jncc L2; L1:`.
+//!   - Empty jumps - a jump to a label that immediately follows it is removed.
+//!
+//! Only jumps to labels are considered; indirect jumps and jumps emitted with
+//! `kOptionUnfollow` are never changed. Labels are never removed, so code that
+//! references them by other means (data, `lea`, or `CodeHolder`) still works.
+//!
+//! The pass can be added to `X86Compiler` either before the register allocator
+//! (`insertPass(0, ...)`), so the allocator sees the simplified control flow
+//! and removes forwarding blocks that became unreachable, or after it
+//! (`addPass()`), which also threads jumps the allocator generated:
+//!
+//! ~~~
+//! X86Compiler cc(&code);
+//! cc.insertPass(0, cc.newPassT<X86JumpPass>());
+//! ~~~
+class ASMJIT_VIRTAPI X86JumpPass : public CBPass {
+public:
+  ASMJIT_NONCOPYABLE(X86JumpPass)
+  typedef CBPass Base;
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  //! Create a new `X86JumpPass` instance.
+  ASMJIT_API X86JumpPass() noexcept;
+  //! Destroy the `X86JumpPass` instance.
+  ASMJIT_API virtual ~X86JumpPass() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  ASMJIT_API virtual Error process(Zone* zone) noexcept override;
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  //! Get number of jumps retargeted by the last `process()`.
+  ASMJIT_INLINE uint32_t getThreadedCount() const noexcept { return _threadedCount; }
+  //! Get number of `jcc` + `jmp` pairs inverted by the last `process()`.
+  ASMJIT_INLINE uint32_t getInvertedCount() const noexcept { return _invertedCount; }
+  //! Get number of empty jumps removed by the last `process()`.
+  ASMJIT_INLINE uint32_t getRemovedCount() const noexcept { return _removedCount; }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  uint32_t _threadedCount;               //!< Number of retargeted jumps.
+  uint32_t _invertedCount;               //!< Number of inverted `jcc` + `jmp` pairs.
+  uint32_t _removedCount;                //!< Number of removed empty jumps.
+};
+
+//! \}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // !ASMJIT_DISABLE_BUILDER
+#endif // _ASMJIT_X86_X86JUMP_H
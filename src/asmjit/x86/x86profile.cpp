@@ -0,0 +1,461 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Export]
+#define ASMJIT_EXPORTS
+
+// [Guard]
+#include "../asmjit_build.h"
+#if defined(ASMJIT_BUILD_X86) && !defined(ASMJIT_DISABLE_COMPILER)
+
+// [Dependencies]
+#include "../x86/x86compiler.h"
+#include "../x86/x86jump.h"
+#include "../x86/x86profile.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+// ============================================================================
+// [asmjit::X86ProfileBlock]
+// ============================================================================
+
+//! \internal
+//!
+//! A block of nodes that starts at a label, after a jump, or after a `ret`.
+struct X86ProfileBlock {
+  CBNode* first;                         //!< First node of the block.
+  CBNode* last;                          //!< Last node of the block.
+  uint32_t site;                         //!< Site that counts the block or `kInvalidValue`.
+  bool cold;                             //!< Block is cold and will be moved.
+};
+
+// ============================================================================
+// [asmjit::X86ProfilePass - Helpers]
+// ============================================================================
+
+//! \internal
+//!
+//! Get whether `node` is a site (except the function entry).
+static ASMJIT_INLINE bool X86ProfilePass_isSite(const CBNode* node) noexcept {
+  return node->getType() == CBNode::kNodeLabel || node->isJcc();
+}
+
+//! \internal
+//!
+//! Get the number of sites of all functions.
+static uint32_t X86ProfilePass_countSites(CodeBuilder* cb) noexcept {
+  uint32_t count = 0;
+
+  for (CBNode* node = cb->getFirstNode(); node; node = node->getNext()) {
+    if (node->getType() != CBNode::kNodeFunc)
+      continue;
+
+    CCFunc* func = node->as<CCFunc>();
+    CBNode* stop = func->getExitNode();
+
+    count++;
+    for (node = func->getNext(); node && node != stop; node = node->getNext())
+      count += X86ProfilePass_isSite(node);
+
+    if (!node) break;
+  }
+
+  return count;
+}
+
+//! \internal
+//!
+//! Get whether any of `flags` is read after `node` before it's overwritten.
+//!
+//! Jumps are not followed, so flags are considered live at any jump.
+static bool X86ProfilePass_areFlagsLive(CBNode* node, uint32_t flags) noexcept {
+  for (;;) {
+    node = node->getNext();
+    if (!node) return false;
+
+    switch (node->getType()) {
+      case CBNode::kNodeLabel:
+      case CBNode::kNodeComment:
+      case CBNode::kNodeHint:
+        continue;
+
+      // Flags are not preserved across calls and returns.
+      case CBNode::kNodeSentinel:
+      case CBNode::kNodeFuncExit:
+      case CBNode::kNodeFuncCall:
+        return false;
+
+      case CBNode::kNodeInst: {
+        CBInst* inst = node->as<CBInst>();
+        uint32_t instId = inst->getInstId();
+
+        if (!X86Inst::isDefinedId(instId) || inst->isJmpOrJcc())
+          return true;
+
+        const X86Inst::OperationData& operationData = X86Inst::getInst(instId).getOperationData();
+        if (operationData.getSpecialRegsR() & flags)
+          return true;
+
+        flags &= ~operationData.getSpecialRegsW();
+        if (!flags) return false;
+        break;
+      }
+
+      default:
+        return true;
+    }
+  }
+}
+
+//! \internal
+//!
+//! Increment `counter` after `node`.
+static Error X86ProfilePass_emitIncrement(X86Compiler* cc, CBNode* node, uint64_t* counter, bool atomic) noexcept {
+  uint32_t addFlags = X86Inst::getInst(X86Inst::kIdAdd).getOperationData().getSpecialRegsW();
+  bool flagsLive = X86ProfilePass_areFlagsLive(node, addFlags);
+
+  // There is no `lock` prefixed increment that preserves flags.
+  if (ASMJIT_UNLIKELY(flagsLive && atomic))
+    return DebugUtils::errored(kErrorInvalidState);
+
+  cc->_setCursor(node);
+
+  // The counter can be anywhere in the address space, so its address is
+  // loaded into a register instead of using an absolute memory operand.
+  X86Gp ptr = cc->newIntPtr();
+  cc->mov(ptr, imm_ptr(counter));
+
+  if (flagsLive) {
+    // Increment that doesn't change flags, only the low 32 bits of the
+    // counter are incremented in 32-bit mode.
+    X86Gp tmp = cc->newIntPtr();
+    cc->mov(tmp, x86::ptr(ptr));
+    cc->lea(tmp, x86::ptr(tmp, 1));
+    cc->mov(x86::ptr(ptr), tmp);
+  }
+  else if (cc->is64Bit()) {
+    if (atomic) cc->lock();
+    cc->add(x86::qword_ptr(ptr), 1);
+  }
+  else {
+    if (atomic) cc->lock();
+    cc->add(x86::dword_ptr(ptr), 1);
+    if (atomic) cc->lock();
+    cc->adc(x86::dword_ptr(ptr, 4), 0);
+  }
+
+  return cc->getLastError();
+}
+
+//! \internal
+//!
+//! Get whether the execution continues after the last node of `block`.
+static bool X86ProfilePass_fallsThrough(const X86ProfileBlock& block) noexcept {
+  CBNode* node = block.last;
+  while (node != block.first && node->getType() == CBNode::kNodeComment)
+    node = node->getPrev();
+  return !node->isJmp() && node->getType() != CBNode::kNodeFuncExit;
+}
+
+//! \internal
+//!
+//! Get whether all nodes of `block` can be moved.
+static bool X86ProfilePass_isMovable(const X86ProfileBlock& block) noexcept {
+  CBNode* node = block.first;
+  for (;;) {
+    switch (node->getType()) {
+      case CBNode::kNodeInst:
+      case CBNode::kNodeLabel:
+      case CBNode::kNodeComment:
+      case CBNode::kNodeFuncExit:
+      case CBNode::kNodeFuncCall:
+      case CBNode::kNodePushArg:
+      case CBNode::kNodeHint:
+        break;
+
+      default:
+        return false;
+    }
+
+    if (node == block.last)
+      return true;
+    node = node->getNext();
+  }
+}
+
+//! \internal
+//!
+//! Get the label at the start of `block`, bind a new one if there is none.
+static CBLabel* X86ProfilePass_ensureLabel(X86Compiler* cc, CBNode*& first) noexcept {
+  if (first->getType() == CBNode::kNodeLabel)
+    return first->as<CBLabel>();
+
+  Label label = cc->newLabel();
+  cc->_setCursor(first->getPrev());
+  if (cc->bind(label) != kErrorOk)
+    return nullptr;
+
+  first = cc->getCursor();
+  return first->as<CBLabel>();
+}
+
+//! \internal
+//!
+//! Move nodes from `first` to `last` before `ref`.
+//!
+//! Nodes are relinked directly as `CodeBuilder::removeNode()` would unlink
+//! jumps from their labels.
+static void X86ProfilePass_moveBefore(CBNode* first, CBNode* last, CBNode* ref) noexcept {
+  CBNode* prev = first->_prev;
+  CBNode* next = last->_next;
+
+  prev->_next = next;
+  next->_prev = prev;
+
+  prev = ref->_prev;
+  prev->_next = first;
+  first->_prev = prev;
+
+  last->_next = ref;
+  ref->_prev = last;
+}
+
+// ============================================================================
+// [asmjit::X86ProfilePass - Construction / Destruction]
+// ============================================================================
+
+X86ProfilePass::X86ProfilePass(JitRuntime* runtime) noexcept
+  : CBPass("X86ProfilePass"),
+    _runtime(runtime),
+    _counters(nullptr),
+    _profile(nullptr),
+    _counterCount(0),
+    _coldCount(0),
+    _atomic(false) {}
+
+X86ProfilePass::X86ProfilePass(const uint64_t* counters, uint32_t count) noexcept
+  : CBPass("X86ProfilePass"),
+    _runtime(nullptr),
+    _counters(nullptr),
+    _profile(counters),
+    _counterCount(count),
+    _coldCount(0),
+    _atomic(false) {}
+
+X86ProfilePass::~X86ProfilePass() noexcept {}
+
+// ============================================================================
+// [asmjit::X86ProfilePass - Instrument]
+// ============================================================================
+
+static Error X86ProfilePass_instrument(X86ProfilePass* self, X86Compiler* cc, Zone* zone) noexcept {
+  uint32_t count = X86ProfilePass_countSites(cc);
+  if (!count) return kErrorOk;
+
+  // Sites are collected first, the instrumentation adds new nodes after them.
+  CBNode** sites = zone->allocT<CBNode*>(count * sizeof(CBNode*));
+  uint64_t* counters = self->_runtime->allocCounters(count);
+
+  if (ASMJIT_UNLIKELY(!sites || !counters)) {
+    if (counters) self->_runtime->releaseCounters(counters);
+    return DebugUtils::errored(kErrorNoHeapMemory);
+  }
+
+  uint32_t i = 0;
+  for (CBNode* node = cc->getFirstNode(); node; node = node->getNext()) {
+    if (node->getType() != CBNode::kNodeFunc)
+      continue;
+
+    CCFunc* func = node->as<CCFunc>();
+    CBNode* stop = func->getExitNode();
+
+    sites[i++] = func;
+    for (node = func->getNext(); node && node != stop; node = node->getNext())
+      if (X86ProfilePass_isSite(node))
+        sites[i++] = node;
+
+    if (!node) break;
+  }
+  ASMJIT_ASSERT(i == count);
+
+  self->_counters = counters;
+  self->_counterCount = count;
+
+  CBNode* oldCursor = cc->getCursor();
+  for (i = 0; i < count; i++)
+    ASMJIT_PROPAGATE(X86ProfilePass_emitIncrement(cc, sites[i], &counters[i], self->_atomic));
+
+  cc->_setCursor(oldCursor);
+  return kErrorOk;
+}
+
+// ============================================================================
+// [asmjit::X86ProfilePass - Apply]
+// ============================================================================
+
+static Error X86ProfilePass_applyFunc(X86ProfilePass* self, X86Compiler* cc, ZoneHeap* heap, CCFunc* func, uint32_t& site) noexcept {
+  const uint64_t* profile = self->_profile;
+  CBLabel* exitNode = func->getExitNode();
+
+  ZoneVector<X86ProfileBlock> blocks;
+  X86ProfileBlock* block = nullptr;
+
+  uint32_t entrySite = site++;
+  uint32_t nextSite = entrySite;
+  uint64_t maxCount = profile[entrySite];
+
+  // Split the function body into blocks.
+  for (CBNode* node = func->getNext(); node != exitNode; node = node->getNext()) {
+    if (!node) return DebugUtils::errored(kErrorInvalidState);
+
+    if (node->getType() == CBNode::kNodeLabel || !block) {
+      X86ProfileBlock newBlock;
+      newBlock.first = node;
+      newBlock.site = nextSite;
+      newBlock.cold = false;
+
+      if (node->getType() == CBNode::kNodeLabel) {
+        newBlock.site = site++;
+        if (profile[newBlock.site] > maxCount)
+          maxCount = profile[newBlock.site];
+      }
+
+      ASMJIT_PROPAGATE(blocks.append(heap, newBlock));
+      block = &blocks[blocks.getLength() - 1];
+      nextSite = kInvalidValue;
+    }
+
+    block->last = node;
+
+    if (node->isJcc()) {
+      nextSite = site++;
+      if (profile[nextSite] > maxCount)
+        maxCount = profile[nextSite];
+      block = nullptr;
+    }
+    else if (node->isJmp() || node->getType() == CBNode::kNodeFuncExit) {
+      block = nullptr;
+    }
+  }
+
+  // Find cold blocks, the first block is always entered.
+  size_t blockCount = blocks.getLength();
+  uint32_t coldCount = 0;
+
+  if (!maxCount) return kErrorOk;
+
+  for (size_t i = 1; i < blockCount; i++) {
+    X86ProfileBlock& b = blocks[i];
+    if (b.site == kInvalidValue || b.site == entrySite)
+      continue;
+
+    uint64_t count = profile[b.site];
+    if (count * X86ProfilePass::kColdRatio < maxCount && X86ProfilePass_isMovable(b)) {
+      b.cold = true;
+      coldCount++;
+    }
+  }
+
+  if (!coldCount) return kErrorOk;
+
+  // Bind labels to cold blocks and to blocks cold blocks fall through to.
+  for (size_t i = 1; i < blockCount; i++) {
+    X86ProfileBlock& b = blocks[i];
+    if (!b.cold) continue;
+
+    if (!X86ProfilePass_ensureLabel(cc, b.first))
+      return cc->getLastError();
+
+    if (i + 1 < blockCount && X86ProfilePass_fallsThrough(b))
+      if (!X86ProfilePass_ensureLabel(cc, blocks[i + 1].first))
+        return cc->getLastError();
+  }
+
+  // Replace fall-through edges whose target is not the next block after the
+  // move by jumps. These are edges into and out of cold blocks and the edge
+  // from the last block to the exit, as cold blocks are moved before it.
+  for (size_t i = 0; i < blockCount; i++) {
+    X86ProfileBlock& b = blocks[i];
+    bool isLast = i + 1 == blockCount;
+
+    if (!b.cold && !isLast && !blocks[i + 1].cold)
+      continue;
+
+    if (X86ProfilePass_fallsThrough(b)) {
+      CBLabel* next = isLast ? exitNode : blocks[i + 1].first->as<CBLabel>();
+      cc->_setCursor(b.last);
+      cc->jmp(next->getLabel());
+      b.last = cc->getCursor();
+    }
+  }
+  ASMJIT_PROPAGATE(cc->getLastError());
+
+  // Move cold blocks to the end of the function, keeping their order.
+  for (size_t i = 1; i < blockCount; i++) {
+    X86ProfileBlock& b = blocks[i];
+    if (b.cold)
+      X86ProfilePass_moveBefore(b.first, b.last, exitNode);
+  }
+
+  self->_coldCount += coldCount;
+  return kErrorOk;
+}
+
+static Error X86ProfilePass_apply(X86ProfilePass* self, X86Compiler* cc, Zone* zone) noexcept {
+  // The code must be the same as the instrumented one.
+  if (X86ProfilePass_countSites(cc) != self->_counterCount)
+    return kErrorOk;
+
+  ZoneHeap heap(zone);
+  CBNode* oldCursor = cc->getCursor();
+  uint32_t site = 0;
+
+  for (CBNode* node = cc->getFirstNode(); node; node = node->getNext()) {
+    if (node->getType() != CBNode::kNodeFunc)
+      continue;
+
+    CCFunc* func = node->as<CCFunc>();
+    ASMJIT_PROPAGATE(X86ProfilePass_applyFunc(self, cc, &heap, func, site));
+    node = func->getExitNode();
+  }
+
+  cc->_setCursor(oldCursor);
+  if (!self->_coldCount)
+    return kErrorOk;
+
+  // Invert conditional jumps that now jump to the hot path over a `jmp` to a
+  // cold block and remove jumps to labels that follow them.
+  X86JumpPass jumpPass;
+  jumpPass._cb = cc;
+  return jumpPass.process(zone);
+}
+
+// ============================================================================
+// [asmjit::X86ProfilePass - Interface]
+// ============================================================================
+
+Error X86ProfilePass::process(Zone* zone) noexcept {
+  X86Compiler* cc = static_cast<X86Compiler*>(_cb);
+  _coldCount = 0;
+
+  if (_runtime)
+    return X86ProfilePass_instrument(this, cc, zone);
+  else if (_profile)
+    return X86ProfilePass_apply(this, cc, zone);
+  else
+    return kErrorOk;
+}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // ASMJIT_BUILD_X86 && !ASMJIT_DISABLE_COMPILER
@@ -0,0 +1,141 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _ASMJIT_X86_X86PROFILE_H
+#define _ASMJIT_X86_X86PROFILE_H
+
+#include "../asmjit_build.h"
+#if !defined(ASMJIT_DISABLE_COMPILER)
+
+// [Dependencies]
+#include "../base/codecompiler.h"
+#include "../base/runtime.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+//! \addtogroup asmjit_x86
+//! \{
+
+// ============================================================================
+// [asmjit::X86ProfilePass]
+// ============================================================================
+
+//! X86/X64 profile-guided block layout.
+//!
+//! The pass works in two modes that are used by two compilations of the same
+//! code (tier-1 and tier-2):
+//!
+//!   - Instrument - created with a `JitRuntime`. Allocates one 64-bit counter
+//!     per site from the runtime and increments it each time the site is
+//!     executed. The sites are the function entry, each label in the function
+//!     body, and the fall-through edge of each conditional jump.
+//!   - Apply - created with the counters collected by the instrumented code.
+//!     Moves blocks that were never or rarely executed to the end of the
+//!     function (before its exit label) and inverts the conditional jumps
+//!     that branched around them, so the hot path is laid out sequentially.
+//!
+//! The counts are matched to the sites by their order, so the code passed to
+//! the compiler in both modes must be the same. If the number of counts
+//! doesn't match the number of sites the code is not changed.
+//!
+//! The pass works on virtual registers, so it must run before the register
+//! allocator that `X86Compiler` adds when attached:
+//!
+//! ~~~
+//! // Tier-1.
+//! X86ProfilePass* profile = cc.newPassT<X86ProfilePass>(&runtime);
+//! cc.insertPass(0, profile);
+//!
+//! // ... generate and run the code ...
+//!
+//! // Tier-2, `counters` must stay valid until `finalize()` returns.
+//! cc2.insertPass(0, cc2.newPassT<X86ProfilePass>(
+//!   static_cast<const uint64_t*>(profile->getCounters()), profile->getCounterCount()));
+//! ~~~
+class ASMJIT_VIRTAPI X86ProfilePass : public CBPass {
+public:
+  ASMJIT_NONCOPYABLE(X86ProfilePass)
+  typedef CBPass Base;
+
+  //! Blocks executed less than `1 / kColdRatio` times the most executed site
+  //! of the function are considered cold.
+  ASMJIT_ENUM(Limits) {
+    kColdRatio = 64
+  };
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  //! Create a new `X86ProfilePass` that instruments the code with counters
+  //! allocated from `runtime`.
+  ASMJIT_API X86ProfilePass(JitRuntime* runtime) noexcept;
+  //! Create a new `X86ProfilePass` that lays out the code by using `count`
+  //! counters collected by an instrumented code.
+  ASMJIT_API X86ProfilePass(const uint64_t* counters, uint32_t count) noexcept;
+  //! Destroy the `X86ProfilePass` instance.
+  ASMJIT_API virtual ~X86ProfilePass() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  ASMJIT_API virtual Error process(Zone* zone) noexcept override;
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  //! Get whether the pass instruments the code.
+  ASMJIT_INLINE bool isInstrumenting() const noexcept { return _runtime != nullptr; }
+
+  //! Get whether the counters are incremented by `lock` prefixed instructions.
+  ASMJIT_INLINE bool isAtomic() const noexcept { return _atomic; }
+  //! Set whether the counters are incremented by `lock` prefixed instructions,
+  //! required if the code is executed by multiple threads at the same time and
+  //! the counts must be exact.
+  //!
+  //! A counter incremented where flags are live can't use a `lock` prefixed
+  //! instruction, `process()` fails with `kErrorInvalidState` in such case.
+  ASMJIT_INLINE void setAtomic(bool atomic) noexcept { _atomic = atomic; }
+
+  //! Get counters allocated by the last `process()` (instrument mode).
+  //!
+  //! The counters are owned by the `JitRuntime`, release them by calling
+  //! `JitRuntime::releaseCounters()` after the code was released.
+  ASMJIT_INLINE uint64_t* getCounters() const noexcept { return _counters; }
+  //! Get the number of counters (instrument mode) or counts (apply mode).
+  ASMJIT_INLINE uint32_t getCounterCount() const noexcept { return _counterCount; }
+
+  //! Get number of cold blocks moved by the last `process()` (apply mode).
+  ASMJIT_INLINE uint32_t getColdCount() const noexcept { return _coldCount; }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  JitRuntime* _runtime;                  //!< Runtime that owns the counters (instrument mode).
+  uint64_t* _counters;                   //!< Counters (instrument mode).
+  const uint64_t* _profile;              //!< Collected counts (apply mode).
+  uint32_t _counterCount;                //!< Number of counters or counts.
+  uint32_t _coldCount;                   //!< Number of moved cold blocks.
+  bool _atomic;                          //!< Use `lock` prefixed increments.
+};
+
+//! \}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // !ASMJIT_DISABLE_COMPILER
+#endif // _ASMJIT_X86_X86PROFILE_H
@@ -231,6 +231,10 @@ Error X86RAPass::emitMove(VirtReg* vReg, uint32_t dstId, uint32_t srcId, const c
 }
 
 Error X86RAPass::emitLoad(VirtReg* vReg, uint32_t id, const char* reason) {
+  // Constants are rematerialized instead of loaded from their home.
+  if (vReg->isMaterialized())
+    return emitRemat(vReg, id);
+
   const char* comment = nullptr;
   if (_emitComments) {
     _stringBuilder.setFormat("[%s] %s", reason, vReg->getName());
@@ -243,6 +247,10 @@ Error X86RAPass::emitLoad(VirtReg* vReg, uint32_t id, const char* reason) {
 }
 
 Error X86RAPass::emitSave(VirtReg* vReg, uint32_t id, const char* reason) {
+  // Constants are never saved, `emitLoad()` rematerializes them.
+  if (vReg->isMaterialized())
+    return kErrorOk;
+
   const char* comment = nullptr;
   if (_emitComments) {
     _stringBuilder.setFormat("[%s] %s", reason, vReg->getName());
@@ -254,6 +262,25 @@ Error X86RAPass::emitSave(VirtReg* vReg, uint32_t id, const char* reason) {
   return X86Internal::emitRegMove(reinterpret_cast<X86Emitter*>(cc()), dst, src, vReg->getTypeId(), _avxEnabled, comment);
 }
 
+Error X86RAPass::emitRemat(VirtReg* vReg, uint32_t id) {
+  ASMJIT_ASSERT(vReg->isMaterialized());
+
+  Operand_ o0(vReg->_rematOps[0]);
+  Operand_ o1(vReg->_rematOps[1]);
+
+  // Zeroing and all-ones idioms use the register as both operands.
+  o0._reg.id = id;
+  if (o1.isReg())
+    o1._reg.id = id;
+
+  if (_emitComments) {
+    _stringBuilder.setFormat("[Remat] %s", vReg->getName());
+    cc()->setInlineComment(_stringBuilder.getData());
+  }
+
+  return cc()->emit(vReg->_rematInstId, o0, o1);
+}
+
 Error X86RAPass::emitSwapGp(VirtReg* dstReg, VirtReg* srcReg, uint32_t dstPhysId, uint32_t srcPhysId, const char* reason) noexcept {
   ASMJIT_ASSERT(dstPhysId != Globals::kInvalidRegId);
   ASMJIT_ASSERT(srcPhysId != Globals::kInvalidRegId);
@@ -1945,7 +1972,7 @@ _NextGroup:
         CCFuncCall* node = static_cast<CCFuncCall*>(node_);
         FuncDetail& fd = node->getDetail();
 
-        Operand_* target = node->_opArray;
+        Operand_* target = node->getOpArray();
         Operand_* args = node->_args;
         Operand_* rets = node->_ret;
 
@@ -2375,6 +2402,15 @@ protected:
   template<int C>
   ASMJIT_INLINE void modified();
 
+  // --------------------------------------------------------------------------
+  // [Preserve]
+  // --------------------------------------------------------------------------
+
+  //! Move function arguments that are live across calls from registers used
+  //! to pass them to free registers preserved by these calls.
+  template<int C>
+  ASMJIT_INLINE void preserve();
+
   // --------------------------------------------------------------------------
   // [Members]
   // --------------------------------------------------------------------------
@@ -2474,6 +2510,15 @@ Error X86VarAlloc::run(CBNode* node_) {
     modified<X86Reg::kKindMm>();
     modified<X86Reg::kKindVec>();
 
+    // Function arguments are moved after the function node (prolog).
+    if (node_->getType() == CBNode::kNodeFunc) {
+      _cc->_setCursor(node_);
+
+      preserve<X86Reg::kKindGp>();
+      preserve<X86Reg::kKindMm>();
+      preserve<X86Reg::kKindVec>();
+    }
+
     // Cleanup; disconnect Vd->Va.
     cleanup();
 
@@ -2517,6 +2562,22 @@ ASMJIT_INLINE void X86VarAlloc::cleanup() {
 // [asmjit::X86VarAlloc - Plan / Spill / Alloc]
 // ============================================================================
 
+//! \internal
+//!
+//! Get which of `regs` hold variables that can be rematerialized.
+template<int C>
+static ASMJIT_INLINE uint32_t X86RAPass_getRematRegs(X86RAState* state, uint32_t regs) {
+  VirtReg** vregs = state->getListByKind(C);
+  uint32_t rematRegs = 0;
+
+  for (uint32_t i = 0; regs != 0; i++, regs >>= 1) {
+    if ((regs & 0x1) && vregs[i] && vregs[i]->isMaterialized())
+      rematRegs |= Utils::mask(i);
+  }
+
+  return rematRegs;
+}
+
 template<int C>
 ASMJIT_INLINE void X86VarAlloc::plan() {
   if (isTiedDone(C)) return;
@@ -2673,10 +2734,16 @@ ASMJIT_INLINE void X86VarAlloc::plan() {
       uint32_t regMask;
 
       if (candidateRegs == 0) {
-        candidateRegs = m & occupied & ~state->_modified.get(C);
+        // Prefer registers that don't have to be saved when spilled.
+        uint32_t dirtyRegs = state->_modified.get(C) & ~X86RAPass_getRematRegs<C>(state, m & occupied);
+        candidateRegs = m & occupied & ~dirtyRegs;
         if (candidateRegs == 0)
           candidateRegs = m;
       }
+
+      // Prefer registers that survive all calls the variable is live across.
+      uint32_t callClobbered = vreg->getCallClobberedMask();
+      if (candidateRegs & ~callClobbered) candidateRegs &= ~callClobbered;
       if (candidateRegs & homeMask) candidateRegs &= homeMask;
 
       physId = Utils::findFirstBit(candidateRegs);
@@ -2735,7 +2802,8 @@ ASMJIT_INLINE void X86VarAlloc::spill() {
     TiedReg* tied = vreg->_tied;
     ASMJIT_ASSERT(!tied || (tied->flags & TiedReg::kXReg) == 0);
 
-    if (vreg->isModified() && availableRegs) {
+    // Rematerializable variables are spilled for free.
+    if (vreg->isModified() && !vreg->isMaterialized() && availableRegs) {
       // Don't check for alternatives if the variable has to be spilled.
       if (!tied || (tied->flags & TiedReg::kSpill) == 0) {
         uint32_t altRegs = guessSpill<C>(vreg, availableRegs);
@@ -2959,6 +3027,34 @@ ASMJIT_INLINE void X86VarAlloc::modified() {
   }
 }
 
+// ============================================================================
+// [asmjit::X86VarAlloc - Preserve]
+// ============================================================================
+
+template<int C>
+ASMJIT_INLINE void X86VarAlloc::preserve() {
+  TiedReg* tiedArray = getTiedArrayByKind(C);
+  uint32_t tiedCount = getTiedCountByKind(C);
+  X86RAState* state = getState();
+
+  for (uint32_t i = 0; i < tiedCount; i++) {
+    VirtReg* vreg = tiedArray[i].vreg;
+    uint32_t physId = vreg->getPhysId();
+    uint32_t callClobbered = vreg->getCallClobberedMask();
+
+    if (vreg->isFixed() || physId == Globals::kInvalidRegId || (callClobbered & Utils::mask(physId)) == 0)
+      continue;
+
+    uint32_t availableRegs = getGaRegs(C) & ~(state->_occupied.get(C) | callClobbered);
+    if (availableRegs == 0)
+      continue;
+
+    uint32_t newPhysId = Utils::findFirstBit(availableRegs);
+    _context->move<C>(vreg, newPhysId);
+    _context->_clobberedRegs.or_(C, Utils::mask(newPhysId));
+  }
+}
+
 // ============================================================================
 // [asmjit::X86CallAlloc]
 // ============================================================================
@@ -3294,13 +3390,15 @@ ASMJIT_INLINE void X86CallAlloc::spill() {
     VirtReg* vreg = sVars[i];
     ASMJIT_ASSERT(vreg && !vreg->_tied);
 
-    if (vreg->isModified() && availableRegs) {
+    if (vreg->isModified() && !vreg->isMaterialized() && availableRegs) {
       uint32_t available = guessSpill<C>(vreg, availableRegs);
       if (available != 0) {
         uint32_t physId = Utils::findFirstBit(available);
         uint32_t regMask = Utils::mask(physId);
 
         _context->move<C>(vreg, physId);
+        _context->_clobberedRegs.or_(C, regMask);
+
         availableRegs ^= regMask;
         continue;
       }
@@ -3511,7 +3609,10 @@ _UseSafeRegs:
 template<int C>
 ASMJIT_INLINE uint32_t X86CallAlloc::guessSpill(VirtReg* vreg, uint32_t allocableRegs) {
   ASMJIT_ASSERT(allocableRegs != 0);
-  return 0;
+
+  // The variable is not used by the call, moving it to a register preserved
+  // by the call avoids saving it now and reloading it after the call.
+  return allocableRegs & ~_raData->clobberedRegs.get(C);
 }
 
 // ============================================================================
@@ -3524,16 +3625,31 @@ ASMJIT_INLINE void X86CallAlloc::save() {
   VirtReg** sVars = state->getListByKind(C);
 
   uint32_t i;
-  uint32_t affected = _raData->clobberedRegs.get(C) & state->_occupied.get(C) & state->_modified.get(C);
+  uint32_t clobbered = _raData->clobberedRegs.get(C);
+  uint32_t affected = clobbered & state->_occupied.get(C);
+
+  // Preserved registers that are free, a variable that is not used by the call
+  // is moved there instead of being saved now and reloaded after the call.
+  uint32_t availableRegs = getGaRegs(C) & ~(clobbered | state->_occupied.get(C) | _willAlloc.get(C));
 
   for (i = 0; affected != 0; i++, affected >>= 1) {
     if (affected & 0x1) {
       VirtReg* vreg = sVars[i];
       ASMJIT_ASSERT(vreg != nullptr);
-      ASMJIT_ASSERT(vreg->isModified());
 
       TiedReg* tied = vreg->_tied;
-      if (!tied || (tied->flags & (TiedReg::kWReg | TiedReg::kUnuse)) == 0)
+      if (!tied && availableRegs && !vreg->isMaterialized()) {
+        uint32_t physId = Utils::findFirstBit(availableRegs);
+        uint32_t regMask = Utils::mask(physId);
+
+        _context->move<C>(vreg, physId);
+        _context->_clobberedRegs.or_(C, regMask);
+
+        availableRegs ^= regMask;
+        continue;
+      }
+
+      if (vreg->isModified() && (!tied || (tied->flags & (TiedReg::kWReg | TiedReg::kUnuse)) == 0))
         _context->save<C>(vreg);
     }
   }
@@ -3745,7 +3861,7 @@ static void X86RAPass_translateJump(X86RAPass* self, CBJump* jNode, CBLabel* jTa
 
     // Finally, patch `jNode` target.
     ASMJIT_ASSERT(jNode->getOpCount() > 0);
-    jNode->_opArray[jNode->getOpCount() - 1] = injectLabel->getLabel();
+    jNode->getOpArray()[jNode->getOpCount() - 1] = injectLabel->getLabel();
     jNode->_target = injectLabel;
     // If we injected any code it may not satisfy short form anymore.
     jNode->delOptions(X86Inst::kOptionShortForm);
@@ -3828,6 +3944,273 @@ _EmitRet:
   return kErrorOk;
 }
 
+// ============================================================================
+// [asmjit::X86RAPass - Translate - CallCrossings]
+// ============================================================================
+
+//! \internal
+//!
+//! Collect registers clobbered by all calls each variable is live across, the
+//! allocator uses it to prefer registers preserved by these calls, which costs
+//! a single save in prolog and epilog instead of a save and reload per call.
+static void X86RAPass_markCallCrossings(X86RAPass* self) {
+  CBNode* stop = self->getStop();
+
+  VirtReg** vregs = self->_contextVd.getData();
+  uint32_t vregCount = static_cast<uint32_t>(self->_contextVd.getLength());
+
+  uint32_t i;
+  for (i = 0; i < vregCount; i++)
+    vregs[i]->_callClobberedMask = 0;
+
+  for (CBNode* node = self->getFunc(); node != stop; node = node->getNext()) {
+    if (node->getType() != CBNode::kNodeFuncCall || !node->hasPassData())
+      continue;
+
+    // Variables live after the call (liveness of the next node).
+    CBNode* next = node->getNext();
+    while (next != stop && !next->hasPassData())
+      next = next->getNext();
+
+    RABits* liveness = next != stop ? next->getPassData<RAData>()->liveness : static_cast<RABits*>(nullptr);
+    if (!liveness) continue;
+
+    X86RAData* raData = node->getPassData<X86RAData>();
+    for (i = 0; i < vregCount; i++) {
+      if (!liveness->getBit(i)) continue;
+
+      // Variables written by the call (return values) are not live across.
+      VirtReg* vreg = vregs[i];
+      TiedReg* tied = raData->findTied(vreg);
+      if (tied && (tied->flags & TiedReg::kWAll) != 0) continue;
+
+      vreg->_callClobberedMask |= raData->clobberedRegs.get(vreg->getKind());
+    }
+  }
+}
+
+// ============================================================================
+// [asmjit::X86RAPass - Translate - Remat]
+// ============================================================================
+
+//! \internal
+//!
+//! Get whether the instruction `node` (that writes its first operand only)
+//! materializes a constant, which is an immediate, zeroing or all-ones idiom,
+//! or a load from a constant pool.
+static bool X86RAPass_isRematInst(X86RAPass* self, CBInst* node, VirtReg* vreg) {
+  if (node->getOpCount() != 2 || node->hasExtraReg())
+    return false;
+
+  const Operand* opArray = node->getOpArray();
+  const Operand& o0 = opArray[0];
+  const Operand& o1 = opArray[1];
+
+  if (!o0.isVirtReg() || o0.getId() != vreg->getId())
+    return false;
+
+  // `mov reg, imm`.
+  if (o1.isImm())
+    return node->getInstId() == X86Inst::kIdMov;
+
+  // `xor reg, reg`, `pcmpeqd reg, reg`, etc... The fetch clears the read
+  // flag of these, so being write-only is enough to tell them apart. GP
+  // idioms write flags, only `xor` and `sub` are accepted as these are
+  // rematerialized by a flag-neutral `mov reg, 0`, see `markRematerializable`.
+  if (o1.isReg()) {
+    if (o1.getId() != o0.getId() || o1.getSignature() != o0.getSignature())
+      return false;
+
+    if (static_cast<const X86Reg&>(o0).isGp()) {
+      uint32_t instId = node->getInstId();
+      return instId == X86Inst::kIdXor || instId == X86Inst::kIdSub;
+    }
+
+    return true;
+  }
+
+  // Load from a constant pool.
+  if (o1.isMem()) {
+    const X86Mem& m = static_cast<const X86Mem&>(o1);
+    if (!m.hasBaseLabel() || m.hasIndex())
+      return false;
+
+    uint32_t index = Operand::unpackId(m.getBaseId());
+    const ZoneVector<CBLabel*>& labels = self->cc()->getLabels();
+
+    return index < labels.getLength() && labels[index] &&
+           labels[index]->getType() == CBNode::kNodeConstPool;
+  }
+
+  return false;
+}
+
+//! \internal
+//!
+//! Mark variables that are defined exactly once by an instruction that
+//! materializes a constant. The allocator re-emits such instruction instead
+//! of saving the variable to and loading it from its stack home.
+static Error X86RAPass_markRematerializable(X86RAPass* self) {
+  CBNode* stop = self->getStop();
+
+  VirtReg** vregs = self->_contextVd.getData();
+  uint32_t vregCount = static_cast<uint32_t>(self->_contextVd.getLength());
+
+  uint32_t i;
+  for (i = 0; i < vregCount; i++)
+    vregs[i]->_isMaterialized = false;
+
+  RABits* defined = self->newBits((vregCount + RABits::kEntityBits - 1) / RABits::kEntityBits);
+  RABits* rejected = self->newBits((vregCount + RABits::kEntityBits - 1) / RABits::kEntityBits);
+
+  if (ASMJIT_UNLIKELY(!defined || !rejected))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  for (CBNode* node = self->getFunc(); node != stop; node = node->getNext()) {
+    if (!node->hasPassData())
+      continue;
+
+    X86RAData* raData = node->getPassData<X86RAData>();
+    TiedReg* tiedArray = raData->tiedArray;
+    uint32_t tiedTotal = raData->tiedTotal;
+
+    for (uint32_t j = 0; j < tiedTotal; j++) {
+      TiedReg* tied = &tiedArray[j];
+      VirtReg* vreg = tied->vreg;
+      uint32_t raId = vreg->_raId;
+
+      // Variables that use their stack home can't be rematerialized.
+      if (tied->flags & (TiedReg::kRMem | TiedReg::kWMem)) {
+        rejected->setBit(raId);
+        continue;
+      }
+
+      if (!(tied->flags & TiedReg::kWAll))
+        continue;
+
+      if (defined->getBit(raId) || (tied->flags & TiedReg::kRAll) || tiedTotal != 1 ||
+          node->getType() != CBNode::kNodeInst || vreg->isFixed() || vreg->isStack() ||
+          !X86RAPass_isRematInst(self, static_cast<CBInst*>(node), vreg)) {
+        rejected->setBit(raId);
+      }
+      else {
+        const Operand_* opArray = static_cast<CBInst*>(node)->getOpArray();
+        vreg->_rematInstId = static_cast<CBInst*>(node)->getInstId();
+        vreg->_rematOps[0] = opArray[0];
+        vreg->_rematOps[1] = opArray[1];
+
+        // Remat can be inserted where flags are live, GP zeroing must not
+        // clobber them.
+        if (opArray[1].isReg() && static_cast<const X86Reg&>(opArray[0]).isGp()) {
+          vreg->_rematInstId = X86Inst::kIdMov;
+          vreg->_rematOps[1] = Imm(0);
+        }
+      }
+
+      defined->setBit(raId);
+    }
+  }
+
+  for (i = 0; i < vregCount; i++)
+    vregs[i]->_isMaterialized = defined->getBit(i) && !rejected->getBit(i);
+
+  return kErrorOk;
+}
+
+// ============================================================================
+// [asmjit::X86RAPass - Translate - Coalesce]
+// ============================================================================
+
+//! \internal
+//!
+//! Get whether the instruction copies a whole register to another register.
+static ASMJIT_INLINE bool X86RAPass_isCopyInst(uint32_t instId, uint32_t kind) noexcept {
+  if (kind == X86Reg::kKindGp)
+    return instId == X86Inst::kIdMov;
+
+  if (kind == X86Reg::kKindVec) {
+    switch (instId) {
+      case X86Inst::kIdMovaps : case X86Inst::kIdMovapd : case X86Inst::kIdMovdqa :
+      case X86Inst::kIdMovups : case X86Inst::kIdMovupd : case X86Inst::kIdMovdqu :
+      case X86Inst::kIdVmovaps: case X86Inst::kIdVmovapd: case X86Inst::kIdVmovdqa:
+      case X86Inst::kIdVmovups: case X86Inst::kIdVmovupd: case X86Inst::kIdVmovdqu:
+        return true;
+    }
+  }
+
+  return false;
+}
+
+template<int C>
+static ASMJIT_INLINE void X86RAPass_coalesceCopyT(X86RAPass* self, VirtReg* dst, VirtReg* src, bool dstUsed) {
+  uint32_t physId = src->getPhysId();
+
+  // `dst` is overwritten, its previous content is not needed.
+  self->unuse<C>(dst);
+  self->unuse<C>(src);
+
+  if (dstUsed)
+    self->attach<C>(dst, physId, true);
+}
+
+//! \internal
+//!
+//! Coalesce a register copy `dst <- src` if `src` is not live after the copy
+//! and both are allocated in registers of the same kind. Such `dst` and `src`
+//! don't interfere, so `dst` takes over the register of `src` and the copy is
+//! removed. Returns true if the copy has been coalesced.
+static bool X86RAPass_coalesceCopy(X86RAPass* self, CBInst* node) {
+  if (node->getOpCount() != 2 || node->hasExtraReg())
+    return false;
+
+  const Operand* opArray = node->getOpArray();
+  if (!opArray[0].isVirtReg() || !opArray[1].isVirtReg())
+    return false;
+
+  X86Compiler* cc = self->cc();
+  VirtReg* dst = cc->getVirtRegById(opArray[0].getId());
+  VirtReg* src = cc->getVirtRegById(opArray[1].getId());
+
+  // Only whole registers of the same type, a copy of a part of a register
+  // (or an extending copy) can't be coalesced.
+  uint32_t signature = src->getSignature();
+  if (dst == src || dst->getSignature() != signature ||
+      opArray[0].getSignature() != signature || opArray[1].getSignature() != signature)
+    return false;
+
+  uint32_t kind = src->getKind();
+  if (!X86RAPass_isCopyInst(node->getInstId(), kind) || dst->isFixed() || src->isFixed())
+    return false;
+
+  X86RAData* raData = node->getPassData<X86RAData>();
+  if (!raData || raData->tiedTotal != 2 || !raData->inRegs.isEmpty() || !raData->outRegs.isEmpty())
+    return false;
+
+  TiedReg* dTied = raData->findTied(dst);
+  TiedReg* sTied = raData->findTied(src);
+  ASMJIT_ASSERT(dTied != nullptr && sTied != nullptr);
+
+  // `dst` is write-only, `src` is read-only and dies here.
+  const uint32_t kRWMask = TiedReg::kRAll | TiedReg::kWAll | TiedReg::kSpill;
+  if ((dTied->flags & kRWMask) != TiedReg::kWReg || dTied->hasOutPhysId() ||
+      (sTied->flags & kRWMask) != TiedReg::kRReg || !(sTied->flags & TiedReg::kUnuse) || sTied->inRegs != 0)
+    return false;
+
+  // Don't move `dst` into a register clobbered by a call it lives across.
+  uint32_t physId = src->getPhysId();
+  if (physId == Globals::kInvalidRegId || !(dTied->allocableRegs & ~dst->getCallClobberedMask() & Utils::mask(physId)))
+    return false;
+
+  bool dstUsed = (dTied->flags & TiedReg::kUnuse) == 0;
+  switch (kind) {
+    case X86Reg::kKindGp : X86RAPass_coalesceCopyT<X86Reg::kKindGp >(self, dst, src, dstUsed); break;
+    case X86Reg::kKindVec: X86RAPass_coalesceCopyT<X86Reg::kKindVec>(self, dst, src, dstUsed); break;
+  }
+
+  cc->removeNode(node);
+  return true;
+}
+
 // ============================================================================
 // [asmjit::X86RAPass - Translate - Func]
 // ============================================================================
@@ -3840,6 +4223,12 @@ Error X86RAPass::translate() {
   X86VarAlloc vAlloc(this);
   X86CallAlloc cAlloc(this);
 
+  // Prefer preserved registers for variables live across calls.
+  X86RAPass_markCallCrossings(this);
+
+  // Rematerialize constants instead of spilling them.
+  ASMJIT_PROPAGATE(X86RAPass_markRematerializable(this));
+
   // Flow.
   CBNode* node_ = func;
   CBNode* next = nullptr;
@@ -3936,6 +4325,10 @@ _NextGroup:
             }
           }
 
+          // Coalesce a copy from a register that dies at the copy.
+          if (node_->getType() == CBNode::kNodeInst && X86RAPass_coalesceCopy(this, static_cast<CBInst*>(node_)))
+            break;
+
           if (node_->getType() == CBNode::kNodeFuncCall) {
             ASMJIT_PROPAGATE(cAlloc.run(static_cast<CCFuncCall*>(node_)));
             break;
@@ -4048,6 +4441,18 @@ _Done:
 
     cc->_setCursor(func->getExitNode());
     ASMJIT_PROPAGATE(FuncUtils::emitEpilog(this->cc(), layout));
+
+    // Bind labels after the epilog and after the code injected by jumps that
+    // switch state (placed after the epilog), so the function's code range is
+    // known and unwind information can be generated after the code is relocated.
+    CBLabel* epilogEnd = cc->newLabelNode();
+    CBLabel* funcEnd = cc->newLabelNode();
+    if (ASMJIT_UNLIKELY(!epilogEnd || !funcEnd))
+      return DebugUtils::errored(kErrorNoHeapMemory);
+
+    cc->addNode(epilogEnd);
+    cc->addBefore(funcEnd, func->getEnd());
+    ASMJIT_PROPAGATE(cc->getCode()->addUnwindEntry(func->getLabel(), funcEnd->getLabel(), layout, epilogEnd->getLabel()));
   }
 
   return kErrorOk;
@@ -326,6 +326,7 @@ public:
   Error emitMove(VirtReg* vreg, uint32_t dstId, uint32_t srcId, const char* reason);
   Error emitLoad(VirtReg* vreg, uint32_t id, const char* reason);
   Error emitSave(VirtReg* vreg, uint32_t id, const char* reason);
+  Error emitRemat(VirtReg* vreg, uint32_t id);
   Error emitSwapGp(VirtReg* aVReg, VirtReg* bVReg, uint32_t aId, uint32_t bId, const char* reason) noexcept;
 
   Error emitImmToReg(uint32_t dstTypeId, uint32_t dstPhysId, const Imm* src) noexcept;
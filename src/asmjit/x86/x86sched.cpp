@@ -0,0 +1,782 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Export]
+#define ASMJIT_EXPORTS
+
+// [Guard]
+#include "../asmjit_build.h"
+#if defined(ASMJIT_BUILD_X86) && !defined(ASMJIT_DISABLE_BUILDER)
+
+// [Dependencies]
+#include "../base/utils.h"
+#include "../x86/x86inst.h"
+#include "../x86/x86operand.h"
+#include "../x86/x86sched.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+// ============================================================================
+// [asmjit::X86SchedPass - Model]
+// ============================================================================
+
+//! \internal
+//!
+//! Scheduling class of an instruction.
+enum X86SchedClass {
+  kX86SchedAlu       = 0,                //!< Integer ALU.
+  kX86SchedImul      = 1,                //!< Integer multiplication.
+  kX86SchedMove      = 2,                //!< Register or memory move.
+  kX86SchedVecAlu    = 3,                //!< Vector integer and logical operation.
+  kX86SchedVecShuf   = 4,                //!< Vector shuffle, unpack, pack, and byte shift.
+  kX86SchedVecIMul   = 5,                //!< Vector 16-bit multiplication (and pmuludq, pmaddwd).
+  kX86SchedVecIMul32 = 6,                //!< Vector 32-bit multiplication (pmulld).
+  kX86SchedFpAdd     = 7,                //!< FP addition, comparison, min/max.
+  kX86SchedFpMul     = 8,                //!< FP multiplication.
+  kX86SchedFma       = 9,                //!< FP fused multiply-add.
+  kX86SchedFpDiv     = 10,               //!< FP division.
+  kX86SchedFpSqrt    = 11,               //!< FP square root.
+  kX86SchedCvt       = 12,               //!< Conversion.
+  kX86SchedLoad      = 13,               //!< Load unit (used together with other class).
+  kX86SchedStore     = 14,               //!< Store unit (used together with other class).
+  kX86SchedCount     = 15                //!< Count of scheduling classes.
+};
+
+//! \internal
+//!
+//! Latency and execution units of a scheduling class.
+struct X86SchedEntry {
+  uint8_t latency;                       //!< Latency in cycles.
+  uint8_t units;                         //!< Number of units able to execute the class.
+  uint8_t busy;                          //!< Cycles a unit is busy (reciprocal throughput).
+  uint8_t reserved;                      //!< \internal
+};
+
+//! \internal
+//!
+//! Scheduling model of a microarchitecture.
+struct X86SchedModel {
+  uint8_t issueWidth;                    //!< Instructions issued per cycle.
+  uint8_t reserved[3];                   //!< \internal
+  X86SchedEntry entries[kX86SchedCount]; //!< Latency and units of each class.
+};
+
+#define E(LATENCY, UNITS, BUSY) { LATENCY, UNITS, BUSY, 0 }
+static const X86SchedModel x86SchedModels[X86SchedPass::kModelCount] = {
+  // Generic - conservative, close to the worst of the supported models.
+  { 4, { 0 }, {
+    E(1, 3, 1), E(3, 1, 1), E(1, 3, 1), E(1, 2, 1), E(1, 1, 1), E(5, 1, 1), E(10, 1, 2), E(4, 1, 1),
+    E(5, 1, 1), E(5, 1, 1), E(14, 1, 7), E(18, 1, 12), E(4, 1, 1), E(5, 2, 1), E(1, 1, 1)
+  } },
+  // Intel Sandy Bridge and Ivy Bridge.
+  { 4, { 0 }, {
+    E(1, 3, 1), E(3, 1, 1), E(1, 3, 1), E(1, 2, 1), E(1, 2, 1), E(5, 1, 1), E(5, 1, 1), E(3, 1, 1),
+    E(5, 1, 1), E(5, 1, 1), E(12, 1, 6), E(14, 1, 14), E(3, 1, 1), E(5, 2, 1), E(1, 1, 1)
+  } },
+  // Intel Haswell and Broadwell.
+  { 4, { 0 }, {
+    E(1, 4, 1), E(3, 1, 1), E(1, 4, 1), E(1, 3, 1), E(1, 1, 1), E(5, 1, 1), E(10, 1, 2), E(3, 1, 1),
+    E(5, 2, 1), E(5, 2, 1), E(13, 1, 7), E(13, 1, 7), E(4, 1, 1), E(5, 2, 1), E(1, 1, 1)
+  } },
+  // Intel Skylake and derivatives.
+  { 4, { 0 }, {
+    E(1, 4, 1), E(3, 1, 1), E(1, 4, 1), E(1, 3, 1), E(1, 1, 1), E(5, 2, 1), E(10, 2, 1), E(4, 2, 1),
+    E(4, 2, 1), E(4, 2, 1), E(11, 1, 3), E(12, 1, 3), E(4, 2, 1), E(5, 2, 1), E(1, 1, 1)
+  } },
+  // AMD Zen.
+  { 5, { 0 }, {
+    E(1, 4, 1), E(3, 1, 1), E(1, 4, 1), E(1, 3, 1), E(1, 2, 1), E(4, 1, 1), E(4, 1, 2), E(3, 2, 1),
+    E(3, 2, 1), E(5, 2, 1), E(10, 1, 3), E(14, 1, 5), E(4, 1, 1), E(4, 2, 1), E(1, 1, 1)
+  } }
+};
+#undef E
+
+static uint32_t X86SchedPass_getClass(uint32_t instId) noexcept {
+  if ((instId >= X86Inst::kIdVfmadd132pd && instId <= X86Inst::kIdVfnmsubss))
+    return kX86SchedFma;
+
+  if ((instId >= X86Inst::kIdCvtdq2pd  && instId <= X86Inst::kIdCvttss2si ) ||
+      (instId >= X86Inst::kIdVcvtdq2pd && instId <= X86Inst::kIdVcvtusi2ss))
+    return kX86SchedCvt;
+
+  if ((instId >= X86Inst::kIdPunpckhbw  && instId <= X86Inst::kIdPunpcklwd ) ||
+      (instId >= X86Inst::kIdVpunpckhbw && instId <= X86Inst::kIdVpunpcklwd))
+    return kX86SchedVecShuf;
+
+  switch (instId) {
+    case X86Inst::kIdImul:
+      return kX86SchedImul;
+
+    case X86Inst::kIdMov:
+    case X86Inst::kIdMovd:
+    case X86Inst::kIdMovq:
+    case X86Inst::kIdMovaps:
+    case X86Inst::kIdMovapd:
+    case X86Inst::kIdMovdqa:
+    case X86Inst::kIdMovups:
+    case X86Inst::kIdMovupd:
+    case X86Inst::kIdMovdqu:
+    case X86Inst::kIdVmovd:
+    case X86Inst::kIdVmovq:
+    case X86Inst::kIdVmovaps:
+    case X86Inst::kIdVmovapd:
+    case X86Inst::kIdVmovdqa:
+    case X86Inst::kIdVmovups:
+    case X86Inst::kIdVmovupd:
+    case X86Inst::kIdVmovdqu:
+      return kX86SchedMove;
+
+    case X86Inst::kIdShufps:
+    case X86Inst::kIdShufpd:
+    case X86Inst::kIdPshufb:
+    case X86Inst::kIdPshufd:
+    case X86Inst::kIdPshufhw:
+    case X86Inst::kIdPshuflw:
+    case X86Inst::kIdUnpckhps:
+    case X86Inst::kIdUnpckhpd:
+    case X86Inst::kIdUnpcklps:
+    case X86Inst::kIdUnpcklpd:
+    case X86Inst::kIdPalignr:
+    case X86Inst::kIdPslldq:
+    case X86Inst::kIdPsrldq:
+    case X86Inst::kIdPacksswb:
+    case X86Inst::kIdPackssdw:
+    case X86Inst::kIdPackuswb:
+    case X86Inst::kIdPackusdw:
+    case X86Inst::kIdVshufps:
+    case X86Inst::kIdVshufpd:
+    case X86Inst::kIdVpshufb:
+    case X86Inst::kIdVpshufd:
+    case X86Inst::kIdVpshufhw:
+    case X86Inst::kIdVpshuflw:
+    case X86Inst::kIdVunpckhps:
+    case X86Inst::kIdVunpckhpd:
+    case X86Inst::kIdVunpcklps:
+    case X86Inst::kIdVunpcklpd:
+    case X86Inst::kIdVpalignr:
+    case X86Inst::kIdVpslldq:
+    case X86Inst::kIdVpsrldq:
+    case X86Inst::kIdVpacksswb:
+    case X86Inst::kIdVpackssdw:
+    case X86Inst::kIdVpackuswb:
+    case X86Inst::kIdVpackusdw:
+    case X86Inst::kIdVpermd:
+    case X86Inst::kIdVpermps:
+    case X86Inst::kIdVpermq:
+    case X86Inst::kIdVpermpd:
+    case X86Inst::kIdVperm2f128:
+    case X86Inst::kIdVperm2i128:
+      return kX86SchedVecShuf;
+
+    case X86Inst::kIdPmullw:
+    case X86Inst::kIdPmulhw:
+    case X86Inst::kIdPmulhuw:
+    case X86Inst::kIdPmulhrsw:
+    case X86Inst::kIdPmuludq:
+    case X86Inst::kIdPmuldq:
+    case X86Inst::kIdPmaddwd:
+    case X86Inst::kIdPmaddubsw:
+    case X86Inst::kIdVpmullw:
+    case X86Inst::kIdVpmulhw:
+    case X86Inst::kIdVpmulhuw:
+    case X86Inst::kIdVpmulhrsw:
+    case X86Inst::kIdVpmuludq:
+    case X86Inst::kIdVpmuldq:
+    case X86Inst::kIdVpmaddwd:
+    case X86Inst::kIdVpmaddubsw:
+      return kX86SchedVecIMul;
+
+    case X86Inst::kIdPmulld:
+    case X86Inst::kIdVpmulld:
+      return kX86SchedVecIMul32;
+
+    case X86Inst::kIdAddps:
+    case X86Inst::kIdAddpd:
+    case X86Inst::kIdAddss:
+    case X86Inst::kIdAddsd:
+    case X86Inst::kIdSubps:
+    case X86Inst::kIdSubpd:
+    case X86Inst::kIdSubss:
+    case X86Inst::kIdSubsd:
+    case X86Inst::kIdMinps:
+    case X86Inst::kIdMinpd:
+    case X86Inst::kIdMinss:
+    case X86Inst::kIdMinsd:
+    case X86Inst::kIdMaxps:
+    case X86Inst::kIdMaxpd:
+    case X86Inst::kIdMaxss:
+    case X86Inst::kIdMaxsd:
+    case X86Inst::kIdCmpps:
+    case X86Inst::kIdCmppd:
+    case X86Inst::kIdCmpss:
+    case X86Inst::kIdCmpsd:
+    case X86Inst::kIdAddsubps:
+    case X86Inst::kIdAddsubpd:
+    case X86Inst::kIdVaddps:
+    case X86Inst::kIdVaddpd:
+    case X86Inst::kIdVaddss:
+    case X86Inst::kIdVaddsd:
+    case X86Inst::kIdVsubps:
+    case X86Inst::kIdVsubpd:
+    case X86Inst::kIdVsubss:
+    case X86Inst::kIdVsubsd:
+    case X86Inst::kIdVminps:
+    case X86Inst::kIdVminpd:
+    case X86Inst::kIdVminss:
+    case X86Inst::kIdVminsd:
+    case X86Inst::kIdVmaxps:
+    case X86Inst::kIdVmaxpd:
+    case X86Inst::kIdVmaxss:
+    case X86Inst::kIdVmaxsd:
+    case X86Inst::kIdVcmpps:
+    case X86Inst::kIdVcmppd:
+    case X86Inst::kIdVcmpss:
+    case X86Inst::kIdVcmpsd:
+    case X86Inst::kIdVaddsubps:
+    case X86Inst::kIdVaddsubpd:
+      return kX86SchedFpAdd;
+
+    case X86Inst::kIdMulps:
+    case X86Inst::kIdMulpd:
+    case X86Inst::kIdMulss:
+    case X86Inst::kIdMulsd:
+    case X86Inst::kIdVmulps:
+    case X86Inst::kIdVmulpd:
+    case X86Inst::kIdVmulss:
+    case X86Inst::kIdVmulsd:
+      return kX86SchedFpMul;
+
+    case X86Inst::kIdDivps:
+    case X86Inst::kIdDivpd:
+    case X86Inst::kIdDivss:
+    case X86Inst::kIdDivsd:
+    case X86Inst::kIdVdivps:
+    case X86Inst::kIdVdivpd:
+    case X86Inst::kIdVdivss:
+    case X86Inst::kIdVdivsd:
+      return kX86SchedFpDiv;
+
+    case X86Inst::kIdSqrtps:
+    case X86Inst::kIdSqrtpd:
+    case X86Inst::kIdSqrtss:
+    case X86Inst::kIdSqrtsd:
+    case X86Inst::kIdVsqrtps:
+    case X86Inst::kIdVsqrtpd:
+    case X86Inst::kIdVsqrtss:
+    case X86Inst::kIdVsqrtsd:
+      return kX86SchedFpSqrt;
+
+    default: {
+      const X86Inst::CommonData& commonData = X86Inst::getInst(instId).getCommonData();
+      return (commonData.isVec() || commonData.isMmx()) ? kX86SchedVecAlu : kX86SchedAlu;
+    }
+  }
+}
+
+// ============================================================================
+// [asmjit::X86SchedPass - Analysis]
+// ============================================================================
+
+//! \internal
+//!
+//! Maximum number of instructions scheduled together, longer basic blocks are
+//! split into regions of at most `kX86SchedMaxRegion` instructions.
+enum { kX86SchedMaxRegion = 64 };
+
+//! \internal
+enum {
+  kX86SchedFlagsMask = x86::kSpecialReg_FLAGS_CF | x86::kSpecialReg_FLAGS_PF |
+                       x86::kSpecialReg_FLAGS_AF | x86::kSpecialReg_FLAGS_ZF |
+                       x86::kSpecialReg_FLAGS_SF | x86::kSpecialReg_FLAGS_DF |
+                       x86::kSpecialReg_FLAGS_OF
+};
+
+//! \internal
+//!
+//! Instruction of a scheduling region.
+struct X86SchedNode {
+  CBInst* inst;                          //!< Instruction node.
+  uint64_t regsR;                        //!< Registers read (GP|VEC|MM|K bits).
+  uint64_t regsW;                        //!< Registers written (GP|VEC|MM|K bits).
+  uint64_t preds;                        //!< Instructions this instruction depends on.
+  uint64_t rawPreds;                     //!< Subset of `preds` that produce a value read.
+  uint32_t flagsR;                       //!< Flags read.
+  uint32_t flagsW;                       //!< Flags written.
+  uint8_t memR;                          //!< Reads memory.
+  uint8_t memW;                          //!< Writes memory.
+  uint8_t schedClass;                    //!< Scheduling class, see \ref X86SchedClass.
+  uint8_t latency;                       //!< Latency of the result.
+  uint32_t height;                       //!< Latency-weighted height (priority).
+  uint32_t ready;                        //!< First cycle all operands are available.
+};
+
+// Get bit that represents a physical register, zero if not tracked.
+static ASMJIT_INLINE uint64_t X86SchedPass_regBit(uint32_t kind, uint32_t id) noexcept {
+  uint32_t base;
+  uint32_t count;
+
+  switch (kind) {
+    case X86Reg::kKindGp : base =  0; count = 16; break;
+    case X86Reg::kKindVec: base = 16; count = 32; break;
+    case X86Reg::kKindMm : base = 48; count =  8; break;
+    case X86Reg::kKindK  : base = 56; count =  8; break;
+    default:
+      return 0;
+  }
+
+  return id < count ? static_cast<uint64_t>(1) << (base + id) : static_cast<uint64_t>(0);
+}
+
+// Fill `sn` from `inst`. Returns false if the instruction cannot be moved.
+static bool X86SchedPass_analyze(X86SchedNode& sn, CBInst* inst, const X86SchedModel& model) noexcept {
+  uint32_t instId = inst->getInstId();
+  if (ASMJIT_UNLIKELY(!X86Inst::isDefinedId(instId)))
+    return false;
+
+  const X86Inst& instInfo = X86Inst::getInst(instId);
+  const X86Inst::CommonData& commonData = instInfo.getCommonData();
+  const X86Inst::OperationData& operationData = instInfo.getOperationData();
+
+  if (commonData.doesJump() || commonData.isFpu() || operationData.isVolatile() || operationData.isBarrier())
+    return false;
+
+  // Instructions that implicitly access registers or state not described by
+  // the instruction database (upper halves of all YMM registers and MXCSR).
+  switch (instId) {
+    case X86Inst::kIdVzeroupper:
+    case X86Inst::kIdVzeroall:
+    case X86Inst::kIdLdmxcsr:
+    case X86Inst::kIdStmxcsr:
+    case X86Inst::kIdVldmxcsr:
+    case X86Inst::kIdVstmxcsr:
+    case X86Inst::kIdUd2:
+      return false;
+
+    default:
+      break;
+  }
+
+  uint32_t specialR = operationData.getSpecialRegsR();
+  uint32_t specialW = operationData.getSpecialRegsW();
+  if ((specialR | specialW) & ~static_cast<uint32_t>(kX86SchedFlagsMask))
+    return false;
+
+  uint32_t opCount = inst->getOpCount();
+  const Operand* opArray = inst->getOpArray();
+
+  // Implicit registers are not tracked, except shift count (always explicit)
+  // and multi-operand IMUL, which doesn't use fixed registers.
+  if (commonData.hasFixedRM()) {
+    bool explicitOnly = (instId == X86Inst::kIdImul && opCount >= 2) ||
+                        instId == X86Inst::kIdRcl || instId == X86Inst::kIdRcr ||
+                        instId == X86Inst::kIdRol || instId == X86Inst::kIdRor ||
+                        instId == X86Inst::kIdSal || instId == X86Inst::kIdSar ||
+                        instId == X86Inst::kIdShl || instId == X86Inst::kIdShr ;
+    if (!explicitOnly)
+      return false;
+  }
+
+  sn.inst = inst;
+  sn.regsR = 0;
+  sn.regsW = 0;
+  sn.preds = 0;
+  sn.rawPreds = 0;
+  sn.flagsR = specialR;
+  sn.flagsW = specialW;
+  sn.memR = 0;
+  sn.memW = 0;
+  sn.schedClass = static_cast<uint8_t>(X86SchedPass_getClass(instId));
+  sn.height = 0;
+  sn.ready = 0;
+
+  if (inst->hasExtraReg()) {
+    const RegOnly& extraReg = inst->getExtraReg();
+    if (extraReg.isVirtReg() || extraReg.getKind() != X86Reg::kKindK)
+      return false;
+    sn.regsR |= X86SchedPass_regBit(X86Reg::kKindK, extraReg.getId());
+  }
+
+  uint32_t flags = commonData.getFlags();
+  bool noAccess = instId == X86Inst::kIdLea || operationData.isPrefetch();
+
+  for (uint32_t i = 0; i < opCount; i++) {
+    const Operand& op = opArray[i];
+
+    // Operand use, only the first two operands can be written.
+    bool isR = true;
+    bool isW = false;
+
+    if (i == 0) {
+      isR = (flags & (X86Inst::kFlagUseA | X86Inst::kFlagUseR | X86Inst::kFlagUseXX)) != 0 ||
+            (flags & X86Inst::kFlagUseW) == 0;
+      isW = (flags & (X86Inst::kFlagUseA | X86Inst::kFlagUseW | X86Inst::kFlagUseXX)) != 0;
+    }
+    else if (i == 1) {
+      isW = (flags & X86Inst::kFlagUseXX) != 0;
+    }
+
+    if (op.isReg()) {
+      const X86Reg& reg = op.as<X86Reg>();
+      if (reg.isVirtReg())
+        return false;
+
+      uint64_t bit = X86SchedPass_regBit(reg.getKind(), reg.getId());
+      if (!bit)
+        return false;
+
+      // Writing 8-bit or 16-bit GP register merges with the previous value.
+      if (isW && reg.getKind() == X86Reg::kKindGp && reg.getSize() < 4)
+        isR = true;
+
+      if (isR) sn.regsR |= bit;
+      if (isW) sn.regsW |= bit;
+    }
+    else if (op.isMem()) {
+      const X86Mem& mem = op.as<X86Mem>();
+
+      if (mem.hasBaseReg() && mem.getBaseType() != X86Reg::kRegRip) {
+        if (Operand::isPackedId(mem.getBaseId()))
+          return false;
+        sn.regsR |= X86SchedPass_regBit(X86Reg::kKindGp, mem.getBaseId());
+      }
+
+      if (mem.hasIndexReg()) {
+        uint32_t indexType = mem.getIndexType();
+        uint32_t indexKind = (indexType >= X86Reg::kRegXmm && indexType <= X86Reg::kRegZmm) ? X86Reg::kKindVec : X86Reg::kKindGp;
+
+        if (Operand::isPackedId(mem.getIndexId()))
+          return false;
+        sn.regsR |= X86SchedPass_regBit(indexKind, mem.getIndexId());
+      }
+
+      if (!noAccess) {
+        if (isR) sn.memR = 1;
+        if (isW) sn.memW = 1;
+      }
+    }
+  }
+
+  // Latency of the result, a load replaces the latency of a move.
+  uint32_t latency = model.entries[sn.schedClass].latency;
+  if (sn.memR) {
+    uint32_t loadLatency = model.entries[kX86SchedLoad].latency;
+    latency = sn.schedClass == kX86SchedMove ? loadLatency : latency + loadLatency;
+  }
+
+  sn.latency = static_cast<uint8_t>(latency);
+  return true;
+}
+
+// ============================================================================
+// [asmjit::X86SchedPass - Simulation]
+// ============================================================================
+
+//! \internal
+//!
+//! Execution units state used to estimate when an instruction can be issued.
+struct X86SchedUnits {
+  enum { kMaxUnits = 4 };
+
+  ASMJIT_INLINE void reset() noexcept { ::memset(freeAt, 0, sizeof(freeAt)); }
+
+  // Get index of a unit that can execute `schedClass` at `cycle`, or -1.
+  ASMJIT_INLINE int find(const X86SchedModel& model, uint32_t schedClass, uint32_t cycle) const noexcept {
+    uint32_t units = std::min<uint32_t>(model.entries[schedClass].units, kMaxUnits);
+    for (uint32_t u = 0; u < units; u++)
+      if (freeAt[schedClass][u] <= cycle)
+        return static_cast<int>(u);
+    return -1;
+  }
+
+  ASMJIT_INLINE bool canIssue(const X86SchedModel& model, const X86SchedNode& sn, uint32_t cycle) const noexcept {
+    return find(model, sn.schedClass, cycle) >= 0 &&
+           (!sn.memR || find(model, kX86SchedLoad, cycle) >= 0) &&
+           (!sn.memW || find(model, kX86SchedStore, cycle) >= 0);
+  }
+
+  ASMJIT_INLINE void use(const X86SchedModel& model, uint32_t schedClass, uint32_t cycle) noexcept {
+    int u = find(model, schedClass, cycle);
+    ASMJIT_ASSERT(u >= 0);
+    freeAt[schedClass][u] = cycle + model.entries[schedClass].busy;
+  }
+
+  ASMJIT_INLINE void issue(const X86SchedModel& model, const X86SchedNode& sn, uint32_t cycle) noexcept {
+    use(model, sn.schedClass, cycle);
+    if (sn.memR) use(model, kX86SchedLoad, cycle);
+    if (sn.memW) use(model, kX86SchedStore, cycle);
+  }
+
+  uint32_t freeAt[kX86SchedCount][kMaxUnits];
+};
+
+// Get latency of an edge from `nodes[j]` to `nodes[i]`.
+static ASMJIT_INLINE uint32_t X86SchedPass_edgeLatency(const X86SchedNode* nodes, uint32_t j, uint32_t i) noexcept {
+  return ((nodes[i].rawPreds >> j) & 1) ? static_cast<uint32_t>(nodes[j].latency) : 0U;
+}
+
+// Mark `nodes[j]` issued at `cycle` and update readiness of its successors.
+static ASMJIT_INLINE uint32_t X86SchedPass_release(X86SchedNode* nodes, uint32_t count, uint32_t j, uint32_t cycle) noexcept {
+  for (uint32_t k = j + 1; k < count; k++)
+    if ((nodes[k].preds >> j) & 1)
+      nodes[k].ready = std::max<uint32_t>(nodes[k].ready, cycle + X86SchedPass_edgeLatency(nodes, j, k));
+  return cycle + nodes[j].latency;
+}
+
+// Estimate cycles of the region if issued in the original order.
+static uint32_t X86SchedPass_simulateInOrder(X86SchedNode* nodes, uint32_t count, const X86SchedModel& model) noexcept {
+  X86SchedUnits units;
+  units.reset();
+
+  uint32_t cycle = 0;
+  uint32_t issued = 0;
+  uint32_t end = 0;
+
+  for (uint32_t i = 0; i < count; i++)
+    nodes[i].ready = 0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    X86SchedNode& sn = nodes[i];
+
+    uint32_t c = std::max<uint32_t>(cycle, sn.ready);
+    if (c != cycle) issued = 0;
+
+    while (issued >= model.issueWidth || !units.canIssue(model, sn, c)) {
+      c++;
+      issued = 0;
+    }
+
+    units.issue(model, sn, c);
+    end = std::max<uint32_t>(end, X86SchedPass_release(nodes, count, i, c));
+
+    cycle = c;
+    issued++;
+  }
+
+  return end;
+}
+
+// Schedule the region, store the new order to `order`, and return its cycles.
+static uint32_t X86SchedPass_schedule(X86SchedNode* nodes, uint32_t count, const X86SchedModel& model, uint8_t* order) noexcept {
+  X86SchedUnits units;
+  units.reset();
+
+  uint32_t i;
+  for (i = 0; i < count; i++)
+    nodes[i].ready = 0;
+
+  uint64_t done = 0;
+  uint32_t cycle = 0;
+  uint32_t end = 0;
+  uint32_t n = 0;
+
+  while (n < count) {
+    uint32_t issued = 0;
+
+    while (issued < model.issueWidth) {
+      uint32_t best = count;
+      for (i = 0; i < count; i++) {
+        const X86SchedNode& sn = nodes[i];
+        if (((done >> i) & 1) || (sn.preds & ~done) || sn.ready > cycle)
+          continue;
+
+        if (best != count && sn.height <= nodes[best].height)
+          continue;
+
+        if (units.canIssue(model, sn, cycle))
+          best = i;
+      }
+
+      if (best == count)
+        break;
+
+      units.issue(model, nodes[best], cycle);
+      end = std::max<uint32_t>(end, X86SchedPass_release(nodes, count, best, cycle));
+
+      done |= static_cast<uint64_t>(1) << best;
+      order[n++] = static_cast<uint8_t>(best);
+      issued++;
+    }
+
+    cycle++;
+  }
+
+  return end;
+}
+
+// ============================================================================
+// [asmjit::X86SchedPass - Region]
+// ============================================================================
+
+// Build dependencies of `count` nodes and compute their heights.
+static void X86SchedPass_buildDeps(X86SchedNode* nodes, uint32_t count) noexcept {
+  uint32_t i, j;
+
+  for (i = 1; i < count; i++) {
+    X86SchedNode& b = nodes[i];
+    for (j = 0; j < i; j++) {
+      const X86SchedNode& a = nodes[j];
+      uint64_t bit = static_cast<uint64_t>(1) << j;
+
+      bool raw = (a.regsW & b.regsR) != 0 || (a.flagsW & b.flagsR) != 0 || (a.memW & b.memR) != 0;
+      bool war = (a.regsR & b.regsW) != 0 || (a.flagsR & b.flagsW) != 0 || (a.memR & b.memW) != 0;
+      bool waw = (a.regsW & b.regsW) != 0 || (a.flagsW & b.flagsW) != 0 || (a.memW & b.memW) != 0;
+
+      if (raw) b.rawPreds |= bit;
+      if (raw | war | waw) b.preds |= bit;
+    }
+  }
+
+  i = count;
+  while (i) {
+    X86SchedNode& a = nodes[--i];
+    uint32_t height = a.latency;
+
+    for (j = i + 1; j < count; j++)
+      if ((nodes[j].preds >> i) & 1)
+        height = std::max<uint32_t>(height, X86SchedPass_edgeLatency(nodes, i, j) + nodes[j].height);
+
+    a.height = height;
+  }
+}
+
+static void X86SchedPass_scheduleRegion(X86SchedPass* self, X86SchedNode* nodes, uint32_t count, const X86SchedModel& model) noexcept {
+  if (count < 3) return;
+
+  uint8_t order[kX86SchedMaxRegion];
+  X86SchedPass_buildDeps(nodes, count);
+
+  uint32_t before = X86SchedPass_simulateInOrder(nodes, count, model);
+  uint32_t after = X86SchedPass_schedule(nodes, count, model, order);
+
+  uint32_t i;
+  bool changed = false;
+
+  for (i = 0; i < count; i++)
+    if (order[i] != i)
+      changed = true;
+
+  if (!changed || after >= before) {
+    self->_cyclesBefore += before;
+    self->_cyclesAfter += before;
+    return;
+  }
+
+  // Relink the region in the new order.
+  CodeBuilder* cb = self->_cb;
+  CBNode* prev = nodes[0].inst->getPrev();
+
+  for (i = 0; i < count; i++)
+    cb->removeNode(nodes[i].inst);
+
+  for (i = 0; i < count; i++)
+    prev = cb->addAfter(nodes[order[i]].inst, prev);
+
+  self->_scheduledCount++;
+  self->_cyclesBefore += before;
+  self->_cyclesAfter += after;
+}
+
+// ============================================================================
+// [asmjit::X86SchedPass - Construction / Destruction]
+// ============================================================================
+
+X86SchedPass::X86SchedPass() noexcept
+  : CBPass("X86SchedPass"),
+    _modelId(modelIdOf(CpuInfo::getHost())),
+    _scheduledCount(0),
+    _cyclesBefore(0),
+    _cyclesAfter(0) {}
+
+X86SchedPass::X86SchedPass(const CpuInfo& cpuInfo) noexcept
+  : CBPass("X86SchedPass"),
+    _modelId(modelIdOf(cpuInfo)),
+    _scheduledCount(0),
+    _cyclesBefore(0),
+    _cyclesAfter(0) {}
+
+X86SchedPass::~X86SchedPass() noexcept {}
+
+// ============================================================================
+// [asmjit::X86SchedPass - Accessors]
+// ============================================================================
+
+uint32_t X86SchedPass::modelIdOf(const CpuInfo& cpuInfo) noexcept {
+  uint32_t family = cpuInfo.getFamily();
+  uint32_t model = cpuInfo.getModel();
+
+  if (cpuInfo.getVendorId() == CpuInfo::kVendorIntel && family == 0x06) {
+    switch (model) {
+      case 0x2A: case 0x2D: case 0x3A: case 0x3E:
+        return kModelSandyBridge;
+
+      case 0x3C: case 0x3F: case 0x45: case 0x46:
+      case 0x3D: case 0x47: case 0x4F: case 0x56:
+        return kModelHaswell;
+
+      case 0x4E: case 0x5E: case 0x55: case 0x8E:
+      case 0x9E: case 0x66: case 0x7D: case 0x7E:
+      case 0x6A: case 0x6C: case 0xA5: case 0xA6:
+        return kModelSkylake;
+
+      default:
+        return kModelGeneric;
+    }
+  }
+
+  if (cpuInfo.getVendorId() == CpuInfo::kVendorAMD && family >= 0x17)
+    return kModelZen;
+
+  return kModelGeneric;
+}
+
+// ============================================================================
+// [asmjit::X86SchedPass - Interface]
+// ============================================================================
+
+Error X86SchedPass::process(Zone* zone) noexcept {
+  _scheduledCount = 0;
+  _cyclesBefore = 0;
+  _cyclesAfter = 0;
+
+  X86SchedNode* nodes = zone->allocT<X86SchedNode>(kX86SchedMaxRegion * sizeof(X86SchedNode));
+  if (ASMJIT_UNLIKELY(!nodes))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  const X86SchedModel& model = x86SchedModels[_modelId];
+  CBNode* node_ = _cb->getFirstNode();
+  uint32_t count = 0;
+
+  while (node_) {
+    CBNode* next = node_->getNext();
+
+    // Regions end at the first node that isn't a movable instruction.
+    if (node_->getType() != CBNode::kNodeInst ||
+        !X86SchedPass_analyze(nodes[count], node_->as<CBInst>(), model)) {
+      X86SchedPass_scheduleRegion(this, nodes, count, model);
+      count = 0;
+    }
+    else if (++count == kX86SchedMaxRegion) {
+      X86SchedPass_scheduleRegion(this, nodes, count, model);
+      count = 0;
+    }
+
+    node_ = next;
+  }
+
+  X86SchedPass_scheduleRegion(this, nodes, count, model);
+  return kErrorOk;
+}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // ASMJIT_BUILD_X86 && !ASMJIT_DISABLE_BUILDER
@@ -0,0 +1,123 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _ASMJIT_X86_X86SCHED_H
+#define _ASMJIT_X86_X86SCHED_H
+
+#include "../asmjit_build.h"
+#if !defined(ASMJIT_DISABLE_BUILDER)
+
+// [Dependencies]
+#include "../base/codebuilder.h"
+#include "../base/cpuinfo.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+//! \addtogroup asmjit_x86
+//! \{
+
+// ============================================================================
+// [asmjit::X86SchedPass]
+// ============================================================================
+
+//! X86/X64 instruction scheduler.
+//!
+//! List scheduler that reorders instructions within basic blocks to separate
+//! dependent long-latency instructions (multiplications, divisions, loads).
+//! Dependencies are computed from register, flags, and memory use of each
+//! instruction, and the schedule is driven by a latency and execution-unit
+//! model selected from \ref CpuInfo (vendor, family, and model).
+//!
+//! The scheduler works on physical registers, so it must be added after the
+//! register allocator (`X86Compiler` adds its register allocator when attached,
+//! so any pass added later is fine):
+//!
+//! ~~~
+//! X86Compiler cc(&code);
+//! cc.addPassT<X86SchedPass>();
+//! ~~~
+//!
+//! Labels, jumps, calls, and instructions that use implicit registers, the
+//! stack, or have side effects (fences, privileged and x87 instructions) are
+//! never moved and split basic blocks into smaller regions. A region is only
+//! rewritten if the model estimates it would execute faster.
+class ASMJIT_VIRTAPI X86SchedPass : public CBPass {
+public:
+  ASMJIT_NONCOPYABLE(X86SchedPass)
+  typedef CBPass Base;
+
+  //! Scheduling model (microarchitecture).
+  ASMJIT_ENUM(ModelId) {
+    kModelGeneric     = 0,               //!< Generic model (unknown processor).
+    kModelSandyBridge = 1,               //!< Intel Sandy Bridge and Ivy Bridge.
+    kModelHaswell     = 2,               //!< Intel Haswell and Broadwell.
+    kModelSkylake     = 3,               //!< Intel Skylake and derivatives.
+    kModelZen         = 4,               //!< AMD Zen.
+    kModelCount       = 5                //!< Count of scheduling models.
+  };
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  //! Create a `X86SchedPass` that uses a model of the host processor.
+  ASMJIT_API X86SchedPass() noexcept;
+  //! Create a `X86SchedPass` that uses a model of the given `cpuInfo`.
+  ASMJIT_API explicit X86SchedPass(const CpuInfo& cpuInfo) noexcept;
+  //! Destroy the `X86SchedPass` instance.
+  ASMJIT_API virtual ~X86SchedPass() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  ASMJIT_API virtual Error process(Zone* zone) noexcept override;
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  //! Get scheduling model that matches `cpuInfo`, see \ref ModelId.
+  static ASMJIT_API uint32_t modelIdOf(const CpuInfo& cpuInfo) noexcept;
+
+  //! Get scheduling model, see \ref ModelId.
+  ASMJIT_INLINE uint32_t getModelId() const noexcept { return _modelId; }
+  //! Set scheduling model, see \ref ModelId.
+  ASMJIT_INLINE void setModelId(uint32_t modelId) noexcept {
+    _modelId = modelId < kModelCount ? modelId : static_cast<uint32_t>(kModelGeneric);
+  }
+
+  //! Get number of regions rewritten by the last `process()`.
+  ASMJIT_INLINE uint32_t getScheduledCount() const noexcept { return _scheduledCount; }
+  //! Get estimated cycles of all regions before scheduling (last `process()`).
+  ASMJIT_INLINE uint32_t getCyclesBefore() const noexcept { return _cyclesBefore; }
+  //! Get estimated cycles of all regions after scheduling (last `process()`).
+  ASMJIT_INLINE uint32_t getCyclesAfter() const noexcept { return _cyclesAfter; }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  uint32_t _modelId;                     //!< Scheduling model.
+  uint32_t _scheduledCount;              //!< Number of regions rewritten.
+  uint32_t _cyclesBefore;                //!< Estimated cycles before scheduling.
+  uint32_t _cyclesAfter;                 //!< Estimated cycles after scheduling.
+};
+
+//! \}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // !ASMJIT_DISABLE_BUILDER
+#endif // _ASMJIT_X86_X86SCHED_H
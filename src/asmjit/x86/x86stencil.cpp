@@ -0,0 +1,672 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Export]
+#define ASMJIT_EXPORTS
+
+// [Guard]
+#include "../asmjit_build.h"
+#if defined(ASMJIT_BUILD_X86)
+
+// [Dependencies]
+#include "../base/runtime.h"
+#include "../base/utils.h"
+#include "../x86/x86stencil.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+// ============================================================================
+// [asmjit::X86Stencil - Helpers]
+// ============================================================================
+
+//! \internal
+//!
+//! Register id used by the reference encoding. Not `eax`, which has short
+//! forms of many instructions, and not `esp|ebp`, which are special as a base.
+static const uint32_t kX86StencilRegId = 1;
+
+//! \internal
+//!
+//! Get a value of an immediate parameter used by the reference (`alt == 0`)
+//! and alternative (`alt == 1`) encoding. Both are negative and don't fit into
+//! 8 bits (or 32 bits in case of `kParamImm64`) so the assembler always uses
+//! the same form for any value of the parameter.
+static ASMJIT_INLINE uint64_t X86Stencil_immValue(uint32_t paramType, uint32_t index, uint32_t alt) noexcept {
+  if (paramType == X86Stencil::kParamImm64) {
+    uint64_t value = ASMJIT_UINT64_C(0x9E3779B97F4A7C15) + index * ASMJIT_UINT64_C(0x0102030405060708);
+    return alt ? value ^ ASMJIT_UINT64_C(0x00FFFFFFFFFFFF00) : value;
+  }
+  else {
+    uint32_t value = 0x8B5D3C10U + index * 0x01020304U;
+    if (alt) value ^= 0x00FFFF00U;
+    return static_cast<uint64_t>(static_cast<int64_t>(static_cast<int32_t>(value)));
+  }
+}
+
+//! \internal
+//!
+//! Encode the stencil into a new `code` by calling `func`. Register parameters
+//! are `regIds`, immediates are taken from `immValues`, and labels are created
+//! (not bound) and stored to `labels`.
+static Error X86Stencil_encode(
+  CodeHolder& code, uint32_t archType, X86Stencil::EmitFunc func, void* data,
+  const uint8_t* paramTypes, uint32_t paramCount,
+  const uint32_t* regIds, const uint64_t* immValues, Label* labels) {
+
+  ASMJIT_PROPAGATE(code.init(CodeInfo(archType)));
+
+  X86Assembler a(&code);
+  Operand params[X86Stencil::kMaxParams];
+
+  for (uint32_t i = 0; i < paramCount; i++) {
+    switch (paramTypes[i]) {
+      case X86Stencil::kParamImm32:
+      case X86Stencil::kParamImm64:
+        params[i].copyFrom(imm(static_cast<int64_t>(immValues[i])));
+        break;
+
+      case X86Stencil::kParamGpd:
+        params[i].copyFrom(x86::gpd(regIds[i]));
+        break;
+
+      case X86Stencil::kParamGpq:
+        params[i].copyFrom(x86::gpq(regIds[i]));
+        break;
+
+      case X86Stencil::kParamLabel:
+        labels[i] = a.newLabel();
+        params[i].copyFrom(labels[i]);
+        break;
+    }
+  }
+
+  func(a, params, data);
+  ASMJIT_PROPAGATE(a.getLastError());
+
+  code.sync();
+  if (ASMJIT_UNLIKELY(code.getSections().getLength() != 1 || code.getRelocEntries().getLength() != 0))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  return kErrorOk;
+}
+
+//! \internal
+static ASMJIT_INLINE const CodeBuffer& X86Stencil_getBuffer(const CodeHolder& code) noexcept {
+  return code.getSectionEntry(0)->getBuffer();
+}
+
+//! \internal
+//!
+//! Stamp `stencil` into a new code and compare it with the code encoded by
+//! the stencil function with the same parameters.
+static bool X86Stencil_verify(
+  const X86Stencil& stencil, X86Stencil::EmitFunc func, void* data,
+  const uint32_t* regIds, const uint64_t* immValues) {
+
+  uint32_t archType = stencil.getArchType();
+  uint32_t paramCount = stencil.getParamCount();
+
+  CodeHolder expected;
+  Label labels[X86Stencil::kMaxParams];
+
+  if (X86Stencil_encode(expected, archType, func, data,
+                        stencil._paramTypes, paramCount, regIds, immValues, labels) != kErrorOk)
+    return false;
+
+  CodeHolder actual;
+  if (actual.init(CodeInfo(archType)) != kErrorOk)
+    return false;
+
+  X86Assembler a(&actual);
+  Operand args[X86Stencil::kMaxParams];
+
+  for (uint32_t i = 0; i < paramCount; i++) {
+    switch (stencil._paramTypes[i]) {
+      case X86Stencil::kParamImm32:
+      case X86Stencil::kParamImm64:
+        args[i].copyFrom(imm(static_cast<int64_t>(immValues[i])));
+        break;
+
+      case X86Stencil::kParamGpd:
+        args[i].copyFrom(x86::gpd(regIds[i]));
+        break;
+
+      case X86Stencil::kParamGpq:
+        args[i].copyFrom(x86::gpq(regIds[i]));
+        break;
+
+      case X86Stencil::kParamLabel:
+        args[i].copyFrom(a.newLabel());
+        break;
+    }
+  }
+
+  if (a.emitStencil(stencil, args, paramCount) != kErrorOk)
+    return false;
+  actual.sync();
+
+  const CodeBuffer& eb = X86Stencil_getBuffer(expected);
+  const CodeBuffer& ab = X86Stencil_getBuffer(actual);
+
+  return eb.getLength() == ab.getLength() &&
+         ::memcmp(eb.getData(), ab.getData(), eb.getLength()) == 0;
+}
+
+// ============================================================================
+// [asmjit::X86Stencil - Construction / Destruction]
+// ============================================================================
+
+X86Stencil::X86Stencil() noexcept
+  : _data(nullptr),
+    _patches(nullptr),
+    _regTables(nullptr),
+    _archType(ArchInfo::kTypeNone),
+    _size(0),
+    _wordCount(0),
+    _patchCount(0),
+    _regParamCount(0),
+    _paramCount(0) {}
+X86Stencil::~X86Stencil() noexcept { reset(); }
+
+// ============================================================================
+// [asmjit::X86Stencil - Init / Reset]
+// ============================================================================
+
+Error X86Stencil::init(uint32_t archType, EmitFunc func, const uint8_t* paramTypes, uint32_t paramCount, void* data) {
+  reset();
+
+  if (ASMJIT_UNLIKELY(archType != ArchInfo::kTypeX86 && archType != ArchInfo::kTypeX64))
+    return DebugUtils::errored(kErrorInvalidArch);
+
+  if (ASMJIT_UNLIKELY(!func || paramCount > kMaxParams))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  uint32_t i;
+  uint32_t regParamCount = 0;
+  uint32_t regIds[kMaxParams];
+  uint64_t immValues[kMaxParams];
+  uint64_t altValues[kMaxParams];
+  Label labels[kMaxParams];
+
+  for (i = 0; i < paramCount; i++) {
+    uint32_t paramType = paramTypes[i];
+    if (ASMJIT_UNLIKELY(paramType >= kParamCount ||
+                        (paramType == kParamGpq && archType != ArchInfo::kTypeX64)))
+      return DebugUtils::errored(kErrorInvalidArgument);
+
+    if (paramType == kParamGpd || paramType == kParamGpq)
+      regParamCount++;
+
+    regIds[i] = kX86StencilRegId;
+    immValues[i] = X86Stencil_immValue(paramType, i, 0);
+    altValues[i] = X86Stencil_immValue(paramType, i, 1);
+  }
+
+  // Reference encoding.
+  CodeHolder ref;
+  ASMJIT_PROPAGATE(X86Stencil_encode(ref, archType, func, data, paramTypes, paramCount, regIds, immValues, labels));
+
+  const CodeBuffer& refBuffer = X86Stencil_getBuffer(ref);
+  const uint8_t* refData = refBuffer.getData();
+  uint32_t size = static_cast<uint32_t>(refBuffer.getLength());
+
+  if (ASMJIT_UNLIKELY(size == 0 || refBuffer.getLength() > 0xFFFFFFFFU / 4))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  // The stencil is padded to 64-bit words and each register parameter has
+  // a table of words to OR for each register id. Each byte can start at most
+  // one immediate or label patch.
+  uint32_t wordCount = (size + 7) / 8;
+  size_t patchesOffset = static_cast<size_t>(wordCount) * 8;
+  size_t regTablesOffset = Utils::alignTo<size_t>(patchesOffset + static_cast<size_t>(size) * sizeof(Patch), 8);
+  size_t regTablesSize = static_cast<size_t>(regParamCount) * 16 * wordCount * 8;
+
+  _data = static_cast<uint8_t*>(Internal::allocMemory(regTablesOffset + regTablesSize));
+  if (ASMJIT_UNLIKELY(!_data))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  ::memcpy(_data, refData, size);
+  ::memset(_data + size, 0, patchesOffset - size);
+  ::memset(_data + regTablesOffset, 0, regTablesSize);
+
+  _patches = reinterpret_cast<Patch*>(_data + patchesOffset);
+  _regTables = reinterpret_cast<uint64_t*>(_data + regTablesOffset);
+  _archType = archType;
+  _size = size;
+  _wordCount = wordCount;
+  _paramCount = paramCount;
+  _regParamCount = regParamCount;
+
+  for (i = 0; i < paramCount; i++)
+    _paramTypes[i] = paramTypes[i];
+
+  uint32_t patchCount = 0;
+  uint32_t regIndex = 0;
+  Error err = kErrorOk;
+
+  // Labels - only labels passed as parameters can be unbound, their links
+  // become patches. The placeholder (0x04040404) is kept in the stencil as
+  // it's required by `Assembler::bind()`.
+  for (size_t index = 0; index < ref.getLabelsCount(); index++) {
+    LabelEntry* le = ref._getLabelEntryByIndex(index);
+    LabelLink* link = le->_links;
+
+    for (i = 0; i < paramCount; i++)
+      if (paramTypes[i] == kParamLabel && labels[i].getId() == le->getId())
+        break;
+
+    if (i == paramCount) {
+      if (link) goto InvalidArgument;
+      continue;
+    }
+
+    if (le->isBound()) goto InvalidArgument;
+    while (link) {
+      if (link->relocId != RelocEntry::kInvalidId || link->offset + 4 > size || refData[link->offset] != 4)
+        goto InvalidArgument;
+
+      Patch& patch = _patches[patchCount++];
+      patch.type = Patch::kTypeRel32;
+      patch.param = static_cast<uint8_t>(i);
+      patch.reserved = 0;
+      patch.offset = static_cast<uint32_t>(link->offset);
+      patch.rel = static_cast<int32_t>(link->rel);
+      link = link->prev;
+    }
+  }
+
+  // Immediates - found by comparing the reference and alternative encoding.
+  {
+    CodeHolder alt;
+    Label altLabels[kMaxParams];
+
+    err = X86Stencil_encode(alt, archType, func, data, paramTypes, paramCount, regIds, altValues, altLabels);
+    if (err) goto Failed;
+
+    const CodeBuffer& altBuffer = X86Stencil_getBuffer(alt);
+    if (altBuffer.getLength() != size) goto InvalidArgument;
+
+    const uint8_t* altData = altBuffer.getData();
+    for (i = 0; i < paramCount; i++) {
+      uint32_t paramType = paramTypes[i];
+      if (paramType != kParamImm32 && paramType != kParamImm64)
+        continue;
+
+      uint32_t immSize = paramType == kParamImm32 ? 4 : 8;
+      uint8_t refImm[8];
+      uint8_t altImm[8];
+
+      Utils::writeU64uLE(refImm, immValues[i]);
+      Utils::writeU64uLE(altImm, altValues[i]);
+
+      uint32_t offset = 0;
+      while (offset + immSize <= size) {
+        if (::memcmp(refData + offset, refImm, immSize) == 0 && ::memcmp(altData + offset, altImm, immSize) == 0) {
+          Patch& patch = _patches[patchCount++];
+          patch.type = static_cast<uint8_t>(paramType == kParamImm32 ? Patch::kTypeImm32 : Patch::kTypeImm64);
+          patch.param = static_cast<uint8_t>(i);
+          patch.reserved = 0;
+          patch.offset = offset;
+          patch.rel = 0;
+          offset += immSize;
+        }
+        else {
+          offset++;
+        }
+      }
+    }
+  }
+
+  // Registers - fields are found by comparing the reference encoding with the
+  // encoding that uses `edx` (ModRM, SIB, or opcode fields) and `r9` (REX).
+  for (i = 0; i < paramCount; i++) {
+    uint32_t paramType = paramTypes[i];
+    if (paramType != kParamGpd && paramType != kParamGpq)
+      continue;
+
+    uint8_t* regTable = reinterpret_cast<uint8_t*>(_regTables + static_cast<size_t>(regIndex++) * 16 * wordCount);
+    for (uint32_t pass = 0; pass < 2; pass++) {
+      if (pass == 1 && archType != ArchInfo::kTypeX64)
+        break;
+
+      CodeHolder code;
+      Label tmpLabels[kMaxParams];
+
+      regIds[i] = pass == 0 ? 2 : 9;
+      err = X86Stencil_encode(code, archType, func, data, paramTypes, paramCount, regIds, immValues, tmpLabels);
+      regIds[i] = kX86StencilRegId;
+
+      if (!err && X86Stencil_getBuffer(code).getLength() != size)
+        err = DebugUtils::errored(kErrorInvalidArgument);
+
+      if (err) {
+        // Registers `r8..r15` may not be encodable without REX prefix.
+        if (pass == 0) goto Failed;
+
+        err = kErrorOk;
+        break;
+      }
+
+      const uint8_t* regData = X86Stencil_getBuffer(code).getData();
+      uint32_t offset;
+
+      // Either of ModRM|SIB fields (`ecx ^ edx == 3`), or REX.R|X|B bits.
+      for (offset = 0; offset < size; offset++) {
+        uint32_t diff = refData[offset] ^ regData[offset];
+        if (pass == 0 ? (diff & 0xC0) || ((diff & 0x7) != 0 && (diff & 0x7) != 3) || ((diff & 0x38) != 0 && (diff & 0x38) != 0x18)
+                      : (diff & ~0x7U) != 0)
+          break;
+      }
+
+      if (offset != size) {
+        if (pass == 0) goto InvalidArgument;
+        break;
+      }
+
+      for (offset = 0; offset < size; offset++) {
+        uint32_t diff = refData[offset] ^ regData[offset];
+        if (!diff) continue;
+
+        uint32_t fields = 0;
+        if (pass == 0) {
+          if (diff & 0x07) fields |= 0x07;
+          if (diff & 0x38) fields |= 0x38;
+          _data[offset] &= static_cast<uint8_t>(~fields);
+        }
+
+        // `(id & 7) * 9` replicates the low 3 bits of `id` to both fields.
+        for (uint32_t id = 0; id < 16; id++) {
+          uint32_t bits = pass == 0 ? ((id & 0x7) * 9) & fields : diff * (id >> 3);
+          regTable[id * wordCount * 8 + offset] |= static_cast<uint8_t>(bits);
+        }
+      }
+    }
+  }
+
+  _patchCount = patchCount;
+
+  // Verify - the stencil must produce the same code as the stencil function
+  // with alternative immediates and with each register of each parameter.
+  for (i = 0; i < paramCount; i++)
+    _regMasks[i] = 0xFFFF;
+
+  if (!X86Stencil_verify(*this, func, data, regIds, altValues))
+    goto InvalidArgument;
+
+  for (i = 0; i < paramCount; i++) {
+    uint32_t paramType = paramTypes[i];
+    if (paramType != kParamGpd && paramType != kParamGpq) {
+      _regMasks[i] = 0;
+      continue;
+    }
+
+    uint32_t regCount = archType == ArchInfo::kTypeX64 ? 16 : 8;
+    uint32_t regMask = 0;
+
+    for (uint32_t id = 0; id < regCount; id++) {
+      regIds[i] = id;
+      if (X86Stencil_verify(*this, func, data, regIds, immValues))
+        regMask |= Utils::mask(id);
+    }
+
+    regIds[i] = kX86StencilRegId;
+    if (!(regMask & Utils::mask(kX86StencilRegId)))
+      goto InvalidArgument;
+    _regMasks[i] = static_cast<uint16_t>(regMask);
+  }
+
+  return kErrorOk;
+
+InvalidArgument:
+  err = DebugUtils::errored(kErrorInvalidArgument);
+
+Failed:
+  reset();
+  return err;
+}
+
+void X86Stencil::reset() noexcept {
+  if (_data)
+    Internal::releaseMemory(_data);
+
+  _data = nullptr;
+  _patches = nullptr;
+  _regTables = nullptr;
+  _archType = ArchInfo::kTypeNone;
+  _size = 0;
+  _wordCount = 0;
+  _patchCount = 0;
+  _regParamCount = 0;
+  _paramCount = 0;
+}
+
+// ============================================================================
+// [asmjit::X86Stencil - Test]
+// ============================================================================
+
+#if defined(ASMJIT_TEST)
+static void ASMJIT_CDECL x86StencilTestFunc(X86Assembler& a, const Operand* params, void* data) {
+  ASMJIT_UNUSED(data);
+
+  const X86Gp& x = params[0].as<X86Gp>();
+  const X86Gp& y = params[1].as<X86Gp>();
+  Label L_Local = a.newLabel();
+
+  a.mov(x, params[3].as<Imm>());
+  a.add(x, y);
+  a.add(y, x86::qword_ptr(x, params[2].as<Imm>().getInt32()));
+  a.cmp(y, params[2].as<Imm>());
+  a.je(L_Local);
+  a.imul(x, y);
+  a.bind(L_Local);
+  a.jne(params[4].as<Label>());
+}
+
+static void ASMJIT_CDECL x86StencilTestFunc32(X86Assembler& a, const Operand* params, void* data) {
+  ASMJIT_UNUSED(data);
+
+  const X86Gp& x = params[0].as<X86Gp>();
+  const X86Gp& y = params[1].as<X86Gp>();
+
+  a.add(x, y);
+  a.lea(y, x86::ptr(x, y, 2, params[2].as<Imm>().getInt32()));
+  a.call(params[3].as<Label>());
+}
+
+static const uint8_t x86StencilTestParams[] = {
+  X86Stencil::kParamGpq,
+  X86Stencil::kParamGpq,
+  X86Stencil::kParamImm32,
+  X86Stencil::kParamImm64,
+  X86Stencil::kParamLabel
+};
+
+static const uint8_t x86StencilTestParams32[] = {
+  X86Stencil::kParamGpd,
+  X86Stencil::kParamGpd,
+  X86Stencil::kParamImm32,
+  X86Stencil::kParamLabel
+};
+
+//! Check that `stencil` emits the same code as `func` with the registers
+//! `x` and `y` (first two parameters) and the immediates `imms`.
+static bool x86StencilTestMatches(const X86Stencil& stencil, X86Stencil::EmitFunc func,
+  uint32_t x, uint32_t y, const Imm* imms) {
+
+  uint32_t archType = stencil.getArchType();
+  uint32_t paramCount = stencil.getParamCount();
+
+  CodeHolder code0, code1;
+  code0.init(CodeInfo(archType));
+  code1.init(CodeInfo(archType));
+
+  X86Assembler a0(&code0);
+  X86Assembler a1(&code1);
+
+  Label L0 = a0.newLabel();
+  Label L1 = a1.newLabel();
+
+  Operand args0[X86Stencil::kMaxParams];
+  Operand args1[X86Stencil::kMaxParams];
+
+  for (uint32_t i = 0; i < paramCount; i++) {
+    switch (stencil.getParamType(i)) {
+      case X86Stencil::kParamGpd: args0[i].copyFrom(x86::gpd(i == 0 ? x : y)); break;
+      case X86Stencil::kParamGpq: args0[i].copyFrom(x86::gpq(i == 0 ? x : y)); break;
+      case X86Stencil::kParamLabel: args0[i].copyFrom(L0); break;
+      default: args0[i].copyFrom(imms[i - 2]); break;
+    }
+
+    args1[i].copyFrom(args0[i]);
+    if (args1[i].isLabel()) args1[i].copyFrom(L1);
+  }
+
+  if (a0.emitStencil(stencil, args0, paramCount) != kErrorOk)
+    return false;
+  func(a1, args1, nullptr);
+
+  a0.bind(L0);
+  a1.bind(L1);
+
+  code0.sync();
+  code1.sync();
+
+  const CodeBuffer& b0 = code0.getSectionEntry(0)->getBuffer();
+  const CodeBuffer& b1 = code1.getSectionEntry(0)->getBuffer();
+
+  return b0.getLength() == b1.getLength() && ::memcmp(b0.getData(), b1.getData(), b0.getLength()) == 0;
+}
+
+UNIT(x86_stencil) {
+  X86Stencil stencil;
+  uint32_t x, y;
+
+  INFO("Checking X86Stencil::init()");
+  EXPECT(stencil.init(ArchInfo::kTypeX64, x86StencilTestFunc, x86StencilTestParams, 5) == kErrorOk,
+    "X86Stencil::init() failed");
+
+  // `rsp|r12` as a base require SIB, `rax` has a short form of `cmp`.
+  EXPECT(stencil.getRegMask(0) == 0xEFEF,
+    "X86Stencil::getRegMask(0) returned 0x%04X", stencil.getRegMask(0));
+  EXPECT(stencil.getRegMask(1) == 0xFFFE,
+    "X86Stencil::getRegMask(1) returned 0x%04X", stencil.getRegMask(1));
+
+  INFO("Checking X86Assembler::emitStencil() with all allowed registers");
+  {
+    Imm imms[2] = { imm(-123456), imm(ASMJIT_UINT64_C(0x123456789ABCDEF0)) };
+    for (x = 0; x < 16; x++) {
+      for (y = 0; y < 16; y++) {
+        if (!(stencil.getRegMask(0) & Utils::mask(x)) || !(stencil.getRegMask(1) & Utils::mask(y)))
+          continue;
+
+        EXPECT(x86StencilTestMatches(stencil, x86StencilTestFunc, x, y, imms),
+          "X86Assembler::emitStencil() output doesn't match with x=%u y=%u", x, y);
+      }
+    }
+  }
+
+  INFO("Checking X86Assembler::emitStencil() in 32-bit mode");
+  {
+    X86Stencil stencil32;
+    EXPECT(stencil32.init(ArchInfo::kTypeX86, x86StencilTestFunc32, x86StencilTestParams32, 4) == kErrorOk,
+      "X86Stencil::init() failed");
+
+    // `esp` can't be an index.
+    EXPECT(stencil32.getRegMask(1) == 0x00EF,
+      "X86Stencil::getRegMask(1) returned 0x%04X", stencil32.getRegMask(1));
+
+    Imm imms[1] = { imm(1000000) };
+    for (x = 0; x < 8; x++) {
+      for (y = 0; y < 8; y++) {
+        if (!(stencil32.getRegMask(0) & Utils::mask(x)) || !(stencil32.getRegMask(1) & Utils::mask(y)))
+          continue;
+
+        EXPECT(x86StencilTestMatches(stencil32, x86StencilTestFunc32, x, y, imms),
+          "X86Assembler::emitStencil() output doesn't match with x=%u y=%u", x, y);
+      }
+    }
+  }
+
+  INFO("Checking X86Assembler::emitStencil() with a bound label");
+  {
+    CodeHolder code;
+    code.init(CodeInfo(ArchInfo::kTypeX64));
+
+    X86Assembler a(&code);
+    Label L = a.newLabel();
+
+    a.bind(L);
+    a.nop();
+
+    Operand args[5] = { x86::rcx, x86::rdx, imm(8), imm(0), L };
+    EXPECT(a.emitStencil(stencil, args, 5) == kErrorOk,
+      "X86Assembler::emitStencil() failed");
+
+    // `jne` is the last instruction, its target is the start of the code.
+    code.sync();
+    const CodeBuffer& buffer = code.getSectionEntry(0)->getBuffer();
+    int32_t rel32 = Utils::readI32uLE(buffer.getData() + buffer.getLength() - 4);
+
+    EXPECT(rel32 == -static_cast<int32_t>(buffer.getLength()),
+      "X86Assembler::emitStencil() patched rel32 to %d", rel32);
+
+    INFO("Checking X86Assembler::emitStencil() with invalid arguments");
+    Operand rsp[5] = { x86::rsp, x86::rdx, imm(8), imm(0), L };
+    EXPECT(a.emitStencil(stencil, rsp, 5) == kErrorInvalidPhysId,
+      "X86Assembler::emitStencil() must refuse a register not allowed by the stencil");
+  }
+
+  INFO("Checking X86Assembler::emitStencil() with a fixed-size buffer");
+  {
+    // The stencil must fit exactly, even if the padding of its last word doesn't.
+    JitRuntime rt;
+    uint32_t size = stencil.getSize();
+
+    for (uint32_t n = size - 1; n <= size; n++) {
+      CodeHolder code;
+      code.init(CodeInfo(ArchInfo::kTypeX64));
+      EXPECT(rt.reserve(&code, n) == kErrorOk,
+        "JitRuntime::reserve() failed");
+
+      X86Assembler a(&code);
+      Label L = a.newLabel();
+      a.bind(L);
+
+      Operand args[5] = { x86::rcx, x86::rdx, imm(8), imm(0), L };
+      Error err = a.emitStencil(stencil, args, 5);
+
+      if (n < size) {
+        EXPECT(err == kErrorCodeTooLarge,
+          "X86Assembler::emitStencil() returned %u instead of kErrorCodeTooLarge", err);
+      }
+      else {
+        EXPECT(err == kErrorOk,
+          "X86Assembler::emitStencil() failed");
+
+        code.sync();
+        const CodeBuffer& buffer = code.getSectionEntry(0)->getBuffer();
+        int32_t rel32 = Utils::readI32uLE(buffer.getData() + buffer.getLength() - 4);
+
+        EXPECT(buffer.getLength() == size && rel32 == -static_cast<int32_t>(size),
+          "X86Assembler::emitStencil() output doesn't match");
+      }
+
+      rt.unreserve(&code);
+    }
+  }
+}
+#endif // ASMJIT_TEST
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // ASMJIT_BUILD_X86
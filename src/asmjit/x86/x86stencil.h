@@ -0,0 +1,194 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _ASMJIT_X86_X86STENCIL_H
+#define _ASMJIT_X86_X86STENCIL_H
+
+// [Dependencies]
+#include "../x86/x86assembler.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+//! \addtogroup asmjit_x86
+//! \{
+
+// ============================================================================
+// [asmjit::X86Stencil]
+// ============================================================================
+
+//! X86/X64 stencil - a pre-encoded instruction sequence with patch points.
+//!
+//! A stencil is created once by a function that emits the sequence into an
+//! `X86Assembler`, and then stamped any number of times by
+//! `X86Assembler::emitStencil()`, which copies the encoded bytes and patches
+//! the parameters instead of encoding each instruction again.
+//!
+//! The function is called several times by `init()` with different values of
+//! the parameters, the patch points are found by comparing the outputs, and
+//! the stencil is verified by comparing the stamped code with the code emitted
+//! by the function for each register. The function must use the parameters as
+//! they are (for example `disp + 8` can't be patched) and must not align the
+//! code. Supported parameters are:
+//!
+//!   - `kParamImm32` - 32-bit immediate or displacement, always encoded as a
+//!     sign-extended 32-bit value (never as a short form).
+//!   - `kParamImm64` - 64-bit immediate (`mov r64, imm64` only).
+//!   - `kParamGpd` / `kParamGpq` - 32-bit or 64-bit GP register. Registers
+//!     that require a different encoding (for example `rsp` or `r12` used as
+//!     a base, or `r8..r15` if the sequence has no REX prefix) are not allowed,
+//!     see `getRegMask()`.
+//!   - `kParamLabel` - label used by a jump, call, or RIP-relative memory
+//!     operand. Always encoded with a 32-bit displacement.
+//!
+//! Labels bound by the function are local to the stencil (the code is position
+//! independent), other labels are not allowed.
+//!
+//! ~~~
+//! static void emitAddImm(X86Assembler& a, const Operand* params, void* data) {
+//!   a.add(params[0].as<X86Gp>(), params[1].as<Imm>());
+//!   a.jo(params[2].as<Label>());
+//! }
+//!
+//! static const uint8_t paramTypes[] = {
+//!   X86Stencil::kParamGpq, X86Stencil::kParamImm32, X86Stencil::kParamLabel
+//! };
+//!
+//! X86Stencil stencil;
+//! stencil.init(ArchInfo::kTypeX64, emitAddImm, paramTypes, 3);
+//!
+//! Operand args[] = { x86::rcx, imm(100), L_Overflow };
+//! a.emitStencil(stencil, args, 3);
+//! ~~~
+class X86Stencil {
+public:
+  ASMJIT_NONCOPYABLE(X86Stencil)
+
+  //! Function that emits the stencil, `params` contains `getParamCount()`
+  //! operands of types specified by `init()`.
+  typedef void (ASMJIT_CDECL* EmitFunc)(X86Assembler& a, const Operand* params, void* data);
+
+  //! Stencil parameter type.
+  ASMJIT_ENUM(ParamType) {
+    kParamImm32           = 0,           //!< 32-bit immediate or displacement.
+    kParamImm64           = 1,           //!< 64-bit immediate.
+    kParamGpd             = 2,           //!< 32-bit GP register.
+    kParamGpq             = 3,           //!< 64-bit GP register (X64).
+    kParamLabel           = 4,           //!< Label (32-bit relative displacement).
+    kParamCount           = 5            //!< Count of parameter types.
+  };
+
+  ASMJIT_ENUM(Limits) {
+    kMaxParams            = 16           //!< Maximum number of parameters.
+  };
+
+  //! Stencil patch of an immediate or label parameter.
+  struct Patch {
+    //! Patch type.
+    ASMJIT_ENUM(Type) {
+      kTypeImm32          = 0,           //!< Write a 32-bit value.
+      kTypeImm64          = 1,           //!< Write a 64-bit value.
+      kTypeRel32          = 2            //!< Write a 32-bit displacement to a label.
+    };
+
+    uint8_t type;                        //!< Patch type.
+    uint8_t param;                       //!< Parameter index.
+    uint16_t reserved;                   //!< Reserved.
+    uint32_t offset;                     //!< Offset in the stencil.
+    int32_t rel;                         //!< Displacement addend of a label patch.
+  };
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  ASMJIT_API X86Stencil() noexcept;
+  ASMJIT_API ~X86Stencil() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Init / Reset]
+  // --------------------------------------------------------------------------
+
+  //! Create the stencil for `archType` by calling `func`.
+  ASMJIT_API Error init(uint32_t archType, EmitFunc func, const uint8_t* paramTypes, uint32_t paramCount, void* data = nullptr);
+  //! Reset the stencil and release its memory.
+  ASMJIT_API void reset() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  //! Get whether the stencil is initialized.
+  ASMJIT_INLINE bool isInitialized() const noexcept { return _data != nullptr; }
+  //! Get the target architecture.
+  ASMJIT_INLINE uint32_t getArchType() const noexcept { return _archType; }
+
+  //! Get encoded bytes (with register fields cleared).
+  ASMJIT_INLINE const uint8_t* getData() const noexcept { return _data; }
+  //! Get the size of the stencil in bytes.
+  ASMJIT_INLINE uint32_t getSize() const noexcept { return _size; }
+  //! Get the size of the stencil in 64-bit words (padded by zeros).
+  ASMJIT_INLINE uint32_t getWordCount() const noexcept { return _wordCount; }
+
+  //! Get immediate and label patches.
+  ASMJIT_INLINE const Patch* getPatches() const noexcept { return _patches; }
+  //! Get the number of immediate and label patches.
+  ASMJIT_INLINE uint32_t getPatchCount() const noexcept { return _patchCount; }
+
+  //! Get the number of register parameters.
+  ASMJIT_INLINE uint32_t getRegParamCount() const noexcept { return _regParamCount; }
+
+  //! Get words to OR with the stencil if the `regIndex`-th register parameter
+  //! (not counting other parameters) is `id`. Each table has `getWordCount()`
+  //! words, the bytes of the words are in the same order as the stencil.
+  ASMJIT_INLINE const uint64_t* getRegTable(uint32_t regIndex, uint32_t id) const noexcept {
+    ASMJIT_ASSERT(regIndex < _regParamCount && id < 16);
+    return _regTables + (static_cast<size_t>(regIndex) * 16 + id) * _wordCount;
+  }
+
+  //! Get the number of parameters.
+  ASMJIT_INLINE uint32_t getParamCount() const noexcept { return _paramCount; }
+  //! Get type of the parameter `index`.
+  ASMJIT_INLINE uint32_t getParamType(uint32_t index) const noexcept {
+    ASMJIT_ASSERT(index < _paramCount);
+    return _paramTypes[index];
+  }
+
+  //! Get a mask of register ids allowed by a register parameter `index`.
+  ASMJIT_INLINE uint32_t getRegMask(uint32_t index) const noexcept {
+    ASMJIT_ASSERT(index < _paramCount);
+    return _regMasks[index];
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  uint8_t* _data;                        //!< Encoded bytes followed by patches and register tables.
+  Patch* _patches;                       //!< Immediate and label patches (points to `_data`).
+  uint64_t* _regTables;                  //!< Register tables (points to `_data`).
+  uint32_t _archType;                    //!< Target architecture.
+  uint32_t _size;                        //!< Size of the stencil.
+  uint32_t _wordCount;                   //!< Size of the stencil in 64-bit words.
+  uint32_t _patchCount;                  //!< Number of immediate and label patches.
+  uint32_t _regParamCount;               //!< Number of register parameters.
+  uint32_t _paramCount;                  //!< Number of parameters.
+  uint8_t _paramTypes[kMaxParams];       //!< Parameter types.
+  uint16_t _regMasks[kMaxParams];        //!< Allowed register ids of register parameters.
+};
+
+//! \}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // _ASMJIT_X86_X86STENCIL_H
@@ -13,6 +13,10 @@
 #include "./asmjit_test_misc.h"
 #include "./asmjit_test_opcode.h"
 
+#if ASMJIT_OS_POSIX
+# include <pthread.h>
+#endif // ASMJIT_OS_POSIX
+
 using namespace asmjit;
 
 // ============================================================================
@@ -57,6 +61,1525 @@ static double mbps(uint32_t time, size_t outputSize) {
   return (bytesTotal * 1000) / (static_cast<double>(time) * 1024 * 1024);
 }
 
+// ============================================================================
+// [Bench - VMemMgr]
+// ============================================================================
+
+static const uint32_t kVMemRounds = 20;
+static const uint32_t kVMemOpsPerRound = 100000;
+static const uint32_t kVMemLiveCount = 4096;
+
+// Allocates and releases blocks of random sizes (mostly small, some large) to
+// churn the memory manager the same way a long running JIT does. The time of
+// a round shouldn't grow as the memory gets fragmented.
+static void benchVMem() {
+  VMemMgr memmgr;
+  Performance perf;
+
+  void** live = static_cast<void**>(::calloc(kVMemLiveCount, sizeof(void*)));
+  if (!live) return;
+
+  uint32_t seed = 0x1234567;
+  uint32_t firstTime = 0;
+  uint32_t lastTime = 0;
+  uint32_t worstTime = 0;
+
+  perf.reset();
+  for (uint32_t r = 0; r < kVMemRounds; r++) {
+    perf.start();
+    for (uint32_t i = 0; i < kVMemOpsPerRound; i++) {
+      seed = seed * 1103515245U + 12345U;
+      uint32_t rnd = seed >> 8;
+      uint32_t index = rnd % kVMemLiveCount;
+
+      if (live[index]) {
+        memmgr.release(live[index]);
+        live[index] = nullptr;
+      }
+      else {
+        size_t size = (rnd & 0x7) ? 16 + (rnd >> 3) % 2032 : 2048 + (rnd >> 3) % 30720;
+        live[index] = memmgr.alloc(size);
+      }
+    }
+    uint32_t t = perf.end();
+
+    if (r == 0) firstTime = t;
+    if (worstTime < t) worstTime = t;
+    lastTime = t;
+  }
+
+  VMemStats stats;
+  memmgr.getStats(&stats);
+
+  printf("%-12s       | Time: %-6u [ms] | First: %-6u [ms] | Last: %-6u [ms] | Worst: %-6u [ms]\n",
+    "VMemMgr", perf.best, firstTime, lastTime, worstTime);
+  printf("%-12s       | Used: %u [kB] | Allocated: %u [kB] | Slab: %u/%u [kB] | Large: %u/%u [kB] | Fragmentation: %.3f\n",
+    "VMemMgr",
+    static_cast<unsigned int>(stats.usedBytes / 1024),
+    static_cast<unsigned int>(stats.allocatedBytes / 1024),
+    static_cast<unsigned int>(stats.slabUsedBytes / 1024),
+    static_cast<unsigned int>(stats.slabBytes / 1024),
+    static_cast<unsigned int>(stats.largeUsedBytes / 1024),
+    static_cast<unsigned int>(stats.largeBytes / 1024),
+    stats.getLargeFragmentation());
+
+  for (uint32_t i = 0; i < kVMemLiveCount; i++)
+    memmgr.release(live[i]);
+  ::free(live);
+}
+
+// ============================================================================
+// [Bench - CallInLoop]
+// ============================================================================
+
+#if defined(ASMJIT_BUILD_X86)
+static int ASMJIT_CDECL benchCallInLoopHelper(int a, int b) {
+  return (a ^ b) + 1;
+}
+
+// Row loop that calls a C helper per iteration, `arr`, `cnt`, `i`, `acc`, and
+// `sum` are all live across the call.
+static void generateCallInLoop(X86Compiler& cc) {
+  X86Gp arr = cc.newIntPtr("arr");
+  X86Gp cnt = cc.newIntPtr("cnt");
+  X86Gp i = cc.newIntPtr("i");
+  X86Gp x = cc.newInt32("x");
+  X86Gp acc = cc.newInt32("acc");
+  X86Gp sum = cc.newInt32("sum");
+
+  Label L_Loop = cc.newLabel();
+  Label L_End = cc.newLabel();
+
+  cc.addFunc(FuncSignature2<int, const int*, intptr_t>(cc.getCodeInfo().getCdeclCallConv()));
+  cc.setArg(0, arr);
+  cc.setArg(1, cnt);
+
+  cc.xor_(i, i);
+  cc.xor_(acc, acc);
+  cc.xor_(sum, sum);
+  cc.test(cnt, cnt);
+  cc.jz(L_End);
+
+  cc.bind(L_Loop);
+  cc.mov(x, x86::dword_ptr(arr, i, 2));
+
+  CCFuncCall* call = cc.call(imm_ptr(benchCallInLoopHelper), FuncSignature2<int, int, int>(cc.getCodeInfo().getCdeclCallConv()));
+  call->setArg(0, acc);
+  call->setArg(1, x);
+  call->setRet(0, acc);
+
+  cc.add(sum, acc);
+  cc.inc(i);
+  cc.cmp(i, cnt);
+  cc.jne(L_Loop);
+
+  cc.bind(L_End);
+  cc.add(acc, sum);
+  cc.ret(acc);
+  cc.endFunc();
+}
+
+// Count instructions that spill (store) and reload (load) virtual registers,
+// they are annotated by the register allocator when logging is enabled.
+static void countSpills(const char* s, uint32_t& stores, uint32_t& loads) {
+  stores = 0;
+  loads = 0;
+
+  while (*s) {
+    const char* end = ::strchr(s, '\n');
+    size_t len = end ? static_cast<size_t>(end - s) : ::strlen(s);
+
+    StringBuilder line;
+    line.appendString(s, len);
+    const char* data = line.getData();
+
+    if (::strstr(data, "[Save]") || ::strstr(data, "[Spill]"))
+      stores++;
+    else if (::strstr(data, "[Load]") || (::strstr(data, "[Alloc]") && ::strchr(data, '[') < ::strstr(data, "[Alloc]")))
+      loads++;
+
+    if (!end) break;
+    s = end + 1;
+  }
+}
+
+static void benchCallInLoop(uint32_t archType) {
+  CodeHolder code;
+  StringLogger logger;
+
+  X86Compiler cc;
+  const char* archName = archType == ArchInfo::kTypeX86 ? "X86" : "X64";
+
+  CodeInfo ci(archType);
+  ci.setCdeclCallConv(archType == ArchInfo::kTypeX86 ? CallConv::kIdX86CDecl : CallConv::kIdX86SysV64);
+
+  code.init(ci);
+  code.setLogger(&logger);
+  code.attach(&cc);
+
+  generateCallInLoop(cc);
+  cc.finalize();
+
+  uint32_t stores, loads;
+  countSpills(logger.getString(), stores, loads);
+
+  printf("%-12s (%s) | Spills: %-3u | Reloads: %-3u | Code: %u [bytes]\n",
+    "CallInLoop", archName, stores, loads, static_cast<unsigned int>(code.getCodeSize()));
+}
+#endif // ASMJIT_BUILD_X86
+
+// ============================================================================
+// [Bench - ExprEval]
+// ============================================================================
+
+#if defined(ASMJIT_BUILD_X86)
+// Naive two-address lowering of an expression evaluator - every operation
+// creates a new temporary, copies its left operand into it, and then applies
+// the operation, which leaves a register copy per operation to the allocator.
+template<typename RegT>
+struct ExprLowering {
+  typedef RegT (*NewRegFunc)(X86Compiler& cc);
+
+  ExprLowering(X86Compiler& cc, NewRegFunc newReg, uint32_t movId)
+    : cc(cc), newReg(newReg), movId(movId) {}
+
+  RegT op(uint32_t instId, const RegT& a, const RegT& b) {
+    RegT t = newReg(cc);
+    cc.emit(movId, t, a);
+    cc.emit(instId, t, b);
+    return t;
+  }
+
+  X86Compiler& cc;
+  NewRegFunc newReg;
+  uint32_t movId;
+};
+
+static X86Gp newExprGp(X86Compiler& cc) { return cc.newInt32(); }
+static X86Xmm newExprXmm(X86Compiler& cc) { return cc.newXmmPs(); }
+
+// int f(int a, int b, int c, int d).
+static void generateExprGp(X86Compiler& cc) {
+  X86Gp a = cc.newInt32("a");
+  X86Gp b = cc.newInt32("b");
+  X86Gp c = cc.newInt32("c");
+  X86Gp d = cc.newInt32("d");
+
+  cc.addFunc(FuncSignature4<int, int, int, int, int>(cc.getCodeInfo().getCdeclCallConv()));
+  cc.setArg(0, a);
+  cc.setArg(1, b);
+  cc.setArg(2, c);
+  cc.setArg(3, d);
+
+  ExprLowering<X86Gp> e(cc, newExprGp, X86Inst::kIdMov);
+
+  // ((a + b) * (c - d) + (a ^ c)) * ((b | d) - (a & b)) + ((c + d) ^ (a * d)).
+  X86Gp t0 = e.op(X86Inst::kIdAdd , a, b);
+  X86Gp t1 = e.op(X86Inst::kIdSub , c, d);
+  X86Gp t2 = e.op(X86Inst::kIdImul, t0, t1);
+  X86Gp t3 = e.op(X86Inst::kIdXor , a, c);
+  X86Gp t4 = e.op(X86Inst::kIdAdd , t2, t3);
+  X86Gp t5 = e.op(X86Inst::kIdOr  , b, d);
+  X86Gp t6 = e.op(X86Inst::kIdAnd , a, b);
+  X86Gp t7 = e.op(X86Inst::kIdSub , t5, t6);
+  X86Gp t8 = e.op(X86Inst::kIdImul, t4, t7);
+  X86Gp t9 = e.op(X86Inst::kIdAdd , c, d);
+  X86Gp tA = e.op(X86Inst::kIdImul, a, d);
+  X86Gp tB = e.op(X86Inst::kIdXor , t9, tA);
+  X86Gp tC = e.op(X86Inst::kIdAdd , t8, tB);
+
+  cc.ret(tC);
+  cc.endFunc();
+}
+
+// void f(float* dst, const float* src) - evaluates a polynomial on 4 floats.
+static void generateExprXmm(X86Compiler& cc) {
+  X86Gp dst = cc.newIntPtr("dst");
+  X86Gp src = cc.newIntPtr("src");
+
+  cc.addFunc(FuncSignature2<void, float*, const float*>(cc.getCodeInfo().getCdeclCallConv()));
+  cc.setArg(0, dst);
+  cc.setArg(1, src);
+
+  X86Xmm x = cc.newXmmPs("x");
+  X86Xmm k0 = cc.newXmmPs("k0");
+  X86Xmm k1 = cc.newXmmPs("k1");
+  X86Xmm k2 = cc.newXmmPs("k2");
+
+  cc.movups(x , x86::ptr(src,  0));
+  cc.movups(k0, x86::ptr(src, 16));
+  cc.movups(k1, x86::ptr(src, 32));
+  cc.movups(k2, x86::ptr(src, 48));
+
+  ExprLowering<X86Xmm> e(cc, newExprXmm, X86Inst::kIdMovaps);
+
+  // ((k2 * x + k1) * x + k0) * (x + k2) - x * x.
+  X86Xmm t0 = e.op(X86Inst::kIdMulps, k2, x);
+  X86Xmm t1 = e.op(X86Inst::kIdAddps, t0, k1);
+  X86Xmm t2 = e.op(X86Inst::kIdMulps, t1, x);
+  X86Xmm t3 = e.op(X86Inst::kIdAddps, t2, k0);
+  X86Xmm t4 = e.op(X86Inst::kIdAddps, x, k2);
+  X86Xmm t5 = e.op(X86Inst::kIdMulps, t3, t4);
+  X86Xmm t6 = e.op(X86Inst::kIdMulps, x, x);
+  X86Xmm t7 = e.op(X86Inst::kIdSubps, t5, t6);
+
+  cc.movups(x86::ptr(dst), t7);
+  cc.endFunc();
+}
+
+// Count register to register copies in the logger output.
+static uint32_t countCopies(const char* s) {
+  uint32_t count = 0;
+
+  while (*s) {
+    const char* end = ::strchr(s, '\n');
+    size_t len = end ? static_cast<size_t>(end - s) : ::strlen(s);
+
+    // Strip the comment (annotations of the register allocator).
+    const char* comment = static_cast<const char*>(::memchr(s, ';', len));
+    if (comment)
+      len = static_cast<size_t>(comment - s);
+
+    StringBuilder line;
+    line.appendString(s, len);
+    const char* data = line.getData();
+
+    while (*data == ' ')
+      data++;
+
+    const char* comma = ::strrchr(data, ',');
+    if (::strncmp(data, "mov", 3) == 0 && !::strchr(data, '[') && comma) {
+      comma++;
+      while (*comma == ' ')
+        comma++;
+
+      if (!(*comma >= '0' && *comma <= '9') && *comma != '-')
+        count++;
+    }
+
+    if (!end) break;
+    s = end + 1;
+  }
+
+  return count;
+}
+
+static void benchExprEval(uint32_t archType) {
+  const char* archName = archType == ArchInfo::kTypeX86 ? "X86" : "X64";
+
+  CodeInfo ci(archType);
+  ci.setCdeclCallConv(archType == ArchInfo::kTypeX86 ? CallConv::kIdX86CDecl : CallConv::kIdX86SysV64);
+
+  for (uint32_t kernel = 0; kernel < 2; kernel++) {
+    CodeHolder code;
+    StringLogger logger;
+    X86Compiler cc;
+
+    code.init(ci);
+    code.setLogger(&logger);
+    code.attach(&cc);
+
+    if (kernel == 0)
+      generateExprGp(cc);
+    else
+      generateExprXmm(cc);
+    cc.finalize();
+
+    uint32_t stores, loads;
+    countSpills(logger.getString(), stores, loads);
+
+    printf("%-12s (%s) | Copies: %-3u | Spills: %-3u | Reloads: %-3u | Code: %u [bytes]\n",
+      kernel == 0 ? "ExprEvalGp" : "ExprEvalXmm", archName,
+      countCopies(logger.getString()), stores, loads, static_cast<unsigned int>(code.getCodeSize()));
+  }
+}
+#endif // ASMJIT_BUILD_X86
+
+// ============================================================================
+// [Bench - ConstPressure]
+// ============================================================================
+
+#if defined(ASMJIT_BUILD_X86)
+// SIMD loop that keeps more constants live than there are registers, which
+// forces the register allocator to evict some of them in the loop.
+static void generateConstPressure(X86Compiler& cc) {
+  X86Gp dst = cc.newIntPtr("dst");
+  X86Gp src = cc.newIntPtr("src");
+  X86Gp cnt = cc.newIntPtr("cnt");
+
+  cc.addFunc(FuncSignature3<void, uint32_t*, const uint32_t*, intptr_t>(cc.getCodeInfo().getCdeclCallConv()));
+  cc.setArg(0, dst);
+  cc.setArg(1, src);
+  cc.setArg(2, cnt);
+
+  uint32_t i;
+  X86Xmm k[12];
+
+  for (i = 0; i < 12; i++) {
+    k[i] = cc.newXmm("k%u", i);
+    cc.movdqa(k[i], cc.newXmmConst(kConstScopeLocal, Data128::fromU32(0x01010101U * (i + 1))));
+  }
+
+  X86Xmm zero = cc.newXmm("zero");
+  X86Xmm ones = cc.newXmm("ones");
+  cc.pxor(zero, zero);
+  cc.pcmpeqd(ones, ones);
+
+  X86Xmm x = cc.newXmm("x");
+  X86Xmm y = cc.newXmm("y");
+  X86Xmm z = cc.newXmm("z");
+
+  Label L_Loop = cc.newLabel();
+  Label L_End = cc.newLabel();
+
+  cc.test(cnt, cnt);
+  cc.jz(L_End);
+
+  cc.bind(L_Loop);
+  cc.movdqu(x, x86::ptr(src));
+  cc.movdqa(y, x);
+  cc.movdqa(z, x);
+
+  for (i = 0; i < 12; i += 3) {
+    cc.paddd(x, k[i + 0]);
+    cc.pand(y, k[i + 1]);
+    cc.pxor(z, k[i + 2]);
+    cc.pcmpgtd(y, zero);
+    cc.psubd(z, y);
+    cc.por(x, z);
+  }
+  cc.pxor(x, ones);
+
+  cc.movdqu(x86::ptr(dst), x);
+  cc.add(src, 16);
+  cc.add(dst, 16);
+  cc.sub(cnt, 1);
+  cc.jnz(L_Loop);
+
+  cc.bind(L_End);
+  cc.endFunc();
+}
+
+static void benchConstPressure(uint32_t archType) {
+  CodeHolder code;
+  StringLogger logger;
+
+  X86Compiler cc;
+  const char* archName = archType == ArchInfo::kTypeX86 ? "X86" : "X64";
+
+  CodeInfo ci(archType);
+  ci.setCdeclCallConv(archType == ArchInfo::kTypeX86 ? CallConv::kIdX86CDecl : CallConv::kIdX86SysV64);
+
+  code.init(ci);
+  code.setLogger(&logger);
+  code.attach(&cc);
+
+  generateConstPressure(cc);
+  cc.finalize();
+
+  uint32_t stores, loads;
+  const char* s = logger.getString();
+  countSpills(s, stores, loads);
+
+  uint32_t remats = 0;
+  while ((s = ::strstr(s, "[Remat]")) != nullptr) {
+    remats++;
+    s++;
+  }
+
+  printf("%-12s (%s) | Spills: %-3u | Reloads: %-3u | Remats: %-3u | Code: %u [bytes]\n",
+    "ConstPress", archName, stores, loads, remats, static_cast<unsigned int>(code.getCodeSize()));
+}
+#endif // ASMJIT_BUILD_X86
+
+// ============================================================================
+// [Bench - SpillSlots]
+// ============================================================================
+
+#if defined(ASMJIT_BUILD_X86)
+// Large function made of independent blocks, each block keeps more short
+// lived temporaries live than there are registers, so all blocks spill.
+static void generateSpillSlots(X86Compiler& cc, uint32_t blockCount, uint32_t tmpCount) {
+  X86Gp src = cc.newIntPtr("src");
+  X86Gp sum = cc.newInt32("sum");
+
+  cc.addFunc(FuncSignature1<int, const int*>(cc.getCodeInfo().getCdeclCallConv()));
+  cc.setArg(0, src);
+  cc.xor_(sum, sum);
+
+  for (uint32_t b = 0; b < blockCount; b++) {
+    X86Gp tmp[32];
+    uint32_t i;
+
+    for (i = 0; i < tmpCount; i++) {
+      tmp[i] = cc.newInt32("t%u_%u", b, i);
+      cc.mov(tmp[i], x86::dword_ptr(src, static_cast<int32_t>((b * tmpCount + i) * 4)));
+    }
+
+    for (i = 0; i < tmpCount; i++)
+      cc.xor_(tmp[i], tmp[(i + 1) % tmpCount]);
+
+    for (i = 0; i < tmpCount; i++)
+      cc.add(sum, tmp[i]);
+  }
+
+  cc.ret(sum);
+  cc.endFunc();
+}
+
+static void benchSpillSlots(uint32_t archType) {
+  CodeHolder code;
+  StringLogger logger;
+
+  X86Compiler cc;
+  const char* archName = archType == ArchInfo::kTypeX86 ? "X86" : "X64";
+
+  CodeInfo ci(archType);
+  ci.setCdeclCallConv(archType == ArchInfo::kTypeX86 ? CallConv::kIdX86CDecl : CallConv::kIdX86SysV64);
+
+  code.init(ci);
+  code.setLogger(&logger);
+  code.attach(&cc);
+
+  generateSpillSlots(cc, 64, 24);
+  cc.finalize();
+
+  // The register allocator reports the frame size as a comment.
+  unsigned int frameSize = 0, slotSize = 0, unsharedSize = 0;
+  const char* frame = ::strstr(logger.getString(), "[Frame]");
+
+  if (frame)
+    ::sscanf(frame, "[Frame] %u bytes, spill slots %u bytes (%u bytes", &frameSize, &slotSize, &unsharedSize);
+
+  printf("%-12s (%s) | Frame: %-5u [bytes] | Spill slots: %u [bytes] (%u [bytes] without sharing)\n",
+    "SpillSlots", archName, frameSize, slotSize, unsharedSize);
+}
+#endif // ASMJIT_BUILD_X86
+
+// ============================================================================
+// [Bench - Layout]
+// ============================================================================
+
+#if defined(ASMJIT_BUILD_X86)
+// Sequence of small loops of different sizes, each having a conditional
+// branch inside, so loop headers and branches land at arbitrary offsets.
+static void generateLayout(X86Compiler& cc, uint32_t loopCount) {
+  X86Gp src = cc.newIntPtr("src");
+  X86Gp cnt = cc.newInt32("cnt");
+  X86Gp sum = cc.newInt32("sum");
+  X86Gp tmp = cc.newInt32("tmp");
+
+  cc.addFunc(FuncSignature2<int, const int*, int>(cc.getCodeInfo().getCdeclCallConv()));
+  cc.setArg(0, src);
+  cc.setArg(1, cnt);
+  cc.xor_(sum, sum);
+
+  for (uint32_t i = 0; i < loopCount; i++) {
+    X86Gp idx = cc.newInt32("idx%u", i);
+    Label L_Loop = cc.newLabel();
+    Label L_Skip = cc.newLabel();
+
+    cc.mov(idx, cnt);
+    cc.bind(L_Loop);
+    cc.mov(tmp, x86::dword_ptr(src, idx, 2, -4));
+
+    for (uint32_t j = 0; j < i % 5; j++)
+      cc.add(tmp, static_cast<int>(j * 77 + 1));
+
+    cc.test(tmp, static_cast<int>(1) << (i % 8));
+    cc.jz(L_Skip);
+    cc.add(sum, tmp);
+    cc.bind(L_Skip);
+    cc.dec(idx);
+    cc.jnz(L_Loop);
+  }
+
+  cc.ret(sum);
+  cc.endFunc();
+}
+
+static void benchLayout(uint32_t archType) {
+  const char* archName = archType == ArchInfo::kTypeX86 ? "X86" : "X64";
+  size_t codeSize[2];
+  size_t paddingSize[2];
+
+  for (uint32_t i = 0; i < 2; i++) {
+    CodeHolder code;
+    X86Compiler cc;
+
+    CodeInfo ci(archType);
+    ci.setCdeclCallConv(archType == ArchInfo::kTypeX86 ? CallConv::kIdX86CDecl : CallConv::kIdX86SysV64);
+
+    code.init(ci);
+    code.addGlobalHints(CodeEmitter::kHintOptimizedAlign);
+    if (i == 1)
+      code.addGlobalHints(CodeEmitter::kHintAlignLoops | CodeEmitter::kHintAlignBranches);
+    code.attach(&cc);
+
+    generateLayout(cc, 32);
+    cc.finalize();
+
+    codeSize[i] = code.getCodeSize();
+    paddingSize[i] = code.getLayoutPaddingSize();
+  }
+
+  printf("%-12s (%s) | Code: %-5u [bytes] | Aligned code: %u [bytes] (%u [bytes] of padding)\n",
+    "Layout", archName,
+    static_cast<unsigned int>(codeSize[0]),
+    static_cast<unsigned int>(codeSize[1]),
+    static_cast<unsigned int>(paddingSize[1]));
+}
+#endif // ASMJIT_BUILD_X86
+
+// ============================================================================
+// [Bench - Sched]
+// ============================================================================
+
+#if defined(ASMJIT_BUILD_X86)
+static const uint32_t kSchedBlocks = 1024;
+static const uint32_t kSchedRounds = 2000;
+
+// Kernel that processes 16 floats per iteration as four dependency chains
+// written one after another, each chain has a multiplication and a division.
+static void generateSchedKernel(X86Compiler& cc) {
+  X86Gp dst = cc.newIntPtr("dst");
+  X86Gp src = cc.newIntPtr("src");
+  X86Gp cnt = cc.newIntPtr("cnt");
+
+  X86Xmm one = cc.newXmm("one");
+  X86Xmm v[4];
+
+  Label L_Loop = cc.newLabel();
+  uint32_t i;
+
+  cc.addFunc(FuncSignature3<void, float*, const float*, intptr_t>(cc.getCodeInfo().getCdeclCallConv()));
+  cc.setArg(0, dst);
+  cc.setArg(1, src);
+  cc.setArg(2, cnt);
+
+  cc.movaps(one, x86::ptr(src));
+  cc.bind(L_Loop);
+
+  for (i = 0; i < 4; i++) {
+    v[i] = cc.newXmm("v%u", i);
+    cc.movups(v[i], x86::ptr(src, static_cast<int32_t>(i * 16)));
+    cc.mulps(v[i], v[i]);
+    cc.addps(v[i], one);
+    cc.divps(v[i], one);
+    cc.mulps(v[i], v[i]);
+  }
+
+  cc.addps(v[0], v[1]);
+  cc.addps(v[2], v[3]);
+  cc.addps(v[0], v[2]);
+  cc.movups(x86::ptr(dst), v[0]);
+
+  cc.add(src, 64);
+  cc.add(dst, 16);
+  cc.dec(cnt);
+  cc.jnz(L_Loop);
+
+  cc.endFunc();
+}
+
+static void benchSched() {
+  typedef void (*SchedFunc)(float* dst, const float* src, intptr_t cnt);
+
+  JitRuntime rt;
+  Performance perf;
+
+  float* src = static_cast<float*>(::malloc(kSchedBlocks * 16 * sizeof(float)));
+  float* dst = static_cast<float*>(::malloc(kSchedBlocks * 4 * sizeof(float)));
+  if (!src || !dst) {
+    ::free(src);
+    ::free(dst);
+    return;
+  }
+
+  for (uint32_t i = 0; i < kSchedBlocks * 16; i++)
+    src[i] = 1.0f + static_cast<float>(i & 15) * 0.125f;
+
+  uint32_t time[2];
+  uint32_t cycles[2];
+
+  for (uint32_t useSched = 0; useSched < 2; useSched++) {
+    CodeHolder code;
+    X86Compiler cc;
+
+    code.init(rt.getCodeInfo());
+    code.attach(&cc);
+
+    X86SchedPass* pass = nullptr;
+    if (useSched) {
+      pass = cc.newPassT<X86SchedPass>();
+      cc.addPass(pass);
+    }
+
+    generateSchedKernel(cc);
+    cc.finalize();
+
+    SchedFunc fn;
+    if (rt.add(&fn, &code) != kErrorOk)
+      break;
+
+    perf.reset();
+    for (uint32_t r = 0; r < kNumRepeats; r++) {
+      perf.start();
+      for (uint32_t k = 0; k < kSchedRounds; k++)
+        fn(dst, src, kSchedBlocks);
+      perf.end();
+    }
+
+    time[useSched] = perf.best;
+    cycles[useSched] = pass ? pass->getCyclesAfter() : 0;
+    if (pass) cycles[0] = pass->getCyclesBefore();
+
+    rt.release(fn);
+  }
+
+  printf("%-12s (%s) | Time: %-6u [ms] | Scheduled: %u [ms] | Model: %u | Cycles: %u -> %u [estimated]\n",
+    "Sched", ASMJIT_ARCH_64BIT ? "X64" : "X86", time[0], time[1],
+    X86SchedPass::modelIdOf(CpuInfo::getHost()), cycles[0], cycles[1]);
+
+  ::free(src);
+  ::free(dst);
+}
+#endif // ASMJIT_BUILD_X86
+
+// ============================================================================
+// [Bench - IR]
+// ============================================================================
+
+#if defined(ASMJIT_BUILD_X86)
+static const uint32_t kIrBlocks = 8192;
+static const uint32_t kIrWalks = 20;
+
+// Large function of short blocks, each has a label, a load, arithmetic on
+// registers and immediates, a store, and a conditional jump.
+static void generateIr(X86Compiler& cc) {
+  X86Gp p = cc.newIntPtr("p");
+  X86Gp a = cc.newInt32("a");
+  X86Gp b = cc.newInt32("b");
+
+  cc.addFunc(FuncSignature1<void, int*>(cc.getCodeInfo().getCdeclCallConv()));
+  cc.setArg(0, p);
+
+  for (uint32_t i = 0; i < kIrBlocks; i++) {
+    Label L = cc.newLabel();
+    int32_t disp = static_cast<int32_t>((i & 63) * 4);
+
+    cc.bind(L);
+    cc.mov(a, x86::dword_ptr(p, disp));
+    cc.mov(b, a);
+    cc.shl(b, 3);
+    cc.add(a, b);
+    cc.xor_(a, static_cast<int32_t>(i));
+    cc.mov(x86::dword_ptr(p, disp), a);
+    cc.cmp(a, b);
+    cc.jz(L);
+  }
+
+  cc.endFunc();
+}
+
+// Walk all nodes and their operands like an analysis pass would.
+static uint32_t walkIr(const CodeBuilder& cb) {
+  uint32_t hash = 0;
+
+  for (const CBNode* node = cb.getFirstNode(); node; node = node->getNext()) {
+    hash += node->getType();
+    if (node->getType() != CBNode::kNodeInst)
+      continue;
+
+    const CBInst* inst = static_cast<const CBInst*>(node);
+    const Operand* opArray = inst->getOpArray();
+
+    hash = hash * 31 + inst->getInstId();
+    for (uint32_t i = 0; i < inst->getOpCount(); i++)
+      hash ^= opArray[i].getId() + opArray[i].getOp();
+  }
+
+  return hash;
+}
+
+static void benchIr(uint32_t archType) {
+  CodeHolder code;
+  X86Compiler cc;
+  Performance perf;
+
+  CodeInfo ci(archType);
+  ci.setCdeclCallConv(archType == ArchInfo::kTypeX86 ? CallConv::kIdX86CDecl : CallConv::kIdX86SysV64);
+
+  uint32_t nodeCount = 0;
+  size_t irSize = 0;
+  uint32_t hash = 0;
+  uint32_t buildTime;
+
+  perf.reset();
+  for (uint32_t r = 0; r < kNumRepeats; r++) {
+    code.init(ci);
+    code.attach(&cc);
+
+    perf.start();
+    generateIr(cc);
+    perf.end();
+
+    nodeCount = 0;
+    for (CBNode* node = cc.getFirstNode(); node; node = node->getNext())
+      nodeCount++;
+    irSize = cc._cbBaseZone.getUsedSize() + cc._cbNodeZone.getUsedSize();
+
+    if (r != kNumRepeats - 1)
+      code.reset(false); // Detaches `cc`.
+  }
+  buildTime = perf.best;
+
+  perf.reset();
+  for (uint32_t r = 0; r < kNumRepeats; r++) {
+    perf.start();
+    for (uint32_t k = 0; k < kIrWalks; k++)
+      hash += walkIr(cc);
+    perf.end();
+  }
+
+  printf("%-12s (%s) | Nodes: %-6u | Memory: %u [kB] (%u [bytes/node]) | Build: %u [ms] | Walk: %u [ms] (%08X)\n",
+    "IR", archType == ArchInfo::kTypeX86 ? "X86" : "X64",
+    nodeCount,
+    static_cast<unsigned int>(irSize / 1024),
+    static_cast<unsigned int>(irSize / nodeCount),
+    buildTime, perf.best, hash);
+
+  code.reset(false);
+}
+#endif // ASMJIT_BUILD_X86
+
+// ============================================================================
+// [Bench - Streaming]
+// ============================================================================
+
+#if defined(ASMJIT_BUILD_X86)
+static const uint32_t kStreamFuncs = 2000;
+
+static size_t getCompilerMemory(X86Compiler& cc) {
+  return cc._cbBaseZone.getUsedSize() +
+         cc._cbNodeZone.getUsedSize() +
+         cc._cbDataZone.getUsedSize() +
+         cc._vRegZone.getUsedSize();
+}
+
+// Function body that sums `n` ints with a few temporaries, without `endFunc()`.
+static void generateStreamFunc(X86Compiler& cc) {
+  X86Gp p = cc.newIntPtr("p");
+  X86Gp n = cc.newIntPtr("n");
+  X86Gp sum = cc.newInt32("sum");
+  X86Gp t[4];
+
+  Label L_Loop = cc.newLabel();
+  Label L_Done = cc.newLabel();
+  uint32_t i;
+
+  cc.addFunc(FuncSignature2<int, const int*, intptr_t>(cc.getCodeInfo().getCdeclCallConv()));
+  cc.setArg(0, p);
+  cc.setArg(1, n);
+
+  cc.xor_(sum, sum);
+  cc.test(n, n);
+  cc.jz(L_Done);
+
+  cc.bind(L_Loop);
+  for (i = 0; i < 4; i++) {
+    t[i] = cc.newInt32("t%u", i);
+    cc.mov(t[i], x86::dword_ptr(p, static_cast<int32_t>(i * 4)));
+    cc.imul(t[i], t[i], static_cast<int32_t>(i + 3));
+  }
+  for (i = 0; i < 4; i++)
+    cc.add(sum, t[i]);
+  cc.add(p, 16);
+  cc.dec(n);
+  cc.jnz(L_Loop);
+
+  cc.bind(L_Done);
+  cc.ret(sum);
+}
+
+static void benchStreaming(uint32_t archType) {
+  Performance perf;
+
+  CodeInfo ci(archType);
+  ci.setCdeclCallConv(archType == ArchInfo::kTypeX86 ? CallConv::kIdX86CDecl : CallConv::kIdX86SysV64);
+
+  uint32_t time[2];
+  size_t peak[2];
+  size_t codeSize[2];
+
+  for (uint32_t streaming = 0; streaming < 2; streaming++) {
+    perf.reset();
+    for (uint32_t r = 0; r < kNumRepeats; r++) {
+      CodeHolder code;
+      X86Compiler cc;
+
+      code.init(ci);
+      code.attach(&cc);
+      cc.setStreaming(streaming != 0);
+
+      peak[streaming] = 0;
+      perf.start();
+
+      // The memory is the highest before a function is flushed.
+      for (uint32_t f = 0; f < kStreamFuncs; f++) {
+        generateStreamFunc(cc);
+        peak[streaming] = std::max(peak[streaming], getCompilerMemory(cc));
+        cc.endFunc();
+      }
+      peak[streaming] = std::max(peak[streaming], getCompilerMemory(cc));
+
+      cc.finalize();
+      perf.end();
+
+      codeSize[streaming] = code.getCodeSize();
+    }
+    time[streaming] = perf.best;
+  }
+
+  printf("%-12s (%s) | Functions: %u | Peak: %u -> %u [kB] | Time: %u -> %u [ms] | Code: %u -> %u [bytes]\n",
+    "Streaming", archType == ArchInfo::kTypeX86 ? "X86" : "X64",
+    kStreamFuncs,
+    static_cast<unsigned int>(peak[0] / 1024), static_cast<unsigned int>(peak[1] / 1024),
+    time[0], time[1],
+    static_cast<unsigned int>(codeSize[0]), static_cast<unsigned int>(codeSize[1]));
+}
+#endif // ASMJIT_BUILD_X86
+
+// ============================================================================
+// [Bench - EmitInPlace]
+// ============================================================================
+
+#if defined(ASMJIT_BUILD_X86)
+static const uint32_t kEmitModules = 10;
+static const uint32_t kEmitRepeats = 64;
+
+static void benchEmitInPlace() {
+  JitRuntime rt;
+  Performance perf;
+
+  uint32_t time[2];
+  size_t moduleSize = 0;
+
+  for (uint32_t inPlace = 0; inPlace < 2; inPlace++) {
+    perf.reset();
+    for (uint32_t r = 0; r < kNumRepeats; r++) {
+      perf.start();
+      for (uint32_t m = 0; m < kEmitModules; m++) {
+        CodeHolder code;
+        X86Assembler a;
+
+        code.init(rt.getCodeInfo());
+        if (inPlace && rt.reserve(&code, moduleSize) != kErrorOk)
+          return;
+        code.attach(&a);
+
+        for (uint32_t i = 0; i < kEmitRepeats; i++)
+          asmtest::generateOpcodes(a);
+        if (!inPlace) moduleSize = code.getCodeSize();
+
+        void* p;
+        if (rt.add(&p, &code) != kErrorOk)
+          return;
+        rt.release(p);
+      }
+      perf.end();
+    }
+    time[inPlace] = perf.best;
+  }
+
+  printf("%-12s (%s) | Module: %u [kB] | Copy: %u [ms] | In-place: %u [ms]\n",
+    "EmitInPlace", ASMJIT_ARCH_64BIT ? "X64" : "X86",
+    static_cast<unsigned int>(moduleSize / 1024), time[0], time[1]);
+}
+#endif // ASMJIT_BUILD_X86
+
+// ============================================================================
+// [Bench - Hash]
+// ============================================================================
+
+static const uint32_t kHashNodes = 200000;
+static const uint32_t kHashLookups = 4;
+
+struct BenchHashNode : public ZoneHashNode {
+  char name[16];
+  uint32_t nameLength;
+};
+
+struct BenchHashKey {
+  inline BenchHashKey(const char* name, uint32_t nameLength) noexcept
+    : name(name),
+      nameLength(nameLength),
+      hVal(Utils::hashString(name, nameLength)) {}
+
+  inline bool matches(const BenchHashNode* node) const noexcept {
+    return node->nameLength == nameLength && ::memcmp(node->name, name, nameLength) == 0;
+  }
+
+  const char* name;
+  uint32_t nameLength;
+  uint32_t hVal;
+};
+
+template<typename Hash>
+static uint32_t benchHashRun(const BenchHashNode* nodes, BenchHashNode* copy) {
+  Zone zone(65536 - Zone::kZoneOverhead);
+  ZoneHeap heap(&zone);
+  Hash hash(&heap);
+
+  ::memcpy(copy, nodes, kHashNodes * sizeof(BenchHashNode));
+  for (uint32_t i = 0; i < kHashNodes; i++)
+    hash.put(&copy[i]);
+
+  uint32_t found = 0;
+  for (uint32_t n = 0; n < kHashLookups; n++) {
+    // Lookup both existing (even) and missing (odd) names, like a front-end
+    // that checks whether a label exists before it creates it.
+    for (uint32_t i = 0; i < kHashNodes; i++) {
+      const BenchHashNode& node = nodes[i];
+      char name[16];
+
+      ::memcpy(name, node.name, node.nameLength);
+      name[0] = (i & 1) ? 'M' : 'L';
+
+      BenchHashKey key(name, node.nameLength);
+      found += hash.get(key) != nullptr;
+    }
+  }
+  return found;
+}
+
+static void benchHash() {
+  BenchHashNode* nodes = static_cast<BenchHashNode*>(::malloc(kHashNodes * sizeof(BenchHashNode)));
+  BenchHashNode* copy = static_cast<BenchHashNode*>(::malloc(kHashNodes * sizeof(BenchHashNode)));
+  if (!nodes || !copy) {
+    ::free(nodes);
+    ::free(copy);
+    return;
+  }
+
+  for (uint32_t i = 0; i < kHashNodes; i++) {
+    BenchHashNode* node = new(&nodes[i]) BenchHashNode();
+    node->nameLength = static_cast<uint32_t>(::snprintf(node->name, sizeof(node->name), "L_%u", i));
+    node->_hVal = Utils::hashString(node->name, node->nameLength);
+  }
+
+  Performance perf;
+  uint32_t time[2];
+  uint32_t found[2];
+
+  for (uint32_t open = 0; open < 2; open++) {
+    perf.reset();
+    for (uint32_t r = 0; r < kNumRepeats; r++) {
+      perf.start();
+      found[open] = open ? benchHashRun< ZoneOpenHash<BenchHashNode> >(nodes, copy)
+                         : benchHashRun< ZoneHash<BenchHashNode> >(nodes, copy);
+      perf.end();
+    }
+    time[open] = perf.best;
+  }
+
+  printf("%-12s (%s) | Nodes: %u | Found: %u/%u | Chained: %u [ms] | Open: %u [ms]\n",
+    "Hash", ASMJIT_ARCH_64BIT ? "X64" : "X86",
+    kHashNodes, found[0], found[1], time[0], time[1]);
+
+  ::free(nodes);
+  ::free(copy);
+}
+
+// ============================================================================
+// [Bench - ZoneCache]
+// ============================================================================
+
+#if ASMJIT_OS_POSIX
+static const uint32_t kZoneCacheThreads = 4;
+static const uint32_t kZoneCacheCompiles = 5000;
+
+struct ZoneCacheWorker {
+  pthread_t thread;
+  ZoneBlockCache::Stats stats;
+};
+
+static void* benchZoneCacheThread(void* arg) {
+  ZoneCacheWorker* worker = static_cast<ZoneCacheWorker*>(arg);
+  ZoneBlockCache::resetStats();
+
+  for (uint32_t i = 0; i < kZoneCacheCompiles; i++) {
+    CodeHolder code;
+    X86Compiler cc;
+
+    code.init(CodeInfo(ArchInfo::kTypeHost));
+    code.attach(&cc);
+
+    generateStreamFunc(cc);
+    cc.endFunc();
+    cc.finalize();
+  }
+
+  ZoneBlockCache::getStats(&worker->stats);
+  ZoneBlockCache::trim(0);
+  return nullptr;
+}
+
+static void benchZoneCache() {
+  ZoneCacheWorker workers[kZoneCacheThreads];
+  Performance perf;
+
+  uint32_t time[2];
+  size_t allocs[2];
+  size_t hits[2];
+
+  bool wasEnabled = ZoneBlockCache::isEnabled();
+  for (uint32_t enabled = 0; enabled < 2; enabled++) {
+    ZoneBlockCache::setEnabled(enabled != 0);
+
+    perf.reset();
+    for (uint32_t r = 0; r < kNumRepeats; r++) {
+      uint32_t i;
+      perf.start();
+      for (i = 0; i < kZoneCacheThreads; i++)
+        pthread_create(&workers[i].thread, nullptr, benchZoneCacheThread, &workers[i]);
+      for (i = 0; i < kZoneCacheThreads; i++)
+        pthread_join(workers[i].thread, nullptr);
+      perf.end();
+
+      allocs[enabled] = 0;
+      hits[enabled] = 0;
+      for (i = 0; i < kZoneCacheThreads; i++) {
+        allocs[enabled] += workers[i].stats.allocCount;
+        hits[enabled] += workers[i].stats.hitCount;
+      }
+    }
+    time[enabled] = perf.best;
+  }
+  ZoneBlockCache::setEnabled(wasEnabled);
+
+  printf("%-12s (%s) | Threads: %u | Blocks: %u/%u [malloc] | Cached: %u [hits] | Time: %u/%u [ms]\n",
+    "ZoneCache", ASMJIT_ARCH_64BIT ? "X64" : "X86",
+    kZoneCacheThreads,
+    static_cast<unsigned int>(allocs[0]), static_cast<unsigned int>(allocs[1]),
+    static_cast<unsigned int>(hits[1]),
+    time[0], time[1]);
+}
+#endif // ASMJIT_OS_POSIX
+
+// ============================================================================
+// [Bench - Labels]
+// ============================================================================
+
+static const uint32_t kLabelCount = 1048576;
+
+static void benchLabels() {
+  Label* labels = static_cast<Label*>(::malloc(kLabelCount * sizeof(Label)));
+  if (!labels) return;
+
+  Performance createPerf;
+  Performance bindPerf;
+
+  createPerf.reset();
+  bindPerf.reset();
+
+  for (uint32_t r = 0; r < kNumRepeats; r++) {
+    CodeHolder code;
+    X86Assembler a;
+    uint32_t i;
+
+    code.init(CodeInfo(ArchInfo::kTypeX64));
+    code.attach(&a);
+
+    createPerf.start();
+    for (i = 0; i < kLabelCount; i++)
+      labels[i] = a.newLabel();
+    createPerf.end();
+
+    // A large switch - a table of forward jumps to cases bound afterwards.
+    bindPerf.start();
+    for (i = 0; i < kLabelCount; i++)
+      a.jmp(labels[i]);
+    for (i = 0; i < kLabelCount; i++) {
+      a.bind(labels[i]);
+      a.nop();
+    }
+    bindPerf.end();
+  }
+
+  printf("%-12s (%s) | Count: %u | Entry: %u [B] | Create: %u [ms] | Jump+Bind: %u [ms]\n",
+    "Labels", "X64",
+    kLabelCount, static_cast<unsigned int>(sizeof(LabelEntry)),
+    createPerf.best, bindPerf.best);
+
+  ::free(labels);
+}
+
+// ============================================================================
+// [Bench - Fragment]
+// ============================================================================
+
+#if defined(ASMJIT_BUILD_X86)
+static const uint32_t kFragmentCount = 20000;
+
+static void benchFragmentBody(X86Emitter& e, const X86Gp& x, const X86Gp& y, const X86Gp& p) {
+  Label L = e.newLabel();
+
+  e.cmp(x, 0);
+  e.jge(L);
+  e.neg(x);
+  e.bind(L);
+  e.imul(x, x, 3);
+  e.add(x, y);
+  e.add(x, x86::dword_ptr(p, 4));
+  e.lea(y, x86::ptr(p, x, 2, 8));
+  e.xor_(x, y);
+  e.mov(x86::dword_ptr(p), x);
+}
+
+static void benchFragment() {
+  static const X86Gp args[][3] = {
+    { x86::eax, x86::ecx, x86::rdx },
+    { x86::esi, x86::edi, x86::r8  },
+    { x86::r9d, x86::ebx, x86::r10 }
+  };
+
+  Performance directPerf;
+  Performance fragmentPerf;
+
+  directPerf.reset();
+  fragmentPerf.reset();
+
+  // Record the body once, the compiler is only used as a `CodeBuilder`.
+  CBFragment fragment;
+  {
+    CodeHolder code;
+    X86Compiler cc;
+
+    code.init(CodeInfo(ArchInfo::kTypeX64));
+    code.attach(&cc);
+
+    CBNode* prev = cc.getCursor();
+    benchFragmentBody(cc, args[0][0], args[0][1], args[0][2]);
+
+    Operand params[3] = { args[0][0], args[0][1], args[0][2] };
+    if (fragment.init(prev ? prev->getNext() : cc.getFirstNode(), cc.getCursor(), params, 3) != kErrorOk ||
+        fragment.validate(ArchInfo::kTypeX64) != kErrorOk) {
+      printf("Fragment (X64) | Failed\n");
+      return;
+    }
+  }
+
+  size_t directSize = 0;
+  size_t fragmentSize = 0;
+
+  for (uint32_t r = 0; r < kNumRepeats; r++) {
+    for (uint32_t mode = 0; mode < 2; mode++) {
+      CodeHolder code;
+      X86Assembler a;
+
+      code.init(CodeInfo(ArchInfo::kTypeX64));
+      code.attach(&a);
+      a._globalOptions |= CodeEmitter::kOptionStrictValidation;
+
+      Performance& perf = mode == 0 ? directPerf : fragmentPerf;
+      perf.start();
+      for (uint32_t i = 0; i < kFragmentCount; i++) {
+        const X86Gp* v = args[i % 3];
+        if (mode == 0) {
+          benchFragmentBody(a, v[0], v[1], v[2]);
+        }
+        else {
+          Operand ops[3] = { v[0], v[1], v[2] };
+          fragment.emit(&a, ops, 3);
+        }
+      }
+      perf.end();
+
+      if (mode == 0)
+        directSize = code.getCodeSize();
+      else
+        fragmentSize = code.getCodeSize();
+    }
+  }
+
+  printf("%-12s (%s) | Count: %u | Size: %u/%u [B] | Direct: %u [ms] | Fragment: %u [ms]\n",
+    "Fragment", "X64",
+    kFragmentCount,
+    static_cast<unsigned int>(directSize),
+    static_cast<unsigned int>(fragmentSize),
+    directPerf.best, fragmentPerf.best);
+}
+#endif // ASMJIT_BUILD_X86
+
+// ============================================================================
+// [Bench - Stencil]
+// ============================================================================
+
+#if defined(ASMJIT_BUILD_X86)
+static const uint32_t kStencilCount = 100000;
+
+static void ASMJIT_CDECL benchStencilFunc(X86Assembler& a, const Operand* params, void* data) {
+  ASMJIT_UNUSED(data);
+
+  const X86Gp& x = params[0].as<X86Gp>();
+  const X86Gp& y = params[1].as<X86Gp>();
+  const Imm& disp = params[2].as<Imm>();
+
+  a.mov(x, x86::qword_ptr(y, disp.getInt32()));
+  a.add(x, disp);
+  a.imul(x, y);
+  a.mov(x86::qword_ptr(y, 8), x);
+  a.cmp(x, y);
+  a.jne(params[3].as<Label>());
+}
+
+static void benchStencil() {
+  static const uint8_t paramTypes[] = {
+    X86Stencil::kParamGpq, X86Stencil::kParamGpq, X86Stencil::kParamImm32, X86Stencil::kParamLabel
+  };
+
+  static const X86Gp regs[][2] = {
+    { x86::rcx, x86::rdx },
+    { x86::rsi, x86::r8  },
+    { x86::r9 , x86::rbx }
+  };
+
+  X86Stencil stencil;
+  if (stencil.init(ArchInfo::kTypeX64, benchStencilFunc, paramTypes, 4) != kErrorOk) {
+    printf("%-12s (%s) | Failed\n", "Stencil", "X64");
+    return;
+  }
+
+  Performance directPerf;
+  Performance stencilPerf;
+
+  directPerf.reset();
+  stencilPerf.reset();
+
+  size_t directSize = 0;
+  size_t stencilSize = 0;
+
+  for (uint32_t r = 0; r < kNumRepeats; r++) {
+    for (uint32_t mode = 0; mode < 2; mode++) {
+      CodeHolder code;
+      X86Assembler a;
+
+      code.init(CodeInfo(ArchInfo::kTypeX64));
+      code.attach(&a);
+
+      Label L_Exit = a.newLabel();
+      Performance& perf = mode == 0 ? directPerf : stencilPerf;
+
+      perf.start();
+      for (uint32_t i = 0; i < kStencilCount; i++) {
+        const X86Gp* v = regs[i % 3];
+        Operand args[4] = { v[0], v[1], imm(static_cast<int32_t>(i * 16 + 1024)), L_Exit };
+
+        if (mode == 0)
+          benchStencilFunc(a, args, nullptr);
+        else
+          a.emitStencil(stencil, args, 4);
+      }
+      a.bind(L_Exit);
+      perf.end();
+
+      if (mode == 0)
+        directSize = code.getCodeSize();
+      else
+        stencilSize = code.getCodeSize();
+    }
+  }
+
+  printf("%-12s (%s) | Count: %u | Size: %u/%u [B] | Direct: %7.3f [MB/s] | Stencil: %7.3f [MB/s]\n",
+    "Stencil", "X64",
+    kStencilCount,
+    static_cast<unsigned int>(directSize),
+    static_cast<unsigned int>(stencilSize),
+    mbps(directPerf.best, directSize),
+    mbps(stencilPerf.best, stencilSize));
+}
+#endif // ASMJIT_BUILD_X86
+
+// ============================================================================
+// [Bench - Validation]
+// ============================================================================
+
+#if defined(ASMJIT_BUILD_X86)
+static const uint32_t kValidationCount = 100000;
+
+static void generateValidationMix(X86Assembler& a, const Label& L) {
+  using namespace x86;
+
+  const X86Gp& zsi = a.zsi();
+  const X86Gp& zdi = a.zdi();
+  const X86Gp& zbp = a.zbp();
+
+  a.push(zbp);
+  a.mov(eax, dword_ptr(zsi, 16));
+  a.add(eax, ecx);
+  a.add(eax, 100);
+  a.sub(edx, dword_ptr(zdi, zsi, 2, 8));
+  a.lea(ebx, ptr(zsi, zdi, 1, 4));
+  a.imul(eax, edx);
+  a.shl(eax, 3);
+  a.shr(edx, cl);
+  a.cmp(eax, 1000);
+  a.test(ecx, ecx);
+  a.xor_(edx, edx);
+  a.mov(dword_ptr(zdi, 4), eax);
+  a.movzx(eax, byte_ptr(zsi));
+  a.and_(ebx, 0xFF);
+  a.inc(ecx);
+  a.cmovz(eax, ebx);
+  a.setnz(al);
+  a.movaps(xmm0, xmm1);
+  a.addps(xmm0, ptr(zsi, 32));
+  a.mulss(xmm2, xmm3);
+  a.movdqu(xmm4, ptr(zdi));
+  a.vaddps(ymm0, ymm1, ymm2);
+  a.vmulpd(xmm3, xmm4, ptr(zsi, 64));
+  a.vfmadd231ps(ymm1, ymm2, ymm3);
+  a.pop(zbp);
+  a.jne(L);
+  a.call(L);
+  a.nop();
+}
+
+static void benchValidation(uint32_t archType) {
+  Performance perf;
+  uint32_t time[2];
+  size_t size = 0;
+
+  for (uint32_t strict = 0; strict < 2; strict++) {
+    perf.reset();
+    for (uint32_t r = 0; r < kNumRepeats; r++) {
+      CodeHolder code;
+      X86Assembler a;
+
+      code.init(CodeInfo(archType));
+      code.attach(&a);
+
+      if (strict)
+        a._globalOptions |= CodeEmitter::kOptionStrictValidation;
+
+      Label L = a.newLabel();
+      a.bind(L);
+
+      perf.start();
+      for (uint32_t i = 0; i < kValidationCount; i++)
+        generateValidationMix(a, L);
+      perf.end();
+
+      if (a.isInErrorState()) {
+        printf("%-12s (%s) | Failed\n", "Validation", archType == ArchInfo::kTypeX86 ? "X86" : "X64");
+        return;
+      }
+      size = code.getCodeSize();
+    }
+    time[strict] = perf.best;
+  }
+
+  printf("%-12s (%s) | Size: %u [kB] | Emit: %u [ms] | Strict: %u [ms] | Overhead: %.1f%%\n",
+    "Validation", archType == ArchInfo::kTypeX86 ? "X86" : "X64",
+    static_cast<unsigned int>(size / 1024), time[0], time[1],
+    time[0] ? (double(time[1]) - double(time[0])) * 100.0 / double(time[0]) : 0.0);
+}
+#endif // ASMJIT_BUILD_X86
+
+// ============================================================================
+// [Bench - Batch]
+// ============================================================================
+
+#if defined(ASMJIT_BUILD_X86)
+static const uint32_t kBatchCount = 200000;
+
+// Rounds of `kBatchCount` records emitted in each timed run, a single round is
+// too short to be measured in milliseconds.
+static const uint32_t kBatchRounds = 100;
+
+static void initBatchRecords(Inst::Record* records, uint32_t count, const Label& L) {
+  using namespace x86;
+
+  for (uint32_t i = 0; i < count; i++) {
+    Inst::Record& record = records[i];
+    int32_t disp = static_cast<int32_t>(i & 0xFF) * 8;
+
+    switch (i % 10) {
+      case 0: record.init(X86Inst::kIdMov, eax, dword_ptr(rsi, disp)); break;
+      case 1: record.init(X86Inst::kIdAdd, eax, ecx); break;
+      case 2: record.init(X86Inst::kIdAdd, rdx, imm(disp)); break;
+      case 3: record.init(X86Inst::kIdLea, rbx, ptr(rsi, rdi, 1, disp)); break;
+      case 4: record.init(X86Inst::kIdImul, eax, edx); break;
+      case 5: record.init(X86Inst::kIdMov, qword_ptr(rdi, disp), rax); break;
+      case 6: record.init(X86Inst::kIdCmp, eax, imm(1000)); break;
+      case 7: record.init(X86Inst::kIdMovdqu, xmm0, ptr(rsi, disp)); break;
+      case 8: record.init(X86Inst::kIdVaddps, ymm0, ymm1, ymm2); break;
+      case 9: record.init(X86Inst::kIdJne, L); break;
+    }
+  }
+}
+
+static void benchBatch() {
+  Inst::Record* records = static_cast<Inst::Record*>(::malloc(kBatchCount * sizeof(Inst::Record)));
+  if (!records) return;
+
+  Performance perf;
+  uint32_t time[2];
+  size_t size = 0;
+
+  for (uint32_t batch = 0; batch < 2; batch++) {
+    perf.reset();
+    for (uint32_t r = 0; r < kNumRepeats; r++) {
+      CodeHolder code;
+      X86Assembler a;
+
+      code.init(CodeInfo(ArchInfo::kTypeX64));
+      code.attach(&a);
+
+      Label L = a.newLabel();
+      a.bind(L);
+      initBatchRecords(records, kBatchCount, L);
+
+      perf.start();
+      for (uint32_t round = 0; round < kBatchRounds; round++) {
+        // Each round overwrites the previous one, the buffer grows only once.
+        a.setOffset(0);
+
+        if (batch) {
+          a.emitBatch(records, kBatchCount);
+        }
+        else {
+          for (uint32_t i = 0; i < kBatchCount; i++) {
+            const Inst::Record& record = records[i];
+            const Operand_* op = record.operands;
+
+            a.setOptions(record.options);
+            a.setExtraReg(record.extraReg);
+            a.emit(record.instId, op[0], op[1], op[2], op[3]);
+          }
+        }
+      }
+      perf.end();
+
+      if (a.isInErrorState()) {
+        printf("%-12s (X64) | Failed\n", "Batch");
+        ::free(records);
+        return;
+      }
+      size = code.getCodeSize();
+    }
+    time[batch] = perf.best;
+  }
+
+  printf("%-12s (X64) | Records: %u x %u | Size: %u [kB] | Emit: %u [ms] | Batch: %u [ms] | Speedup: %.2fx\n",
+    "Batch", kBatchCount, kBatchRounds, static_cast<unsigned int>(size / 1024), time[0], time[1],
+    time[1] ? double(time[0]) / double(time[1]) : 0.0);
+
+  ::free(records);
+}
+#endif // ASMJIT_BUILD_X86
+
 // ============================================================================
 // [Main]
 // ============================================================================
@@ -140,7 +1663,45 @@ int main(int argc, char* argv[]) {
 #if defined(ASMJIT_BUILD_X86)
   benchX86(ArchInfo::kTypeX86);
   benchX86(ArchInfo::kTypeX64);
+
+  benchCallInLoop(ArchInfo::kTypeX86);
+  benchCallInLoop(ArchInfo::kTypeX64);
+
+  benchExprEval(ArchInfo::kTypeX86);
+  benchExprEval(ArchInfo::kTypeX64);
+
+  benchConstPressure(ArchInfo::kTypeX86);
+  benchConstPressure(ArchInfo::kTypeX64);
+
+  benchSpillSlots(ArchInfo::kTypeX86);
+  benchSpillSlots(ArchInfo::kTypeX64);
+
+  benchLayout(ArchInfo::kTypeX86);
+  benchLayout(ArchInfo::kTypeX64);
+
+  benchSched();
+
+  benchIr(ArchInfo::kTypeX86);
+  benchIr(ArchInfo::kTypeX64);
+
+  benchStreaming(ArchInfo::kTypeX86);
+  benchStreaming(ArchInfo::kTypeX64);
+
+  benchEmitInPlace();
+  benchLabels();
+  benchFragment();
+  benchStencil();
+
+  benchValidation(ArchInfo::kTypeX86);
+  benchValidation(ArchInfo::kTypeX64);
+  benchBatch();
+
+#if ASMJIT_OS_POSIX
+  benchZoneCache();
+#endif // ASMJIT_OS_POSIX
 #endif // ASMJIT_BUILD_X86
 
+  benchHash();
+  benchVMem();
   return 0;
 }
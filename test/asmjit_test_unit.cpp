@@ -190,6 +190,7 @@ static void dumpSizeOf(void) {
   DUMP_TYPE(CodeHolder);
   DUMP_TYPE(ConstPool);
   DUMP_TYPE(LabelEntry);
+  DUMP_TYPE(LabelNameEntry);
   DUMP_TYPE(RelocEntry);
   DUMP_TYPE(Runtime);
   DUMP_TYPE(SectionEntry);
@@ -620,6 +620,59 @@ public:
   }
 };
 
+// ============================================================================
+// [X86Test_AllocCopyChain]
+// ============================================================================
+
+class X86Test_AllocCopyChain : public X86Test {
+public:
+  X86Test_AllocCopyChain() : X86Test("[Alloc] Copy chain") {}
+
+  static void add(X86TestManager& mgr) {
+    mgr.add(new X86Test_AllocCopyChain());
+  }
+
+  virtual void compile(X86Compiler& cc) {
+    cc.addFunc(FuncSignature1<int, int>(CallConv::kIdHost));
+
+    X86Gp cnt = cc.newInt32("cnt");
+    X86Gp x = cc.newInt32("x");
+    X86Gp y = cc.newInt32("y");
+    X86Gp t = cc.newInt32("t");
+    Label L_Loop = cc.newLabel();
+
+    cc.setArg(0, cnt);
+    cc.mov(x, 0);
+    cc.mov(y, 1);
+
+    // Fibonacci, `y` and `t` die at the copies, which rotates registers of
+    // `x`, `y`, and `t` in every iteration.
+    cc.bind(L_Loop);
+    cc.mov(t, x);
+    cc.add(t, y);
+    cc.mov(x, y);
+    cc.mov(y, t);
+    cc.dec(cnt);
+    cc.jnz(L_Loop);
+
+    cc.ret(x);
+    cc.endFunc();
+  }
+
+  virtual bool run(void* _func, StringBuilder& result, StringBuilder& expect) {
+    typedef int (*Func)(int);
+    Func func = ptr_as_func<Func>(_func);
+
+    int resultRet = func(20);
+    int expectRet = 6765;
+
+    result.setFormat("ret=%d", resultRet);
+    expect.setFormat("ret=%d", expectRet);
+
+    return resultRet == expectRet;
+  }
+};
+
 // ============================================================================
 // [X86Test_AllocManual]
 // ============================================================================
@@ -884,6 +937,229 @@ public:
   }
 };
 
+// ============================================================================
+// [X86Test_AllocRemat]
+// ============================================================================
+
+class X86Test_AllocRemat : public X86Test {
+public:
+  X86Test_AllocRemat() : X86Test("[Alloc] Remat") {}
+
+  enum { kCount = 20 };
+
+  static void add(X86TestManager& mgr) {
+    mgr.add(new X86Test_AllocRemat());
+  }
+
+  virtual void compile(X86Compiler& cc) {
+    cc.addFunc(FuncSignature2<int, int, int*>(CallConv::kIdHost));
+
+    X86Gp cnt = cc.newInt32("cnt");
+    X86Gp out = cc.newIntPtr("out");
+    X86Gp acc = cc.newInt32("acc");
+    X86Gp zero = cc.newInt32("zero");
+    X86Gp k[kCount];
+
+    uint32_t i;
+    Label L_Loop = cc.newLabel();
+
+    cc.setArg(0, cnt);
+    cc.setArg(1, out);
+
+    // More constants than registers, they are rematerialized in the loop.
+    for (i = 0; i < kCount; i++) {
+      k[i] = cc.newInt32("k%u", i);
+      cc.mov(k[i], static_cast<int>(i * 3 + 1));
+    }
+    cc.xor_(zero, zero);
+    cc.mov(acc, zero);
+
+    cc.bind(L_Loop);
+    for (i = 0; i < kCount; i++) {
+      cc.add(acc, k[i]);
+      cc.xor_(acc, k[kCount - 1 - i]);
+    }
+    cc.dec(cnt);
+    cc.jnz(L_Loop);
+
+    cc.mov(x86::dword_ptr(out), zero);
+    for (i = 0; i < kCount; i++)
+      cc.add(x86::dword_ptr(out), k[i]);
+
+    cc.ret(acc);
+    cc.endFunc();
+  }
+
+  virtual bool run(void* _func, StringBuilder& result, StringBuilder& expect) {
+    typedef int (*Func)(int, int*);
+    Func func = ptr_as_func<Func>(_func);
+
+    int resultSum = 0;
+    int resultRet = func(3, &resultSum);
+
+    int expectSum = 0;
+    int expectRet = 0;
+
+    for (int n = 0; n < 3; n++) {
+      for (int i = 0; i < kCount; i++) {
+        expectRet += i * 3 + 1;
+        expectRet ^= (kCount - 1 - i) * 3 + 1;
+      }
+    }
+
+    for (int i = 0; i < kCount; i++)
+      expectSum += i * 3 + 1;
+
+    result.setFormat("ret=%d sum=%d", resultRet, resultSum);
+    expect.setFormat("ret=%d sum=%d", expectRet, expectSum);
+
+    return resultRet == expectRet && resultSum == expectSum;
+  }
+};
+
+// ============================================================================
+// [X86Test_AllocRematFlags]
+// ============================================================================
+
+class X86Test_AllocRematFlags : public X86Test {
+public:
+  X86Test_AllocRematFlags() : X86Test("[Alloc] Remat (Flags)") {}
+
+  enum { kCount = 20 };
+
+  static void add(X86TestManager& mgr) {
+    mgr.add(new X86Test_AllocRematFlags());
+  }
+
+  virtual void compile(X86Compiler& cc) {
+    cc.addFunc(FuncSignature2<int, int, int>(CallConv::kIdHost));
+
+    X86Gp a = cc.newInt32("a");
+    X86Gp b = cc.newInt32("b");
+    X86Gp acc = cc.newInt32("acc");
+    X86Gp zero = cc.newInt32("zero");
+    X86Gp k[kCount];
+
+    uint32_t i;
+
+    cc.setArg(0, a);
+    cc.setArg(1, b);
+
+    // `zero` is evicted by the pressure below and rematerialized between
+    // `cmp` and `adc`, so its recipe must not clobber the carry flag.
+    cc.xor_(zero, zero);
+    cc.mov(acc, 100);
+
+    for (i = 0; i < kCount; i++) {
+      k[i] = cc.newInt32("k%u", i);
+      cc.lea(k[i], x86::ptr(a, static_cast<int>(i)));
+    }
+
+    cc.cmp(a, b);
+    cc.adc(acc, zero);
+
+    for (i = 0; i < kCount; i++)
+      cc.add(acc, k[i]);
+
+    cc.ret(acc);
+    cc.endFunc();
+  }
+
+  virtual bool run(void* _func, StringBuilder& result, StringBuilder& expect) {
+    typedef int (*Func)(int, int);
+    Func func = ptr_as_func<Func>(_func);
+
+    int resultRet = func(1, 5);
+    int expectRet = 100 + 1;
+
+    for (int i = 0; i < kCount; i++)
+      expectRet += 1 + i;
+
+    result.setFormat("ret=%d", resultRet);
+    expect.setFormat("ret=%d", expectRet);
+
+    return resultRet == expectRet;
+  }
+};
+
+// ============================================================================
+// [X86Test_AllocSpillSlots]
+// ============================================================================
+
+class X86Test_AllocSpillSlots : public X86Test {
+public:
+  X86Test_AllocSpillSlots() : X86Test("[Alloc] Spill slots") {}
+
+  enum { kBlockCount = 8, kTmpCount = 20 };
+
+  static void add(X86TestManager& mgr) {
+    mgr.add(new X86Test_AllocSpillSlots());
+  }
+
+  virtual void compile(X86Compiler& cc) {
+    cc.addFunc(FuncSignature1<int, const int*>(CallConv::kIdHost));
+
+    X86Gp src = cc.newIntPtr("src");
+    X86Gp sum = cc.newInt32("sum");
+
+    cc.setArg(0, src);
+    cc.xor_(sum, sum);
+
+    // Temporaries of each block spill, blocks don't interfere so their stack
+    // homes are shared.
+    for (uint32_t b = 0; b < kBlockCount; b++) {
+      X86Gp tmp[kTmpCount];
+      uint32_t i;
+
+      for (i = 0; i < kTmpCount; i++) {
+        tmp[i] = cc.newInt32("t%u_%u", b, i);
+        cc.mov(tmp[i], x86::dword_ptr(src, static_cast<int32_t>((b * kTmpCount + i) * 4)));
+      }
+
+      for (i = 0; i < kTmpCount; i++)
+        cc.imul(tmp[i], tmp[(i + 1) % kTmpCount]);
+
+      for (i = 0; i < kTmpCount; i++)
+        cc.add(sum, tmp[i]);
+    }
+
+    cc.ret(sum);
+    cc.endFunc();
+  }
+
+  virtual bool run(void* _func, StringBuilder& result, StringBuilder& expect) {
+    typedef int (*Func)(const int*);
+    Func func = ptr_as_func<Func>(_func);
+
+    int src[kBlockCount * kTmpCount];
+    int i;
+
+    for (i = 0; i < kBlockCount * kTmpCount; i++)
+      src[i] = i * 7 + 3;
+
+    int resultRet = func(src);
+    int expectRet = 0;
+
+    for (int b = 0; b < kBlockCount; b++) {
+      int tmp[kTmpCount];
+      for (i = 0; i < kTmpCount; i++)
+        tmp[i] = src[b * kTmpCount + i];
+
+      // Same order as the generated code, the last product uses updated `tmp[0]`.
+      for (i = 0; i < kTmpCount; i++)
+        tmp[i] *= tmp[(i + 1) % kTmpCount];
+
+      for (i = 0; i < kTmpCount; i++)
+        expectRet += tmp[i];
+    }
+
+    result.setFormat("ret=%d", resultRet);
+    expect.setFormat("ret=%d", expectRet);
+
+    return resultRet == expectRet;
+  }
+};
+
 // ============================================================================
 // [X86Test_AllocImul1]
 // ============================================================================
@@ -2818,6 +3094,88 @@ public:
   }
 };
 
+// ============================================================================
+// [X86Test_CallInLoop]
+// ============================================================================
+
+class X86Test_CallInLoop : public X86Test {
+public:
+  X86Test_CallInLoop() : X86Test("[Call] In Loop") {}
+
+  static void add(X86TestManager& mgr) {
+    mgr.add(new X86Test_CallInLoop());
+  }
+
+  static int calledFunc(int x) {
+    return x * 3 + 1;
+  }
+
+  virtual void compile(X86Compiler& cc) {
+    unsigned int k;
+
+    X86Gp buf = cc.newIntPtr("buf");
+    X86Gp cnt = cc.newInt32("cnt");
+    X86Gp idx = cc.newInt32("idx");
+    X86Gp ret = cc.newInt32("ret");
+    X86Gp acc[6];
+
+    Label L_Loop = cc.newLabel();
+
+    cc.addFunc(FuncSignature2<int, int*, int>(CallConv::kIdHost));
+    cc.setArg(0, buf);
+    cc.setArg(1, cnt);
+
+    // More values live across the call than preserved registers on X86.
+    for (k = 0; k < 6; k++) {
+      acc[k] = cc.newInt32("acc%u", k);
+      cc.mov(acc[k], static_cast<int>(k));
+    }
+    cc.xor_(idx, idx);
+
+    cc.bind(L_Loop);
+    cc.mov(ret, x86::dword_ptr(buf, idx, 2));
+
+    CCFuncCall* call = cc.call(imm_ptr(calledFunc), FuncSignature1<int, int>(CallConv::kIdHost));
+    call->setArg(0, ret);
+    call->setRet(0, ret);
+
+    for (k = 0; k < 6; k++) {
+      cc.add(acc[k], ret);
+      cc.add(acc[k], idx);
+    }
+
+    cc.inc(idx);
+    cc.cmp(idx, cnt);
+    cc.jne(L_Loop);
+
+    for (k = 1; k < 6; k++)
+      cc.xor_(acc[0], acc[k]);
+
+    cc.ret(acc[0]);
+    cc.endFunc();
+  }
+
+  virtual bool run(void* _func, StringBuilder& result, StringBuilder& expect) {
+    typedef int (*Func)(int*, int);
+    Func func = ptr_as_func<Func>(_func);
+
+    int buffer[8] = { 127, 87, 23, 17, 1, 0, -5, 1000 };
+    int acc[6] = { 0, 1, 2, 3, 4, 5 };
+
+    for (int i = 0; i < 8; i++)
+      for (int k = 0; k < 6; k++)
+        acc[k] += calledFunc(buffer[i]) + i;
+
+    int resultRet = func(buffer, 8);
+    int expectRet = acc[0] ^ acc[1] ^ acc[2] ^ acc[3] ^ acc[4] ^ acc[5];
+
+    result.setFormat("ret=%d", resultRet);
+    expect.setFormat("ret=%d", expectRet);
+
+    return resultRet == expectRet;
+  }
+};
+
 // ============================================================================
 // [X86Test_CallRecursive]
 // ============================================================================
@@ -3493,6 +3851,1081 @@ public:
   static void ASMJIT_FASTCALL handler() { longjmp(globalJmpBuf, 1); }
 };
 
+// ============================================================================
+// [X86Test_MiscLayout]
+// ============================================================================
+
+class X86Test_MiscLayout : public X86Test {
+public:
+  X86Test_MiscLayout() : X86Test("[Misc] Layout") {}
+
+  static void add(X86TestManager& mgr) {
+    mgr.add(new X86Test_MiscLayout());
+  }
+
+  static int ASMJIT_FASTCALL calledFunc(int x) { return x * 3; }
+
+  virtual void compile(X86Compiler& cc) {
+    // Align loop headers and keep branches off 32-byte boundaries, the hints
+    // are propagated to the assembler the code is serialized to.
+    cc.getCode()->addGlobalHints(CodeEmitter::kHintOptimizedAlign |
+                                 CodeEmitter::kHintAlignLoops     |
+                                 CodeEmitter::kHintAlignBranches  );
+
+    cc.addFunc(FuncSignature1<int, int>(CallConv::kIdHost));
+
+    X86Gp n = cc.newInt32("n");
+    X86Gp i = cc.newInt32("i");
+    X86Gp j = cc.newInt32("j");
+    X86Gp sum = cc.newInt32("sum");
+    X86Gp tmp = cc.newInt32("tmp");
+
+    Label L_Outer = cc.newLabel();
+    Label L_Inner = cc.newLabel();
+    Label L_Skip = cc.newLabel();
+    Label L_Next = cc.newLabel();
+
+    cc.setArg(0, n);
+    cc.xor_(sum, sum);
+    cc.xor_(i, i);
+
+    cc.bind(L_Outer);
+    cc.test(i, 1);
+    cc.jz(L_Skip);
+
+    // Odd `i` - add `i * 3` computed by a function call.
+    X86Gp fn = cc.newIntPtr("fn");
+    cc.mov(fn, imm_ptr(calledFunc));
+
+    CCFuncCall* call = cc.call(fn, FuncSignature1<int, int>(CallConv::kIdHostFastCall));
+    call->setArg(0, i);
+    call->setRet(0, tmp);
+    cc.add(sum, tmp);
+    cc.jmp(L_Next);
+
+    // Even `i` - add `i` one by one.
+    cc.bind(L_Skip);
+    cc.mov(j, i);
+    cc.test(j, j);
+    cc.jz(L_Next);
+
+    cc.bind(L_Inner);
+    cc.inc(sum);
+    cc.dec(j);
+    cc.jnz(L_Inner);
+
+    cc.bind(L_Next);
+    cc.inc(i);
+    cc.cmp(i, n);
+    cc.jb(L_Outer);
+
+    cc.ret(sum);
+    cc.endFunc();
+  }
+
+  virtual bool run(void* _func, StringBuilder& result, StringBuilder& expect) {
+    typedef int (*Func)(int);
+    Func func = ptr_as_func<Func>(_func);
+
+    int resultRet = func(100);
+    int expectRet = 0;
+
+    for (int i = 0; i < 100; i++)
+      expectRet += (i & 1) ? i * 3 : i;
+
+    result.setFormat("ret={%d}", resultRet);
+    expect.setFormat("ret={%d}", expectRet);
+
+    return resultRet == expectRet;
+  }
+};
+
+// ============================================================================
+// [X86Test_MiscSched]
+// ============================================================================
+
+class X86Test_MiscSched : public X86Test {
+public:
+  X86Test_MiscSched() : X86Test("[Misc] Sched") {}
+
+  static void add(X86TestManager& mgr) {
+    mgr.add(new X86Test_MiscSched());
+  }
+
+  virtual void compile(X86Compiler& cc) {
+    // Scheduler runs after the register allocator added by `X86Compiler`.
+    cc.addPassT<X86SchedPass>();
+    cc.addFunc(FuncSignature3<int, float*, const float*, int*>(CallConv::kIdHost));
+
+    X86Gp dst = cc.newIntPtr("dst");
+    X86Gp src = cc.newIntPtr("src");
+    X86Gp arr = cc.newIntPtr("arr");
+
+    cc.setArg(0, dst);
+    cc.setArg(1, src);
+    cc.setArg(2, arr);
+
+    // Four dependency chains written one after another.
+    X86Xmm v[4];
+    uint32_t i;
+
+    for (i = 0; i < 4; i++) {
+      v[i] = cc.newXmm("v%u", i);
+      cc.movups(v[i], x86::ptr(src, static_cast<int32_t>(i * 16)));
+      cc.mulps(v[i], v[i]);
+      cc.addps(v[i], x86::ptr(src, 64));
+      cc.divps(v[i], x86::ptr(src, 80));
+    }
+
+    cc.addps(v[0], v[1]);
+    cc.addps(v[2], v[3]);
+    cc.addps(v[0], v[2]);
+    cc.movups(x86::ptr(dst), v[0]);
+
+    // Integer chains, a store followed by a load of the same memory, and
+    // flags consumed by setcc.
+    X86Gp a = cc.newInt32("a");
+    X86Gp b = cc.newInt32("b");
+    X86Gp c = cc.newInt32("c");
+
+    cc.mov(a, x86::dword_ptr(arr, 0));
+    cc.imul(a, a, 7);
+    cc.add(a, 3);
+    cc.mov(x86::dword_ptr(arr, 4), a);
+    cc.mov(b, x86::dword_ptr(arr, 4));
+    cc.imul(b, b);
+    cc.mov(c, x86::dword_ptr(arr, 8));
+    cc.imul(c, c, 11);
+    cc.cmp(b, c);
+    cc.setg(c.r8());
+    cc.movzx(c, c.r8());
+    cc.add(b, c);
+    cc.add(b, a);
+
+    cc.ret(b);
+    cc.endFunc();
+  }
+
+  virtual bool run(void* _func, StringBuilder& result, StringBuilder& expect) {
+    typedef int (*Func)(float*, const float*, int*);
+    Func func = ptr_as_func<Func>(_func);
+
+    float src[24];
+    float dstResult[4];
+    float dstExpect[4];
+    int arr[3] = { 5, 0, 9 };
+    uint32_t i, j;
+
+    for (i = 0; i < 16; i++)
+      src[i] = static_cast<float>(i) * 0.25f - 1.0f;
+    for (i = 16; i < 20; i++)
+      src[i] = 0.5f;
+    for (i = 20; i < 24; i++)
+      src[i] = 2.0f;
+
+    for (j = 0; j < 4; j++) {
+      float x[4];
+      for (i = 0; i < 4; i++)
+        x[i] = (src[i * 4 + j] * src[i * 4 + j] + src[16 + j]) / src[20 + j];
+      dstExpect[j] = (x[0] + x[1]) + (x[2] + x[3]);
+    }
+
+    int a = 5 * 7 + 3;
+    int b = a * a;
+    int c = 9 * 11;
+    int expectRet = b + (b > c) + a;
+    int resultRet = func(dstResult, src, arr);
+
+    result.setFormat("ret={%d, %g, %g, %g, %g}", resultRet, dstResult[0], dstResult[1], dstResult[2], dstResult[3]);
+    expect.setFormat("ret={%d, %g, %g, %g, %g}", expectRet, dstExpect[0], dstExpect[1], dstExpect[2], dstExpect[3]);
+
+    return resultRet == expectRet && ::memcmp(dstResult, dstExpect, sizeof(dstResult)) == 0;
+  }
+};
+
+// ============================================================================
+// [X86Test_MiscCse]
+// ============================================================================
+
+class X86Test_MiscCse : public X86Test {
+public:
+  X86Test_MiscCse() : X86Test("[Misc] Cse") {}
+
+  static void add(X86TestManager& mgr) {
+    mgr.add(new X86Test_MiscCse());
+  }
+
+  virtual void compile(X86Compiler& cc) {
+    // Value numbering works on virtual registers, it must run before the
+    // register allocator added by `X86Compiler`.
+    cc.insertPass(0, cc.newPassT<X86CsePass>());
+    cc.addFunc(FuncSignature3<int, int*, intptr_t, float*>(CallConv::kIdHost));
+
+    X86Gp p = cc.newIntPtr("p");
+    X86Gp i = cc.newIntPtr("i");
+    X86Gp f = cc.newIntPtr("f");
+
+    cc.setArg(0, p);
+    cc.setArg(1, i);
+    cc.setArg(2, f);
+
+    // The same address computation and load, the second is eliminated.
+    X86Gp t1 = cc.newIntPtr("t1");
+    X86Gp t2 = cc.newIntPtr("t2");
+    X86Gp a = cc.newInt32("a");
+    X86Gp b = cc.newInt32("b");
+    X86Gp c = cc.newInt32("c");
+
+    cc.lea(t1, x86::ptr(p, i, 2, 8));
+    cc.mov(a, x86::dword_ptr(t1));
+    cc.lea(t2, x86::ptr(p, i, 2, 8));
+    cc.mov(b, x86::dword_ptr(t2));
+
+    // Store invalidates the loaded value, `c` must be loaded again.
+    cc.mov(x86::dword_ptr(p, i, 2, 8), 100);
+    cc.mov(c, x86::dword_ptr(t2));
+
+    // The same expression through copies, the flags of the second `add` are
+    // overwritten by the next `add` so it can be eliminated.
+    X86Gp x = cc.newInt32("x");
+    X86Gp y = cc.newInt32("y");
+
+    cc.mov(x, a);
+    cc.add(x, b);
+    cc.mov(y, a);
+    cc.add(y, b);
+    cc.add(x, y);
+    cc.add(x, c);
+
+    // Vector shuffles of the same input, the destination of the second one
+    // is also kept in a different register.
+    X86Xmm v = cc.newXmm("v");
+    X86Xmm s1 = cc.newXmm("s1");
+    X86Xmm s2 = cc.newXmm("s2");
+
+    cc.movups(v, x86::ptr(f));
+    cc.pshufd(s1, v, x86::shufImm(0, 1, 2, 3));
+    cc.pshufd(s2, v, x86::shufImm(0, 1, 2, 3));
+    cc.addps(s1, s2);
+    cc.movups(x86::ptr(f), s1);
+
+    cc.ret(x);
+    cc.endFunc();
+  }
+
+  virtual bool run(void* _func, StringBuilder& result, StringBuilder& expect) {
+    typedef int (*Func)(int*, intptr_t, float*);
+    Func func = ptr_as_func<Func>(_func);
+
+    int arr[8] = { 0, 0, 0, 0, 5, 0, 0, 0 };
+    float vec[4] = { 1.0f, 2.0f, 3.0f, 4.0f };
+
+    int resultRet = func(arr, 2, vec);
+    int expectRet = (5 + 5) + (5 + 5) + 100;
+
+    result.setFormat("ret={%d, %d, %g, %g, %g, %g}", resultRet, arr[4], vec[0], vec[1], vec[2], vec[3]);
+    expect.setFormat("ret={%d, %d, %g, %g, %g, %g}", expectRet, 100, 8.0, 6.0, 4.0, 2.0);
+
+    return resultRet == expectRet && arr[4] == 100 &&
+           vec[0] == 8.0f && vec[1] == 6.0f && vec[2] == 4.0f && vec[3] == 2.0f;
+  }
+};
+
+// ============================================================================
+// [X86Test_MiscJump]
+// ============================================================================
+
+class X86Test_MiscJump : public X86Test {
+public:
+  X86Test_MiscJump() : X86Test("[Misc] Jump") {}
+
+  static void add(X86TestManager& mgr) {
+    mgr.add(new X86Test_MiscJump());
+  }
+
+  virtual void compile(X86Compiler& cc) {
+    cc.insertPass(0, cc.newPassT<X86JumpPass>());
+    cc.addFunc(FuncSignature1<int, int>(CallConv::kIdHost));
+
+    X86Gp a = cc.newInt32("a");
+    X86Gp r = cc.newInt32("r");
+
+    Label L_Small = cc.newLabel();
+    Label L_Big   = cc.newLabel();
+    Label L_Fwd   = cc.newLabel();
+    Label L_Zero  = cc.newLabel();
+    Label L_Next  = cc.newLabel();
+    Label L_Done  = cc.newLabel();
+
+    cc.setArg(0, a);
+    cc.mov(r, 1);
+
+    // Jump to a forwarding block, threaded to `L_Zero`.
+    cc.cmp(a, 0);
+    cc.je(L_Fwd);
+
+    // Jcc followed by jmp, inverted to `jge L_Big`.
+    cc.cmp(a, 10);
+    cc.jl(L_Small);
+    cc.jmp(L_Big);
+
+    cc.bind(L_Small);
+    cc.mov(r, 2);
+    cc.jmp(L_Done);
+
+    cc.bind(L_Fwd);
+    cc.jmp(L_Zero);
+
+    cc.bind(L_Big);
+    cc.mov(r, 3);
+    cc.jmp(L_Next);
+
+    cc.bind(L_Zero);
+    cc.mov(r, 4);
+    cc.jmp(L_Next);
+
+    // Empty jumps, removed.
+    cc.bind(L_Next);
+    cc.jmp(L_Done);
+
+    cc.bind(L_Done);
+    cc.ret(r);
+    cc.endFunc();
+  }
+
+  virtual bool run(void* _func, StringBuilder& result, StringBuilder& expect) {
+    typedef int (*Func)(int);
+    Func func = ptr_as_func<Func>(_func);
+
+    int resultRet[3] = { func(0), func(5), func(20) };
+    int expectRet[3] = { 4, 2, 3 };
+
+    result.setFormat("ret={%d, %d, %d}", resultRet[0], resultRet[1], resultRet[2]);
+    expect.setFormat("ret={%d, %d, %d}", expectRet[0], expectRet[1], expectRet[2]);
+
+    return ::memcmp(resultRet, expectRet, sizeof(resultRet)) == 0;
+  }
+};
+
+// ============================================================================
+// [X86Test_MiscProfile]
+// ============================================================================
+
+class X86Test_MiscProfile : public X86Test {
+public:
+  X86Test_MiscProfile() : X86Test("[Misc] Profile"), _profile(nullptr), _atomicErr(kErrorOk) {
+    ::memset(_counts, 0, sizeof(_counts));
+    ::memset(_results, 0, sizeof(_results));
+  }
+
+  enum { kSiteCount = 6 };
+
+  static void add(X86TestManager& mgr) {
+    mgr.add(new X86Test_MiscProfile());
+  }
+
+  static void generate(X86Compiler& cc) {
+    cc.addFunc(FuncSignature1<int, int>(CallConv::kIdHost));
+
+    X86Gp a = cc.newInt32("a");
+    X86Gp r = cc.newInt32("r");
+
+    Label L_Neg  = cc.newLabel();
+    Label L_Pos  = cc.newLabel();
+    Label L_Done = cc.newLabel();
+
+    cc.setArg(0, a);
+    cc.mov(r, 0);
+
+    // Flags are live after `jl`, the counter must not change them.
+    cc.cmp(a, 0);
+    cc.jl(L_Neg);
+    cc.jg(L_Pos);
+
+    cc.mov(r, 100);
+    cc.jmp(L_Done);
+
+    cc.bind(L_Neg);
+    cc.mov(r, -1);
+    cc.jmp(L_Done);
+
+    cc.bind(L_Pos);
+    cc.mov(r, a);
+    cc.add(r, 1);
+
+    cc.bind(L_Done);
+    cc.ret(r);
+    cc.endFunc();
+  }
+
+  virtual void compile(X86Compiler& cc) {
+    typedef int (*Func)(int);
+
+    // Tier-1 - instrumented code.
+    CodeHolder code;
+    code.init(_runtime.getCodeInfo());
+
+    X86Compiler cc1(&code);
+    X86ProfilePass* instrument = cc1.newPassT<X86ProfilePass>(&_runtime);
+    cc1.insertPass(0, instrument);
+    generate(cc1);
+
+    Func func;
+    if (cc1.finalize() == kErrorOk && _runtime.add(&func, &code) == kErrorOk) {
+      for (int i = 1; i <= 200; i++)
+        _results[0] += func(i);
+      _results[1] = func(0);
+      _results[2] = func(-1);
+      _runtime.release(func);
+    }
+
+    for (uint32_t i = 0; i < kSiteCount; i++)
+      _counts[i] = i < instrument->getCounterCount() ? instrument->getCounters()[i] : 0;
+
+    // Flags are live after `jl`, which can't be counted atomically.
+    CodeHolder atomicCode;
+    atomicCode.init(_runtime.getCodeInfo());
+
+    X86Compiler cc2(&atomicCode);
+    X86ProfilePass* atomicInstrument = cc2.newPassT<X86ProfilePass>(&_runtime);
+    atomicInstrument->setAtomic(true);
+    cc2.insertPass(0, atomicInstrument);
+    generate(cc2);
+    _atomicErr = cc2.finalize();
+
+    if (atomicInstrument->getCounters())
+      _runtime.releaseCounters(atomicInstrument->getCounters());
+
+    // Tier-2 - cold blocks moved out of the hot path.
+    _profile = cc.newPassT<X86ProfilePass>(static_cast<const uint64_t*>(_counts), uint32_t(kSiteCount));
+    cc.insertPass(0, _profile);
+    generate(cc);
+  }
+
+  virtual bool run(void* _func, StringBuilder& result, StringBuilder& expect) {
+    typedef int (*Func)(int);
+    Func func = ptr_as_func<Func>(_func);
+
+    // Entry, `jl` and `jg` fall-through, `L_Neg`, `L_Pos`, and `L_Done`.
+    static const uint64_t expectCounts[kSiteCount] = { 202, 201, 1, 1, 200, 202 };
+    int trainRet = 20300 + 100 - 1;
+
+    int resultRet[3] = { func(-5), func(0), func(7) };
+    int expectRet[3] = { -1, 100, 8 };
+
+    result.setFormat("ret={%d, %d, %d} train=%d counts={%u, %u, %u, %u, %u, %u} cold=%u atomic=%u",
+      resultRet[0], resultRet[1], resultRet[2], _results[0] + _results[1] + _results[2],
+      unsigned(_counts[0]), unsigned(_counts[1]), unsigned(_counts[2]),
+      unsigned(_counts[3]), unsigned(_counts[4]), unsigned(_counts[5]),
+      _profile->getColdCount(), _atomicErr);
+    expect.setFormat("ret={%d, %d, %d} train=%d counts={%u, %u, %u, %u, %u, %u} cold=%u atomic=%u",
+      expectRet[0], expectRet[1], expectRet[2], trainRet,
+      unsigned(expectCounts[0]), unsigned(expectCounts[1]), unsigned(expectCounts[2]),
+      unsigned(expectCounts[3]), unsigned(expectCounts[4]), unsigned(expectCounts[5]),
+      2U, unsigned(kErrorInvalidState));
+
+    return result.eq(expect);
+  }
+
+  JitRuntime _runtime;
+  X86ProfilePass* _profile;
+  uint64_t _counts[kSiteCount];
+  int _results[3];
+  Error _atomicErr;
+};
+
+// ============================================================================
+// [X86Test_MiscProfileTail]
+// ============================================================================
+
+class X86Test_MiscProfileTail : public X86Test {
+public:
+  X86Test_MiscProfileTail() : X86Test("[Misc] Profile (Tail)"), _profile(nullptr) {
+    ::memset(_counts, 0, sizeof(_counts));
+  }
+
+  enum { kSiteCount = 3 };
+
+  static void add(X86TestManager& mgr) {
+    mgr.add(new X86Test_MiscProfileTail());
+  }
+
+  static void generate(X86Compiler& cc) {
+    cc.addFunc(FuncSignature2<void, int, int*>(CallConv::kIdHost));
+
+    X86Gp a = cc.newInt32("a");
+    X86Gp r = cc.newInt32("r");
+    X86Gp out = cc.newIntPtr("out");
+
+    Label L_Store = cc.newLabel();
+
+    cc.setArg(0, a);
+    cc.setArg(1, out);
+    cc.mov(r, a);
+
+    cc.cmp(a, 0);
+    cc.jg(L_Store);
+    cc.add(r, 100);
+
+    // The last block falls through to the end of the function, it must not
+    // fall into the cold block that is moved after it.
+    cc.bind(L_Store);
+    cc.mov(x86::dword_ptr(out), r);
+    cc.endFunc();
+  }
+
+  virtual void compile(X86Compiler& cc) {
+    typedef void (*Func)(int, int*);
+
+    // Tier-1 - instrumented code, flags are not live at any site, so the
+    // counters can be incremented atomically.
+    CodeHolder code;
+    code.init(_runtime.getCodeInfo());
+
+    X86Compiler cc1(&code);
+    X86ProfilePass* instrument = cc1.newPassT<X86ProfilePass>(&_runtime);
+    instrument->setAtomic(true);
+    cc1.insertPass(0, instrument);
+    generate(cc1);
+
+    Func func;
+    if (cc1.finalize() == kErrorOk && _runtime.add(&func, &code) == kErrorOk) {
+      int dummy;
+      for (int i = 0; i <= 200; i++)
+        func(i, &dummy);
+      _runtime.release(func);
+    }
+
+    for (uint32_t i = 0; i < kSiteCount; i++)
+      _counts[i] = i < instrument->getCounterCount() ? instrument->getCounters()[i] : 0;
+
+    // Tier-2 - the `a <= 0` block is moved out of the hot path.
+    _profile = cc.newPassT<X86ProfilePass>(static_cast<const uint64_t*>(_counts), uint32_t(kSiteCount));
+    cc.insertPass(0, _profile);
+    generate(cc);
+  }
+
+  virtual bool run(void* _func, StringBuilder& result, StringBuilder& expect) {
+    typedef void (*Func)(int, int*);
+    Func func = ptr_as_func<Func>(_func);
+
+    // Entry, `jg` fall-through, and `L_Store`.
+    static const uint64_t expectCounts[kSiteCount] = { 201, 1, 201 };
+
+    int resultRet[3] = { 0, 0, 0 };
+    int expectRet[3] = { 1, 100, 97 };
+
+    func(1, &resultRet[0]);
+    func(0, &resultRet[1]);
+    func(-3, &resultRet[2]);
+
+    result.setFormat("ret={%d, %d, %d} counts={%u, %u, %u} cold=%u",
+      resultRet[0], resultRet[1], resultRet[2],
+      unsigned(_counts[0]), unsigned(_counts[1]), unsigned(_counts[2]),
+      _profile->getColdCount());
+    expect.setFormat("ret={%d, %d, %d} counts={%u, %u, %u} cold=%u",
+      expectRet[0], expectRet[1], expectRet[2],
+      unsigned(expectCounts[0]), unsigned(expectCounts[1]), unsigned(expectCounts[2]),
+      1U);
+
+    return result.eq(expect);
+  }
+
+  JitRuntime _runtime;
+  X86ProfilePass* _profile;
+  uint64_t _counts[kSiteCount];
+};
+
+// ============================================================================
+// [X86Test_MiscInline]
+// ============================================================================
+
+class X86Test_MiscInline : public X86Test {
+public:
+  X86Test_MiscInline() : X86Test("[Misc] Inline"), _inline(nullptr) {}
+
+  static void add(X86TestManager& mgr) {
+    mgr.add(new X86Test_MiscInline());
+  }
+
+  virtual void compile(X86Compiler& cc) {
+    _inline = cc.newPassT<X86InlinePass>();
+    cc.insertPass(0, _inline);
+
+    FuncSignature2<int, int*, int> mainSig(CallConv::kIdHost);
+    FuncSignature2<int, int, int> combineSig(CallConv::kIdHost);
+    FuncSignature1<int, int*> loadSig(CallConv::kIdHost);
+
+    CCFunc* mainFunc = cc.newFunc(mainSig);
+    CCFunc* combineFunc = cc.newFunc(combineSig);
+    CCFunc* loadFunc = cc.newFunc(loadSig);
+
+    {
+      X86Gp p = cc.newIntPtr("p");
+      X86Gp a = cc.newInt32("a");
+      X86Gp r = cc.newInt32("r");
+
+      cc.addFunc(mainFunc);
+      cc.setArg(0, p);
+      cc.setArg(1, a);
+
+      CCFuncCall* call = cc.call(loadFunc->getLabel(), loadSig);
+      call->setArg(0, p);
+      call->setRet(0, r);
+
+      call = cc.call(combineFunc->getLabel(), combineSig);
+      call->setArg(0, r);
+      call->setArg(1, a);
+      call->setRet(0, r);
+
+      call = cc.call(combineFunc->getLabel(), combineSig);
+      call->setArg(0, r);
+      call->setArg(1, imm(7));
+      call->setRet(0, r);
+
+      cc.ret(r);
+      cc.endFunc();
+    }
+
+    // hashCombine(a, b) - `a ^ (b + 0x9E3779B9 + (a << 6) + (a >> 2))`.
+    {
+      X86Gp a = cc.newInt32("a");
+      X86Gp b = cc.newInt32("b");
+      X86Gp t = cc.newInt32("t");
+
+      cc.addFunc(combineFunc);
+      cc.setArg(0, a);
+      cc.setArg(1, b);
+
+      cc.add(b, 0x9E3779B9);
+      cc.mov(t, a);
+      cc.shl(t, 6);
+      cc.add(b, t);
+      cc.mov(t, a);
+      cc.shr(t, 2);
+      cc.add(b, t);
+      cc.xor_(a, b);
+      cc.ret(a);
+      cc.endFunc();
+    }
+
+    // load(p) - `p ? *p : -1`, two returns.
+    {
+      X86Gp p = cc.newIntPtr("p");
+      X86Gp r = cc.newInt32("r");
+      Label L_Null = cc.newLabel();
+
+      cc.addFunc(loadFunc);
+      cc.setArg(0, p);
+
+      cc.test(p, p);
+      cc.jz(L_Null);
+      cc.mov(r, x86::dword_ptr(p));
+      cc.ret(r);
+
+      cc.bind(L_Null);
+      cc.mov(r, -1);
+      cc.ret(r);
+      cc.endFunc();
+    }
+  }
+
+  static uint32_t hashCombine(uint32_t a, uint32_t b) {
+    return a ^ (b + 0x9E3779B9U + (a << 6) + (a >> 2));
+  }
+
+  virtual bool run(void* _func, StringBuilder& result, StringBuilder& expect) {
+    typedef int (*Func)(int*, int);
+    Func func = ptr_as_func<Func>(_func);
+
+    int value = 1234;
+    int resultRet[2] = { func(&value, 42), func(nullptr, 42) };
+    int expectRet[2] = {
+      int(hashCombine(hashCombine(1234U, 42U), 7U)),
+      int(hashCombine(hashCombine(uint32_t(-1), 42U), 7U))
+    };
+
+    result.setFormat("ret={%d, %d} inlined=%u", resultRet[0], resultRet[1], _inline->getInlinedCount());
+    expect.setFormat("ret={%d, %d} inlined=%u", expectRet[0], expectRet[1], 3U);
+
+    return result.eq(expect);
+  }
+
+  X86InlinePass* _inline;
+};
+
+// ============================================================================
+// [X86Test_MiscStreaming]
+// ============================================================================
+
+class X86Test_MiscStreaming : public X86Test {
+public:
+  X86Test_MiscStreaming() : X86Test("[Misc] Streaming"), _released(false) {}
+
+  static void add(X86TestManager& mgr) {
+    mgr.add(new X86Test_MiscStreaming());
+  }
+
+  virtual void compile(X86Compiler& cc) {
+    FuncSignature2<int, int, int> sumSig(CallConv::kIdHost);
+    Label L_Sum = cc.newLabel();
+
+    cc.setStreaming(true);
+
+    // main(p) - `sum(p[0], p[1]) + 100`.
+    {
+      X86Gp p = cc.newIntPtr("p");
+      X86Gp a = cc.newInt32("a");
+      X86Gp b = cc.newInt32("b");
+
+      cc.addFunc(FuncSignature1<int, int*>(CallConv::kIdHost));
+      cc.setArg(0, p);
+
+      cc.mov(a, x86::dword_ptr(p, 0));
+      cc.mov(b, x86::dword_ptr(p, 4));
+
+      CCFuncCall* call = cc.call(L_Sum, sumSig);
+      call->setArg(0, a);
+      call->setArg(1, b);
+      call->setRet(0, a);
+
+      cc.add(a, cc.newInt32Const(kConstScopeGlobal, 100));
+      cc.ret(a);
+      cc.endFunc();
+    }
+
+    _released = cc.getFirstNode() == nullptr && cc.getVirtRegArray().getLength() == 0;
+
+    // sum(a, b) - `a * 3 + b + 100 + 7`, called before it's bound.
+    {
+      X86Gp a = cc.newInt32("a");
+      X86Gp b = cc.newInt32("b");
+
+      cc.bind(L_Sum);
+      cc.addFunc(sumSig);
+      cc.setArg(0, a);
+      cc.setArg(1, b);
+
+      cc.imul(a, a, 3);
+      cc.add(a, b);
+      cc.add(a, cc.newInt32Const(kConstScopeGlobal, 100));
+      cc.add(a, cc.newInt32Const(kConstScopeLocal, 7));
+      cc.ret(a);
+      cc.endFunc();
+    }
+  }
+
+  virtual bool run(void* _func, StringBuilder& result, StringBuilder& expect) {
+    typedef int (*Func)(int*);
+    Func func = ptr_as_func<Func>(_func);
+
+    int values[2] = { 5, 9 };
+    int resultRet = func(values);
+    int expectRet = (5 * 3 + 9 + 100 + 7) + 100;
+
+    result.setFormat("ret=%d released=%u", resultRet, unsigned(_released));
+    expect.setFormat("ret=%d released=%u", expectRet, 1U);
+
+    return result.eq(expect);
+  }
+
+  bool _released;
+};
+
+// ============================================================================
+// [X86Test_MiscStreamingError]
+// ============================================================================
+
+class X86Test_MiscStreamingError : public X86Test {
+public:
+  X86Test_MiscStreamingError()
+    : X86Test("[Misc] Streaming (Error)"),
+      _endFuncErr(kErrorOk),
+      _finalizeErr(kErrorOk),
+      _endFuncNull(false),
+      _released(false) {}
+
+  static void add(X86TestManager& mgr) {
+    mgr.add(new X86Test_MiscStreamingError());
+  }
+
+  virtual void compile(X86Compiler& cc) {
+    // A function that fails to serialize, `mov` can't have two memory operands.
+    {
+      CodeHolder code;
+      code.init(CodeInfo(ArchInfo::kTypeHost));
+
+      X86Compiler cc1(&code);
+      cc1.setStreaming(true);
+
+      X86Gp p = cc1.newIntPtr("p");
+      cc1.addFunc(FuncSignature1<void, int*>(CallConv::kIdHost));
+      cc1.setArg(0, p);
+      cc1.emit(X86Inst::kIdMov, x86::dword_ptr(p), x86::dword_ptr(p, 4));
+
+      _endFuncNull = cc1.endFunc() == nullptr;
+      _endFuncErr = cc1.getLastError();
+      _released = cc1.getFirstNode() == nullptr;
+      _finalizeErr = cc1.finalize();
+    }
+
+    cc.addFunc(FuncSignature0<int>(CallConv::kIdHost));
+    X86Gp r = cc.newInt32("r");
+    cc.mov(r, 1);
+    cc.ret(r);
+    cc.endFunc();
+  }
+
+  virtual bool run(void* _func, StringBuilder& result, StringBuilder& expect) {
+    typedef int (*Func)(void);
+    Func func = ptr_as_func<Func>(_func);
+
+    result.setFormat("ret=%d endFunc={null=%u err=%u} released=%u finalize=%u",
+      func(), unsigned(_endFuncNull), _endFuncErr, unsigned(_released), _finalizeErr);
+    expect.setFormat("ret=%d endFunc={null=%u err=%u} released=%u finalize=%u",
+      1, 1U, unsigned(kErrorInvalidInstruction), 1U, unsigned(kErrorInvalidInstruction));
+
+    return result.eq(expect);
+  }
+
+  Error _endFuncErr;
+  Error _finalizeErr;
+  bool _endFuncNull;
+  bool _released;
+};
+
+// ============================================================================
+// [X86Test_MiscFragment]
+// ============================================================================
+
+class X86Test_MiscFragment : public X86Test {
+public:
+  X86Test_MiscFragment() : X86Test("[Misc] Fragment") {}
+
+  static void add(X86TestManager& mgr) {
+    mgr.add(new X86Test_MiscFragment());
+  }
+
+  virtual void compile(X86Compiler& cc) {
+    cc.addFunc(FuncSignature3<int, int, int, int*>(CallConv::kIdHost));
+
+    X86Gp a = cc.newInt32("a");
+    X86Gp b = cc.newInt32("b");
+    X86Gp p = cc.newIntPtr("p");
+    X86Gp q = cc.newIntPtr("q");
+
+    cc.setArg(0, a);
+    cc.setArg(1, b);
+    cc.setArg(2, p);
+    cc.mov(q, p);
+    cc.add(q, 4);
+
+    // `x = abs(x) * 3 + y + [ptr]`, recorded while emitted.
+    CBNode* prev = cc.getCursor();
+    Label L_Pos = cc.newLabel();
+
+    cc.cmp(a, 0);
+    cc.jge(L_Pos);
+    cc.neg(a);
+    cc.bind(L_Pos);
+    cc.imul(a, a, 3);
+    cc.add(a, b);
+    cc.add(a, x86::dword_ptr(p));
+
+    CBFragment fragment;
+    Operand params[3] = { a, b, p };
+
+    // Replayed with other registers, `L_Pos` is replaced by a new label.
+    Operand args0[3] = { b, a, q };
+    Operand args1[3] = { a, b, p };
+
+    if (fragment.init(prev->getNext(), cc.getCursor(), params, 3) == kErrorOk) {
+      fragment.emit(&cc, args0, 3);
+      fragment.emit(&cc, args1, 3);
+    }
+
+    cc.ret(a);
+    cc.endFunc();
+  }
+
+  virtual bool run(void* _func, StringBuilder& result, StringBuilder& expect) {
+    typedef int (*Func)(int, int, int*);
+    Func func = ptr_as_func<Func>(_func);
+
+    int values[2] = { 7, -11 };
+    int resultRet = func(-5, 4, values);
+
+    int a = -5, b = 4;
+    a = (a < 0 ? -a : a) * 3 + b + values[0];
+    b = (b < 0 ? -b : b) * 3 + a + values[1];
+    a = (a < 0 ? -a : a) * 3 + b + values[0];
+    int expectRet = a;
+
+    result.setFormat("ret=%d", resultRet);
+    expect.setFormat("ret=%d", expectRet);
+
+    return resultRet == expectRet;
+  }
+};
+
+// ============================================================================
+// [X86Test_MiscFragmentImm]
+// ============================================================================
+
+class X86Test_MiscFragmentImm : public X86Test {
+public:
+  X86Test_MiscFragmentImm() : X86Test("[Misc] FragmentImm"), _errOk(0xFFFFFFFFU), _errInvalid(0xFFFFFFFFU) {}
+
+  static void add(X86TestManager& mgr) {
+    mgr.add(new X86Test_MiscFragmentImm());
+  }
+
+  virtual void compile(X86Compiler& cc) {
+    // A validated fragment emitted into a strict assembler must still reject
+    // an immediate that is out of range of the recorded instruction.
+    CBFragment fragment;
+    {
+      CodeHolder code1;
+      X86Compiler cc1;
+
+      code1.init(CodeInfo(ArchInfo::kTypeX64));
+      code1.attach(&cc1);
+
+      CBNode* prev = cc1.getCursor();
+      cc1.pshufd(x86::xmm0, x86::xmm1, imm(1));
+
+      Operand params[1] = { imm(1) };
+      if (fragment.init(prev ? prev->getNext() : cc1.getFirstNode(), cc1.getCursor(), params, 1) != kErrorOk ||
+          fragment.validate(ArchInfo::kTypeX64) != kErrorOk)
+        fragment.reset();
+    }
+
+    if (fragment.isInitialized()) {
+      CodeHolder code2;
+      X86Assembler a;
+
+      code2.init(CodeInfo(ArchInfo::kTypeX64));
+      code2.attach(&a);
+      a._globalOptions |= CodeEmitter::kOptionStrictValidation;
+
+      Operand args0[1] = { imm(0x12) };
+      Operand args1[1] = { imm(0x1234) };
+
+      _errOk = fragment.emit(&a, args0, 1);
+      _errInvalid = fragment.emit(&a, args1, 1);
+    }
+
+    cc.addFunc(FuncSignature0<int>(CallConv::kIdHost));
+
+    X86Gp x = cc.newInt32("x");
+    cc.mov(x, 1);
+    cc.ret(x);
+
+    cc.endFunc();
+  }
+
+  virtual bool run(void* _func, StringBuilder& result, StringBuilder& expect) {
+    typedef int (*Func)(void);
+    Func func = ptr_as_func<Func>(_func);
+
+    int resultRet = func();
+    int expectRet = 1;
+
+    result.setFormat("ret=%d, errOk=%u, errInvalid=%u", resultRet, _errOk, _errInvalid);
+    expect.setFormat("ret=%d, errOk=%u, errInvalid=%u", expectRet, kErrorOk, kErrorInvalidImmediate);
+
+    return result.eq(expect);
+  }
+
+  uint32_t _errOk;
+  uint32_t _errInvalid;
+};
+
+// ============================================================================
+// [X86Test_MiscUnwindStateSwitch]
+// ============================================================================
+
+class X86Test_MiscUnwindStateSwitch : public X86Test {
+public:
+  enum { kCount = 20 };
+
+  X86Test_MiscUnwindStateSwitch() : X86Test("[Misc] UnwindStateSwitch"), _code(NULL) {}
+
+  static void add(X86TestManager& mgr) {
+    mgr.add(new X86Test_MiscUnwindStateSwitch());
+  }
+
+  virtual void compile(X86Compiler& cc) {
+    _code = cc.getCode();
+    cc.addFunc(FuncSignature2<int, int*, int>(CallConv::kIdHost));
+
+    X86Gp p = cc.newIntPtr("p");
+    X86Gp x = cc.newInt32("x");
+    X86Gp sum = cc.newInt32("sum");
+    X86Gp v[kCount];
+
+    cc.setArg(0, p);
+    cc.setArg(1, x);
+
+    uint32_t i;
+    for (i = 0; i < kCount; i++) {
+      v[i] = cc.newInt32("v%u", i);
+      cc.mov(v[i], x86::dword_ptr(p, i * 4));
+    }
+
+    // The jump skips code that spills and reloads some variables, which
+    // requires code that switches the state to be injected after the epilog.
+    Label L_Skip = cc.newLabel();
+    cc.test(x, x);
+    cc.jz(L_Skip);
+
+    for (i = 0; i < kCount; i++)
+      cc.add(v[i], x);
+
+    cc.bind(L_Skip);
+    cc.xor_(sum, sum);
+
+    i = kCount;
+    while (i != 0)
+      cc.add(sum, v[--i]);
+
+    cc.ret(sum);
+    cc.endFunc();
+  }
+
+  virtual bool run(void* _func, StringBuilder& result, StringBuilder& expect) {
+    typedef int (*Func)(int*, int);
+    Func func = ptr_as_func<Func>(_func);
+
+    int values[kCount];
+    for (uint32_t i = 0; i < kCount; i++)
+      values[i] = int(i);
+
+    // The function's unwind range must cover the code after the epilog.
+    const ZoneVector<UnwindEntry*>& entries = _code->getUnwindEntries();
+    unsigned int covered = 0;
+
+    if (entries.getLength() == 1 && entries[0]->getEpilogLabelId()) {
+      const LabelEntry* epilog = _code->getLabelEntry(entries[0]->getEpilogLabelId());
+      const LabelEntry* end = _code->getLabelEntry(entries[0]->getEndLabelId());
+      size_t codeSize = _code->getSectionEntry(0)->getBuffer().getLength();
+
+      covered = epilog->getOffset() < end->getOffset() &&
+                static_cast<size_t>(end->getOffset()) == codeSize;
+    }
+
+    int resultRet0 = func(values, 0);
+    int resultRet1 = func(values, 1);
+
+    result.setFormat("ret={%d, %d} covered=%u", resultRet0, resultRet1, covered);
+    expect.setFormat("ret={%d, %d} covered=%u", 190, 190 + kCount, 1U);
+
+    return result.eq(expect);
+  }
+
+  CodeHolder* _code;
+};
+
 // ============================================================================
 // [X86Test_Bug100]
 // ============================================================================
@@ -3606,10 +5039,14 @@ int main(int argc, char* argv[]) {
 
   // Alloc.
   ADD_TEST(X86Test_AllocBase);
+  ADD_TEST(X86Test_AllocCopyChain);
   ADD_TEST(X86Test_AllocManual);
   ADD_TEST(X86Test_AllocUseMem);
   ADD_TEST(X86Test_AllocMany1);
   ADD_TEST(X86Test_AllocMany2);
+  ADD_TEST(X86Test_AllocRemat);
+  ADD_TEST(X86Test_AllocRematFlags);
+  ADD_TEST(X86Test_AllocSpillSlots);
   ADD_TEST(X86Test_AllocImul1);
   ADD_TEST(X86Test_AllocImul2);
   ADD_TEST(X86Test_AllocIdiv1);
@@ -3645,6 +5082,7 @@ int main(int argc, char* argv[]) {
   ADD_TEST(X86Test_CallDoubleAsXmmRet);
   ADD_TEST(X86Test_CallConditional);
   ADD_TEST(X86Test_CallMultiple);
+  ADD_TEST(X86Test_CallInLoop);
   ADD_TEST(X86Test_CallRecursive);
   ADD_TEST(X86Test_CallMisc1);
   ADD_TEST(X86Test_CallMisc2);
@@ -3658,6 +5096,18 @@ int main(int argc, char* argv[]) {
   ADD_TEST(X86Test_MiscMultiFunc);
   ADD_TEST(X86Test_MiscFastEval);
   ADD_TEST(X86Test_MiscUnfollow);
+  ADD_TEST(X86Test_MiscLayout);
+  ADD_TEST(X86Test_MiscSched);
+  ADD_TEST(X86Test_MiscCse);
+  ADD_TEST(X86Test_MiscJump);
+  ADD_TEST(X86Test_MiscProfile);
+  ADD_TEST(X86Test_MiscProfileTail);
+  ADD_TEST(X86Test_MiscInline);
+  ADD_TEST(X86Test_MiscStreaming);
+  ADD_TEST(X86Test_MiscStreamingError);
+  ADD_TEST(X86Test_MiscFragment);
+  ADD_TEST(X86Test_MiscFragmentImm);
+  ADD_TEST(X86Test_MiscUnwindStateSwitch);
 
   // Bugs.
   ADD_TEST(X86Test_Bug100);